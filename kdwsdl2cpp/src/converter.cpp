@@ -408,7 +408,7 @@ void Converter::convertTypes()
 
 // Helper for clientstub and serverstub
 KODE::Code Converter::serializePart(const Part &part, const QString &localVariableName, const QString &nilVariableName, const QString &varName,
-                                    bool append)
+                                    bool append, bool useContentsWriter)
 {
     bool qualified, nillable;
     const QName elemName = elementNameForPart(part, &qualified, &nillable);
@@ -418,5 +418,6 @@ KODE::Code Converter::serializePart(const Part &part, const QString &localVariab
     serializer.setIsQualified(qualified);
     serializer.setNillable(nillable);
     serializer.setOptional(false); // Don't omit entire parts, this especially breaks the wrappers for RPC messages
+    serializer.setUseContentsWriter(useContentsWriter);
     return serializer.generateSerializationCode();
 }
@@ -16,6 +16,8 @@
 #include "namemapper.h"
 #include "typemap.h"
 
+class ElementArgumentSerializer;
+
 #ifdef NDEBUG
 #define COMMENT QString()
 #else
@@ -60,6 +62,9 @@ private:
 
     void convertComplexType(const XSD::ComplexType *);
     void createComplexTypeSerializer(KODE::Class &, const XSD::ComplexType *);
+    KODE::Code createElementXmlWriter(const XSD::Element &elem, const ElementArgumentSerializer &serializer, const QString &localVariableName,
+                                      bool direct, bool *needsValues) const;
+    void createComplexTypePullParser(KODE::Class &, const XSD::ComplexType *, const XSD::Element::List &, const XSD::Attribute::List &);
 
     void convertSimpleType(const XSD::SimpleType *, const XSD::SimpleType::List &simpleTypeList);
     void createSimpleTypeSerializer(KODE::Class &, const XSD::SimpleType *, const XSD::SimpleType::List &simpleTypeList);
@@ -76,10 +81,11 @@ private:
     void clientGenerateMessage(KODE::Code &code, const Binding &binding, const Message &message, const Operation &operation,
                                bool varsAreMembers = false);
     void addMessageArgument(KODE::Code &code, const SoapBinding::Style &bindingStyle, const Part &part, const QString &localVariableName,
-                            const QByteArray &messageName, bool varIsMember = false);
+                            const QByteArray &messageName, bool varIsMember = false, bool useContentsWriter = false);
     void createHeader(const SoapBinding::Header &header, KODE::Class &newClass);
     void addJobResultMember(KODE::Class &jobClass, const Part &part, const QString &varName, const QStringList &inputGetters);
-    KODE::Code serializePart(const Part &part, const QString &localVariableName, const QString &nilVariableName, const QString &varName, bool append);
+    KODE::Code serializePart(const Part &part, const QString &localVariableName, const QString &nilVariableName, const QString &varName, bool append,
+                             bool useContentsWriter = false);
 
     void addVariableInitializer(KODE::MemberVariable &variable) const;
 
@@ -97,7 +103,7 @@ private:
     void convertServerService();
     void generateServerMethod(KODE::Code &code, const Binding &binding, const Operation &operation, KODE::Class &newClass, bool first);
     void generateDelayedReponseMethod(const QString &methodName, const QString &retInputType, const Part &retPart, KODE::Class &newClass,
-                                      const Binding &binding, const Message &outputMessage);
+                                      const Binding &binding, const Message &outputMessage, bool useContentsWriter);
 
     SoapBinding::Style soapStyle(const Binding &binding) const;
 
@@ -609,7 +609,7 @@ QName Converter::elementNameForPart(const Part &part, bool *qualified, bool *nil
 }
 
 void Converter::addMessageArgument(KODE::Code &code, const SoapBinding::Style &bindingStyle, const Part &part, const QString &localVariableName,
-                                   const QByteArray &messageName, bool varIsMember)
+                                   const QByteArray &messageName, bool varIsMember, bool useContentsWriter)
 {
     const QString partname =
         varIsMember ? KODE::MemberVariable::memberVariableName(localVariableName) : mNameMapper.escape(lowerlize(localVariableName));
@@ -617,7 +617,7 @@ void Converter::addMessageArgument(KODE::Code &code, const SoapBinding::Style &b
     // In document style, the "part" is directly added as arguments
     // See https://www.ibm.com/developerworks/webservices/library/ws-whichwsdl/
     if (bindingStyle == SoapBinding::DocumentStyle) {
-        code.addBlock(serializePart(part, partname, nilPartname, messageName, false));
+        code.addBlock(serializePart(part, partname, nilPartname, messageName, false, useContentsWriter));
     } else {
         const QString argType = mTypeMap.localType(part.type(), part.element());
         if (argType != QLatin1String("void")) {
@@ -631,6 +631,7 @@ void Converter::clientGenerateMessage(KODE::Code &code, const Binding &binding,
 {
     code += "KDSoapMessage message;";
 
+    bool useContentsWriter = false;
     if (binding.type() == Binding::SOAPBinding) {
         const SoapBinding soapBinding = binding.soapBinding();
         const SoapBinding::Operation op = soapBinding.operations().value(operation.name());
@@ -638,6 +639,7 @@ void Converter::clientGenerateMessage(KODE::Code &code, const Binding &binding,
             code += "message.setUse(KDSoapMessage::EncodedUse);";
         } else {
             code += "message.setUse(KDSoapMessage::LiteralUse);";
+            useContentsWriter = Settings::self()->generateXmlWriters(); // writeXml() only does literal
         }
         // qDebug() << "input headers:" << op.inputHeaders().count();
 
@@ -650,7 +652,7 @@ void Converter::clientGenerateMessage(KODE::Code &code, const Binding &binding,
 
     for (const Part &part : selectedParts(binding, message, operation, true /*input*/)) {
         isBuiltin = isBuiltin || mTypeMap.isBuiltinType(part.type(), part.element());
-        addMessageArgument(code, soapStyle(binding), part, part.name(), "message", varsAreMembers);
+        addMessageArgument(code, soapStyle(binding), part, part.name(), "message", varsAreMembers, useContentsWriter);
     }
 
     if (soapStyle(binding) == SoapBinding::DocumentStyle && message.parts().size() > 1 && isBuiltin) {
@@ -698,17 +700,36 @@ bool Converter::convertClientCall(const Operation &operation, const Binding &bin
     KODE::Code code;
     const bool hasAction = clientAddAction(code, binding, operation.name());
     clientGenerateMessage(code, binding, inputMessage, operation);
+
+    // Return value(s) :
+    const Part::List outParts = selectedParts(binding, outputMessage, operation, false /*output*/);
+    const int numReturnValues = outParts.count();
+
+    // With -pull-parsers, a complex response is deserialized while the reply is being parsed
+    bool pullResponse = false;
+    if (Settings::self()->generatePullParsers() && numReturnValues == 1 && soapStyle(binding) == SoapBinding::DocumentStyle) {
+        const Part &retPart = outParts.first();
+        pullResponse = mTypeMap.isComplexType(retPart.type(), retPart.element()) && !mTypeMap.isPolymorphic(retPart.type(), retPart.element())
+            && mTypeMap.localType(retPart.type(), retPart.element()) != QLatin1String("void");
+    }
+
     QString callLine =
         QLatin1String("d_ptr->m_lastReply = clientInterface()->call(QLatin1String(\"") + operation.name() + QLatin1String("\"), message");
     if (hasAction) {
         callLine += QLatin1String(", action");
+    } else if (pullResponse) {
+        callLine += QLatin1String(", QString()");
+    }
+    if (pullResponse) {
+        code += mTypeMap.localType(outParts.first().type(), outParts.first().element()) + QLatin1String(" ret;") + COMMENT;
+        code += callLine + QLatin1String(", KDSoapHeaders(),");
+        code.indent();
+        code += "[&ret](QXmlStreamReader& reader, const QXmlStreamNamespaceDeclarations& namespaces) { ret.deserialize(reader, namespaces); });";
+        code.unindent();
+    } else {
+        callLine += QLatin1String(");");
+        code += callLine;
     }
-    callLine += QLatin1String(");");
-    code += callLine;
-
-    // Return value(s) :
-    const Part::List outParts = selectedParts(binding, outputMessage, operation, false /*output*/);
-    const int numReturnValues = outParts.count();
 
     if (numReturnValues == 1) {
         const Part &retPart = outParts.first();
@@ -728,7 +749,9 @@ bool Converter::convertClientCall(const Operation &operation, const Binding &bin
         // WARNING: if you change the logic below, also adapt the result parsing for async calls
 
         if (retType != QLatin1String("void")) {
-            if (soapStyle(binding) == SoapBinding::DocumentStyle /*no wrapper*/) {
+            if (pullResponse) {
+                code += QLatin1String("return ret;") + COMMENT;
+            } else if (soapStyle(binding) == SoapBinding::DocumentStyle /*no wrapper*/) {
                 code += retType + QLatin1String(" ret;"); // local var
                 code.addBlock(deserializeRetVal(retPart, QLatin1String("d_ptr->m_lastReply"), retType, QLatin1String("ret")));
                 code += QLatin1String("return ret;") + COMMENT;
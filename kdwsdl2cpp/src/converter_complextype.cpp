@@ -514,10 +514,17 @@ void Converter::createComplexTypeSerializer(KODE::Class &newClass, const XSD::Co
     }
 
     KODE::Code marshalCode, demarshalCode;
+    // writeXml(), with -xml-writers: the same as serialize(), but written into a QXmlStreamWriter right away
+    const bool xmlWriters = Settings::self()->generateXmlWriters();
+    bool directXmlWriter = true;
+    bool xmlWriterNeedsValues = false;
+    bool xmlWriterHasAttributes = false;
+    KODE::Code xmlWriterCode, xmlWriterAttributesCode;
 
     const QString typeArgs = namespaceString(type->nameSpace()) + QLatin1String(", QString::fromLatin1(\"") + type->name() + QLatin1String("\")");
 
     if (type->baseTypeName() != XmlAnyType && !type->baseTypeName().isEmpty() && !type->isArray()) {
+        directXmlWriter = false;
 
         const QName baseName = type->baseTypeName();
 
@@ -581,6 +588,7 @@ void Converter::createComplexTypeSerializer(KODE::Class &newClass, const XSD::Co
     }
 
     if (type->isArray()) {
+        directXmlWriter = false;
         if (elements.count() != 1) {
             qDebug() << "array" << type->name() << "has" << elements.count() << "elements!";
         }
@@ -653,6 +661,15 @@ void Converter::createComplexTypeSerializer(KODE::Class &newClass, const XSD::Co
                 marshalCode.unindent();
                 marshalCode += '}';
 
+                if (xmlWriters && directXmlWriter) {
+                    const bool direct = !elem.hasSubstitutions() && !mTypeMap.isPolymorphic(elem.type());
+                    xmlWriterCode += QLatin1String("for (int i = 0; i < ") + variableName + QLatin1String(".count(); ++i) {") + COMMENT;
+                    xmlWriterCode.indent();
+                    xmlWriterCode.addBlock(createElementXmlWriter(elem, serializer, localVariableName, direct, &xmlWriterNeedsValues));
+                    xmlWriterCode.unindent();
+                    xmlWriterCode += '}';
+                }
+
                 ElementArgumentSerializer deserializer(mTypeMap, elem.type(), QName(), variableName, nilVariableName);
                 deserializer.setOptional(isElementOptional(elem));
                 demarshalCode.addBlock(deserializer.demarshalArray("val"));
@@ -670,6 +687,20 @@ void Converter::createComplexTypeSerializer(KODE::Class &newClass, const XSD::Co
                 serializer.setNillable(elem.nillable());
                 marshalCode.addBlock(serializer.generateSerializationCode());
 
+                if (xmlWriters && directXmlWriter) {
+                    const bool direct = !elem.hasSubstitutions() && !usePointer && !elem.nillable() && !mTypeMap.isPolymorphic(elem.type());
+                    KODE::Code elemCode = createElementXmlWriter(elem, serializer, variableName, direct, &xmlWriterNeedsValues);
+                    if (direct && optional) {
+                        xmlWriterCode += QLatin1String("if (!") + nilVariableName + QLatin1String(") {") + COMMENT;
+                        xmlWriterCode.indent();
+                        xmlWriterCode.addBlock(elemCode);
+                        xmlWriterCode.unindent();
+                        xmlWriterCode += '}';
+                    } else {
+                        xmlWriterCode.addBlock(elemCode);
+                    }
+                }
+
                 demarshalCode.addBlock(serializer.demarshalVariable("val"));
             }
 
@@ -711,6 +742,8 @@ void Converter::createComplexTypeSerializer(KODE::Class &newClass, const XSD::Co
             serializer.setNillable(false);
             serializer.setOptional(attribute.attributeUse() == XSD::Attribute::Optional || attribute.attributeUse() == XSD::Attribute::Prohibited);
             marshalCode.addBlock(serializer.generateSerializationCode());
+            xmlWriterAttributesCode.addBlock(serializer.generateSerializationCode());
+            xmlWriterHasAttributes = true;
 
             demarshalCode.addBlock(serializer.demarshalVariable("val"));
 
@@ -730,4 +763,225 @@ void Converter::createComplexTypeSerializer(KODE::Class &newClass, const XSD::Co
 
     deserializeFunc.setBody(demarshalCode);
     newClass.addFunction(deserializeFunc);
+
+    if (xmlWriters) {
+        newClass.addHeaderInclude(QLatin1String("QtCore/QXmlStreamWriter"));
+        KODE::Function writeXmlFunc(QLatin1String("writeXml"), QLatin1String("void"));
+        writeXmlFunc.addArgument(QLatin1String("QXmlStreamWriter& writer"));
+        writeXmlFunc.addArgument(QLatin1String("const QString& messageNamespace"));
+        if (!type->derivedTypes().isEmpty()) {
+            writeXmlFunc.setVirtualMode(KODE::Function::Virtual);
+        }
+        if (!newClass.baseClasses().isEmpty()) {
+            writeXmlFunc.setVirtualMode(KODE::Function::Override);
+        }
+        writeXmlFunc.setConst(true);
+        KODE::Code code;
+        if (!directXmlWriter) {
+            // Not worth it, these are rare
+            code += QLatin1String("serialize(QString()).writeLiteralContents(writer, messageNamespace);") + COMMENT;
+        } else {
+            if (xmlWriterNeedsValues) {
+                code += QLatin1String("KDSoapValueList _values;") + COMMENT;
+            }
+            if (xmlWriterHasAttributes) {
+                code += "KDSoapValueList attribs;";
+                code.addBlock(xmlWriterAttributesCode);
+                code += "KDSoapValue _attributes(QString(), QVariant());";
+                code += "_attributes.childValues().attributes() = attribs;";
+                code += QLatin1String("_attributes.writeLiteralContents(writer, messageNamespace);") + COMMENT;
+            }
+            if (!xmlWriterHasAttributes && elements.isEmpty()) {
+                code += "Q_UNUSED(writer);";
+                code += "Q_UNUSED(messageNamespace);";
+            }
+            code.addBlock(xmlWriterCode);
+        }
+        writeXmlFunc.setBody(code);
+        newClass.addFunction(writeXmlFunc);
+    }
+
+    if (Settings::self()->generatePullParsers()) {
+        createComplexTypePullParser(newClass, type, elements, attributes);
+    }
+}
+
+// Writes one element for writeXml(): complex values are written by their own writeXml(),
+// other values are serialized into a KDSoapValue, like in serialize(), and written right away.
+KODE::Code Converter::createElementXmlWriter(const XSD::Element &elem, const ElementArgumentSerializer &serializer, const QString &localVariableName,
+                                             bool direct, bool *needsValues) const
+{
+    KODE::Code code;
+    if (!direct || !mTypeMap.isComplexType(elem.type())) {
+        *needsValues = true;
+        ElementArgumentSerializer valuesSerializer(serializer);
+        valuesSerializer.setOutputVariable(QLatin1String("_values"), true);
+        code.addBlock(valuesSerializer.generateSerializationCode());
+        code += QLatin1String("for (const KDSoapValue& _value : qAsConst(_values)) {") + COMMENT;
+        code.indent();
+        code += "_value.writeLiteralElement(writer, messageNamespace);";
+        code.unindent();
+        code += "}";
+        code += "_values.clear();";
+        return code;
+    }
+
+    // Same rules as KDSoapValue::writeElement. serialize() qualifies the value itself when its first element is qualified.
+    bool qualified = elem.isQualified();
+    const XSD::ComplexType complexType = mWSDL.findComplexType(elem.type());
+    for (const XSD::Element &childElem : complexType.elements()) {
+        if (mTypeMap.localType(childElem.type()) != QLatin1String("void")) {
+            qualified = qualified || childElem.isQualified();
+            break;
+        }
+    }
+    const QName qualName = elem.qualifiedName();
+    const QString nameArg = QLatin1String("QString::fromLatin1(\"") + qualName.localName() + QLatin1String("\")");
+    const QString nsArg = namespaceString(qualName.nameSpace());
+    if (qualified) {
+        code += QLatin1String("writer.writeStartElement(") + (qualName.nameSpace().isEmpty() ? QLatin1String("messageNamespace") : nsArg)
+            + QLatin1String(", ") + nameArg + QLatin1String(");") + COMMENT;
+    } else if (!qualName.nameSpace().isEmpty()) {
+        code += QLatin1String("if (") + nsArg + QLatin1String(" != messageNamespace)") + COMMENT;
+        code.indent();
+        code += QLatin1String("writer.writeStartElement(") + nsArg + QLatin1String(", ") + nameArg + QLatin1String(");");
+        code.unindent();
+        code += "else";
+        code.indent();
+        code += QLatin1String("writer.writeStartElement(") + nameArg + QLatin1String(");");
+        code.unindent();
+    } else {
+        code += QLatin1String("writer.writeStartElement(") + nameArg + QLatin1String(");") + COMMENT;
+    }
+    code += localVariableName + QLatin1String(".writeXml(writer, messageNamespace);");
+    code += "writer.writeEndElement();";
+    return code;
+}
+
+// deserialize(QXmlStreamReader&): fills in the members while reading the XML, without building a KDSoapValue tree.
+// Only complex members are read that way, the other ones go through KDSoapValue::readElement and the usual demarshalling.
+void Converter::createComplexTypePullParser(KODE::Class &newClass, const XSD::ComplexType *type, const XSD::Element::List &elements,
+                                            const XSD::Attribute::List &attributes)
+{
+    newClass.addHeaderInclude(QLatin1String("QtCore/QXmlStreamReader"));
+
+    KODE::Function deserializeFunc(QLatin1String("deserialize"), QLatin1String("void"));
+    deserializeFunc.addArgument(QLatin1String("QXmlStreamReader& reader"));
+    deserializeFunc.addArgument(
+        KODE::Function::Argument(QLatin1String("const QXmlStreamNamespaceDeclarations& namespaces"), QLatin1String("QXmlStreamNamespaceDeclarations()")));
+    if (!type->derivedTypes().isEmpty()) {
+        deserializeFunc.setVirtualMode(KODE::Function::Virtual);
+    }
+    if (!newClass.baseClasses().isEmpty()) {
+        deserializeFunc.setVirtualMode(KODE::Function::Override);
+    }
+
+    KODE::Code code;
+    if ((type->baseTypeName() != XmlAnyType && !type->baseTypeName().isEmpty()) || type->isArray()) {
+        // Not worth it, these are rare
+        code += QLatin1String("deserialize(KDSoapValue::readElement(reader, namespaces));") + COMMENT;
+        deserializeFunc.setBody(code);
+        newClass.addFunction(deserializeFunc);
+        return;
+    }
+
+    // Most elements don't declare namespaces, then the declarations of the parent are shared
+    code += QLatin1String("QXmlStreamNamespaceDeclarations _namespaces = namespaces;") + COMMENT;
+    code += "const QXmlStreamNamespaceDeclarations _declarations = reader.namespaceDeclarations();";
+    code += "if (!_declarations.isEmpty()) {";
+    code.indent();
+    code += "_namespaces += _declarations;";
+    code.unindent();
+    code += "}";
+
+    bool hasAttributes = false;
+    for (const XSD::Attribute &attribute : qAsConst(attributes)) {
+        hasAttributes = hasAttributes || !attribute.name().isEmpty();
+    }
+    if (hasAttributes) {
+        code += "const QXmlStreamAttributes _attributes = reader.attributes();";
+        code += "for (const QXmlStreamAttribute& _attribute : _attributes) {";
+        code.indent();
+        code += "const auto _name = _attribute.name();";
+        code += "const KDSoapValue val(_name.toString(), _attribute.value().toString());";
+        bool first = true;
+        for (const XSD::Attribute &attribute : qAsConst(attributes)) {
+            const QString attrName = attribute.name();
+            if (attrName.isEmpty()) {
+                continue;
+            }
+            const QString variableName = QLatin1String("d_ptr->") + KODE::MemberVariable::memberVariableName(attrName);
+            const QString nilVariableName = QLatin1String("d_ptr->") + KODE::MemberVariable::memberVariableName(attrName + "_nil");
+
+            code.addBlock(demarshalNameTest(attribute.type(), attrName, &first));
+            code.indent();
+            ElementArgumentSerializer serializer(mTypeMap, attribute.type(), QName(), variableName, nilVariableName);
+            serializer.setOptional(attribute.attributeUse() == XSD::Attribute::Optional || attribute.attributeUse() == XSD::Attribute::Prohibited);
+            code.addBlock(serializer.demarshalVariable("val"));
+            code.unindent();
+            code += "}";
+        }
+        code.unindent();
+        code += "}";
+    }
+
+    code += QLatin1String("while (reader.readNextStartElement()) {") + COMMENT;
+    code.indent();
+    code += "const auto _name = reader.name();";
+    bool first = true;
+    bool hasAny = false;
+    for (const XSD::Element &elem : qAsConst(elements)) {
+        const QString elemName = elem.name();
+        const QString typeName = mTypeMap.localType(elem.type());
+        const QString variableName = QLatin1String("d_ptr->") + KODE::MemberVariable::memberVariableName(elemName);
+        const QString nilVariableName = QLatin1String("d_ptr->") + KODE::MemberVariable::memberVariableName(elemName + "_nil");
+        const bool isList = elem.maxOccurs() > 1 || elem.compositor().maxOccurs() > 1;
+        const bool optional = isElementOptional(elem);
+
+        hasAny = hasAny || (elem.type().nameSpace() == XMLSchemaURI && elem.type().localName() == QLatin1String("any"));
+        code.addBlock(demarshalNameTest(elem.type(), elemName, &first));
+        code.indent();
+
+        const bool pullable = mTypeMap.isComplexType(elem.type()) && !mTypeMap.isPolymorphic(elem.type())
+            && !usePointerForElement(elem, newClass, mTypeMap, isList);
+        if (pullable && isList) {
+            const QString tempVar = KODE::MemberVariable::memberVariableName(elemName) + QLatin1String("Temp");
+            code += typeName + QLatin1String(" ") + tempVar + QLatin1String(";") + COMMENT;
+            code += tempVar + QLatin1String(".deserialize(reader, _namespaces);");
+            code += variableName + QLatin1String(".append(") + tempVar + QLatin1String(");");
+            if (optional) {
+                code += nilVariableName + QLatin1String(" = false;");
+            }
+        } else if (pullable) {
+            code += variableName + QLatin1String(".deserialize(reader, _namespaces);") + COMMENT;
+            if (optional) {
+                code += nilVariableName + QLatin1String(" = false;");
+            }
+        } else {
+            code += QLatin1String("const KDSoapValue val = KDSoapValue::readElement(reader, _namespaces);") + COMMENT;
+            ElementArgumentSerializer deserializer(mTypeMap, elem.type(), QName(), variableName, nilVariableName);
+            deserializer.setOptional(optional);
+            if (isList) {
+                code.addBlock(deserializer.demarshalArray("val"));
+            } else {
+                deserializer.setUsePointer(usePointerForElement(elem, newClass, mTypeMap, false));
+                code.addBlock(deserializer.demarshalVariable("val"));
+            }
+        }
+
+        code.unindent();
+        code += "}";
+    }
+    if (!hasAny) {
+        code += QString::fromLatin1(first ? "{" : "else {");
+        code.indent();
+        code += "reader.skipCurrentElement();";
+        code.unindent();
+        code += "}";
+    }
+    code.unindent();
+    code += "}";
+
+    deserializeFunc.setBody(code);
+    newClass.addFunction(deserializeFunc);
 }
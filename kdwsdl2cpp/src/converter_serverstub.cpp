@@ -178,6 +178,9 @@ void Converter::generateServerMethod(KODE::Code &code, const Binding &binding, c
             // isComplex = mTypeMap.isComplexType( outPart.type(), outPart.element() );
             retPart = outPart;
         }
+        // writeXml() only does literal
+        const bool useContentsWriter = Settings::self()->generateXmlWriters() && binding.type() == Binding::SOAPBinding
+            && binding.soapBinding().operations().value(operation.name()).output().use() != SoapBinding::EncodedUse;
         const QString methodCall = methodName + '(' + inputVars.join(", ") + ')';
         if (retType == "void") {
             code += methodCall + ";" + COMMENT;
@@ -189,11 +192,11 @@ void Converter::generateServerMethod(KODE::Code &code, const Binding &binding, c
 
         // TODO factorize with same code in next method
         if (soapStyle(binding) == SoapBinding::DocumentStyle) {
-            code.addBlock(serializePart(retPart, "ret", "ret_nil", responseVarName, false));
+            code.addBlock(serializePart(retPart, "ret", "ret_nil", responseVarName, false, useContentsWriter));
         } else {
             code += QString("KDSoapValue wrapper(\"%1\", QVariant(), \"%2\");").arg(outputMessage.name()).arg(outputMessage.nameSpace());
             code.addBlock(serializePart(retPart, "ret", "ret_nil", "wrapper.childValues()", true));
-            code += responseVarName + " = wrapper;";
+            code += responseVarName + " = std::move(wrapper);";
         }
 
         code.unindent();
@@ -203,7 +206,7 @@ void Converter::generateServerMethod(KODE::Code &code, const Binding &binding, c
 
         newClass.addIncludes(mTypeMap.headerIncludes(retPart.type()), mTypeMap.forwardDeclarationsForElement(retPart.element()));
 
-        generateDelayedReponseMethod(methodName, retInputType, retPart, newClass, binding, outputMessage);
+        generateDelayedReponseMethod(methodName, retInputType, retPart, newClass, binding, outputMessage, useContentsWriter);
     }
     code.unindent();
     code += "}";
@@ -212,7 +215,7 @@ void Converter::generateServerMethod(KODE::Code &code, const Binding &binding, c
 }
 
 void Converter::generateDelayedReponseMethod(const QString &methodName, const QString &retInputType, const Part &retPart, KODE::Class &newClass,
-                                             const Binding &binding, const Message &outputMessage)
+                                             const Binding &binding, const Message &outputMessage, bool useContentsWriter)
 {
     const QString delayedMethodName = methodName + "Response";
     KODE::Function delayedMethod(delayedMethodName);
@@ -224,11 +227,11 @@ void Converter::generateDelayedReponseMethod(const QString &methodName, const QS
     code.addLine("KDSoapMessage _response;");
 
     if (soapStyle(binding) == SoapBinding::DocumentStyle) {
-        code.addBlock(serializePart(retPart, "ret", "ret_nil", "_response", false));
+        code.addBlock(serializePart(retPart, "ret", "ret_nil", "_response", false, useContentsWriter));
     } else {
         code += QString("KDSoapValue wrapper(\"%1\", QVariant(), \"%2\");").arg(outputMessage.name()).arg(outputMessage.nameSpace());
         code.addBlock(serializePart(retPart, "ret", "ret_nil", "wrapper.childValues()", true));
-        code += "_response = wrapper;";
+        code += "_response = std::move(wrapper);";
     }
 
     code.addLine("sendDelayedResponse(responseHandle, _response);");
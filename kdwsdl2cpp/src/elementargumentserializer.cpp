@@ -22,6 +22,7 @@ ElementArgumentSerializer::ElementArgumentSerializer(const TypeMap &typeMap, con
     , mNillable(false)
     , mOptional(false)
     , mUsePointer(false)
+    , mUseContentsWriter(false)
 {
 }
 
@@ -106,7 +107,24 @@ KODE::Code ElementArgumentSerializer::generateSerializationCode() const
             block.indent();
         }
 
-        if (isComplex) {
+        if (isComplex && mUseContentsWriter && !isPolymorphic && !mUsePointer && !mAppend && !mNillable) {
+            // The message only gets a name here, its contents are written when it's sent
+            const QString qtTypeName = mTypeMap.localType(mType, mElementType);
+            const QString contentsVarName = mValueVarName + QLatin1String("Contents");
+            block += QLatin1String("KDSoapValue ") + mValueVarName + QLatin1Char('(') + mNameArg + QLatin1String(", QVariant());") + COMMENT;
+            if (!mNameNamespace.isEmpty()) {
+                block += mValueVarName + QLatin1String(".setNamespaceUri(") + mNameNamespace + QLatin1String(");");
+            }
+            if (mIsQualified) {
+                block += mValueVarName + QLatin1String(".setQualified(true);");
+            }
+            block += mOutputVarName + QLatin1String(" = std::move(") + mValueVarName + QLatin1String(");");
+            block += QLatin1String("const ") + qtTypeName + QLatin1Char(' ') + contentsVarName + QLatin1String(" = ") + mLocalVarName + QLatin1String(";");
+            block += mOutputVarName + QLatin1String(".setContentsWriter([") + contentsVarName
+                + QLatin1String("](QXmlStreamWriter& writer, const QString& messageNamespace) { ") + contentsVarName
+                + QLatin1String(".writeXml(writer, messageNamespace); });");
+            return block;
+        } else if (isComplex) {
             const QString op = (isPolymorphic || mUsePointer) ? "->" : ".";
             block += QLatin1String("KDSoapValue ") + mValueVarName + QLatin1Char('(') + mLocalVarName + op + QLatin1String("serialize(") + mNameArg
                 + QLatin1String("));") + COMMENT;
@@ -129,7 +147,8 @@ KODE::Code ElementArgumentSerializer::generateSerializationCode() const
         if (mNillable) {
             block += mValueVarName + QLatin1String(".setNillable(true);");
         }
-        block += varAndMethodBefore + mValueVarName + varAndMethodAfter + QLatin1String(";") + COMMENT;
+        // The value isn't used anymore, move it rather than copying it
+        block += varAndMethodBefore + QLatin1String("std::move(") + mValueVarName + QLatin1String(")") + varAndMethodAfter + QLatin1String(";") + COMMENT;
 
         if (mAppend && mOptional) {
             block.unindent();
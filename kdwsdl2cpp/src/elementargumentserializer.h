@@ -87,6 +87,13 @@ public:
      */
     void setUsePointer(bool usePointer);
 
+    /**
+     * @brief sets whether a complex value assigned to a message (append == false) should be
+     * written by its writeXml() method, see KDSoapMessage::setContentsWriter
+     * The default is false.
+     */
+    void setUseContentsWriter(bool useContentsWriter);
+
     /**
      * The main method: generate the serialization code.
      * @return the generated code
@@ -126,6 +133,7 @@ private:
     bool mNillable;
     bool mOptional;
     bool mUsePointer;
+    bool mUseContentsWriter;
 };
 
 #endif // ELEMENTARGUMENTSERIALIZER_H
@@ -69,6 +69,10 @@ static void showHelp(const char *appName)
             "  -no-sync                  Do not generate synchronous API methods to the client code\n"
             "  -no-async                 Do not generate asynchronous API methods to the client code\n"
             "  -no-async-jobs            Do not generate asynchronous job API classes to the client code\n"
+            "  -pull-parsers             Generate deserialize(QXmlStreamReader&) methods, used by the\n"
+            "                            synchronous API methods to read responses straight from the XML\n"
+            "  -xml-writers              Generate writeXml(QXmlStreamWriter&) methods, used to send\n"
+            "                            literal requests and responses without building KDSoapValues\n"
             "\n",
             appName, appName, appName);
 }
@@ -96,6 +100,8 @@ int main(int argc, char **argv)
     bool useLocalFilesOnly = false;
     bool helpOnMissing = false;
     bool skipAsync = false, skipSync = false, skipAsyncJobs = false;
+    bool pullParsers = false;
+    bool xmlWriters = false;
 #if !defined(QT_NO_SSL)
     QString pkcs12File, pkcs12Password;
 #endif
@@ -238,6 +244,10 @@ int main(int argc, char **argv)
             skipAsync = true;
         } else if (opt == QLatin1String("-no-async-jobs")) {
             skipAsyncJobs = true;
+        } else if (opt == QLatin1String("-pull-parsers")) {
+            pullParsers = true;
+        } else if (opt == QLatin1String("-xml-writers")) {
+            xmlWriters = true;
         } else if (!fileName) {
             fileName = argv[arg];
         } else {
@@ -294,6 +304,8 @@ int main(int argc, char **argv)
     Settings::self()->setSkipSync(skipSync);
     Settings::self()->setSkipAsync(skipAsync);
     Settings::self()->setSkipAsyncJobs(skipAsyncJobs);
+    Settings::self()->setGeneratePullParsers(pullParsers);
+    Settings::self()->setGenerateXmlWriters(xmlWriters);
 
     KWSDL::Compiler compiler;
 #if !defined(QT_NO_SSL)
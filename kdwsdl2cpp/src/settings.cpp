@@ -264,3 +264,23 @@ bool Settings::helpOnMissing() const
 {
     return mHelpOnMissing;
 }
+
+bool Settings::generatePullParsers() const
+{
+    return mGeneratePullParsers;
+}
+
+void Settings::setGeneratePullParsers(bool b)
+{
+    mGeneratePullParsers = b;
+}
+
+bool Settings::generateXmlWriters() const
+{
+    return mGenerateXmlWriters;
+}
+
+void Settings::setGenerateXmlWriters(bool b)
+{
+    mGenerateXmlWriters = b;
+}
@@ -87,6 +87,12 @@ public:
     bool skipAsyncJobs() const;
     void setSkipAsyncJobs(bool skipAsyncJobs);
 
+    bool generatePullParsers() const;
+    void setGeneratePullParsers(bool b);
+
+    bool generateXmlWriters() const;
+    void setGenerateXmlWriters(bool b);
+
 private:
     friend class SettingsSingleton;
     Settings();
@@ -110,6 +116,8 @@ private:
     bool mSkipSync = false;
     bool mSkipAsync = false;
     bool mSkipAsyncJobs = false;
+    bool mGeneratePullParsers = false;
+    bool mGenerateXmlWriters = false;
 };
 
 #endif
@@ -0,0 +1,169 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2010-2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#include "KDSoapAtomTable_p.h"
+#include "KDSoapNamespaceManager.h"
+#include <QMultiHash>
+#include <QReadWriteLock>
+#include <QThreadStorage>
+
+// Element and type names come from the network, don't let them grow the table forever
+static const int s_maxAtoms = 10000;
+
+static QString toQString(const QString &str)
+{
+    return str;
+}
+
+template<typename String>
+static QString toQString(const String &str)
+{
+    return str.toString();
+}
+
+namespace {
+class AtomTable
+{
+public:
+    AtomTable()
+    {
+        const QString namespaces[] = {KDSoapNamespaceManager::xmlSchema1999(),
+                                      KDSoapNamespaceManager::xmlSchema2001(),
+                                      KDSoapNamespaceManager::xmlSchemaInstance1999(),
+                                      KDSoapNamespaceManager::xmlSchemaInstance2001(),
+                                      KDSoapNamespaceManager::soapEnvelope(),
+                                      KDSoapNamespaceManager::soapEnvelope200305(),
+                                      KDSoapNamespaceManager::soapEncoding(),
+                                      KDSoapNamespaceManager::soapEncoding200305(),
+                                      KDSoapNamespaceManager::soapMessageAddressing(),
+                                      KDSoapNamespaceManager::soapSecurityExtention(),
+                                      KDSoapNamespaceManager::soapSecurityUtility(),
+                                      KDSoapNamespaceManager::soapMessageAddressing200303(),
+                                      KDSoapNamespaceManager::soapMessageAddressing200403(),
+                                      KDSoapNamespaceManager::soapMessageAddressing200408()};
+        for (const QString &ns : namespaces) {
+            insert(ns);
+        }
+        static const char *const s_names[] = {"Envelope", "Header", "Body", "Fault", "faultcode", "faultstring", "faultactor", "detail",
+                                              "Code", "Reason", "Value", "Text", "string", "int", "boolean", "double", "float",
+                                              "dateTime", "date", "time", "base64Binary", "hexBinary"};
+        for (const char *name : s_names) {
+            insert(QString::fromLatin1(name));
+        }
+    }
+
+    template<typename String>
+    QString intern(const String &str)
+    {
+        const uint hash = uint(qHash(str));
+        // The atoms already returned to this thread are found again without taking the lock
+        Atoms &localAtoms = m_localAtoms.localData();
+        QString atom;
+        if (find(localAtoms, hash, str, &atom)) {
+            return atom;
+        }
+        {
+            QReadLocker locker(&m_lock);
+            if (!find(m_atoms, hash, str, &atom)) {
+                if (m_atoms.size() >= s_maxAtoms) {
+                    return toQString(str);
+                }
+                locker.unlock();
+                QWriteLocker writeLocker(&m_lock);
+                if (!find(m_atoms, hash, str, &atom)) { // could have been inserted by another thread in the meantime
+                    atom = toQString(str);
+                    m_atoms.insert(hash, atom);
+                }
+            }
+        }
+        // Bounded too: every atom in there is also in m_atoms
+        localAtoms.insert(hash, atom);
+        return atom;
+    }
+
+    bool contains(const QString &atom)
+    {
+        const uint hash = uint(qHash(atom));
+        if (containsAtom(m_localAtoms.localData(), hash, atom)) {
+            return true;
+        }
+        QReadLocker locker(&m_lock);
+        return containsAtom(m_atoms, hash, atom);
+    }
+
+    int count()
+    {
+        QReadLocker locker(&m_lock);
+        return m_atoms.size();
+    }
+
+private:
+    typedef QMultiHash<uint, QString> Atoms;
+
+    void insert(const QString &str)
+    {
+        m_atoms.insert(uint(qHash(str)), str);
+    }
+
+    template<typename String>
+    static bool find(const Atoms &atoms, uint hash, const String &str, QString *atom)
+    {
+        const auto range = atoms.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it.value() == str) {
+                *atom = it.value();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static bool containsAtom(const Atoms &atoms, uint hash, const QString &atom)
+    {
+        const auto range = atoms.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it.value().constData() == atom.constData() && it.value().size() == atom.size()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    QReadWriteLock m_lock;
+    Atoms m_atoms;
+    QThreadStorage<Atoms> m_localAtoms;
+};
+}
+
+Q_GLOBAL_STATIC(AtomTable, s_atomTable)
+
+QString KDSoapAtomTable::intern(const QString &str)
+{
+    return s_atomTable()->intern(str);
+}
+
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+QString KDSoapAtomTable::intern(const QStringRef &str)
+#else
+QString KDSoapAtomTable::intern(QStringView str)
+#endif
+{
+    return s_atomTable()->intern(str);
+}
+
+bool KDSoapAtomTable::contains(const QString &atom)
+{
+    return s_atomTable()->contains(atom);
+}
+
+int KDSoapAtomTable::count()
+{
+    return s_atomTable()->count();
+}
@@ -0,0 +1,54 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2010-2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#ifndef KDSOAPATOMTABLE_P_H
+#define KDSOAPATOMTABLE_P_H
+
+#include "KDSoapGlobal.h"
+#include <QtCore/QString>
+
+/**
+ * \internal
+ * Thread-safe table of interned strings, for element names, namespace URIs and type names.
+ * Each thread keeps the atoms it already looked up, so that finding them again doesn't lock.
+ *
+ * Interning a string returns a QString sharing its data with every other string
+ * interned with the same contents, so a message with many repeated tags doesn't
+ * allocate their names over and over again.
+ *
+ * The table is prefilled with the standard namespaces and names (see KDSoapNamespaceManager),
+ * and stops growing after a fixed number of entries, so that hostile input cannot fill it up.
+ */
+class KDSOAP_EXPORT KDSoapAtomTable // krazy:exclude=dpointer
+{
+public:
+    static QString intern(const QString &str);
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+    static QString intern(const QStringRef &str);
+#else
+    static QString intern(QStringView str);
+#endif
+
+    /**
+     * Returns true if \p atom is in the table. Once the table is full, intern() returns
+     * strings which aren't: they are only shared by the copies of the returned QString.
+     */
+    static bool contains(const QString &atom);
+
+    /**
+     * Returns the number of strings in the table (for the benchmarks).
+     */
+    static int count();
+
+private:
+    KDSoapAtomTable();
+};
+
+#endif // KDSOAPATOMTABLE_P_H
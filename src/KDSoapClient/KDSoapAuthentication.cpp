@@ -136,7 +136,7 @@ bool KDSoapAuthentication::hasWSUsernameTokenHeader() const
     return hasAuth() && d->useWSUsernameToken;
 }
 
-void KDSoapAuthentication::writeWSUsernameTokenHeader(QXmlStreamWriter &writer) const
+void KDSoapAuthentication::writeWSUsernameTokenHeader(KDSoapXmlWriter &writer) const
 {
     if (!hasAuth()) {
         return;
@@ -16,9 +16,9 @@ QT_BEGIN_NAMESPACE
 class QAuthenticator;
 class QDateTime;
 class QNetworkReply;
-class QXmlStreamWriter;
 QT_END_NAMESPACE
 class KDSoapNamespacePrefixes;
+class KDSoapXmlWriter;
 
 /**
  * KDSoapAuthentication provides an authentication object.
@@ -136,7 +136,7 @@ private:
     /**
      * \internal
      */
-    void writeWSUsernameTokenHeader(QXmlStreamWriter &writer) const;
+    void writeWSUsernameTokenHeader(KDSoapXmlWriter &writer) const;
 
 private:
     class Private;
@@ -0,0 +1,494 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2010-2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+#include "KDSoapBinaryCodec_p.h"
+
+#include <cstring>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define KDSOAP_X86_SIMD
+#include <immintrin.h>
+#define KDSOAP_TARGET(features) __attribute__((target(features)))
+#endif
+
+static const char s_base64Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+static const char s_hexDigits[] = "0123456789abcdef";
+
+// Value of a base64 or hex character, -1 if it isn't one
+static signed char base64Value(uint ch)
+{
+    if (ch >= 'A' && ch <= 'Z')
+        return static_cast<signed char>(ch - 'A');
+    if (ch >= 'a' && ch <= 'z')
+        return static_cast<signed char>(ch - 'a' + 26);
+    if (ch >= '0' && ch <= '9')
+        return static_cast<signed char>(ch - '0' + 52);
+    if (ch == '+')
+        return 62;
+    if (ch == '/')
+        return 63;
+    return -1;
+}
+
+static signed char hexValue(uint ch)
+{
+    if (ch >= '0' && ch <= '9')
+        return static_cast<signed char>(ch - '0');
+    if (ch >= 'a' && ch <= 'f')
+        return static_cast<signed char>(ch - 'a' + 10);
+    if (ch >= 'A' && ch <= 'F')
+        return static_cast<signed char>(ch - 'A' + 10);
+    return -1;
+}
+
+////
+
+static void toBase64Scalar(const uchar *data, qint64 size, char *out)
+{
+    qint64 i = 0;
+    for (; i + 3 <= size; i += 3) {
+        const uint group = (uint(data[i]) << 16) | (uint(data[i + 1]) << 8) | data[i + 2];
+        *out++ = s_base64Alphabet[group >> 18];
+        *out++ = s_base64Alphabet[(group >> 12) & 0x3f];
+        *out++ = s_base64Alphabet[(group >> 6) & 0x3f];
+        *out++ = s_base64Alphabet[group & 0x3f];
+    }
+    if (i < size) {
+        const bool twoBytes = i + 1 < size;
+        const uint group = (uint(data[i]) << 16) | (twoBytes ? uint(data[i + 1]) << 8 : 0);
+        *out++ = s_base64Alphabet[group >> 18];
+        *out++ = s_base64Alphabet[(group >> 12) & 0x3f];
+        *out++ = twoBytes ? s_base64Alphabet[(group >> 6) & 0x3f] : '=';
+        *out++ = '=';
+    }
+}
+
+static void toHexScalar(const uchar *data, qint64 size, char *out)
+{
+    for (qint64 i = 0; i < size; ++i) {
+        *out++ = s_hexDigits[data[i] >> 4];
+        *out++ = s_hexDigits[data[i] & 0xf];
+    }
+}
+
+// Base64 decoding state between blocks: the bits which don't make a full byte yet
+struct Base64State
+{
+    uint buffer = 0;
+    int bits = 0;
+};
+
+template<typename Char>
+static char *fromBase64Scalar(const Char *text, qint64 length, char *out, Base64State &state)
+{
+    for (qint64 i = 0; i < length; ++i) {
+        const signed char value = base64Value(text[i]);
+        if (value < 0) {
+            continue; // like QByteArray::fromBase64, which skips whitespace, padding and invalid characters
+        }
+        state.buffer = (state.buffer << 6) | uint(value);
+        state.bits += 6;
+        if (state.bits >= 8) {
+            state.bits -= 8;
+            *out++ = char(state.buffer >> state.bits);
+            state.buffer &= (1u << state.bits) - 1;
+        }
+    }
+    return out;
+}
+
+// Hex decoding goes backwards, like QByteArray::fromHex: the state is whether a low nibble is pending
+template<typename Char>
+static char *fromHexScalar(const Char *text, qint64 length, char *outEnd, bool &lowNibblePending)
+{
+    for (qint64 i = length - 1; i >= 0; --i) {
+        const signed char value = hexValue(text[i]);
+        if (value < 0) {
+            continue;
+        }
+        if (!lowNibblePending) {
+            *--outEnd = char(value);
+            lowNibblePending = true;
+        } else {
+            *outEnd = char(uchar(*outEnd) | (value << 4));
+            lowNibblePending = false;
+        }
+    }
+    return outEnd;
+}
+
+////
+
+#ifdef KDSOAP_X86_SIMD
+
+static bool cpuHasSsse3()
+{
+    static const bool result = __builtin_cpu_supports("ssse3");
+    return result;
+}
+
+static bool cpuHasAvx2()
+{
+    static const bool result = __builtin_cpu_supports("avx2");
+    return result;
+}
+
+// Encoding 12 bytes into 16 characters, see Wojciech Muła's "Base64 encoding with SIMD instructions"
+KDSOAP_TARGET("ssse3") static inline __m128i base64EncodeBlock(__m128i input)
+{
+    // Each 32-bit lane gets the bytes b1 b0 b2 b1 of its group of 3
+    input = _mm_shuffle_epi8(input, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+    // Move the four 6-bit indices of each group into their own bytes
+    const __m128i t0 = _mm_and_si128(input, _mm_set1_epi32(0x0fc0fc00));
+    const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+    const __m128i t2 = _mm_and_si128(input, _mm_set1_epi32(0x003f03f0));
+    const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+    const __m128i indices = _mm_or_si128(t1, t3);
+    // Turn the indices into characters by adding the offset of their range of the alphabet
+    __m128i range = _mm_subs_epu8(indices, _mm_set1_epi8(51)); // 0 for A-Z and a-z, 1..12 for 0-9, 11 for '+', 12 for '/'
+    const __m128i lessThan26 = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+    range = _mm_or_si128(range, _mm_and_si128(lessThan26, _mm_set1_epi8(13))); // 13 for A-Z
+    const __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                          '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    return _mm_add_epi8(indices, _mm_shuffle_epi8(offsets, range));
+}
+
+KDSOAP_TARGET("avx2") static inline __m256i base64EncodeBlock(__m256i input)
+{
+    const __m256i shuffle = _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1, 10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+    input = _mm256_shuffle_epi8(input, shuffle);
+    const __m256i t0 = _mm256_and_si256(input, _mm256_set1_epi32(0x0fc0fc00));
+    const __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+    const __m256i t2 = _mm256_and_si256(input, _mm256_set1_epi32(0x003f03f0));
+    const __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+    const __m256i indices = _mm256_or_si256(t1, t3);
+    __m256i range = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+    const __m256i lessThan26 = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+    range = _mm256_or_si256(range, _mm256_and_si256(lessThan26, _mm256_set1_epi8(13)));
+    const __m256i offsets = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                             '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0, 'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                             '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    return _mm256_add_epi8(indices, _mm256_shuffle_epi8(offsets, range));
+}
+
+// Returns the number of bytes encoded, a multiple of 3
+KDSOAP_TARGET("ssse3") static qint64 toBase64Ssse3(const uchar *data, qint64 size, char *out)
+{
+    qint64 i = 0;
+    // 16 bytes are loaded for 12 bytes of input
+    for (; i + 16 <= size; i += 12, out += 16) {
+        const __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out), base64EncodeBlock(input));
+    }
+    return i;
+}
+
+KDSOAP_TARGET("avx2") static qint64 toBase64Avx2(const uchar *data, qint64 size, char *out)
+{
+    qint64 i = 0;
+    // Two groups of 12 bytes, one per 128-bit lane
+    for (; i + 28 <= size; i += 24, out += 32) {
+        const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i + 12));
+        const __m256i input = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), base64EncodeBlock(input));
+    }
+    return i;
+}
+
+KDSOAP_TARGET("ssse3") static qint64 toHexSsse3(const uchar *data, qint64 size, char *out)
+{
+    const __m128i digits = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s_hexDigits));
+    const __m128i lowMask = _mm_set1_epi8(0x0f);
+    qint64 i = 0;
+    for (; i + 16 <= size; i += 16, out += 32) {
+        const __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        const __m128i high = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(input, 4), lowMask));
+        const __m128i low = _mm_shuffle_epi8(digits, _mm_and_si128(input, lowMask));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_unpacklo_epi8(high, low));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 16), _mm_unpackhi_epi8(high, low));
+    }
+    return i;
+}
+
+KDSOAP_TARGET("avx2") static qint64 toHexAvx2(const uchar *data, qint64 size, char *out)
+{
+    const __m256i digits = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(s_hexDigits)));
+    const __m256i lowMask = _mm256_set1_epi8(0x0f);
+    qint64 i = 0;
+    for (; i + 32 <= size; i += 32, out += 64) {
+        const __m256i input = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        const __m256i high = _mm256_shuffle_epi8(digits, _mm256_and_si256(_mm256_srli_epi16(input, 4), lowMask));
+        const __m256i low = _mm256_shuffle_epi8(digits, _mm256_and_si256(input, lowMask));
+        // unpack works within each 128-bit lane, put the lanes back in order
+        const __m256i first = _mm256_unpacklo_epi8(high, low);
+        const __m256i second = _mm256_unpackhi_epi8(high, low);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), _mm256_permute2x128_si256(first, second, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + 32), _mm256_permute2x128_si256(first, second, 0x31));
+    }
+    return i;
+}
+
+// Loading 16 or 32 characters as bytes. UTF-16 is narrowed with unsigned saturation,
+// so that any non-Latin1 character becomes 0xff, which is invalid.
+KDSOAP_TARGET("ssse3") static inline __m128i loadChars16(const char *text)
+{
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(text));
+}
+
+KDSOAP_TARGET("ssse3") static inline __m128i loadChars16(const ushort *text)
+{
+    // packus_epi16 saturates signed words: 0x8000 and above become 0, which is invalid too
+    return _mm_packus_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(text)), _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + 8)));
+}
+
+KDSOAP_TARGET("avx2") static inline __m256i loadChars32(const char *text)
+{
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text));
+}
+
+KDSOAP_TARGET("avx2") static inline __m256i loadChars32(const ushort *text)
+{
+    const __m256i packed = _mm256_packus_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(text)),
+                                               _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text + 16)));
+    return _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+// Range checks on signed bytes: characters above 0x7f are negative, and never in range
+KDSOAP_TARGET("ssse3") static inline __m128i inRange(__m128i chars, char low, char high)
+{
+    return _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8(char(low - 1))), _mm_cmpgt_epi8(_mm_set1_epi8(char(high + 1)), chars));
+}
+
+KDSOAP_TARGET("avx2") static inline __m256i inRange(__m256i chars, char low, char high)
+{
+    return _mm256_and_si256(_mm256_cmpgt_epi8(chars, _mm256_set1_epi8(char(low - 1))), _mm256_cmpgt_epi8(_mm256_set1_epi8(char(high + 1)), chars));
+}
+
+// Decodes 16 base64 characters into 12 bytes, written into 16 bytes of \p out. Returns false if they aren't all base64 characters.
+KDSOAP_TARGET("ssse3") static inline bool base64DecodeBlock(__m128i input, char *out)
+{
+    const __m128i upper = inRange(input, 'A', 'Z');
+    const __m128i lower = inRange(input, 'a', 'z');
+    const __m128i digit = inRange(input, '0', '9');
+    const __m128i plus = _mm_cmpeq_epi8(input, _mm_set1_epi8('+'));
+    const __m128i slash = _mm_cmpeq_epi8(input, _mm_set1_epi8('/'));
+    const __m128i valid = _mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(digit, _mm_or_si128(plus, slash)));
+    if (_mm_movemask_epi8(valid) != 0xffff) {
+        return false;
+    }
+    __m128i shift = _mm_and_si128(upper, _mm_set1_epi8(-65));
+    shift = _mm_or_si128(shift, _mm_and_si128(lower, _mm_set1_epi8(-71)));
+    shift = _mm_or_si128(shift, _mm_and_si128(digit, _mm_set1_epi8(4)));
+    shift = _mm_or_si128(shift, _mm_and_si128(plus, _mm_set1_epi8(19)));
+    shift = _mm_or_si128(shift, _mm_and_si128(slash, _mm_set1_epi8(16)));
+    const __m128i values = _mm_add_epi8(input, shift);
+    // Pack the four 6-bit values of each 32-bit lane into 24 bits, then put the bytes in order
+    const __m128i pairs = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+    const __m128i groups = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+    const __m128i bytes = _mm_shuffle_epi8(groups, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out), bytes);
+    return true;
+}
+
+// Decodes 32 base64 characters into 24 bytes, written into 32 bytes of \p out
+KDSOAP_TARGET("avx2") static inline bool base64DecodeBlock(__m256i input, char *out)
+{
+    const __m256i upper = inRange(input, 'A', 'Z');
+    const __m256i lower = inRange(input, 'a', 'z');
+    const __m256i digit = inRange(input, '0', '9');
+    const __m256i plus = _mm256_cmpeq_epi8(input, _mm256_set1_epi8('+'));
+    const __m256i slash = _mm256_cmpeq_epi8(input, _mm256_set1_epi8('/'));
+    const __m256i valid = _mm256_or_si256(_mm256_or_si256(upper, lower), _mm256_or_si256(digit, _mm256_or_si256(plus, slash)));
+    if (uint(_mm256_movemask_epi8(valid)) != 0xffffffffu) {
+        return false;
+    }
+    __m256i shift = _mm256_and_si256(upper, _mm256_set1_epi8(-65));
+    shift = _mm256_or_si256(shift, _mm256_and_si256(lower, _mm256_set1_epi8(-71)));
+    shift = _mm256_or_si256(shift, _mm256_and_si256(digit, _mm256_set1_epi8(4)));
+    shift = _mm256_or_si256(shift, _mm256_and_si256(plus, _mm256_set1_epi8(19)));
+    shift = _mm256_or_si256(shift, _mm256_and_si256(slash, _mm256_set1_epi8(16)));
+    const __m256i values = _mm256_add_epi8(input, shift);
+    const __m256i pairs = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+    const __m256i groups = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+    const __m256i bytes = _mm256_shuffle_epi8(groups, _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1, 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+    // 12 bytes at the start of each lane, make them contiguous
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), _mm256_permutevar8x32_epi32(bytes, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7)));
+    return true;
+}
+
+// Decodes 16 hex digits into 8 bytes, written into 16 bytes of \p out
+KDSOAP_TARGET("ssse3") static inline bool hexDecodeBlock(__m128i input, char *out)
+{
+    const __m128i digit = inRange(input, '0', '9');
+    const __m128i lower = inRange(input, 'a', 'f');
+    const __m128i upper = inRange(input, 'A', 'F');
+    if (_mm_movemask_epi8(_mm_or_si128(digit, _mm_or_si128(lower, upper))) != 0xffff) {
+        return false;
+    }
+    __m128i shift = _mm_and_si128(digit, _mm_set1_epi8(-'0'));
+    shift = _mm_or_si128(shift, _mm_and_si128(lower, _mm_set1_epi8(char(10 - 'a'))));
+    shift = _mm_or_si128(shift, _mm_and_si128(upper, _mm_set1_epi8(char(10 - 'A'))));
+    const __m128i values = _mm_add_epi8(input, shift);
+    const __m128i pairs = _mm_maddubs_epi16(values, _mm_set1_epi16(0x0110)); // high * 16 + low
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_packus_epi16(pairs, pairs));
+    return true;
+}
+
+// For a block which isn't only base64 characters (line breaks, padding, the end of the text): decodes it,
+// then the next characters up to the end of a group of 4, so that the following blocks are whole groups again.
+// Returns where the next block starts.
+template<typename Char>
+static qint64 fromBase64Unaligned(const Char *text, qint64 begin, qint64 blockEnd, qint64 length, char *&out, Base64State &state)
+{
+    out = fromBase64Scalar(text + begin, blockEnd - begin, out, state);
+    qint64 i = blockEnd;
+    while (i < length && state.bits != 0) {
+        out = fromBase64Scalar(text + i, 1, out, state);
+        ++i;
+    }
+    return i;
+}
+
+template<typename Char>
+KDSOAP_TARGET("ssse3") static char *fromBase64Ssse3(const Char *text, qint64 length, char *out, Base64State &state)
+{
+    qint64 i = 0;
+    while (i < length) {
+        // Whole blocks of base64 characters, while no bits of a previous block are pending
+        if (length - i >= 16 && state.bits == 0 && base64DecodeBlock(loadChars16(text + i), out)) {
+            out += 12;
+            i += 16;
+        } else {
+            i = fromBase64Unaligned(text, i, qMin<qint64>(i + 16, length), length, out, state);
+        }
+    }
+    return out;
+}
+
+template<typename Char>
+KDSOAP_TARGET("avx2") static char *fromBase64Avx2(const Char *text, qint64 length, char *out, Base64State &state)
+{
+    qint64 i = 0;
+    while (i < length) {
+        if (length - i >= 32 && state.bits == 0 && base64DecodeBlock(loadChars32(text + i), out)) {
+            out += 24;
+            i += 32;
+        } else {
+            i = fromBase64Unaligned(text, i, qMin<qint64>(i + 32, length), length, out, state);
+        }
+    }
+    return out;
+}
+
+template<typename Char>
+KDSOAP_TARGET("ssse3") static char *fromHexSsse3(const Char *text, qint64 length, char *outEnd)
+{
+    bool lowNibblePending = false;
+    qint64 end = length;
+    while (end > 0) {
+        const qint64 blockLength = qMin<qint64>(16, end);
+        char block[16];
+        if (blockLength == 16 && !lowNibblePending && hexDecodeBlock(loadChars16(text + end - 16), block)) {
+            outEnd -= 8;
+            memcpy(outEnd, block, 8);
+        } else {
+            outEnd = fromHexScalar(text + end - blockLength, blockLength, outEnd, lowNibblePending);
+        }
+        end -= blockLength;
+    }
+    return outEnd;
+}
+
+#endif // KDSOAP_X86_SIMD
+
+////
+
+void KDSoapBinaryCodec::toBase64(const char *data, qint64 size, char *out)
+{
+    const uchar *input = reinterpret_cast<const uchar *>(data);
+    qint64 done = 0;
+#ifdef KDSOAP_X86_SIMD
+    if (cpuHasAvx2()) {
+        done = toBase64Avx2(input, size, out);
+    } else if (cpuHasSsse3()) {
+        done = toBase64Ssse3(input, size, out);
+    }
+#endif
+    toBase64Scalar(input + done, size - done, out + done / 3 * 4);
+}
+
+void KDSoapBinaryCodec::toHex(const char *data, qint64 size, char *out)
+{
+    const uchar *input = reinterpret_cast<const uchar *>(data);
+    qint64 done = 0;
+#ifdef KDSOAP_X86_SIMD
+    if (cpuHasAvx2()) {
+        done = toHexAvx2(input, size, out);
+    } else if (cpuHasSsse3()) {
+        done = toHexSsse3(input, size, out);
+    }
+#endif
+    toHexScalar(input + done, size - done, out + done * 2);
+}
+
+template<typename Char>
+static qint64 fromBase64Impl(const Char *text, qint64 length, char *out)
+{
+    Base64State state;
+    char *end;
+#ifdef KDSOAP_X86_SIMD
+    if (cpuHasAvx2()) {
+        end = fromBase64Avx2(text, length, out, state);
+    } else if (cpuHasSsse3()) {
+        end = fromBase64Ssse3(text, length, out, state);
+    } else
+#endif
+    {
+        end = fromBase64Scalar(text, length, out, state);
+    }
+    return end - out;
+}
+
+qint64 KDSoapBinaryCodec::fromBase64(const char *text, qint64 length, char *out)
+{
+    return fromBase64Impl(text, length, out);
+}
+
+qint64 KDSoapBinaryCodec::fromBase64(const ushort *text, qint64 length, char *out)
+{
+    return fromBase64Impl(text, length, out);
+}
+
+template<typename Char>
+static qint64 fromHexImpl(const Char *text, qint64 length, char *out)
+{
+    char *outEnd = out + KDSoapBinaryCodec::decodedBufferSize(length);
+    char *begin;
+#ifdef KDSOAP_X86_SIMD
+    if (cpuHasSsse3()) {
+        begin = fromHexSsse3(text, length, outEnd);
+    } else
+#endif
+    {
+        bool lowNibblePending = false;
+        begin = fromHexScalar(text, length, outEnd, lowNibblePending);
+    }
+    return begin - out;
+}
+
+qint64 KDSoapBinaryCodec::fromHex(const char *text, qint64 length, char *out)
+{
+    return fromHexImpl(text, length, out);
+}
+
+qint64 KDSoapBinaryCodec::fromHex(const ushort *text, qint64 length, char *out)
+{
+    return fromHexImpl(text, length, out);
+}
@@ -0,0 +1,53 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2010-2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#ifndef KDSOAPBINARYCODEC_P_H
+#define KDSOAPBINARYCODEC_P_H
+
+#include <QtCore/qglobal.h>
+
+/**
+ * \internal
+ * Base64 and hex encoding and decoding of xsd:base64Binary and xsd:hexBinary values,
+ * working on raw buffers so that big values aren't copied around between QByteArray and QString.
+ *
+ * On x86 with GCC or Clang, blocks of input are processed with SSSE3 or AVX2 when the CPU supports them;
+ * everything else (and the input with whitespace or padding in it) goes through the scalar code.
+ * The results are the same as the ones of QByteArray::toBase64(), toHex(), fromBase64() and fromHex().
+ */
+class KDSoapBinaryCodec // krazy:exclude=dpointer
+{
+public:
+    static qint64 base64EncodedSize(qint64 size)
+    {
+        return (size + 2) / 3 * 4;
+    }
+    /// Writes base64EncodedSize(size) characters to \p out, with '=' padding
+    static void toBase64(const char *data, qint64 size, char *out);
+    /// Writes 2 * size lowercase characters to \p out
+    static void toHex(const char *data, qint64 size, char *out);
+
+    /// Room needed in the output buffer of fromBase64() and fromHex(), for \p length characters of input
+    static qint64 decodedBufferSize(qint64 length)
+    {
+        return length / 4 * 3 + 3 + 32;
+    }
+    /// Decodes base64, skipping the characters which aren't part of the alphabet. Returns the number of bytes written to \p out.
+    static qint64 fromBase64(const char *text, qint64 length, char *out);
+    /// Same, with UTF-16 text (such as the data of a QString)
+    static qint64 fromBase64(const ushort *text, qint64 length, char *out);
+    /// Decodes hex, skipping the characters which aren't hex digits, and pairing the digits from the end.
+    /// The decoded bytes are written at the end of the \p out buffer, of size decodedBufferSize(length);
+    /// returns the offset of the first one.
+    static qint64 fromHex(const char *text, qint64 length, char *out);
+    static qint64 fromHex(const ushort *text, qint64 length, char *out);
+};
+
+#endif // KDSOAPBINARYCODEC_P_H
@@ -9,13 +9,16 @@
 ****************************************************************************/
 #include "KDSoapClientInterface.h"
 #include "KDSoapClientInterface_p.h"
+#include "KDSoapCompression_p.h"
 #include "KDSoapMessageWriter_p.h"
+#include "KDSoapMtom_p.h"
 #include "KDSoapNamespaceManager.h"
 #ifndef QT_NO_SSL
 #include "KDSoapReplySslHandler_p.h"
 #include "KDSoapSslHandler.h"
 #endif
 #include "KDSoapPendingCall_p.h"
+#include "KDSoapRequestDevice_p.h"
 #include <QAuthenticator>
 #include <QBuffer>
 #include <QDebug>
@@ -53,6 +56,7 @@ KDSoapClientInterface::SoapVersion KDSoapClientInterface::soapVersion() const
 KDSoapClientInterfacePrivate::KDSoapClientInterfacePrivate()
     : m_accessManager(nullptr)
     , m_authentication()
+    , m_persistentHeadersCache(new KDSoapPersistentHeadersCache)
     , m_version(KDSoap::SOAP1_1)
     , m_style(KDSoapClientInterface::RPCStyle)
     , m_ignoreSslErrors(false)
@@ -114,13 +118,8 @@ QNetworkRequest KDSoapClientInterfacePrivate::prepareRequest(const QString &meth
 
     request.setHeader(QNetworkRequest::ContentTypeHeader, soapHeader.toUtf8());
 
-    // FIXME need to find out which version of Qt this is no longer necessary
-    // without that the server might respond with gzip compressed data and
-    // Qt 4.6.2 fails to decode that properly
-    //
-    // happens with retrieval calls in against SugarCRM 5.5.1 running on Apache 2.2.15
-    // when the response seems to reach a certain size threshold
-    request.setRawHeader("Accept-Encoding", "compress");
+    // No Accept-Encoding header here: QNetworkAccessManager then sends "gzip, deflate" itself,
+    // and decompresses the responses, which it doesn't do when the header is set by the application.
 
     for (QMap<QByteArray, QByteArray>::const_iterator it = m_httpHeaders.constBegin(); it != m_httpHeaders.constEnd(); ++it) {
         request.setRawHeader(it.key(), it.value());
@@ -135,17 +134,46 @@ QNetworkRequest KDSoapClientInterfacePrivate::prepareRequest(const QString &meth
     return request;
 }
 
-QBuffer *KDSoapClientInterfacePrivate::prepareRequestBuffer(const QString &method, const KDSoapMessage &message, const QString &soapAction, const KDSoapHeaders &headers)
+QIODevice *KDSoapClientInterfacePrivate::prepareRequestDevice(const QString &method, const KDSoapMessage &message, const QString &soapAction,
+                                                              const KDSoapHeaders &headers, QNetworkRequest &request)
 {
     KDSoapMessageWriter msgWriter;
     msgWriter.setMessageNamespace(m_messageNamespace);
     msgWriter.setVersion(m_version);
-    QBuffer *buffer = new QBuffer;
-    auto setBufferData = [=](const KDSoapMessage &msg) {
-        buffer->setData(msgWriter.messageToXml(msg,
-                                               (m_style == KDSoapClientInterface::RPCStyle) ? method : QString(),
-                                               headers, m_persistentHeaders,
-                                               m_authentication));
+    msgWriter.setPersistentHeadersCache(m_persistentHeadersCache);
+    msgWriter.setNativeXmlWriter(m_nativeXmlWriter);
+    const QString rpcMethod = (m_style == KDSoapClientInterface::RPCStyle) ? method : QString();
+    auto createDevice = [&](const KDSoapMessage &msg) -> QIODevice * {
+        if (m_mtomRequests) {
+            KDSoapMtomAttachments attachments;
+            msgWriter.setMtomAttachments(&attachments);
+            const QByteArray xml = msgWriter.messageToXml(msg, rpcMethod, headers, m_persistentHeaders, m_authentication);
+            const QByteArray soapContentType = request.header(QNetworkRequest::ContentTypeHeader).toByteArray();
+            const QByteArray boundary = KDSoapMtom::createBoundary();
+            request.setHeader(QNetworkRequest::ContentTypeHeader, KDSoapMtom::contentType(boundary, soapContentType));
+            QVector<QByteArray> body = KDSoapMtom::multipartBody(boundary, soapContentType, xml, attachments);
+            QByteArray compressed;
+            if (compressRequestBody(body, request, &compressed)) {
+                body = {compressed};
+            }
+            return new KDSoapMtomDevice(body);
+        }
+        if (m_streamingRequests) {
+            KDSoapRequestDevice *device = new KDSoapRequestDevice(msgWriter, msg, rpcMethod, headers, m_persistentHeaders, m_authentication);
+            // Let QNetworkAccessManager read the request while sending it, rather than reading all of it first
+            request.setAttribute(QNetworkRequest::DoNotBufferUploadDataAttribute, true);
+            request.setHeader(QNetworkRequest::ContentLengthHeader, device->contentLength());
+            return device;
+        }
+        QByteArray data = msgWriter.messageToXml(msg, rpcMethod, headers, m_persistentHeaders, m_authentication);
+        QByteArray compressed;
+        if (compressRequestBody({data}, request, &compressed)) {
+            data = compressed;
+        }
+        QBuffer *buffer = new QBuffer;
+        buffer->setData(data);
+        buffer->open(QIODevice::ReadOnly);
+        return buffer;
     };
 
     if (m_sendSoapActionInWsAddressingHeader) {
@@ -156,29 +184,56 @@ QBuffer *KDSoapClientInterfacePrivate::prepareRequestBuffer(const QString &metho
                      prop.action().toLocal8Bit().constData(), soapAction.toLocal8Bit().constData());
         prop.setAction(soapAction);
         messageCopy.setMessageAddressingProperties(prop);
-        setBufferData(messageCopy);
-    } else {
-        setBufferData(message);
+        return createDevice(messageCopy);
     }
-    buffer->open(QIODevice::ReadOnly);
-    return buffer;
+    return createDevice(message);
+}
+
+bool KDSoapClientInterfacePrivate::compressRequestBody(const QVector<QByteArray> &body, QNetworkRequest &request, QByteArray *compressed) const
+{
+    if (m_requestCompression == KDSoapClientInterface::NoCompression || !KDSoapCompression::isAvailable()) {
+        return false;
+    }
+    int size = 0;
+    for (const QByteArray &piece : body) {
+        size += piece.size();
+    }
+    if (size < m_compressionThreshold) {
+        return false;
+    }
+    const KDSoapCompression::Encoding encoding =
+        m_requestCompression == KDSoapClientInterface::GzipCompression ? KDSoapCompression::Gzip : KDSoapCompression::Deflate;
+    if (!KDSoapCompression::compress(body, encoding, m_compressionLevel, compressed)) {
+        return false;
+    }
+    request.setRawHeader("Content-Encoding", KDSoapCompression::name(encoding));
+    return true;
 }
 
 KDSoapPendingCall KDSoapClientInterface::asyncCall(const QString &method, const KDSoapMessage &message, const QString &soapAction,
                                                    const KDSoapHeaders &headers)
 {
-    QBuffer *buffer = d->prepareRequestBuffer(method, message, soapAction, headers);
     QNetworkRequest request = d->prepareRequest(method, soapAction);
-    QNetworkReply *reply = d->accessManager()->post(request, buffer);
+    QIODevice *device = d->prepareRequestDevice(method, message, soapAction, headers, request);
+    QNetworkReply *reply = d->accessManager()->post(request, device);
     d->setupReply(reply);
-    maybeDebugRequest(buffer->data(), reply->request(), reply);
-    KDSoapPendingCall call(reply, buffer);
+    maybeDebugRequest(device, reply->request(), reply);
+    KDSoapPendingCall call(reply, device);
     call.d->soapVersion = d->m_version;
+    call.d->messageReader.setLazyParsing(d->m_lazyResponseParsing);
+    call.d->messageReader.setCompactParsing(d->m_compactResponseParsing);
+    call.d->messageReader.setReplaceInvalidCharacterReferences(d->m_replaceInvalidCharacterReferences);
     return call;
 }
 
 KDSoapMessage KDSoapClientInterface::call(const QString &method, const KDSoapMessage &message, const QString &soapAction,
                                           const KDSoapHeaders &headers)
+{
+    return call(method, message, soapAction, headers, ResponseReader());
+}
+
+KDSoapMessage KDSoapClientInterface::call(const QString &method, const KDSoapMessage &message, const QString &soapAction,
+                                          const KDSoapHeaders &headers, const ResponseReader &responseReader)
 {
     d->accessManager()->cookieJar(); // create it in the right thread, the secondary thread will use it
     // Problem is: I don't want a nested event loop here. Too dangerous for GUI programs.
@@ -186,13 +241,33 @@ KDSoapMessage KDSoapClientInterface::call(const QString &method, const KDSoapMes
     // So the only option that remains is a thread and acquiring a semaphore...
     KDSoapThreadTaskData *task = new KDSoapThreadTaskData(this, method, message, soapAction, headers);
     task->m_authentication = d->m_authentication;
+    task->m_responseReader = responseReader;
+    // With a response reader, this thread parses the reply while the other one receives it
+    KDSoapReplyPipe replyPipe;
+    if (responseReader) {
+        task->m_replyPipe = &replyPipe;
+    }
     d->m_thread.enqueue(task);
     if (!d->m_thread.isRunning()) {
         d->m_thread.start();
     }
+    KDSoapMessage ret;
+    KDSoapHeaders retHeaders;
+    KDSoapMessageReader::XmlError parseError = KDSoapMessageReader::NoError;
+    if (responseReader) {
+        KDSoapMessageReader reader;
+        reader.setCompactParsing(d->m_compactResponseParsing);
+        reader.setReplaceInvalidCharacterReferences(d->m_replaceInvalidCharacterReferences);
+        reader.setResponseReader(responseReader);
+        parseError = reader.xmlToMessage(&replyPipe, &ret, nullptr, &retHeaders, d->m_version);
+    }
     task->waitForCompletion();
-    KDSoapMessage ret = task->response();
-    d->m_lastResponseHeaders = task->responseHeaders();
+    // Network errors take precedence, unless the reply was a fault message (see KDSoapPendingCall::Private::parseReply)
+    if (!replyPipe.isStreamed() || (task->response().isFault() && (parseError != KDSoapMessageReader::NoError || !ret.isFault()))) {
+        ret = task->response();
+        retHeaders = task->responseHeaders();
+    }
+    d->m_lastResponseHeaders = retHeaders;
     delete task;
     return ret;
 }
@@ -200,13 +275,13 @@ KDSoapMessage KDSoapClientInterface::call(const QString &method, const KDSoapMes
 void KDSoapClientInterface::callNoReply(const QString &method, const KDSoapMessage &message,
                                         const QString &soapAction, const KDSoapHeaders &headers)
 {
-    QBuffer *buffer = d->prepareRequestBuffer(method, message, soapAction, headers);
     QNetworkRequest request = d->prepareRequest(method, soapAction);
-    QNetworkReply *reply = d->accessManager()->post(request, buffer);
+    QIODevice *device = d->prepareRequestDevice(method, message, soapAction, headers, request);
+    QNetworkReply *reply = d->accessManager()->post(request, device);
     d->setupReply(reply);
-    maybeDebugRequest(buffer->data(), reply->request(), reply);
+    maybeDebugRequest(device, reply->request(), reply);
     QObject::connect(reply, &QNetworkReply::finished, reply, &QNetworkReply::deleteLater);
-    QObject::connect(reply, &QNetworkReply::finished, buffer, &QBuffer::deleteLater);
+    QObject::connect(reply, &QNetworkReply::finished, device, &QIODevice::deleteLater);
 }
 
 void KDSoapClientInterfacePrivate::_kd_slotAuthenticationRequired(QNetworkReply *reply, QAuthenticator *authenticator)
@@ -233,6 +308,7 @@ void KDSoapClientInterface::setHeader(const QString &name, const KDSoapMessage &
 {
     d->m_persistentHeaders[name] = header;
     d->m_persistentHeaders[name].setQualified(true);
+    d->m_persistentHeadersCache->headersChanged();
 }
 
 void KDSoapClientInterface::ignoreSslErrors()
@@ -369,6 +445,99 @@ void KDSoapClientInterface::setSendSoapActionInWsAddressingHeader(bool sendInWsA
     d->m_sendSoapActionInWsAddressingHeader = sendInWsAddressingHeader;
 }
 
+bool KDSoapClientInterface::lazyResponseParsing() const
+{
+    return d->m_lazyResponseParsing;
+}
+
+void KDSoapClientInterface::setLazyResponseParsing(bool lazy)
+{
+    d->m_lazyResponseParsing = lazy;
+}
+
+bool KDSoapClientInterface::compactResponseParsing() const
+{
+    return d->m_compactResponseParsing;
+}
+
+void KDSoapClientInterface::setCompactResponseParsing(bool compact)
+{
+    d->m_compactResponseParsing = compact;
+}
+
+bool KDSoapClientInterface::replaceInvalidCharacterReferences() const
+{
+    return d->m_replaceInvalidCharacterReferences;
+}
+
+void KDSoapClientInterface::setReplaceInvalidCharacterReferences(bool replace)
+{
+    d->m_replaceInvalidCharacterReferences = replace;
+}
+
+bool KDSoapClientInterface::streamingRequests() const
+{
+    return d->m_streamingRequests;
+}
+
+void KDSoapClientInterface::setStreamingRequests(bool streaming)
+{
+    d->m_streamingRequests = streaming;
+}
+
+bool KDSoapClientInterface::nativeXmlWriter() const
+{
+    return d->m_nativeXmlWriter;
+}
+
+void KDSoapClientInterface::setNativeXmlWriter(bool native)
+{
+    d->m_nativeXmlWriter = native;
+}
+
+bool KDSoapClientInterface::mtomRequests() const
+{
+    return d->m_mtomRequests;
+}
+
+void KDSoapClientInterface::setMtomRequests(bool mtom)
+{
+    d->m_mtomRequests = mtom;
+}
+
+KDSoapClientInterface::Compression KDSoapClientInterface::requestCompression() const
+{
+    return d->m_requestCompression;
+}
+
+void KDSoapClientInterface::setRequestCompression(Compression compression)
+{
+    if (compression != NoCompression && !KDSoapCompression::isAvailable()) {
+        qWarning("KDSoap was built without zlib, the requests won't be compressed");
+    }
+    d->m_requestCompression = compression;
+}
+
+int KDSoapClientInterface::compressionLevel() const
+{
+    return d->m_compressionLevel;
+}
+
+void KDSoapClientInterface::setCompressionLevel(int level)
+{
+    d->m_compressionLevel = level;
+}
+
+int KDSoapClientInterface::compressionThreshold() const
+{
+    return d->m_compressionThreshold;
+}
+
+void KDSoapClientInterface::setCompressionThreshold(int bytes)
+{
+    d->m_compressionThreshold = bytes;
+}
+
 #ifndef QT_NO_OPENSSL
 QSslConfiguration KDSoapClientInterface::sslConfiguration() const
 {
@@ -14,12 +14,14 @@
 #include "KDSoapPendingCall.h"
 #include <QtCore/QString>
 #include <QtCore/QtGlobal>
+#include <functional>
 
 class KDSoapAuthentication;
 class KDSoapSslHandler;
 class KDSoapClientInterfacePrivate;
 QT_BEGIN_NAMESPACE
 class QSslError;
+class QXmlStreamReader;
 class QSslConfiguration;
 class QNetworkCookieJar;
 class QNetworkProxy;
@@ -146,6 +148,27 @@ public:
     KDSoapMessage call(const QString &method, const KDSoapMessage &message, const QString &soapAction = QString(),
                        const KDSoapHeaders &headers = KDSoapHeaders());
 
+    /**
+     * Reads the response element of a call, which the reader is positioned on, up to its end element.
+     * The namespace declarations in effect for the response element are passed along.
+     * \since 2.2
+     */
+    typedef std::function<void(QXmlStreamReader &reader, const QXmlStreamNamespaceDeclarations &namespaces)> ResponseReader;
+
+    /**
+     * Same as call() above, but the response element is passed to \p responseReader while the
+     * response is parsed, instead of being turned into KDSoapValues. The returned message then
+     * only has the name and namespace of the response element, unless it's a fault.
+     * The response is read in the calling thread, while it's being received, so \p responseReader
+     * can use the variables of the caller, and the reply is never kept in memory as a whole.
+     *
+     * This is used by the code generated by kdwsdl2cpp -pull-parsers, to fill in the
+     * generated response classes straight from the XML.
+     * \since 2.2
+     */
+    KDSoapMessage call(const QString &method, const KDSoapMessage &message, const QString &soapAction, const KDSoapHeaders &headers,
+                       const ResponseReader &responseReader);
+
     /**
      * Calls the method \p method on this interface and passes the parameters specified in \p message
      * to the method.
@@ -376,6 +399,185 @@ public:
      */
     bool sendSoapActionInWsAddressingHeader() const;
 
+    /**
+     * Enables lazy parsing of the responses: the child elements of a value are only
+     * parsed when KDSoapValue::childValues() is called on it for the first time.
+     * This makes a big difference when only a few values are needed from a big response.
+     *
+     * The response document is then kept in memory as long as values from it are.
+     * Calling childValues() for the first time isn't thread-safe: the same value
+     * must not be accessed by several threads until its child values have been parsed.
+     * This option is disabled by default.
+     * \since 2.2
+     */
+    void setLazyResponseParsing(bool lazy);
+
+    /**
+     * Returns true if lazy parsing of the responses is enabled.
+     * \sa setLazyResponseParsing()
+     * \since 2.2
+     */
+    bool lazyResponseParsing() const;
+
+    /**
+     * Enables compact parsing of the responses: the elements of a response are stored
+     * in a few big blocks of memory shared by the whole response, rather than allocated
+     * separately, and their KDSoapValues are only created when KDSoapValue::childValues() is called.
+     * The blocks are freed all at once, with the last value of the response.
+     * The same caveat as for lazy parsing applies to the first call to childValues().
+     *
+     * This takes precedence over setLazyResponseParsing().
+     * This option is disabled by default.
+     * \since 2.2
+     */
+    void setCompactResponseParsing(bool compact);
+
+    /**
+     * Returns true if compact parsing of the responses is enabled.
+     * \sa setCompactResponseParsing()
+     * \since 2.2
+     */
+    bool compactResponseParsing() const;
+
+    /**
+     * Replaces the character references to characters which are not allowed in XML,
+     * like &amp;#x1;, with '?' in the responses. Some servers send those, and the
+     * responses can't be parsed otherwise.
+     *
+     * The responses are filtered as they are received, in a single pass.
+     * This option is disabled by default.
+     * \since 2.2
+     */
+    void setReplaceInvalidCharacterReferences(bool replace);
+
+    /**
+     * Returns true if invalid character references are replaced in the responses.
+     * \sa setReplaceInvalidCharacterReferences()
+     * \since 2.2
+     */
+    bool replaceInvalidCharacterReferences() const;
+
+    /**
+     * Enables streaming of the requests: instead of serializing the whole request before sending it,
+     * the request is serialized while it's being sent, and the data is freed as soon as it has been sent.
+     * This bounds the memory needed for sending requests with big values, such as binary data.
+     *
+     * The size of the request is then computed beforehand by serializing it once more, without keeping the data.
+     * This option is disabled by default.
+     * \since 2.2
+     */
+    void setStreamingRequests(bool streaming);
+
+    /**
+     * Returns true if streaming of the requests is enabled.
+     * \sa setStreamingRequests()
+     * \since 2.2
+     */
+    bool streamingRequests() const;
+
+    /**
+     * Enables the native XML writer for the requests: instead of QXmlStreamWriter,
+     * which converts every string to UTF-8 separately and escapes the text one character
+     * at a time, the requests are written with an XML writer producing UTF-8 directly.
+     * The requests are the same, byte for byte.
+     *
+     * The requests written by the code generated with kdwsdl2cpp -xml-writers still go through
+     * QXmlStreamWriter, which the generated code needs.
+     * This option is disabled by default.
+     * \since 2.2
+     */
+    void setNativeXmlWriter(bool native);
+
+    /**
+     * Returns true if the native XML writer is enabled.
+     * \sa setNativeXmlWriter()
+     * \since 2.2
+     */
+    bool nativeXmlWriter() const;
+
+    /**
+     * Enables MTOM (https://www.w3.org/TR/soap12-mtom/) for the requests: they are sent as
+     * multipart/related packages, where the binary values of the message travel as raw bytes
+     * in MIME parts of their own, referred to by xop:Include elements, rather than as base64 text.
+     * These are the values of type QByteArray, and the xsd:base64Binary values (as generated by kdwsdl2cpp).
+     *
+     * MTOM responses are understood in any case, and KDSoapServer answers MTOM requests with MTOM responses.
+     * The binary values of MTOM messages are returned as is by KDSoapValue::base64BinaryValue().
+     *
+     * Requests with MTOM are not streamed, see setStreamingRequests().
+     * This option is disabled by default.
+     * \since 2.2
+     */
+    void setMtomRequests(bool mtom);
+
+    /**
+     * Returns true if the requests are sent with MTOM.
+     * \sa setMtomRequests()
+     * \since 2.2
+     */
+    bool mtomRequests() const;
+
+    /**
+     * Compression of the request bodies, see setRequestCompression().
+     * \since 2.2
+     */
+    enum Compression
+    {
+        NoCompression, ///< The requests are sent as they are (default)
+        GzipCompression, ///< The requests are sent with Content-Encoding: gzip
+        DeflateCompression ///< The requests are sent with Content-Encoding: deflate
+    };
+
+    /**
+     * Enables compression of the requests, for servers which accept compressed requests (KDSoapServer does).
+     * Requests smaller than compressionThreshold() are still sent as they are.
+     *
+     * Compression needs KDSoap to be built with zlib, otherwise the requests are sent as they are.
+     * Streamed requests aren't compressed either, see setStreamingRequests().
+     *
+     * Compressed responses are accepted in any case: QNetworkAccessManager asks for them,
+     * and decompresses them, unless the Accept-Encoding header is set with setRawHeader().
+     * \since 2.2
+     */
+    void setRequestCompression(Compression compression);
+
+    /**
+     * Returns the compression of the requests.
+     * \sa setRequestCompression()
+     * \since 2.2
+     */
+    Compression requestCompression() const;
+
+    /**
+     * Sets the zlib compression level of the requests, from 1 (fastest) to 9 (smallest).
+     * The default value, -1, means zlib's default level (currently 6).
+     * \sa setRequestCompression()
+     * \since 2.2
+     */
+    void setCompressionLevel(int level);
+
+    /**
+     * Returns the compression level of the requests.
+     * \sa setCompressionLevel()
+     * \since 2.2
+     */
+    int compressionLevel() const;
+
+    /**
+     * Sets the size in bytes from which requests are compressed, 1024 by default:
+     * compressing smaller requests would cost more than it saves.
+     * \sa setRequestCompression()
+     * \since 2.2
+     */
+    void setCompressionThreshold(int bytes);
+
+    /**
+     * Returns the size in bytes from which requests are compressed.
+     * \sa setCompressionThreshold()
+     * \since 2.2
+     */
+    int compressionThreshold() const;
+
 private:
     friend class KDSoapThreadTask;
     KDSoapClientInterfacePrivate *const d;
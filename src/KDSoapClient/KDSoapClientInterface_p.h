@@ -10,6 +10,7 @@
 #ifndef KDSOAPCLIENTINTERFACE_P_H
 #define KDSOAPCLIENTINTERFACE_P_H
 
+#include <QtCore/QVector>
 #include <QtCore/QXmlStreamWriter>
 #include <QtNetwork/QNetworkAccessManager>
 #include <QtNetwork/QNetworkCookieJar>
@@ -18,8 +19,9 @@
 #include "KDSoapAuthentication.h"
 #include "KDSoapClientInterface.h"
 #include "KDSoapClientThread_p.h"
+#include "KDSoapMessageWriter_p.h"
 QT_BEGIN_NAMESPACE
-class QBuffer;
+class QIODevice;
 QT_END_NAMESPACE
 class KDSoapMessage;
 class KDSoapNamespacePrefixes;
@@ -39,6 +41,7 @@ public:
     KDSoapClientThread m_thread;
     KDSoapAuthentication m_authentication;
     QMap<QString, KDSoapMessage> m_persistentHeaders;
+    QSharedPointer<KDSoapPersistentHeadersCache> m_persistentHeadersCache;
     QMap<QByteArray, QByteArray> m_httpHeaders;
     KDSoap::SoapVersion m_version;
     KDSoapClientInterface::Style m_style;
@@ -52,10 +55,23 @@ public:
     int m_timeout;
     bool m_sendSoapActionInHttpHeader = true;
     bool m_sendSoapActionInWsAddressingHeader = false;
+    bool m_lazyResponseParsing = false;
+    bool m_compactResponseParsing = false;
+    bool m_replaceInvalidCharacterReferences = false;
+    bool m_streamingRequests = false;
+    bool m_nativeXmlWriter = false;
+    bool m_mtomRequests = false;
+    KDSoapClientInterface::Compression m_requestCompression = KDSoapClientInterface::NoCompression;
+    int m_compressionLevel = -1;
+    int m_compressionThreshold = 1024;
 
     QNetworkAccessManager *accessManager();
     QNetworkRequest prepareRequest(const QString &method, const QString &action);
-    QBuffer *prepareRequestBuffer(const QString &method, const KDSoapMessage &message, const QString &soapAction, const KDSoapHeaders &headers);
+    // Sets up \p request for the returned device, when streaming requests or with MTOM
+    QIODevice *prepareRequestDevice(const QString &method, const KDSoapMessage &message, const QString &soapAction, const KDSoapHeaders &headers,
+                                    QNetworkRequest &request);
+    // Compresses \p body into \p compressed and sets the Content-Encoding of \p request, if configured to
+    bool compressRequestBody(const QVector<QByteArray> &body, QNetworkRequest &request, QByteArray *compressed) const;
     void writeElementContents(KDSoapNamespacePrefixes &namespacePrefixes, QXmlStreamWriter &writer, const KDSoapValue &element, KDSoapMessage::Use use);
     void writeChildren(KDSoapNamespacePrefixes &namespacePrefixes, QXmlStreamWriter &writer, const KDSoapValueList &args, KDSoapMessage::Use use);
     void writeAttributes(QXmlStreamWriter &writer, const QList<KDSoapValue> &attributes);
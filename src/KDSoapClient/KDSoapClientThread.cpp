@@ -83,16 +83,24 @@ void KDSoapThreadTask::process(QNetworkAccessManager &accessManager)
 
     accessManager.setProxy(m_data->m_iface->d->accessManager()->proxy());
 
-    QBuffer *buffer = m_data->m_iface->d->prepareRequestBuffer(m_data->m_method,
-                                                               m_data->m_message,
-                                                               m_data->m_action,
-                                                               m_data->m_headers);
     QNetworkRequest request = m_data->m_iface->d->prepareRequest(m_data->m_method, m_data->m_action);
-    QNetworkReply *reply = accessManager.post(request, buffer);
+    QIODevice *device = m_data->m_iface->d->prepareRequestDevice(m_data->m_method,
+                                                                 m_data->m_message,
+                                                                 m_data->m_action,
+                                                                 m_data->m_headers,
+                                                                 request);
+    QNetworkReply *reply = accessManager.post(request, device);
     m_data->m_iface->d->setupReply(reply);
-    maybeDebugRequest(buffer->data(), reply->request(), reply);
-    KDSoapPendingCall pendingCall(reply, buffer);
+    maybeDebugRequest(device, reply->request(), reply);
+    KDSoapPendingCall pendingCall(reply, device);
     pendingCall.d->soapVersion = m_data->m_iface->d->m_version;
+    pendingCall.d->messageReader.setLazyParsing(m_data->m_iface->d->m_lazyResponseParsing);
+    pendingCall.d->messageReader.setCompactParsing(m_data->m_iface->d->m_compactResponseParsing);
+    pendingCall.d->messageReader.setReplaceInvalidCharacterReferences(m_data->m_iface->d->m_replaceInvalidCharacterReferences);
+    if (m_data->m_responseReader) {
+        pendingCall.d->setResponseReader(m_data->m_responseReader);
+        pendingCall.d->replyPipe = m_data->m_replyPipe;
+    }
 
     KDSoapPendingCallWatcher *watcher = new KDSoapPendingCallWatcher(pendingCall, this);
     connect(watcher, &KDSoapPendingCallWatcher::finished, this, &KDSoapThreadTask::slotFinished);
@@ -21,6 +21,7 @@
 #include <QtNetwork/QNetworkAccessManager>
 
 class KDSoapPendingCallWatcher;
+class KDSoapReplyPipe;
 class KDSoapClientInterface;
 QT_BEGIN_NAMESPACE
 class QEventLoop;
@@ -36,6 +37,7 @@ public:
         , m_message(message)
         , m_action(action)
         , m_headers(headers)
+        , m_replyPipe(nullptr)
     {
     }
 
@@ -61,6 +63,8 @@ public:
     KDSoapMessage m_response;
     KDSoapHeaders m_responseHeaders;
     KDSoapHeaders m_headers;
+    KDSoapClientInterface::ResponseReader m_responseReader;
+    KDSoapReplyPipe *m_replyPipe; // the reply is parsed by the calling thread, see KDSoapClientInterface::call()
 };
 
 class KDSoapThreadTask : public QObject
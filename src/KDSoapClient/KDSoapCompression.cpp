@@ -0,0 +1,232 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2010-2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+#include "KDSoapCompression_p.h"
+#include <QtCore/QList>
+
+#ifdef KDSOAP_HAVE_ZLIB
+#include <zlib.h>
+
+#include <cstring>
+#include <limits>
+#endif
+
+bool KDSoapCompression::isAvailable()
+{
+#ifdef KDSOAP_HAVE_ZLIB
+    return true;
+#else
+    return false;
+#endif
+}
+
+KDSoapCompression::Encoding KDSoapCompression::contentEncoding(const QByteArray &contentEncoding)
+{
+    const QByteArray value = contentEncoding.trimmed().toLower(); // content codings are case-insensitive
+    if (value.isEmpty() || value == "identity") {
+        return Identity;
+    }
+    if (value == "gzip" || value == "x-gzip") {
+        return Gzip;
+    }
+    if (value == "deflate") {
+        return Deflate;
+    }
+    return Unsupported;
+}
+
+KDSoapCompression::Encoding KDSoapCompression::acceptedEncoding(const QByteArray &acceptEncoding)
+{
+    if (!isAvailable()) {
+        return Identity;
+    }
+    Encoding result = Identity;
+    double bestQuality = 0;
+    const QList<QByteArray> items = acceptEncoding.split(',');
+    for (const QByteArray &item : items) {
+        const QList<QByteArray> parameters = item.split(';');
+        const QByteArray coding = parameters.first().trimmed().toLower();
+        double quality = 1;
+        for (int i = 1; i < parameters.size(); ++i) {
+            const QByteArray parameter = parameters.at(i).trimmed();
+            if (parameter.startsWith("q=") || parameter.startsWith("Q=")) { // krazy:exclude=strings
+                bool ok;
+                quality = parameter.mid(2).toDouble(&ok);
+                if (!ok) {
+                    quality = 0;
+                }
+            }
+        }
+        Encoding encoding;
+        if (coding == "gzip" || coding == "x-gzip" || coding == "*") {
+            encoding = Gzip;
+        } else if (coding == "deflate") {
+            encoding = Deflate;
+        } else {
+            continue;
+        }
+        // On equal quality, gzip wins: some implementations send raw deflate data for "deflate"
+        if (quality > bestQuality || (quality == bestQuality && quality > 0 && encoding == Gzip)) {
+            bestQuality = quality;
+            result = encoding;
+        }
+    }
+    return result;
+}
+
+QByteArray KDSoapCompression::name(Encoding encoding)
+{
+    switch (encoding) {
+    case Gzip:
+        return "gzip";
+    case Deflate:
+        return "deflate";
+    case Identity:
+    case Unsupported:
+        break;
+    }
+    return "identity";
+}
+
+#ifdef KDSOAP_HAVE_ZLIB
+// Leaves room for the QByteArray header, in an allocation whose size is an int
+static const qint64 s_maximumOutputSize = std::numeric_limits<int>::max() - 1024;
+
+static bool inflateData(const QByteArray &data, int windowBits, qint64 maximumSize, QByteArray *output, bool *tooLarge)
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, windowBits) != Z_OK) {
+        return false;
+    }
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.constData()));
+    stream.avail_in = uInt(data.size());
+    // One more byte than the maximum tells that the data is too large
+    const qint64 capacity = qMin(maximumSize + 1, s_maximumOutputSize);
+    // Computed in 64 bits, so that it can't overflow; the buffer grows below if needed
+    output->resize(int(qMin(qMax(4 * qint64(data.size()), qint64(1024)), capacity)));
+    int ret = Z_OK;
+    do {
+        if (stream.total_out == uLong(output->size())) {
+            if (output->size() >= capacity) {
+                break; // still Z_OK
+            }
+            output->resize(int(qMin(2 * qint64(output->size()), capacity)));
+        }
+        stream.next_out = reinterpret_cast<Bytef *>(output->data()) + stream.total_out;
+        stream.avail_out = uInt(uLong(output->size()) - stream.total_out);
+        ret = inflate(&stream, Z_NO_FLUSH);
+    } while (ret == Z_OK);
+    const bool overflow = ret == Z_OK || qint64(stream.total_out) > maximumSize;
+    if (tooLarge) {
+        *tooLarge = overflow;
+    }
+    // Z_BUF_ERROR here means that the input ended before the end of the stream
+    const bool ok = ret == Z_STREAM_END && !overflow;
+    output->resize(ok ? int(stream.total_out) : 0);
+    inflateEnd(&stream);
+    return ok;
+}
+#endif
+
+bool KDSoapCompression::compress(const QVector<QByteArray> &pieces, Encoding encoding, int level, QByteArray *output)
+{
+#ifdef KDSOAP_HAVE_ZLIB
+    if (encoding != Gzip && encoding != Deflate) {
+        return false;
+    }
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    // 16 more window bits select the gzip wrapper rather than the zlib one
+    const int windowBits = encoding == Gzip ? 15 + 16 : 15;
+    if (deflateInit2(&stream, level < 0 ? Z_DEFAULT_COMPRESSION : qMin(level, 9), Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    uLong size = 0;
+    for (const QByteArray &piece : pieces) {
+        size += uLong(piece.size());
+    }
+    // Enough in practice, the buffer grows below otherwise
+    output->resize(int(deflateBound(&stream, size)));
+
+    int ret = Z_OK;
+    // One more iteration, with no input, for finishing the stream
+    for (int i = 0; i <= pieces.size(); ++i) {
+        const bool last = i == pieces.size();
+        if (!last) {
+            stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(pieces.at(i).constData()));
+            stream.avail_in = uInt(pieces.at(i).size());
+        }
+        do {
+            if (stream.total_out == uLong(output->size())) {
+                output->resize(2 * output->size() + 64);
+            }
+            stream.next_out = reinterpret_cast<Bytef *>(output->data()) + stream.total_out;
+            stream.avail_out = uInt(uLong(output->size()) - stream.total_out);
+            ret = deflate(&stream, last ? Z_FINISH : Z_NO_FLUSH);
+            if (ret == Z_STREAM_ERROR) {
+                deflateEnd(&stream);
+                output->clear();
+                return false;
+            }
+        } while (stream.avail_in > 0 || (last && ret != Z_STREAM_END));
+    }
+    output->resize(int(stream.total_out));
+    deflateEnd(&stream);
+    return true;
+#else
+    Q_UNUSED(pieces);
+    Q_UNUSED(encoding);
+    Q_UNUSED(level);
+    Q_UNUSED(output);
+    return false;
+#endif
+}
+
+bool KDSoapCompression::decompress(const QByteArray &data, Encoding encoding, QByteArray *output, qint64 maximumSize, bool *tooLarge)
+{
+    if (tooLarge) {
+        *tooLarge = false;
+    }
+    if (encoding == Identity) {
+        if (maximumSize >= 0 && data.size() > maximumSize) {
+            if (tooLarge) {
+                *tooLarge = true;
+            }
+            return false;
+        }
+        *output = data;
+        return true;
+    }
+#ifdef KDSOAP_HAVE_ZLIB
+    if (encoding != Gzip && encoding != Deflate) {
+        return false;
+    }
+    if (maximumSize < 0) {
+        maximumSize = s_maximumOutputSize;
+    }
+    bool overflow = false;
+    // 32 more window bits detect the zlib or gzip wrapper from the header
+    if (inflateData(data, 32 + 15, maximumSize, output, &overflow)) {
+        return true;
+    }
+    if (overflow) {
+        if (tooLarge) {
+            *tooLarge = true;
+        }
+        return false;
+    }
+    // Some implementations send raw deflate data, without the zlib wrapper
+    return encoding == Deflate && inflateData(data, -15, maximumSize, output, tooLarge);
+#else
+    Q_UNUSED(output);
+    Q_UNUSED(maximumSize);
+    return false;
+#endif
+}
@@ -0,0 +1,71 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2010-2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#ifndef KDSOAPCOMPRESSION_P_H
+#define KDSOAPCOMPRESSION_P_H
+
+#include "KDSoapGlobal.h"
+#include <QtCore/QByteArray>
+#include <QtCore/QVector>
+
+/**
+ * \internal
+ * Compression of HTTP bodies, as described by the Content-Encoding and Accept-Encoding headers.
+ * Only available when KDSoap was built with zlib, see isAvailable().
+ */
+class KDSOAP_EXPORT KDSoapCompression
+{
+public:
+    enum Encoding
+    {
+        Identity, ///< not compressed
+        Gzip,
+        Deflate, ///< the zlib format, as HTTP defines it (RFC 9110)
+        Unsupported
+    };
+
+    /**
+     * Returns true if KDSoap was built with zlib.
+     * Otherwise compress() and decompress() fail for anything but Identity.
+     */
+    static bool isAvailable();
+
+    /**
+     * Returns the encoding named by the value \p contentEncoding of a Content-Encoding header.
+     */
+    static Encoding contentEncoding(const QByteArray &contentEncoding);
+
+    /**
+     * Returns the preferred encoding among those listed, with their q-values, in the value \p acceptEncoding
+     * of an Accept-Encoding header, or Identity if none of them can be used.
+     */
+    static Encoding acceptedEncoding(const QByteArray &acceptEncoding);
+
+    /**
+     * Returns the name of \p encoding, for a Content-Encoding header.
+     */
+    static QByteArray name(Encoding encoding);
+
+    /**
+     * Compresses the concatenation of \p pieces with \p encoding into \p output.
+     * \p level is the zlib level, from 1 to 9, or -1 for the default one.
+     */
+    static bool compress(const QVector<QByteArray> &pieces, Encoding encoding, int level, QByteArray *output);
+
+    /**
+     * Decompresses \p data, compressed with \p encoding, into \p output.
+     * Returns false if \p data is invalid or truncated, or if it decompresses to more than \p maximumSize bytes;
+     * \p tooLarge, if set, tells the latter case apart. A negative \p maximumSize means no limit
+     * but the size of a QByteArray.
+     */
+    static bool decompress(const QByteArray &data, Encoding encoding, QByteArray *output, qint64 maximumSize = -1, bool *tooLarge = nullptr);
+};
+
+#endif // KDSOAPCOMPRESSION_P_H
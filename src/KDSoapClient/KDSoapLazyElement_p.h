@@ -0,0 +1,98 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2010-2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#ifndef KDSOAPLAZYELEMENT_P_H
+#define KDSOAPLAZYELEMENT_P_H
+
+#include "KDSoapNamespaceScope_p.h"
+#include <QtCore/QByteArray>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QVector>
+
+class KDSoapValue;
+class KDSoapValueList;
+
+/**
+ * \internal
+ * A lazily parsed document, and where its elements are in it.
+ *
+ * The elements are recorded while the document is read, so that parsing the children of an
+ * element later on doesn't need to go through all its descendants again.
+ */
+class KDSoapLazyDocument : public QSharedData
+{
+public:
+    typedef QExplicitlySharedDataPointer<KDSoapLazyDocument> Ptr;
+
+    /// Byte offsets of an element in the document
+    struct Element
+    {
+        int tagBegin; ///< the '<' of the start tag
+        int contentBegin; ///< the first byte after the start tag
+        int contentEnd; ///< the '<' of the end tag, or contentBegin for an empty element tag
+        int tagEnd; ///< the first byte after the end tag
+        int next; ///< the index of the element following this one and its descendants
+    };
+
+    explicit KDSoapLazyDocument(const QSharedPointer<const QByteArray> &document)
+        : m_document(document)
+    {
+    }
+
+    const QSharedPointer<const QByteArray> m_document; ///< UTF-8
+    QVector<Element> m_elements; ///< in document order
+};
+
+/**
+ * \internal
+ * The child elements of a value which haven't been parsed yet, see KDSoapMessageReader::setLazyParsing().
+ *
+ * These are elements of a KDSoapLazyDocument, which are only turned into KDSoapValues when
+ * KDSoapValue::childValues() is called for the first time.
+ */
+class KDSoapLazyElement : public QSharedData
+{
+public:
+    typedef QExplicitlySharedDataPointer<KDSoapLazyElement> Ptr;
+
+    /**
+     * \param document the document, shared by all the lazy elements created from it
+     * \param first the index of the first child element in the document
+     * \param end the index of the element following the last descendant
+     * \param scope the namespace declarations in effect for the child elements
+     */
+    KDSoapLazyElement(const KDSoapLazyDocument::Ptr &document, int first, int end, const KDSoapNamespaceScope::Ptr &scope)
+        : m_document(document)
+        , m_first(first)
+        , m_end(end)
+        , m_scope(scope)
+    {
+    }
+
+    /**
+     * Parses the child elements and appends them to \p children.
+     * Their own child elements are left unparsed in turn.
+     * Implemented in KDSoapMessageReader.cpp
+     */
+    void materialize(KDSoapValueList &children) const;
+
+    /**
+     * Makes \p lazyElement the (not yet parsed) child elements of \p value.
+     */
+    static void attach(KDSoapValue &value, const Ptr &lazyElement);
+
+private:
+    const KDSoapLazyDocument::Ptr m_document;
+    const int m_first;
+    const int m_end;
+    const KDSoapNamespaceScope::Ptr m_scope;
+};
+
+#endif // KDSOAPLAZYELEMENT_P_H
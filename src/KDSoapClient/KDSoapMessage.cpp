@@ -29,6 +29,7 @@ public:
     bool isFault;
     bool hasMessageAddressingProperties;
     KDSoapMessageAddressingProperties messageAddressingProperties;
+    KDSoapMessage::ContentsWriter contentsWriter;
 };
 
 KDSoapMessage::KDSoapMessage()
@@ -49,12 +50,34 @@ KDSoapMessage &KDSoapMessage::operator=(const KDSoapMessage &other)
     return *this;
 }
 
+KDSoapMessage::KDSoapMessage(KDSoapMessage &&other) noexcept
+    : KDSoapValue(std::move(other))
+    , d(std::move(other.d))
+{
+    // Same as KDSoapValue(KDSoapValue &&)
+    static const QSharedDataPointer<KDSoapMessageData> s_empty(new KDSoapMessageData);
+    other.d = s_empty;
+}
+
+KDSoapMessage &KDSoapMessage::operator=(KDSoapMessage &&other) noexcept
+{
+    KDSoapValue::operator=(std::move(other));
+    d.swap(other.d);
+    return *this;
+}
+
 KDSoapMessage &KDSoapMessage::operator=(const KDSoapValue &other)
 {
     KDSoapValue::operator=(other);
     return *this;
 }
 
+KDSoapMessage &KDSoapMessage::operator=(KDSoapValue &&other) noexcept
+{
+    KDSoapValue::operator=(std::move(other));
+    return *this;
+}
+
 bool KDSoapMessage::operator==(const KDSoapMessage &other) const
 {
     return KDSoapValue::operator==(other) && d->use == other.d->use && d->isFault == other.d->isFault;
@@ -71,21 +94,26 @@ KDSoapMessage::~KDSoapMessage()
 
 void KDSoapMessage::addArgument(const QString &argumentName, const QVariant &argumentValue, const QString &typeNameSpace, const QString &typeName)
 {
-    KDSoapValue soapValue(argumentName, argumentValue, typeNameSpace, typeName);
-    if (isQualified()) {
-        soapValue.setQualified(true);
-    }
-    childValues().append(soapValue);
+    addArgument(KDSoapValue(argumentName, argumentValue, typeNameSpace, typeName));
 }
 
 void KDSoapMessage::addArgument(const QString &argumentName, const KDSoapValueList &argumentValueList, const QString &typeNameSpace,
                                 const QString &typeName)
 {
-    KDSoapValue soapValue(argumentName, argumentValueList, typeNameSpace, typeName);
+    addArgument(KDSoapValue(argumentName, argumentValueList, typeNameSpace, typeName));
+}
+
+void KDSoapMessage::addArgument(const QString &argumentName, KDSoapValueList &&argumentValueList, const QString &typeNameSpace, const QString &typeName)
+{
+    addArgument(KDSoapValue(argumentName, std::move(argumentValueList), typeNameSpace, typeName));
+}
+
+void KDSoapMessage::addArgument(KDSoapValue &&value)
+{
     if (isQualified()) {
-        soapValue.setQualified(true);
+        value.setQualified(true);
     }
-    childValues().append(soapValue);
+    childValues().append(std::move(value));
 }
 
 // I'm leaving the arguments() method even though it's the same as childValues,
@@ -196,6 +224,28 @@ void KDSoapMessage::setUse(Use use)
     d->use = use;
 }
 
+void KDSoapMessage::setContentsWriter(const ContentsWriter &contentsWriter)
+{
+    d->contentsWriter = contentsWriter;
+}
+
+KDSoapMessage::ContentsWriter KDSoapMessage::contentsWriter() const
+{
+    return d->contentsWriter;
+}
+
+void KDSoapHeaders::append(KDSoapMessage &&header)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    QList<KDSoapMessage>::append(std::move(header));
+#else
+    // Same as KDSoapValueList::append(KDSoapValue &&)
+    KDSoapMessage moved(std::move(header));
+    QList<KDSoapMessage>::append(header);
+    last() = std::move(moved);
+#endif
+}
+
 KDSoapMessage KDSoapHeaders::header(const QString &name) const
 {
     for (const KDSoapMessage &header : qAsConst(*this)) {
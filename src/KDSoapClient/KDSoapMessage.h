@@ -12,6 +12,7 @@
 
 #include <QtCore/QSharedDataPointer>
 #include <QtCore/QVariant>
+#include <functional>
 
 #include "KDSoapMessageAddressingProperties.h"
 #include "KDSoapValue.h"
@@ -46,11 +47,28 @@ public:
      */
     KDSoapMessage &operator=(const KDSoapMessage &other);
 
+    /**
+     * Moves the contents of \p other into a new message. \p other is left empty, as if default-constructed.
+     * \since 2.2
+     */
+    KDSoapMessage(KDSoapMessage &&other) noexcept;
+    /**
+     * Moves the contents of \p other into this message. \p other gets the previous contents of this message.
+     * \since 2.2
+     */
+    KDSoapMessage &operator=(KDSoapMessage &&other) noexcept;
+
     /**
      * Fills in KDSoapMessage from a KDSoapValue.
      */
     KDSoapMessage &operator=(const KDSoapValue &other);
 
+    /**
+     * Fills in KDSoapMessage from a KDSoapValue, moving it rather than copying it.
+     * \since 2.2
+     */
+    KDSoapMessage &operator=(KDSoapValue &&other) noexcept;
+
     /**
      * Compares two KDSoapMessages
      */
@@ -71,6 +89,32 @@ public:
      */
     Use use() const;
 
+    /**
+     * Writes the contents of the message element (its attributes and child elements)
+     * into the element which \p writer just started. \p messageNamespace is the namespace
+     * of the message element.
+     * \since 2.2
+     */
+    typedef std::function<void(QXmlStreamWriter &writer, const QString &messageNamespace)> ContentsWriter;
+
+    /**
+     * Sets a function which writes the contents of the message straight to XML, when the message
+     * is sent, instead of the child values of the message (which should then be empty).
+     * The name and namespace of the message element are still the ones of the message.
+     * The contents writer is responsible for the \c use of the message.
+     *
+     * This is used by the code generated by kdwsdl2cpp -xml-writers, to send the generated
+     * request and response classes without building a tree of KDSoapValues first.
+     * \since 2.2
+     */
+    void setContentsWriter(const ContentsWriter &contentsWriter);
+
+    /**
+     * Returns the function passed to setContentsWriter(), if any.
+     * \since 2.2
+     */
+    ContentsWriter contentsWriter() const;
+
     /**
      * Adds an argument to the message.
      *
@@ -108,6 +152,21 @@ public:
     void addArgument(const QString &argumentName, const KDSoapValueList &argumentValueList, const QString &typeNameSpace = QString(),
                      const QString &typeName = QString());
 
+    /**
+     * Adds a complex-type argument to the message, moving \p argumentValueList into it rather than copying it.
+     * \since 2.2
+     */
+    void addArgument(const QString &argumentName, KDSoapValueList &&argumentValueList, const QString &typeNameSpace = QString(),
+                     const QString &typeName = QString());
+
+    /**
+     * Adds \p value to the arguments of the message, moving it rather than copying it.
+     *
+     * If the message isQualified(), the value will be set to qualified as well, for convenience.
+     * \since 2.2
+     */
+    void addArgument(KDSoapValue &&value);
+
     /**
      * Returns the arguments for the message.
      * The list can be modified, in order to modify the message.
@@ -185,6 +244,14 @@ private:
 class KDSOAP_EXPORT KDSoapHeaders : public QList<KDSoapMessage> // krazy:exclude=dpointer
 {
 public:
+    using QList<KDSoapMessage>::append;
+
+    /**
+     * Appends \p header to the list, moving it rather than copying it.
+     * \since 2.2
+     */
+    void append(KDSoapMessage &&header);
+
     /**
      * Convenience method: return the header with a given XML element name (assumes unicity)
      */
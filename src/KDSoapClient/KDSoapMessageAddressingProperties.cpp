@@ -15,7 +15,6 @@
 #include <QDebug>
 #include <QLatin1String>
 #include <QString>
-#include <QXmlStreamWriter>
 
 class KDSoapMessageAddressingPropertiesData : public QSharedData
 {
@@ -268,14 +267,14 @@ QString KDSoapMessageAddressingProperties::addressingNamespaceToString(KDSoapAdd
     }
 }
 
-static void writeAddressField(QXmlStreamWriter &writer, const QString &addressingNS, const QString &address)
+static void writeAddressField(KDSoapXmlWriter &writer, const QString &addressingNS, const QString &address)
 {
     writer.writeStartElement(addressingNS, QLatin1String("Address"));
     writer.writeCharacters(address);
     writer.writeEndElement();
 }
 
-static void writeKDSoapValueVariant(QXmlStreamWriter &writer, const KDSoapValue &value)
+static void writeKDSoapValueVariant(KDSoapXmlWriter &writer, const KDSoapValue &value)
 {
     const QVariant valueToWrite = value.value();
     if (valueToWrite.canConvert(QVariant::String)) {
@@ -286,7 +285,7 @@ static void writeKDSoapValueVariant(QXmlStreamWriter &writer, const KDSoapValue
     }
 }
 
-static void writeKDSoapValueListHierarchy(KDSoapNamespacePrefixes &namespacePrefixes, QXmlStreamWriter &writer, const QString &addressingNS,
+static void writeKDSoapValueListHierarchy(KDSoapNamespacePrefixes &namespacePrefixes, KDSoapXmlWriter &writer, const QString &addressingNS,
                                           const KDSoapValueList &values)
 {
     for (const KDSoapValue &value : qAsConst(values)) {
@@ -303,7 +302,7 @@ static void writeKDSoapValueListHierarchy(KDSoapNamespacePrefixes &namespacePref
     }
 }
 
-void KDSoapMessageAddressingProperties::writeMessageAddressingProperties(KDSoapNamespacePrefixes &namespacePrefixes, QXmlStreamWriter &writer,
+void KDSoapMessageAddressingProperties::writeMessageAddressingProperties(KDSoapNamespacePrefixes &namespacePrefixes, KDSoapXmlWriter &writer,
                                                                          const QString &messageNamespace, bool forceQualified) const
 {
     Q_UNUSED(messageNamespace);
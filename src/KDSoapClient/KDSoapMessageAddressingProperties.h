@@ -308,9 +308,9 @@ public:
 
 private:
     /**
-     * Private method called to write the properties to the soap header, using QXmlStreamWriter
+     * Private method called to write the properties to the soap header, using KDSoapXmlWriter
      */
-    void writeMessageAddressingProperties(KDSoapNamespacePrefixes &namespacePrefixes, QXmlStreamWriter &writer, const QString &messageNamespace,
+    void writeMessageAddressingProperties(KDSoapNamespacePrefixes &namespacePrefixes, KDSoapXmlWriter &writer, const QString &messageNamespace,
                                           bool forceQualified) const;
 
     /**
@@ -8,240 +8,1253 @@
 **
 ****************************************************************************/
 
-#include "KDDateTime.h"
+#include "KDSoapAtomTable_p.h"
+#include "KDSoapLazyElement_p.h"
 #include "KDSoapMessageReader_p.h"
 #include "KDSoapNamespaceManager.h"
 #include "KDSoapNamespacePrefixes_p.h"
+#include "KDSoapNamespaceScope_p.h"
+#include "KDSoapValueArena_p.h"
 
+#include <QDateTime>
 #include <QDebug>
+#include <QIODevice>
+#include <QScopedPointer>
+#include <QSharedPointer>
 #include <QXmlStreamReader>
 
+#include <cstring>
+
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
 #define QStringView QStringRef
 #endif
 
-static QStringView namespaceForPrefix(const QXmlStreamNamespaceDeclarations &decls, const QString &prefix)
+// Converters from the text of an element to its value, for the XSD builtin types (see KDSoapTextConverter).
+static QVariant convertToByteArray(const QString &text, bool *ok)
 {
-    for (const QXmlStreamNamespaceDeclaration &decl : qAsConst(decls)) {
-        if (decl.prefix() == prefix) {
-            return decl.namespaceUri();
-        }
-    }
-    return QStringView();
+    // Still base64-encoded, like QVariant::convert does
+    *ok = true;
+    return text.toUtf8();
 }
 
-static int xmlTypeToMetaType(const QString &xmlType)
+static QVariant convertToInt(const QString &text, bool *ok)
 {
-    // Reverse operation from variantToXmlType in KDSoapClientInterface, keep in sync
-    static const struct
-    {
-        const char *xml; // xsd: prefix assumed
-        const int metaTypeId;
-    } s_types[] = {{"string", QVariant::String}, // or QUrl
-                   {"base64Binary", QVariant::ByteArray},
-                   {"int", QVariant::Int}, // or long, or uint, or longlong
-                   {"unsignedInt", QVariant::ULongLong},
-                   {"boolean", QVariant::Bool},
-                   {"float", QMetaType::Float},
-                   {"double", QVariant::Double},
-                   {"time", QVariant::Time},
-                   {"date", QVariant::Date}};
-    // Speed: could be sorted and then we could use qBinaryFind
-    for (const auto &type : s_types) {
-        if (xmlType == QLatin1String(type.xml)) {
-            return type.metaTypeId;
-        }
+    // Same as QVariant::convert, including for out-of-range values
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+    // Qt 5 goes through a 64-bit integer, then truncates
+    return int(text.toLongLong(ok));
+#else
+    return text.toInt(ok);
+#endif
+}
+
+static QVariant convertToULongLong(const QString &text, bool *ok)
+{
+    return text.toULongLong(ok);
+}
+
+static QVariant convertToBool(const QString &text, bool *ok)
+{
+    // Same as QVariant::convert
+    *ok = true;
+    return !(text == QLatin1String("0") || text.compare(QLatin1String("false"), Qt::CaseInsensitive) == 0);
+}
+
+static QVariant convertToFloat(const QString &text, bool *ok)
+{
+    // Same as QVariant::convert, including for out-of-range values
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+    return float(text.toDouble(ok));
+#else
+    return text.toFloat(ok);
+#endif
+}
+
+static QVariant convertToDouble(const QString &text, bool *ok)
+{
+    return text.toDouble(ok);
+}
+
+static QVariant convertToTime(const QString &text, bool *ok)
+{
+    const QTime time = QTime::fromString(text, Qt::ISODate);
+    *ok = time.isValid();
+    return time;
+}
+
+static QVariant convertToDate(const QString &text, bool *ok)
+{
+    const QDate date = QDate::fromString(text, Qt::ISODate);
+    *ok = date.isValid();
+    return date;
+}
+
+// Perfect hash of the XSD types below, to find them with a single string comparison
+static const int s_xsdTypeSlots = 32;
+
+template<int N>
+constexpr int xsdTypeSlot(const char (&type)[N])
+{
+    return (2 * (N - 1) + type[0] + type[N - 2]) % s_xsdTypeSlots;
+}
+
+static int xsdTypeSlot(const QString &type)
+{
+    return (2 * type.size() + type.at(0).unicode() + type.at(type.size() - 1).unicode()) % s_xsdTypeSlots;
+}
+
+static_assert(xsdTypeSlot("time") == 1, "wrong slot");
+static_assert(xsdTypeSlot("int") == 3, "wrong slot");
+static_assert(xsdTypeSlot("float") == 4, "wrong slot");
+static_assert(xsdTypeSlot("string") == 6, "wrong slot");
+static_assert(xsdTypeSlot("date") == 17, "wrong slot");
+static_assert(xsdTypeSlot("base64Binary") == 19, "wrong slot");
+static_assert(xsdTypeSlot("double") == 21, "wrong slot");
+static_assert(xsdTypeSlot("dateTime") == 25, "wrong slot");
+static_assert(xsdTypeSlot("boolean") == 30, "wrong slot");
+static_assert(xsdTypeSlot("unsignedInt") == 31, "wrong slot");
+
+// Reverse operation from variantToXmlType in KDSoapValue, keep in sync
+static const struct
+{
+    const char *xml; // xsd: prefix assumed
+    KDSoapTextConverter converter;
+} s_xsdTypes[s_xsdTypeSlots] = {{nullptr, nullptr},
+                                {"time", convertToTime},
+                                {nullptr, nullptr},
+                                {"int", convertToInt}, // or long, or uint, or longlong
+                                {"float", convertToFloat},
+                                {nullptr, nullptr},
+                                {"string", nullptr}, // or QUrl; nothing to convert
+                                {nullptr, nullptr},
+                                {nullptr, nullptr},
+                                {nullptr, nullptr},
+                                {nullptr, nullptr},
+                                {nullptr, nullptr},
+                                {nullptr, nullptr},
+                                {nullptr, nullptr},
+                                {nullptr, nullptr},
+                                {nullptr, nullptr},
+                                {nullptr, nullptr},
+                                {"date", convertToDate},
+                                {nullptr, nullptr},
+                                {"base64Binary", convertToByteArray},
+                                {nullptr, nullptr},
+                                {"double", convertToDouble},
+                                {nullptr, nullptr},
+                                {nullptr, nullptr},
+                                {nullptr, nullptr},
+                                // Kept as a string, KDDateTime::fromDateString() is called on it later
+                                {"dateTime", nullptr},
+                                {nullptr, nullptr},
+                                {nullptr, nullptr},
+                                {nullptr, nullptr},
+                                {nullptr, nullptr},
+                                {"boolean", convertToBool},
+                                {"unsignedInt", convertToULongLong}};
+
+static KDSoapTextConverter xmlTypeToConverter(const QString &xmlType)
+{
+    if (xmlType.isEmpty()) {
+        return nullptr;
     }
-    if (xmlType == QLatin1String("dateTime")) {
-        return qMetaTypeId<KDDateTime>();
+    const auto &type = s_xsdTypes[xsdTypeSlot(xmlType)];
+    if (type.xml && xmlType == QLatin1String(type.xml)) {
+        return type.converter;
     }
     // This will happen with any custom type, don't bother the user
-    // qDebug() << QString::fromLatin1("xmlTypeToMetaType: XML type %1 is not supported in "
-    //                                "KDSoap, see the documentation").arg(xmlType);
-    return -1;
+    return nullptr;
+}
+
+enum AttributeKind
+{
+    PlainAttribute, ///< becomes a KDSoapValue in the attributes of the element
+    TypeAttribute, ///< xsi:type
+    IgnoredAttribute
+};
+
+static AttributeKind attributeKind(const QXmlStreamAttribute &attribute)
+{
+    const QStringView ns = attribute.namespaceUri();
+    // Parse xsi:type and soap-enc:arrayType
+    // and ignore anything else from the xsi or soap-enc namespaces until someone needs it...
+    if (ns == KDSoapNamespaceManager::xmlSchemaInstance1999() || ns == KDSoapNamespaceManager::xmlSchemaInstance2001()) {
+        return attribute.name() == QLatin1String("type") ? TypeAttribute : IgnoredAttribute;
+    } else if (ns == KDSoapNamespaceManager::soapEncoding() || ns == KDSoapNamespaceManager::soapEncoding200305()
+               || ns == KDSoapNamespaceManager::soapEnvelope() || ns == KDSoapNamespaceManager::soapEnvelope200305()) {
+        return IgnoredAttribute;
+    }
+    return PlainAttribute;
 }
 
-static KDSoapValue parseElement(QXmlStreamReader &reader, const QXmlStreamNamespaceDeclarations &envNsDecls)
+// The type can be like xsd:float, resolve that
+static void resolveType(QStringView attrValue, const KDSoapNamespaceScope::Ptr &scope, QString *typeNs, QString *typeName)
 {
-    const QXmlStreamNamespaceDeclarations combinedNamespaceDeclarations = envNsDecls + reader.namespaceDeclarations();
-    const QString name = reader.name().toString();
+    const int pos = attrValue.indexOf(QLatin1Char(':'));
+    *typeName = KDSoapAtomTable::intern(attrValue.mid(pos + 1));
+    *typeNs = KDSoapAtomTable::intern(scope ? scope->namespaceForPrefix(attrValue.left(pos).toString()) : QString());
+}
+
+// Creates the value for the element the reader is positioned on (a StartElement), including its attributes.
+static KDSoapValue readElementStart(QXmlStreamReader &reader, const KDSoapNamespaceScope::Ptr &scope, KDSoapTextConverter *converter)
+{
+    // Names and namespaces repeat a lot within a message (and across messages), share them
+    const QString name = KDSoapAtomTable::intern(reader.name());
     KDSoapValue val(name, QVariant());
-    val.setNamespaceUri(reader.namespaceUri().toString());
+    val.setNamespaceUri(KDSoapAtomTable::intern(reader.namespaceUri()));
     val.setNamespaceDeclarations(reader.namespaceDeclarations());
-    val.setEnvironmentNamespaceDeclarations(combinedNamespaceDeclarations);
+    KDSoapNamespaceScope::attach(val, scope);
     // qDebug() << "parsing" << name;
-    QVariant::Type metaTypeId = QVariant::Invalid;
+    *converter = nullptr;
 
     const QXmlStreamAttributes attributes = reader.attributes();
     for (const QXmlStreamAttribute &attribute : attributes) {
-        const QStringView name = attribute.name();
-        const QStringView ns = attribute.namespaceUri();
-        const QStringView attrValue = attribute.value();
-        // Parse xsi:type and soap-enc:arrayType
-        // and ignore anything else from the xsi or soap-enc namespaces until someone needs it...
-        if (ns == KDSoapNamespaceManager::xmlSchemaInstance1999() || ns == KDSoapNamespaceManager::xmlSchemaInstance2001()) {
-            if (name == QLatin1String("type")) {
-                // The type can be like xsd:float, resolve that
-                const QString type = attrValue.toString();
-                const int pos = type.indexOf(QLatin1Char(':'));
-                const QString dataType = type.mid(pos + 1);
-                val.setType(namespaceForPrefix(combinedNamespaceDeclarations, type.left(pos)).toString(), dataType);
-                metaTypeId = static_cast<QVariant::Type>(xmlTypeToMetaType(dataType));
-            }
-            continue;
-        } else if (ns == KDSoapNamespaceManager::soapEncoding() || ns == KDSoapNamespaceManager::soapEncoding200305()
-                   || ns == KDSoapNamespaceManager::soapEnvelope() || ns == KDSoapNamespaceManager::soapEnvelope200305()) {
-            continue;
-        }
-        // qDebug() << "Got attribute:" << name << ns << "=" << attrValue;
-        val.childValues().attributes().append(KDSoapValue(name.toString(), attrValue.toString()));
-    }
-    QString text;
-    while (reader.readNext() != QXmlStreamReader::Invalid) {
-        if (reader.isEndElement()) {
+        switch (attributeKind(attribute)) {
+        case TypeAttribute: {
+            QString typeNs;
+            QString dataType;
+            resolveType(attribute.value(), scope, &typeNs, &dataType);
+            val.setType(typeNs, dataType);
+            *converter = xmlTypeToConverter(dataType);
             break;
         }
-        if (reader.isCharacters()) {
-            text = reader.text().toString();
-            // qDebug() << "text=" << text;
-        } else if (reader.isStartElement()) {
-            const KDSoapValue subVal = parseElement(reader, combinedNamespaceDeclarations); // recurse
-            val.childValues().append(subVal);
+        case PlainAttribute:
+            // qDebug() << "Got attribute:" << attribute.name() << attribute.namespaceUri() << "=" << attribute.value();
+            val.childValues().attributes().append(KDSoapValue(KDSoapAtomTable::intern(attribute.name()), attribute.value().toString()));
+            break;
+        case IgnoredAttribute:
+            break;
         }
     }
+    return val;
+}
+
+// Same as readElementStart(), into a new node of \p arena, whose index is returned.
+// The node's scope is the one at \p parentScope in the arena, unless the element declares namespaces.
+static int readCompactElementStart(QXmlStreamReader &reader, int parentScope, KDSoapValueArena &arena)
+{
+    KDSoapValueArena::Node node;
+    node.name = arena.atom(KDSoapAtomTable::intern(reader.name()));
+    node.namespaceUri = arena.atom(KDSoapAtomTable::intern(reader.namespaceUri()));
+    node.typeNamespace = 0;
+    node.typeName = 0;
+    node.textBegin = 0;
+    node.textLength = 0;
+    node.firstChild = 0;
+    node.childCount = 0;
+    node.firstAttribute = arena.m_attributes.size();
+    node.attributeCount = 0;
+    node.converter = nullptr;
+    const QXmlStreamNamespaceDeclarations declarations = reader.namespaceDeclarations();
+    node.declaresNamespaces = !declarations.isEmpty();
+    node.scope = node.declaresNamespaces ? arena.addScope(KDSoapNamespaceScope::create(arena.m_scopes.at(parentScope), declarations)) : parentScope;
 
+    const QXmlStreamAttributes attributes = reader.attributes();
+    for (const QXmlStreamAttribute &attribute : attributes) {
+        switch (attributeKind(attribute)) {
+        case TypeAttribute: {
+            QString typeNs;
+            QString dataType;
+            resolveType(attribute.value(), arena.m_scopes.at(node.scope), &typeNs, &dataType);
+            node.typeNamespace = arena.atom(typeNs);
+            node.typeName = arena.atom(dataType);
+            node.converter = xmlTypeToConverter(dataType);
+            break;
+        }
+        case PlainAttribute: {
+            KDSoapValueArena::Attribute attr;
+            attr.name = arena.atom(KDSoapAtomTable::intern(attribute.name()));
+            attr.valueBegin = arena.m_text.size();
+            attr.valueLength = attribute.value().size();
+            arena.m_text += attribute.value();
+            arena.m_attributes.append(attr);
+            ++node.attributeCount;
+            break;
+        }
+        case IgnoredAttribute:
+            break;
+        }
+    }
+    arena.m_nodes.append(node);
+    return arena.m_nodes.size() - 1;
+}
+
+// Sets the text contents of an element, once its end has been reached.
+static void setElementText(KDSoapValue &val, const QString &text, KDSoapTextConverter converter)
+{
     if (!text.isEmpty()) {
-        QVariant variant(text);
-        // qDebug() << text << variant << metaTypeId;
-        // With use=encoded, we have type info, we can convert the variant here
+        // With use=encoded, we have type info, we can convert the text here
         // Otherwise, for servers, we do it later, once we know the method's parameter types.
-        if (metaTypeId != QVariant::Invalid) {
-            QVariant copy = variant;
-            if (!variant.convert(metaTypeId)) {
-                variant = copy;
+        if (converter) {
+            bool ok;
+            const QVariant variant = converter(text, &ok);
+            if (ok) {
+                val.setValue(variant);
+                return;
+            }
+        }
+        val.setValue(text);
+    }
+}
+
+// Records where the elements are in a document being read by a QXmlStreamReader, for KDSoapLazyElement.
+// QXmlStreamReader only knows about character offsets, this maps them to offsets in the UTF-8 data.
+class KDSoapLazyDocumentBuilder
+{
+public:
+    explicit KDSoapLazyDocumentBuilder(const QSharedPointer<QByteArray> &document)
+        : m_document(new KDSoapLazyDocument(document))
+        , m_data(document.data())
+        , m_charOffset(0)
+        , m_byteOffset(0)
+    {
+    }
+
+    int elementCount() const
+    {
+        return m_document->m_elements.size();
+    }
+
+    // Offsets must be passed in increasing order, so that the data is only scanned once
+    void startElement(qint64 contentBeginCharOffset)
+    {
+        KDSoapLazyDocument::Element element;
+        element.contentBegin = byteOffset(contentBeginCharOffset);
+        element.tagBegin = m_data->lastIndexOf('<', element.contentBegin - 1); // attribute values can't contain '<'
+        element.contentEnd = element.contentBegin;
+        element.tagEnd = element.contentBegin;
+        element.next = -1;
+        m_openElements.append(elementCount());
+        m_document->m_elements.append(element);
+    }
+
+    void endElement(qint64 tagEndCharOffset)
+    {
+        KDSoapLazyDocument::Element &element = m_document->m_elements[m_openElements.takeLast()];
+        element.tagEnd = byteOffset(tagEndCharOffset);
+        if (element.tagEnd > element.contentBegin) { // not an empty element tag
+            element.contentEnd = m_data->lastIndexOf('<', element.tagEnd - 1);
+        }
+        element.next = elementCount();
+    }
+
+    // The elements recorded since elementCount() was \p first, i.e. the descendants of the element being read
+    KDSoapLazyElement::Ptr createElement(int first, const KDSoapNamespaceScope::Ptr &scope) const
+    {
+        return KDSoapLazyElement::Ptr(new KDSoapLazyElement(m_document, first, elementCount(), scope));
+    }
+
+private:
+    int byteOffset(qint64 charOffset)
+    {
+        const int size = m_data->size();
+        const char *data = m_data->constData();
+        while (m_charOffset < charOffset && m_byteOffset < size) {
+            const uchar ch = data[m_byteOffset];
+            if (ch < 0x80) {
+                m_byteOffset += 1;
+            } else if ((ch & 0xe0) == 0xc0) {
+                m_byteOffset += 2;
+            } else if ((ch & 0xf0) == 0xe0) {
+                m_byteOffset += 3;
+            } else {
+                m_byteOffset += 4;
+                ++m_charOffset; // a surrogate pair
             }
+            ++m_charOffset;
         }
-        val.setValue(variant);
+        return qMin(m_byteOffset, size);
+    }
+
+    const KDSoapLazyDocument::Ptr m_document;
+    const QByteArray *m_data;
+    qint64 m_charOffset;
+    int m_byteOffset;
+    QVector<int> m_openElements;
+};
+
+// Lazy parsing can only map character offsets to byte offsets in UTF-8 documents (without a byte order mark)
+static bool isLazyParsingPossible(const QXmlStreamReader &reader, const QByteArray &data)
+{
+    if (data.startsWith("\xEF\xBB\xBF") || data.startsWith("\xFE\xFF") || data.startsWith("\xFF\xFE")) {
+        return false;
+    }
+    return reader.documentEncoding().isEmpty() || reader.documentEncoding().compare(QLatin1String("utf-8"), Qt::CaseInsensitive) == 0;
+}
+
+KDSoapValue KDSoapValueArena::createValue(int index) const
+{
+    const Node &node = m_nodes.at(index);
+    KDSoapValue val(m_atoms.at(node.name), QVariant());
+    val.setNamespaceUri(m_atoms.at(node.namespaceUri));
+    val.setType(m_atoms.at(node.typeNamespace), m_atoms.at(node.typeName));
+    if (node.declaresNamespaces) {
+        val.setNamespaceDeclarations(m_scopes.at(node.scope)->declarations());
+    }
+    KDSoapNamespaceScope::attach(val, m_scopes.at(node.scope));
+    if (node.textLength > 0) {
+        setElementText(val, text(node.textBegin, node.textLength), node.converter);
+    }
+    if (node.childCount > 0 || node.attributeCount > 0) {
+        KDSoapValueArena::attach(val, Ptr(const_cast<KDSoapValueArena *>(this)), index);
     }
     return val;
 }
 
-KDSoapMessageReader::KDSoapMessageReader()
+void KDSoapValueArena::materialize(int index, KDSoapValueList &children) const
 {
+    const Node &node = m_nodes.at(index);
+    for (int i = 0; i < node.attributeCount; ++i) {
+        const Attribute &attribute = m_attributes.at(node.firstAttribute + i);
+        children.attributes().append(KDSoapValue(m_atoms.at(attribute.name), text(attribute.valueBegin, attribute.valueLength)));
+    }
+    children.reserve(node.childCount);
+    for (int i = 0; i < node.childCount; ++i) {
+        children.append(createValue(m_children.at(node.firstChild + i)));
+    }
 }
 
-static bool isInvalidCharRef(const QByteArray &charRef)
+static bool isSoapEnvelopeElement(const QXmlStreamReader &reader, const char *name)
 {
-    bool ok = true;
-    int symbol = charRef.indexOf('x');
-    int end = charRef.indexOf(';');
+    return reader.name() == QLatin1String(name)
+        && (reader.namespaceUri() == KDSoapNamespaceManager::soapEnvelope() || reader.namespaceUri() == KDSoapNamespaceManager::soapEnvelope200305());
+}
 
-    if (symbol == -1 || end == -1) {
-        return false;
+static void markFault(KDSoapMessage *pMsg)
+{
+    if (pMsg->name() == QLatin1String("Fault")
+        && (pMsg->namespaceUri() == KDSoapNamespaceManager::soapEnvelope() || pMsg->namespaceUri() == KDSoapNamespaceManager::soapEnvelope200305())) {
+        pMsg->setFault(true);
     }
+}
 
-    uint val = charRef.mid(symbol + 1, end - symbol - 1).toInt(&ok, 16);
+static KDSoapMessageReader::XmlError reportXmlError(const QXmlStreamReader &reader, KDSoapMessage *pMsg, KDSoap::SoapVersion soapVersion)
+{
+    QString faultText = QString::fromLatin1("XML error: [%1:%2] %3")
+                            .arg(QString::number(reader.lineNumber()), QString::number(reader.columnNumber()), reader.errorString());
+    pMsg->createFaultMessage(QString::number(reader.error()), faultText, soapVersion);
+    return reader.error() == QXmlStreamReader::PrematureEndOfDocumentError ? KDSoapMessageReader::PrematureEndOfDocumentError
+                                                                           : KDSoapMessageReader::ParseError;
+}
 
-    if (!ok) {
-        return false;
+// Replaces the character references to characters which are not allowed in XML (like &#x1;) with '?',
+// so that the data can be parsed. QXmlStreamReader would fail with a NotWellFormedError otherwise.
+// This is done in a single pass, chunk by chunk, in front of the parser.
+class KDSoapCharacterReferenceFilter
+{
+public:
+    KDSoapCharacterReferenceFilter()
+        : m_section(Markup)
+        , m_sectionStart(0)
+        , m_commentStart(0)
+        , m_sectionEnd(0)
+        , m_replacements(0)
+    {
+    }
+
+    // Returns the filtered chunk; the end of a reference can be kept until the next call
+    QByteArray filter(const QByteArray &data)
+    {
+        // Most chunks have no references at all: they are returned as is, unless they
+        // open a CDATA section or a comment, which must be tracked for the next chunks
+        if (m_reference.isEmpty() && m_section == Markup && m_sectionStart == 0 && m_commentStart == 0
+            && !std::memchr(data.constData(), '&', data.size()) && !data.contains("<!")) {
+            // Only a '<' at the very end could be the start of one
+            m_sectionStart = m_commentStart = data.endsWith('<') ? 1 : 0;
+            return data;
+        }
+        QByteArray out;
+        out.reserve(data.size() + m_reference.size());
+        for (const char ch : data) {
+            process(ch, out);
+        }
+        return out;
+    }
+
+    // At the end of the data
+    QByteArray flush()
+    {
+        QByteArray out = m_reference;
+        m_reference.clear();
+        return out;
+    }
+
+    int replacements() const
+    {
+        return m_replacements;
+    }
+
+private:
+    static bool isAllowedCharacter(uint ch)
+    {
+        // https://www.w3.org/TR/xml/#NT-Char
+        return ch == 0x9 || ch == 0xa || ch == 0xd || (ch >= 0x20 && ch <= 0xd7ff) || (ch >= 0xe000 && ch <= 0xfffd) || (ch >= 0x10000 && ch <= 0x10ffff);
+    }
+
+    // Returns false if ch doesn't continue the reference being read
+    bool continueReference(char ch, QByteArray &out)
+    {
+        const bool hex = m_reference.size() >= 3 && m_reference.at(2) == 'x';
+        if (m_reference.size() == 1) {
+            return ch == '#';
+        }
+        if (m_reference.size() == 2 && ch == 'x') {
+            return true;
+        }
+        if (ch == ';' && m_reference.size() > (hex ? 3 : 2)) {
+            bool ok;
+            const uint value = m_reference.mid(hex ? 3 : 2).toUInt(&ok, hex ? 16 : 10);
+            if (ok && !isAllowedCharacter(value)) {
+                if (m_replacements++ == 0) {
+                    qWarning() << "found an invalid character reference to remove:" << QLatin1String(m_reference + ';');
+                }
+                out += '?';
+                m_reference.clear();
+                return true;
+            }
+            return false;
+        }
+        const bool isDigit = (ch >= '0' && ch <= '9') || (hex && ((ch >= 'a' && ch <= 'f') || (ch >= 'A' && ch <= 'F')));
+        return isDigit && m_reference.size() < 16;
+    }
+
+    void process(char ch, QByteArray &out)
+    {
+        if (!m_reference.isEmpty()) {
+            if (continueReference(ch, out)) {
+                if (!m_reference.isEmpty()) {
+                    m_reference += ch;
+                }
+                return;
+            }
+            // Not an invalid character reference, leave it alone
+            out += m_reference;
+            m_reference.clear();
+        }
+
+        switch (m_section) {
+        case Markup:
+            if (ch == '&') {
+                m_reference += ch;
+                m_sectionStart = m_commentStart = 0;
+                return;
+            }
+            // References are not expanded in CDATA sections and comments
+            m_sectionStart = matchNext(ch, "<![CDATA[", m_sectionStart);
+            m_commentStart = matchNext(ch, "<!--", m_commentStart);
+            if (m_sectionStart == 9) {
+                m_section = CData;
+            } else if (m_commentStart == 4) {
+                m_section = Comment;
+            }
+            if (m_section != Markup) {
+                m_sectionStart = m_commentStart = m_sectionEnd = 0;
+            }
+            break;
+        case CData:
+        case Comment: {
+            // "]]>" or "-->"
+            const char marker = m_section == CData ? ']' : '-';
+            if (ch == marker) {
+                m_sectionEnd = qMin(m_sectionEnd + 1, 2);
+            } else if (ch == '>' && m_sectionEnd == 2) {
+                m_section = Markup;
+                m_sectionEnd = 0;
+            } else {
+                m_sectionEnd = 0;
+            }
+            break;
+        }
+        }
+        out += ch;
+    }
+
+    static int matchNext(char ch, const char *pattern, int matched)
+    {
+        if (ch == pattern[matched]) {
+            return matched + 1;
+        }
+        return ch == pattern[0] ? 1 : 0;
+    }
+
+    enum Section
+    {
+        Markup,
+        CData,
+        Comment
+    };
+    Section m_section;
+    int m_sectionStart; // number of characters of "<![CDATA[" seen so far
+    int m_commentStart; // same for "<!--"
+    int m_sectionEnd; // same for "]]" or "--"
+    int m_replacements;
+    QByteArray m_reference; // "&#..." so far
+};
+
+// The data of a blocking device, through a KDSoapCharacterReferenceFilter, for xmlToMessage(QIODevice *)
+class KDSoapCharacterReferenceFilterDevice : public QIODevice
+{
+public:
+    explicit KDSoapCharacterReferenceFilterDevice(QIODevice *source)
+        : m_source(source)
+        , m_readPos(0)
+        , m_flushed(false)
+    {
+        open(QIODevice::ReadOnly | QIODevice::Unbuffered);
     }
 
-    if (val != 0x9 && val != 0xa && val != 0xd && (val <= 0x20)) {
+    bool isSequential() const override
+    {
         return true;
     }
 
-    return false;
+protected:
+    qint64 readData(char *data, qint64 maxSize) override
+    {
+        while (m_readPos == m_buffer.size()) {
+            if (m_flushed) {
+                return 0;
+            }
+            // The source blocks until it has data, so nothing read means the end of the data
+            const QByteArray chunk = m_source->read(qMax<qint64>(maxSize, 1));
+            if (chunk.isEmpty()) {
+                m_buffer = m_filter.flush();
+                m_flushed = true;
+            } else {
+                m_buffer = m_filter.filter(chunk);
+            }
+            m_readPos = 0;
+        }
+        const qint64 size = qMin<qint64>(maxSize, m_buffer.size() - m_readPos);
+        std::memcpy(data, m_buffer.constData() + m_readPos, size);
+        m_readPos += int(size);
+        return size;
+    }
+
+    qint64 writeData(const char *data, qint64 maxSize) override
+    {
+        Q_UNUSED(data);
+        Q_UNUSED(maxSize);
+        return -1;
+    }
+
+private:
+    QIODevice *m_source;
+    KDSoapCharacterReferenceFilter m_filter;
+    QByteArray m_buffer;
+    int m_readPos;
+    bool m_flushed;
+};
+
+// An element whose end tag hasn't been seen yet
+struct KDSoapPendingElement
+{
+    KDSoapValue m_value;
+    KDSoapNamespaceScope::Ptr m_scope;
+    KDSoapTextConverter m_converter;
+    QString m_text;
+    int m_firstLazyElement; // for lazy parsing, see KDSoapLazyDocumentBuilder::createElement()
+    bool m_hasChildElements;
+};
+
+// Same as KDSoapPendingElement, with compact parsing
+struct KDSoapCompactPendingElement
+{
+    int m_node;
+    int m_childrenBegin; // in KDSoapMessageReader::Private::m_compactChildren
+};
+
+static KDSoapPendingElement startPendingElement(QXmlStreamReader &reader, const KDSoapNamespaceScope::Ptr &parentScope)
+{
+    KDSoapPendingElement element;
+    element.m_scope = KDSoapNamespaceScope::create(parentScope, reader.namespaceDeclarations());
+    element.m_value = readElementStart(reader, element.m_scope, &element.m_converter);
+    element.m_firstLazyElement = 0;
+    element.m_hasChildElements = false;
+    return element;
 }
 
-static QByteArray handleNotWellFormedError(const QByteArray &data, qint64 offset)
+void KDSoapLazyElement::materialize(KDSoapValueList &children) const
 {
-    qint64 i = offset - 1; // offset is the char following the failing one
-    QByteArray dataCleanedUp;
-    QByteArray originalSequence;
+    // Only the tags and the text of the children are parsed, their own children are skipped
+    // using the offsets recorded in the document. They are replaced with comments, so that
+    // the text around them is split the same way as when parsing the whole document.
+    // The children are wrapped into a dummy element, the namespaces come from the ancestors.
+    const QVector<KDSoapLazyDocument::Element> &elements = m_document->m_elements;
+    const char *document = m_document->m_document->constData();
+    QByteArray data("<_>");
+    for (int i = m_first; i < m_end; i = elements.at(i).next) {
+        const KDSoapLazyDocument::Element &element = elements.at(i);
+        int pos = element.tagBegin;
+        for (int child = i + 1; child < element.next; child = elements.at(child).next) {
+            data.append(document + pos, elements.at(child).tagBegin - pos);
+            data.append("<!---->");
+            pos = elements.at(child).tagEnd;
+        }
+        data.append(document + pos, element.tagEnd - pos);
+    }
+    data.append("</_>");
 
-    while (i >= 0 && data.at(i) != '&') {
-        if (data.at(i) == '<') { // InvalidXML but not invalid characters related
-            return dataCleanedUp;
+    QXmlStreamReader reader(data);
+    if (m_scope) {
+        reader.addExtraNamespaceDeclarations(m_scope->allDeclarations());
+    }
+    reader.readNextStartElement();
+    int index = m_first;
+    KDSoapPendingElement child;
+    bool inChild = false;
+    bool textFollowsText = false;
+    while (reader.readNext() != QXmlStreamReader::Invalid) {
+        const bool isText = reader.isCharacters();
+        if (reader.isStartElement()) {
+            child = startPendingElement(reader, m_scope);
+            inChild = true;
+        } else if (reader.isEndElement()) {
+            if (!inChild) {
+                break; // the dummy element
+            }
+            const KDSoapLazyDocument::Element &element = elements.at(index);
+            if (element.next > index + 1) {
+                KDSoapLazyElement::attach(child.m_value, Ptr(new KDSoapLazyElement(m_document, index + 1, element.next, child.m_scope)));
+            }
+            setElementText(child.m_value, child.m_text, child.m_converter);
+            children.append(std::move(child.m_value));
+            inChild = false;
+            index = element.next;
+        } else if (isText && inChild) {
+            if (textFollowsText) {
+                child.m_text += reader.text();
+            } else {
+                child.m_text = reader.text().toString();
+            }
         }
+        textFollowsText = isText;
+    }
+    if (reader.hasError()) {
+        // The document was checked when it was parsed, this shouldn't happen
+        qWarning() << "Error parsing child elements:" << reader.errorString();
+    }
+}
+
+KDSoapValue KDSoapValue::readElement(QXmlStreamReader &reader, const QXmlStreamNamespaceDeclarations &namespaces)
+{
+    // Like KDSoapMessageReader::Private below, without the envelope
+    QVector<KDSoapPendingElement> pendingElements;
+    pendingElements.append(startPendingElement(reader, KDSoapNamespaceScope::create(KDSoapNamespaceScope::Ptr(), namespaces)));
+    bool textFollowsText = false;
+    while (reader.readNext() != QXmlStreamReader::Invalid) {
+        const bool isText = reader.isCharacters();
+        if (reader.isStartElement()) {
+            pendingElements.append(startPendingElement(reader, pendingElements.last().m_scope));
+        } else if (reader.isEndElement()) {
+            KDSoapPendingElement element = pendingElements.takeLast();
+            setElementText(element.m_value, element.m_text, element.m_converter);
+            if (pendingElements.isEmpty()) {
+                return element.m_value;
+            }
+            pendingElements.last().m_value.childValues().append(std::move(element.m_value));
+        } else if (isText) {
+            QString &text = pendingElements.last().m_text;
+            if (textFollowsText) {
+                text += reader.text();
+            } else {
+                text = reader.text().toString();
+            }
+        }
+        textFollowsText = isText;
+    }
+    // Error, the caller will see it in the reader
+    return pendingElements.first().m_value;
+}
+
+class KDSoapMessageReader::Private
+{
+public:
+    enum State
+    {
+        ExpectEnvelope,
+        ExpectHeaderOrBody,
+        InHeader,
+        ExpectBody,
+        InBody,
+        Done ///< the body element was parsed, anything after it is ignored
+    };
+
+    Private()
+        : m_state(ExpectEnvelope)
+        , m_textFollowsText(false)
+        , m_hasHeader(false)
+        , m_depth(0)
+        , m_nodeCount(0)
+        , m_maximumDepth(1024)
+        , m_maximumNodeCount(0)
+        , m_lazyParsing(false)
+        , m_skippedDepth(0)
+        , m_compactParsing(false)
+        , m_replaceInvalidCharacterReferences(false)
+        , m_allDataAvailable(false)
+    {
+    }
+
+    // A parser for a new document, with the same settings
+    void copySettings(const Private &other)
+    {
+        m_maximumDepth = other.m_maximumDepth;
+        m_maximumNodeCount = other.m_maximumNodeCount;
+        m_lazyParsing = other.m_lazyParsing;
+        m_compactParsing = other.m_compactParsing;
+        m_reusedArena = other.m_reusedArena;
+        m_replaceInvalidCharacterReferences = other.m_replaceInvalidCharacterReferences;
+    }
 
-        originalSequence.prepend(data.at(i));
-        i--;
+    // Whether the response element is handed over to m_responseReader
+    bool useResponseReader() const
+    {
+        return m_allDataAvailable && m_responseReader && m_state == InBody && !hasPendingElements() && !isSoapEnvelopeElement(m_reader, "Fault");
     }
 
-    if (isInvalidCharRef(originalSequence)) {
-        qWarning() << "found an invalid character sequence to remove:" << QLatin1String(originalSequence.prepend('&').constData());
-        dataCleanedUp = data;
-        dataCleanedUp = dataCleanedUp.replace(originalSequence, "?");
+    bool hasPendingElements() const
+    {
+        return !m_pendingElements.isEmpty() || !m_compactElements.isEmpty();
     }
-    return dataCleanedUp;
+
+    void addData(const QByteArray &data);
+    void feedReader(const QByteArray &data);
+    void parseAvailableData();
+    bool checkLimits();
+    void startElement();
+    void endElement();
+    void appendText(bool textFollowsText);
+    void endCompactElement();
+    void toplevelElementDone(KDSoapValue &&value);
+    XmlError finish(KDSoapMessage *pMsg, QString *pMessageNamespace, KDSoapHeaders *pRequestHeaders, KDSoap::SoapVersion soapVersion);
+
+    // The parser doesn't recurse: the elements being parsed are in m_pendingElements
+    QXmlStreamReader m_reader;
+    State m_state;
+    bool m_textFollowsText;
+    bool m_hasHeader;
+    KDSoapNamespaceScope::Ptr m_envelopeScope;
+    QVector<KDSoapPendingElement> m_pendingElements;
+
+    int m_depth; // of the current element in the document, including the envelope
+    int m_nodeCount;
+    int m_maximumDepth;
+    int m_maximumNodeCount;
+
+    // Lazy parsing: only toplevel elements are pending, their descendants are skipped
+    bool m_lazyParsing;
+    int m_skippedDepth;
+    QSharedPointer<QByteArray> m_document;
+    QScopedPointer<KDSoapLazyDocumentBuilder> m_lazyDocument; // set if lazy parsing is possible for this document
+
+    // Compact parsing: the elements go into m_arena, the pending ones are in m_compactElements
+    bool m_compactParsing;
+    KDSoapValueArena::Ptr m_arena;
+    KDSoapValueArena::Ptr m_reusedArena; // see setArena()
+    QVector<KDSoapCompactPendingElement> m_compactElements;
+    QVector<int> m_compactChildren; // the nodes of the children of the pending elements, until they end
+
+    bool m_replaceInvalidCharacterReferences;
+    KDSoapCharacterReferenceFilter m_filter;
+
+    // Only for xmlToMessage: the reader can't stop in the middle of the response element
+    bool m_allDataAvailable;
+    KDSoapClientInterface::ResponseReader m_responseReader;
+
+    KDSoapValue m_bodyElement;
+    KDSoapHeaders m_headers;
+    KDSoapMessageAddressingProperties m_messageAddressingProperties;
+};
+
+bool KDSoapMessageReader::Private::checkLimits()
+{
+    ++m_depth;
+    ++m_nodeCount;
+    if (m_maximumDepth > 0 && m_depth > m_maximumDepth) {
+        m_reader.raiseError(QObject::tr("Maximum element depth of %1 exceeded").arg(m_maximumDepth));
+        return false;
+    }
+    if (m_maximumNodeCount > 0 && m_nodeCount > m_maximumNodeCount) {
+        m_reader.raiseError(QObject::tr("Maximum element count of %1 exceeded").arg(m_maximumNodeCount));
+        return false;
+    }
+    return true;
 }
 
-KDSoapMessageReader::XmlError KDSoapMessageReader::xmlToMessage(const QByteArray &data, KDSoapMessage *pMsg, QString *pMessageNamespace,
-                                                                KDSoapHeaders *pRequestHeaders, KDSoap::SoapVersion soapVersion) const
+void KDSoapMessageReader::Private::startElement()
 {
-    Q_ASSERT(pMsg);
-    QXmlStreamReader reader(data);
-    if (reader.readNextStartElement()) {
-        if (reader.name() == QLatin1String("Envelope")
-            && (reader.namespaceUri() == KDSoapNamespaceManager::soapEnvelope()
-                || reader.namespaceUri() == KDSoapNamespaceManager::soapEnvelope200305())) {
-            const QXmlStreamNamespaceDeclarations envNsDecls = reader.namespaceDeclarations();
-            if (reader.readNextStartElement()) {
-                if (reader.name() == QLatin1String("Header")
-                    && (reader.namespaceUri() == KDSoapNamespaceManager::soapEnvelope()
-                        || reader.namespaceUri() == KDSoapNamespaceManager::soapEnvelope200305())) {
-                    KDSoapMessageAddressingProperties messageAddressingProperties;
-                    while (reader.readNextStartElement()) {
-                        if (KDSoapMessageAddressingProperties::isWSAddressingNamespace(reader.namespaceUri().toString())) {
-                            KDSoapValue value = parseElement(reader, envNsDecls);
-                            messageAddressingProperties.readMessageAddressingProperty(value);
+    if (m_lazyDocument && !m_pendingElements.isEmpty()) {
+        m_pendingElements.last().m_hasChildElements = true;
+        ++m_skippedDepth;
+        m_lazyDocument->startElement(m_reader.characterOffset());
+        return;
+    }
+    if (useResponseReader()) {
+        // The response is deserialized straight from the XML, the message only keeps its name
+        m_bodyElement = KDSoapValue(m_reader.name().toString(), QVariant());
+        m_bodyElement.setNamespaceUri(m_reader.namespaceUri().toString());
+        m_responseReader(m_reader, m_envelopeScope ? m_envelopeScope->allDeclarations() : QXmlStreamNamespaceDeclarations());
+        --m_depth; // its end element was read by m_responseReader
+        if (!m_reader.hasError()) {
+            m_state = Done;
+        }
+        return;
+    }
+    if (m_arena) {
+        const int parentScope = m_compactElements.isEmpty() ? 0 : m_arena->m_nodes.at(m_compactElements.last().m_node).scope;
+        KDSoapCompactPendingElement element;
+        element.m_node = readCompactElementStart(m_reader, parentScope, *m_arena);
+        element.m_childrenBegin = m_compactChildren.size();
+        m_compactElements.append(element);
+        return;
+    }
+    const KDSoapNamespaceScope::Ptr &parentScope = m_pendingElements.isEmpty() ? m_envelopeScope : m_pendingElements.last().m_scope;
+    m_pendingElements.append(startPendingElement(m_reader, parentScope));
+    if (m_lazyDocument) {
+        m_pendingElements.last().m_firstLazyElement = m_lazyDocument->elementCount();
+    }
+}
+
+void KDSoapMessageReader::Private::endElement()
+{
+    if (m_skippedDepth > 0) {
+        --m_skippedDepth;
+        m_lazyDocument->endElement(m_reader.characterOffset());
+        return;
+    }
+    if (m_arena) {
+        endCompactElement();
+        return;
+    }
+    KDSoapPendingElement element = m_pendingElements.takeLast();
+    if (m_lazyDocument && element.m_hasChildElements) {
+        KDSoapLazyElement::attach(element.m_value, m_lazyDocument->createElement(element.m_firstLazyElement, element.m_scope));
+    }
+    setElementText(element.m_value, element.m_text, element.m_converter);
+    if (!m_pendingElements.isEmpty()) {
+        m_pendingElements.last().m_value.childValues().append(std::move(element.m_value));
+        return;
+    }
+    toplevelElementDone(std::move(element.m_value));
+}
+
+void KDSoapMessageReader::Private::endCompactElement()
+{
+    const KDSoapCompactPendingElement element = m_compactElements.takeLast();
+    // The children of the element become contiguous in the arena
+    KDSoapValueArena::Node &node = m_arena->m_nodes[element.m_node];
+    node.firstChild = m_arena->m_children.size();
+    node.childCount = m_compactChildren.size() - element.m_childrenBegin;
+    for (int i = element.m_childrenBegin; i < m_compactChildren.size(); ++i) {
+        m_arena->m_children.append(m_compactChildren.at(i));
+    }
+    m_compactChildren.resize(element.m_childrenBegin);
+    if (!m_compactElements.isEmpty()) {
+        m_compactChildren.append(element.m_node);
+        return;
+    }
+    toplevelElementDone(m_arena->createValue(element.m_node));
+}
+
+void KDSoapMessageReader::Private::toplevelElementDone(KDSoapValue &&value)
+{
+    if (m_state == InHeader) {
+        if (KDSoapMessageAddressingProperties::isWSAddressingNamespace(value.namespaceUri())) {
+            m_messageAddressingProperties.readMessageAddressingProperty(value);
+        } else {
+            KDSoapMessage header;
+            static_cast<KDSoapValue &>(header) = std::move(value);
+            m_headers.append(std::move(header));
+        }
+    } else {
+        m_bodyElement = std::move(value);
+        m_state = Done;
+    }
+}
+
+void KDSoapMessageReader::Private::appendText(bool textFollowsText)
+{
+    // Text can be delivered in several pieces when it spans multiple chunks
+    if (m_arena) {
+        KDSoapValueArena::Node &node = m_arena->m_nodes[m_compactElements.last().m_node];
+        if (!textFollowsText) {
+            node.textBegin = m_arena->m_text.size();
+            node.textLength = 0;
+        }
+        m_arena->m_text += m_reader.text();
+        node.textLength += m_reader.text().size();
+        return;
+    }
+    QString &text = m_pendingElements.last().m_text;
+    if (textFollowsText) {
+        text += m_reader.text();
+    } else {
+        text = m_reader.text().toString();
+    }
+}
+
+void KDSoapMessageReader::Private::parseAvailableData()
+{
+    // Stops on errors, including PrematureEndOfDocumentError which means "wait for more data"
+    while (m_state != Done && m_reader.readNext() != QXmlStreamReader::Invalid) {
+        const bool isText = m_reader.isCharacters();
+        const bool textFollowsText = isText && m_textFollowsText;
+        m_textFollowsText = isText;
+        if (m_reader.isStartElement()) {
+            // Rejects oversized documents before anything is allocated for the element
+            if (!checkLimits()) {
+                break;
+            }
+        } else if (m_reader.isEndElement()) {
+            --m_depth;
+        }
+        switch (m_state) {
+        case ExpectEnvelope:
+            if (m_reader.isStartElement()) {
+                if (isSoapEnvelopeElement(m_reader, "Envelope")) {
+                    m_envelopeScope = KDSoapNamespaceScope::create(KDSoapNamespaceScope::Ptr(), m_reader.namespaceDeclarations());
+                    if (m_compactParsing) {
+                        if (m_reusedArena) {
+                            m_arena = m_reusedArena;
+                            m_arena->reset();
                         } else {
-                            KDSoapMessage header;
-                            static_cast<KDSoapValue &>(header) = parseElement(reader, envNsDecls);
-                            pRequestHeaders->append(header);
+                            m_arena = new KDSoapValueArena;
                         }
+                        m_arena->addScope(m_envelopeScope); // 0, the scope of the toplevel elements
+                    } else if (m_lazyParsing && m_document && isLazyParsingPossible(m_reader, *m_document)) {
+                        m_lazyDocument.reset(new KDSoapLazyDocumentBuilder(m_document));
                     }
-                    pMsg->setMessageAddressingProperties(messageAddressingProperties);
-                    reader.readNextStartElement(); // read <Body>
+                    m_state = ExpectHeaderOrBody;
+                } else {
+                    m_reader.raiseError(QObject::tr("Invalid SOAP Message, Envelope expected"));
                 }
-                if (reader.name() == QLatin1String("Body")
-                    && (reader.namespaceUri() == KDSoapNamespaceManager::soapEnvelope()
-                        || reader.namespaceUri() == KDSoapNamespaceManager::soapEnvelope200305())) {
-                    if (reader.readNextStartElement()) {
-                        *pMsg = parseElement(reader, envNsDecls);
-                        if (pMessageNamespace) {
-                            *pMessageNamespace = pMsg->namespaceUri();
-                        }
-                        if (pMsg->name() == QLatin1String("Fault")
-                            && (reader.namespaceUri() == KDSoapNamespaceManager::soapEnvelope()
-                                || reader.namespaceUri() == KDSoapNamespaceManager::soapEnvelope200305())) {
-                            pMsg->setFault(true);
-                        }
-                    }
-
+            }
+            break;
+        case ExpectHeaderOrBody:
+        case ExpectBody:
+            if (m_reader.isStartElement()) {
+                if (m_state == ExpectHeaderOrBody && isSoapEnvelopeElement(m_reader, "Header")) {
+                    m_hasHeader = true;
+                    m_state = InHeader;
+                } else if (isSoapEnvelopeElement(m_reader, "Body")) {
+                    m_state = InBody;
                 } else {
-                    reader.raiseError(QObject::tr("Invalid SOAP Message, Body expected"));
+                    m_reader.raiseError(QObject::tr("Invalid SOAP Message, Body expected"));
                 }
-            } else {
-                reader.raiseError(QObject::tr("Invalid SOAP Message, empty Envelope"));
+            } else if (m_reader.isEndElement()) {
+                m_reader.raiseError(m_state == ExpectHeaderOrBody ? QObject::tr("Invalid SOAP Message, empty Envelope")
+                                                                  : QObject::tr("Invalid SOAP Message, Body expected"));
             }
-        } else {
-            reader.raiseError(QObject::tr("Invalid SOAP Message, Envelope expected"));
+            break;
+        case InHeader:
+        case InBody:
+            if (m_reader.isStartElement()) {
+                startElement();
+            } else if (m_reader.isEndElement()) {
+                if (hasPendingElements()) {
+                    endElement();
+                } else if (m_state == InHeader) {
+                    m_state = ExpectBody;
+                } else {
+                    m_state = Done; // empty body
+                }
+            } else if (isText && hasPendingElements() && m_skippedDepth == 0) {
+                appendText(textFollowsText);
+            }
+            break;
+        case Done:
+            break;
         }
     }
-    if (reader.hasError()) {
-        if (reader.error() == QXmlStreamReader::NotWellFormedError) {
-            qWarning() << "Handling a Not well Formed Error";
-            QByteArray dataCleanedUp = handleNotWellFormedError(data, reader.characterOffset());
-            if (!dataCleanedUp.isEmpty()) {
-                return xmlToMessage(dataCleanedUp, pMsg, pMessageNamespace, pRequestHeaders, soapVersion);
-            }
+}
+
+KDSoapMessageReader::KDSoapMessageReader()
+    : d(new Private)
+{
+}
+
+KDSoapMessageReader::~KDSoapMessageReader()
+{
+    delete d;
+}
+
+// Whether the NotWellFormedError at offset is due to an invalid character reference
+static bool isInvalidCharacterReferenceError(const QByteArray &data, qint64 offset)
+{
+    const int end = int(qMin<qint64>(offset, data.size()));
+    const int start = data.lastIndexOf('&', end - 1);
+    if (start == -1) {
+        return false;
+    }
+    const int tagStart = data.indexOf('<', start);
+    if (tagStart != -1 && tagStart < end) { // invalid XML but not invalid characters related
+        return false;
+    }
+    KDSoapCharacterReferenceFilter filter;
+    filter.filter(data.mid(start, end - start));
+    return filter.replacements() > 0;
+}
+
+void KDSoapMessageReader::Private::addData(const QByteArray &data)
+{
+    feedReader(m_replaceInvalidCharacterReferences ? m_filter.filter(data) : data);
+    parseAvailableData();
+}
+
+void KDSoapMessageReader::Private::feedReader(const QByteArray &data)
+{
+    if (m_lazyParsing && !m_compactParsing) {
+        // The lazy elements refer to it
+        if (!m_document) {
+            m_document.reset(new QByteArray);
         }
-        QString faultText = QString::fromLatin1("XML error: [%1:%2] %3")
-                                .arg(QString::number(reader.lineNumber()), QString::number(reader.columnNumber()), reader.errorString());
-        pMsg->createFaultMessage(QString::number(reader.error()), faultText, soapVersion);
-        return reader.error() == QXmlStreamReader::PrematureEndOfDocumentError ? PrematureEndOfDocumentError : ParseError;
+        m_document->append(data);
+    }
+    m_reader.addData(data);
+}
+
+KDSoapMessageReader::XmlError KDSoapMessageReader::Private::finish(KDSoapMessage *pMsg, QString *pMessageNamespace, KDSoapHeaders *pRequestHeaders,
+                                                                   KDSoap::SoapVersion soapVersion)
+{
+    Q_ASSERT(pMsg);
+    if (m_replaceInvalidCharacterReferences) {
+        feedReader(m_filter.flush());
+    }
+    parseAvailableData(); // sets PrematureEndOfDocumentError if we're not done yet
+    // Anything after the body element is ignored, including errors
+    if (m_state != Done) {
+        return reportXmlError(m_reader, pMsg, soapVersion);
     }
 
+    if (pRequestHeaders) {
+        pRequestHeaders->append(m_headers);
+    }
+    if (m_hasHeader) {
+        pMsg->setMessageAddressingProperties(m_messageAddressingProperties);
+    }
+    if (!m_bodyElement.name().isEmpty()) {
+        *pMsg = m_bodyElement;
+        if (pMessageNamespace) {
+            *pMessageNamespace = pMsg->namespaceUri();
+        }
+        markFault(pMsg);
+    }
     return NoError;
 }
+
+KDSoapMessageReader::XmlError KDSoapMessageReader::xmlToMessage(const QByteArray &data, KDSoapMessage *pMsg, QString *pMessageNamespace,
+                                                                KDSoapHeaders *pRequestHeaders, KDSoap::SoapVersion soapVersion) const
+{
+    Q_ASSERT(pMsg);
+    // Same parser as for incremental parsing, with all the data at once
+    Private parser;
+    parser.copySettings(*d);
+    parser.m_allDataAvailable = true;
+    parser.m_responseReader = d->m_responseReader;
+    parser.addData(data);
+    if (!parser.m_replaceInvalidCharacterReferences && parser.m_state != Private::Done && parser.m_reader.error() == QXmlStreamReader::NotWellFormedError
+        && isInvalidCharacterReferenceError(data, parser.m_reader.characterOffset())) {
+        // Parse again, once, replacing all the invalid character references at the same time
+        qWarning() << "Handling a Not well Formed Error";
+        Private sanitizingParser;
+        sanitizingParser.copySettings(*d);
+        sanitizingParser.m_replaceInvalidCharacterReferences = true;
+        sanitizingParser.m_allDataAvailable = true;
+        sanitizingParser.m_responseReader = d->m_responseReader;
+        sanitizingParser.addData(data);
+        return sanitizingParser.finish(pMsg, pMessageNamespace, pRequestHeaders, soapVersion);
+    }
+    return parser.finish(pMsg, pMessageNamespace, pRequestHeaders, soapVersion);
+}
+
+KDSoapMessageReader::XmlError KDSoapMessageReader::xmlToMessage(QIODevice *device, KDSoapMessage *pMsg, QString *pMessageNamespace,
+                                                                KDSoapHeaders *pRequestHeaders, KDSoap::SoapVersion soapVersion) const
+{
+    Q_ASSERT(pMsg);
+    Q_ASSERT(device);
+    Private parser;
+    parser.copySettings(*d);
+    parser.m_allDataAvailable = true; // the reader waits for the data of the device
+    parser.m_responseReader = d->m_responseReader;
+    QScopedPointer<KDSoapCharacterReferenceFilterDevice> filterDevice;
+    if (parser.m_replaceInvalidCharacterReferences) {
+        filterDevice.reset(new KDSoapCharacterReferenceFilterDevice(device));
+        parser.m_replaceInvalidCharacterReferences = false; // done by filterDevice
+        parser.m_reader.setDevice(filterDevice.data());
+    } else {
+        parser.m_reader.setDevice(device);
+    }
+    return parser.finish(pMsg, pMessageNamespace, pRequestHeaders, soapVersion);
+}
+
+void KDSoapMessageReader::setLazyParsing(bool lazy)
+{
+    d->m_lazyParsing = lazy;
+}
+
+bool KDSoapMessageReader::lazyParsing() const
+{
+    return d->m_lazyParsing;
+}
+
+void KDSoapMessageReader::setCompactParsing(bool compact)
+{
+    d->m_compactParsing = compact;
+}
+
+bool KDSoapMessageReader::compactParsing() const
+{
+    return d->m_compactParsing;
+}
+
+void KDSoapMessageReader::setArena(const KDSoapValueArena::Ptr &arena)
+{
+    d->m_reusedArena = arena;
+}
+
+void KDSoapMessageReader::setMaximumDepth(int depth)
+{
+    d->m_maximumDepth = depth;
+}
+
+int KDSoapMessageReader::maximumDepth() const
+{
+    return d->m_maximumDepth;
+}
+
+void KDSoapMessageReader::setMaximumNodeCount(int count)
+{
+    d->m_maximumNodeCount = count;
+}
+
+int KDSoapMessageReader::maximumNodeCount() const
+{
+    return d->m_maximumNodeCount;
+}
+
+void KDSoapMessageReader::setReplaceInvalidCharacterReferences(bool replace)
+{
+    d->m_replaceInvalidCharacterReferences = replace;
+}
+
+bool KDSoapMessageReader::replaceInvalidCharacterReferences() const
+{
+    return d->m_replaceInvalidCharacterReferences;
+}
+
+void KDSoapMessageReader::setResponseReader(const KDSoapClientInterface::ResponseReader &responseReader)
+{
+    d->m_responseReader = responseReader;
+}
+
+void KDSoapMessageReader::addData(const QByteArray &data)
+{
+    d->addData(data);
+}
+
+KDSoapMessageReader::XmlError KDSoapMessageReader::finish(KDSoapMessage *pMsg, QString *pMessageNamespace, KDSoapHeaders *pRequestHeaders,
+                                                          KDSoap::SoapVersion soapVersion)
+{
+    return d->finish(pMsg, pMessageNamespace, pRequestHeaders, soapVersion);
+}
@@ -13,6 +13,11 @@
 
 #include "KDSoapClientInterface.h"
 #include "KDSoapMessage.h"
+#include "KDSoapValueArena_p.h"
+
+QT_BEGIN_NAMESPACE
+class QIODevice;
+QT_END_NAMESPACE
 
 class KDSOAP_EXPORT KDSoapMessageReader
 {
@@ -25,9 +30,118 @@ public:
     };
 
     KDSoapMessageReader();
+    ~KDSoapMessageReader();
+
+    KDSoapMessageReader(const KDSoapMessageReader &) = delete;
+    KDSoapMessageReader &operator=(const KDSoapMessageReader &) = delete;
+
+    /**
+     * Lazy parsing: the child elements of the parsed elements are only turned into
+     * KDSoapValues when KDSoapValue::childValues() is called for the first time.
+     * Until then, they are just a range in the parsed document, which is kept in memory.
+     * The attributes and the text of the elements are always available right away.
+     *
+     * This is faster when only a few values are needed out of a big message.
+     * Note that the first call to childValues() is then not thread-safe: make sure that
+     * two threads do not access the child values of the same message at the same time.
+     *
+     * This must be called before any data is passed to the reader. Lazy parsing is only
+     * possible for UTF-8 documents, other documents are always fully parsed.
+     * Disabled by default.
+     */
+    void setLazyParsing(bool lazy);
+    bool lazyParsing() const;
+
+    /**
+     * Compact parsing: the elements of a message are stored in a few big arrays shared by the whole
+     * message (see KDSoapValueArena), rather than as one KDSoapValue per element with several
+     * allocations each. The KDSoapValues of the child elements are created when
+     * KDSoapValue::childValues() is called for the first time, and the arrays are freed
+     * all at once, with the last value of the message.
+     *
+     * The same caveat as for lazy parsing applies to the first call to childValues().
+     * This takes precedence over lazy parsing, and must be called before any data is passed to the reader.
+     * Disabled by default.
+     */
+    void setCompactParsing(bool compact);
+    bool compactParsing() const;
+
+    /**
+     * With compact parsing, parses the next messages into \p arena, after resetting it, rather than into a new arena.
+     * This saves allocations when one arena is reused for many messages, see KDSoapServer::RequestArena.
+     * The values of the previous message parsed into \p arena must not be used anymore.
+     */
+    void setArena(const KDSoapValueArena::Ptr &arena);
+
+    /**
+     * Limits the nesting depth of the elements in a message, including the envelope.
+     * Deeper messages are rejected with a ParseError, as soon as the limit is reached.
+     * 0 means no limit. The default is 1024: before KDSoap 2.2, there was no limit.
+     * This only protects the parser, KDSoapValue trees are still destroyed recursively.
+     */
+    void setMaximumDepth(int depth);
+    int maximumDepth() const;
+
+    /**
+     * Limits the number of elements in a message, including the envelope.
+     * Bigger messages are rejected with a ParseError, as soon as the limit is reached.
+     * 0 means no limit, which is the default.
+     */
+    void setMaximumNodeCount(int count);
+    int maximumNodeCount() const;
+
+    /**
+     * Replaces the character references to characters which are not allowed in XML,
+     * like &#x1;, with '?', as the data is passed to the parser. Some servers send those.
+     * Without this, xmlToMessage() parses the document a second time with this enabled,
+     * when it fails because of such a reference, and incremental parsing fails.
+     * Disabled by default.
+     */
+    void setReplaceInvalidCharacterReferences(bool replace);
+    bool replaceInvalidCharacterReferences() const;
+
+    /**
+     * Hands the response element over to \p responseReader, instead of turning it into a
+     * KDSoapValue tree. The parsed message then only has the name and namespace of that element.
+     * Faults are still parsed as usual. Only used by xmlToMessage(), not by incremental parsing:
+     * use xmlToMessage(QIODevice *) to hand over the response while it's being received.
+     */
+    void setResponseReader(const KDSoapClientInterface::ResponseReader &responseReader);
 
     XmlError xmlToMessage(const QByteArray &data, KDSoapMessage *pParsedMessage, QString *pMessageNamespace, KDSoapHeaders *pRequestHeaders,
                           KDSoap::SoapVersion soapVersion) const;
+
+    /**
+     * Same as above, reading the message from \p device, which must block in read() until more data
+     * is available, like KDSoapReplyPipe. Unlike incremental parsing, the response reader can then
+     * read the response element while it's being received, without buffering the whole message.
+     *
+     * Lazy parsing is not used, and like finish(), this doesn't retry after replacing invalid
+     * character references. Use setReplaceInvalidCharacterReferences() instead.
+     */
+    XmlError xmlToMessage(QIODevice *device, KDSoapMessage *pParsedMessage, QString *pMessageNamespace, KDSoapHeaders *pRequestHeaders,
+                          KDSoap::SoapVersion soapVersion) const;
+
+    /**
+     * Incremental parsing: feeds the next chunk of a message into the reader.
+     * The chunk is parsed right away, as far as possible, so the caller doesn't
+     * need to buffer the whole message until it has been fully received.
+     */
+    void addData(const QByteArray &data);
+
+    /**
+     * Incremental parsing: call this once all the chunks have been passed to addData().
+     * The arguments and the return value are the same as in xmlToMessage().
+     *
+     * Note that unlike xmlToMessage(), this doesn't retry after replacing invalid
+     * character references, since the data was not kept around.
+     * Use setReplaceInvalidCharacterReferences() instead.
+     */
+    XmlError finish(KDSoapMessage *pParsedMessage, QString *pMessageNamespace, KDSoapHeaders *pRequestHeaders, KDSoap::SoapVersion soapVersion);
+
+private:
+    class Private;
+    Private *const d;
 };
 
 #endif
@@ -9,6 +9,7 @@
 ****************************************************************************/
 #include "KDSoapClientInterface_p.h"
 #include "KDSoapMessageWriter_p.h"
+#include "KDSoapMtom_p.h"
 #include "KDSoapNamespaceManager.h"
 #include "KDSoapNamespacePrefixes_p.h"
 #include "KDSoapValue.h"
@@ -16,7 +17,11 @@
 #include <QVariant>
 
 KDSoapMessageWriter::KDSoapMessageWriter()
-    : m_version(KDSoap::SOAP1_1)
+    : m_persistentHeadersGeneration(0)
+    , m_version(KDSoap::SOAP1_1)
+    , m_nativeXmlWriter(false)
+    , m_mtomAttachments(nullptr)
+    , m_sizeHint(0)
 {
 }
 
@@ -30,33 +35,96 @@ void KDSoapMessageWriter::setMessageNamespace(const QString &ns)
     m_messageNamespace = ns;
 }
 
+void KDSoapMessageWriter::setPersistentHeadersCache(const QSharedPointer<KDSoapPersistentHeadersCache> &cache)
+{
+    m_persistentHeadersCache = cache;
+    m_persistentHeadersGeneration = cache ? cache->generation() : 0;
+}
+
+void KDSoapMessageWriter::setNativeXmlWriter(bool native)
+{
+    m_nativeXmlWriter = native;
+}
+
+bool KDSoapMessageWriter::nativeXmlWriter() const
+{
+    return m_nativeXmlWriter;
+}
+
+bool KDSoapMessageWriter::usesNativeXmlWriter(const KDSoapMessage &message) const
+{
+    return m_nativeXmlWriter && !message.contentsWriter();
+}
+
+void KDSoapMessageWriter::setMtomAttachments(KDSoapMtomAttachments *attachments)
+{
+    m_mtomAttachments = attachments;
+}
+
+void KDSoapMessageWriter::setSizeHint(int size)
+{
+    m_sizeHint = size;
+}
+
+void KDSoapPersistentHeadersCache::headersChanged()
+{
+    QMutexLocker locker(&m_mutex);
+    ++m_generation;
+    m_valid = false;
+    m_xml.clear();
+}
+
+int KDSoapPersistentHeadersCache::generation() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_generation;
+}
+
 QByteArray KDSoapMessageWriter::messageToXml(const KDSoapMessage &message, const QString &method, const KDSoapHeaders &headers,
                                              const QMap<QString, KDSoapMessage> &persistentHeaders, const KDSoapAuthentication &authentication) const
 {
     QByteArray data;
-    QXmlStreamWriter writer(&data);
-    writer.writeStartDocument();
+    data.reserve(m_sizeHint);
+    if (usesNativeXmlWriter(message)) {
+        KDSoapUtf8XmlWriter writer(&data);
+        writeMessage(writer, message, method, headers, persistentHeaders, authentication);
+    } else {
+        QXmlStreamWriter streamWriter(&data);
+        KDSoapQtXmlWriter writer(streamWriter);
+        writeMessage(writer, message, method, headers, persistentHeaders, authentication);
+    }
+    return data;
+}
 
+void KDSoapMessageWriter::writeMessage(KDSoapXmlWriter &writer, const KDSoapMessage &message, const QString &method, const KDSoapHeaders &headers,
+                                       const QMap<QString, KDSoapMessage> &persistentHeaders, const KDSoapAuthentication &authentication) const
+{
     KDSoapNamespacePrefixes namespacePrefixes;
-    namespacePrefixes.writeStandardNamespaces(writer, m_version, message.hasMessageAddressingProperties(),
-                                              message.messageAddressingProperties().addressingNamespace());
-
-    QString soapEnvelope;
-    QString soapEncoding;
-    if (m_version == KDSoap::SOAP1_1) {
-        soapEnvelope = KDSoapNamespaceManager::soapEnvelope();
-        soapEncoding = KDSoapNamespaceManager::soapEncoding();
-    } else if (m_version == KDSoap::SOAP1_2) {
-        soapEnvelope = KDSoapNamespaceManager::soapEnvelope200305();
-        soapEncoding = KDSoapNamespaceManager::soapEncoding200305();
+    QString messageNamespace;
+    const bool messageElementStarted =
+        writeStartOfMessage(writer, namespacePrefixes, messageNamespace, message, method, headers, persistentHeaders, authentication);
+    if (messageElementStarted) {
+        writer.setMtomAttachments(m_mtomAttachments); // only for the body
+        if (const KDSoapMessage::ContentsWriter contentsWriter = message.contentsWriter()) {
+            Q_ASSERT(writer.xmlStreamWriter()); // see usesNativeXmlWriter()
+            contentsWriter(*writer.xmlStreamWriter(), messageNamespace);
+        } else {
+            message.writeElementContents(namespacePrefixes, writer, message.use(), messageNamespace);
+        }
     }
+    writeEndOfMessage(writer, messageElementStarted);
+}
 
-    writer.writeStartElement(soapEnvelope, QLatin1String("Envelope"));
+bool KDSoapMessageWriter::writeStartOfMessage(KDSoapXmlWriter &writer, KDSoapNamespacePrefixes &namespacePrefixes, QString &messageNamespace,
+                                              const KDSoapMessage &message, const QString &method, const KDSoapHeaders &headers,
+                                              const QMap<QString, KDSoapMessage> &persistentHeaders,
+                                              const KDSoapAuthentication &authentication) const
+{
+    writer.writeStartDocument();
 
-    // This has been removed, see https://msdn.microsoft.com/en-us/library/ms995710.aspx for details
-    // writer.writeAttribute(soapEnvelope, QLatin1String("encodingStyle"), soapEncoding);
+    const QString soapEnvelope = writeStartOfEnvelope(writer, namespacePrefixes, message);
 
-    QString messageNamespace = m_messageNamespace;
+    messageNamespace = m_messageNamespace;
     if (!message.namespaceUri().isEmpty() && messageNamespace != message.namespaceUri()) {
         messageNamespace = message.namespaceUri();
     }
@@ -67,8 +135,13 @@ QByteArray KDSoapMessageWriter::messageToXml(const KDSoapMessage &message, const
         // and xsi:type attributes that refer to n1, which isn't defined in the body...
         namespacePrefixes.writeNamespace(writer, messageNamespace, QLatin1String("n1") /*make configurable?*/);
         writer.writeStartElement(soapEnvelope, QLatin1String("Header"));
-        for (const KDSoapMessage &header : qAsConst(persistentHeaders)) {
-            header.writeChildren(namespacePrefixes, writer, header.use(), messageNamespace, true);
+        const QByteArray persistentHeadersData = persistentHeadersXml(persistentHeaders, message, messageNamespace);
+        if (!persistentHeadersData.isNull()) {
+            writer.writeRawXml(persistentHeadersData);
+        } else {
+            for (const KDSoapMessage &header : qAsConst(persistentHeaders)) {
+                header.writeChildren(namespacePrefixes, writer, header.use(), messageNamespace, true);
+            }
         }
         for (const KDSoapMessage &header : qAsConst(headers)) {
             header.writeChildren(namespacePrefixes, writer, header.use(), messageNamespace, true);
@@ -96,21 +169,107 @@ QByteArray KDSoapMessageWriter::messageToXml(const KDSoapMessage &message, const
             qWarning("ERROR: Non-empty message with an empty name!");
             qDebug() << message;
         }
+        return false;
+    }
+    // Note that the message itself is always qualified.
+    // isQualified() is only for child elements.
+    if (!message.isFault()) {
+        writer.writeStartElement(messageNamespace, elementName);
     } else {
-        // Note that the message itself is always qualified.
-        // isQualified() is only for child elements.
-        if (!message.isFault()) {
-            writer.writeStartElement(messageNamespace, elementName);
-        } else {
-            // Fault element should be inside soap namespace
-            writer.writeStartElement(soapEnvelope, elementName);
-        }
-        message.writeElementContents(namespacePrefixes, writer, message.use(), messageNamespace);
+        // Fault element should be inside soap namespace
+        writer.writeStartElement(soapEnvelope, elementName);
+    }
+    return true;
+}
+
+void KDSoapMessageWriter::writeEndOfMessage(KDSoapXmlWriter &writer, bool messageElementStarted) const
+{
+    if (messageElementStarted) {
         writer.writeEndElement();
     }
     writer.writeEndElement(); // Body
     writer.writeEndElement(); // Envelope
     writer.writeEndDocument();
+}
 
-    return data;
+QString KDSoapMessageWriter::writeStartOfEnvelope(KDSoapXmlWriter &writer, KDSoapNamespacePrefixes &namespacePrefixes, const KDSoapMessage &message) const
+{
+    namespacePrefixes.writeStandardNamespaces(writer, m_version, message.hasMessageAddressingProperties(),
+                                              message.messageAddressingProperties().addressingNamespace());
+
+    QString soapEnvelope;
+    QString soapEncoding;
+    if (m_version == KDSoap::SOAP1_1) {
+        soapEnvelope = KDSoapNamespaceManager::soapEnvelope();
+        soapEncoding = KDSoapNamespaceManager::soapEncoding();
+    } else if (m_version == KDSoap::SOAP1_2) {
+        soapEnvelope = KDSoapNamespaceManager::soapEnvelope200305();
+        soapEncoding = KDSoapNamespaceManager::soapEncoding200305();
+    }
+
+    if (m_mtomAttachments) {
+        writer.writeNamespace(KDSoapMtom::xopNamespace(), QStringLiteral("xop"));
+    }
+
+    writer.writeStartElement(soapEnvelope, QLatin1String("Envelope"));
+
+    // This has been removed, see https://msdn.microsoft.com/en-us/library/ms995710.aspx for details
+    // writer.writeAttribute(soapEnvelope, QLatin1String("encodingStyle"), soapEncoding);
+
+    return soapEnvelope;
+}
+
+// Returns the persistent headers serialized within <Header>, from the cache if possible,
+// or a null QByteArray if they can't be cached
+QByteArray KDSoapMessageWriter::persistentHeadersXml(const QMap<QString, KDSoapMessage> &persistentHeaders, const KDSoapMessage &message,
+                                                     const QString &messageNamespace) const
+{
+    if (!m_persistentHeadersCache || persistentHeaders.isEmpty()) {
+        return QByteArray();
+    }
+    const bool addressing = message.hasMessageAddressingProperties();
+    const int addressingNamespace = message.messageAddressingProperties().addressingNamespace();
+    const bool mtom = m_mtomAttachments != nullptr;
+
+    KDSoapPersistentHeadersCache &cache = *m_persistentHeadersCache;
+    QMutexLocker locker(&cache.m_mutex);
+    if (cache.m_generation != m_persistentHeadersGeneration) {
+        // The headers changed since this request was prepared: what's in the cache, or will be, isn't for these headers
+        return QByteArray();
+    }
+    if (cache.m_valid && cache.m_messageNamespace == messageNamespace && cache.m_version == m_version && cache.m_addressing == addressing
+        && cache.m_addressingNamespace == addressingNamespace && cache.m_mtom == mtom) {
+        return cache.m_xml;
+    }
+
+    for (const KDSoapMessage &header : persistentHeaders) {
+        if (!header.childValues().attributes().isEmpty()) {
+            return QByteArray(); // these would be attributes of the Header element
+        }
+    }
+
+    // Write the headers in the same context as in writeStartOfMessage, so that they come out the same
+    QByteArray data;
+    QXmlStreamWriter streamWriter(&data);
+    KDSoapQtXmlWriter qtWriter(streamWriter);
+    KDSoapUtf8XmlWriter utf8Writer(&data);
+    KDSoapXmlWriter &writer = m_nativeXmlWriter ? static_cast<KDSoapXmlWriter &>(utf8Writer) : qtWriter;
+    KDSoapNamespacePrefixes namespacePrefixes;
+    const QString soapEnvelope = writeStartOfEnvelope(writer, namespacePrefixes, message);
+    namespacePrefixes.writeNamespace(writer, messageNamespace, QLatin1String("n1"));
+    writer.writeStartElement(soapEnvelope, QLatin1String("Header"));
+    writer.writeCharacters(QString());
+    const int begin = data.size();
+    for (const KDSoapMessage &header : persistentHeaders) {
+        header.writeChildren(namespacePrefixes, writer, header.use(), messageNamespace, true);
+    }
+
+    cache.m_valid = true;
+    cache.m_xml = data.mid(begin);
+    cache.m_messageNamespace = messageNamespace;
+    cache.m_version = m_version;
+    cache.m_addressing = addressing;
+    cache.m_addressingNamespace = addressingNamespace;
+    cache.m_mtom = mtom;
+    return cache.m_xml;
 }
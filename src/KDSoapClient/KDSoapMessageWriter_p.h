@@ -13,16 +13,49 @@
 #include "KDSoapAuthentication.h"
 #include "KDSoapClientInterface.h"
 #include "KDSoapMessage.h"
+#include "KDSoapXmlWriter_p.h"
 #include <QtCore/QByteArray>
 #include <QtCore/QMap>
+#include <QtCore/QMutex>
+#include <QtCore/QSharedPointer>
 #include <QtCore/QString>
-#include <QtCore/QXmlStreamWriter>
 class KDSoapMessage;
 class KDSoapHeaders;
 class KDSoapNamespacePrefixes;
 class KDSoapValue;
 class KDSoapValueList;
 
+/**
+ * \internal
+ * The serialized persistent headers of a KDSoapClientInterface, which are the same
+ * from one request to the next as long as the headers and the envelope don't change.
+ * Shared between the threads of the client, hence the mutex.
+ *
+ * Each change of the headers starts a new generation. A writer only uses and stores the XML
+ * of the generation of the headers it was given, see KDSoapMessageWriter::setPersistentHeadersCache(),
+ * so that requests prepared before a change don't mix up the old and the new headers.
+ */
+class KDSoapPersistentHeadersCache
+{
+public:
+    // Called when the persistent headers change
+    void headersChanged();
+    int generation() const;
+
+private:
+    friend class KDSoapMessageWriter;
+    mutable QMutex m_mutex;
+    int m_generation = 0;
+    bool m_valid = false;
+    QByteArray m_xml;
+    // What the serialization depends on, besides the headers
+    QString m_messageNamespace;
+    KDSoap::SoapVersion m_version = KDSoap::SOAP1_1;
+    bool m_addressing = false;
+    int m_addressingNamespace = 0;
+    bool m_mtom = false;
+};
+
 /**
  * \internal
  * Internal class -- only exported for the server lib
@@ -34,15 +67,46 @@ public:
 
     void setVersion(KDSoap::SoapVersion version);
     void setMessageNamespace(const QString &ns);
+    // Reuses the serialization of the persistent headers from one request to the next.
+    // Call this when taking the persistent headers passed to messageToXml(), it records their generation.
+    void setPersistentHeadersCache(const QSharedPointer<KDSoapPersistentHeadersCache> &cache);
+    // Writes with KDSoapUtf8XmlWriter rather than QXmlStreamWriter, see KDSoapClientInterface::setNativeXmlWriter()
+    void setNativeXmlWriter(bool native);
+    bool nativeXmlWriter() const;
+    // Whether \p message is written with KDSoapUtf8XmlWriter. Not when it's written by generated code,
+    // which needs a QXmlStreamWriter.
+    bool usesNativeXmlWriter(const KDSoapMessage &message) const;
+    // Writes an MTOM message: the binary values of the body go into \p attachments, see KDSoapMtom
+    void setMtomAttachments(KDSoapMtomAttachments *attachments);
+    // The expected size of the XML written by messageToXml(), reserved at once rather than grown step by step
+    void setSizeHint(int size);
 
     QByteArray messageToXml(const KDSoapMessage &message, const QString &method /*empty in document style*/,
                             const KDSoapHeaders &headers,
                             const QMap<QString, KDSoapMessage> &persistentHeaders,
                             const KDSoapAuthentication &authentication = KDSoapAuthentication()) const;
 
+    // messageToXml() in two parts, around the contents of the message element, for KDSoapRequestDevice.
+    // Returns false if there's no message element (null message in document style).
+    bool writeStartOfMessage(KDSoapXmlWriter &writer, KDSoapNamespacePrefixes &namespacePrefixes, QString &messageNamespace,
+                             const KDSoapMessage &message, const QString &method, const KDSoapHeaders &headers,
+                             const QMap<QString, KDSoapMessage> &persistentHeaders, const KDSoapAuthentication &authentication) const;
+    void writeEndOfMessage(KDSoapXmlWriter &writer, bool messageElementStarted) const;
+
 private:
+    void writeMessage(KDSoapXmlWriter &writer, const KDSoapMessage &message, const QString &method, const KDSoapHeaders &headers,
+                      const QMap<QString, KDSoapMessage> &persistentHeaders, const KDSoapAuthentication &authentication) const;
+    QString writeStartOfEnvelope(KDSoapXmlWriter &writer, KDSoapNamespacePrefixes &namespacePrefixes, const KDSoapMessage &message) const;
+    QByteArray persistentHeadersXml(const QMap<QString, KDSoapMessage> &persistentHeaders, const KDSoapMessage &message,
+                                    const QString &messageNamespace) const;
+
     QString m_messageNamespace;
+    QSharedPointer<KDSoapPersistentHeadersCache> m_persistentHeadersCache;
+    int m_persistentHeadersGeneration;
     KDSoap::SoapVersion m_version;
+    bool m_nativeXmlWriter;
+    KDSoapMtomAttachments *m_mtomAttachments;
+    int m_sizeHint;
 };
 
 #endif // KDSOAPMESSAGEWRITER_P_H
@@ -0,0 +1,324 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2010-2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+#include "KDSoapMtom_p.h"
+#include "KDSoapMessage.h"
+#include "KDSoapValue.h"
+#include <QtCore/QUuid>
+
+#include <cstring>
+
+// The Content-ID of the SOAP message in the packages we write
+static const char s_rootContentId[] = "root.message@kdsoap";
+
+static QByteArray randomHex()
+{
+    return QUuid::createUuid().toRfc4122().toHex();
+}
+
+KDSoapMtomAttachments::KDSoapMtomAttachments()
+    : m_idSuffix('.' + randomHex() + "@kdsoap")
+{
+}
+
+QString KDSoapMtomAttachments::add(const QByteArray &data)
+{
+    Attachment attachment;
+    attachment.contentId = QByteArray::number(m_attachments.size() + 1) + m_idSuffix;
+    attachment.data = data;
+    m_attachments.append(attachment);
+    return QLatin1String("cid:") + QString::fromLatin1(attachment.contentId.constData(), attachment.contentId.size());
+}
+
+QString KDSoapMtom::xopNamespace()
+{
+    return QStringLiteral("http://www.w3.org/2004/08/xop/include");
+}
+
+QByteArray KDSoapMtom::createBoundary()
+{
+    return "MIMEBoundary_" + randomHex();
+}
+
+// The MIME type of the SOAP message, without the parameters
+static QByteArray mimeType(const QByteArray &contentType)
+{
+    const int semicolon = contentType.indexOf(';');
+    return (semicolon < 0 ? contentType : contentType.left(semicolon)).trimmed();
+}
+
+QByteArray KDSoapMtom::contentType(const QByteArray &boundary, const QByteArray &soapContentType)
+{
+    QByteArray result = "multipart/related;type=\"application/xop+xml\";start=\"<";
+    result += s_rootContentId;
+    result += ">\";start-info=\"";
+    result += mimeType(soapContentType);
+    result += '\"';
+    // SOAP 1.2 has the action in the Content-Type, see KDSoapClientInterfacePrivate::prepareRequest()
+    const QByteArray action = contentTypeParameter(soapContentType, "action");
+    if (!action.isEmpty()) {
+        result += ";action=\"" + action + '\"';
+    }
+    result += ";boundary=\"" + boundary + '\"';
+    return result;
+}
+
+QVector<QByteArray> KDSoapMtom::multipartBody(const QByteArray &boundary, const QByteArray &soapContentType, const QByteArray &xml,
+                                              const KDSoapMtomAttachments &attachments)
+{
+    QVector<QByteArray> pieces;
+    pieces.reserve(2 * attachments.attachments().size() + 3);
+
+    QByteArray rootHeaders = "--" + boundary;
+    rootHeaders += "\r\nContent-Type: application/xop+xml;charset=utf-8;type=\"" + mimeType(soapContentType);
+    rootHeaders += "\"\r\nContent-Transfer-Encoding: binary\r\nContent-ID: <";
+    rootHeaders += s_rootContentId;
+    rootHeaders += ">\r\n\r\n";
+    pieces.append(rootHeaders);
+    pieces.append(xml);
+
+    for (const KDSoapMtomAttachments::Attachment &attachment : attachments.attachments()) {
+        QByteArray headers = "\r\n--" + boundary;
+        headers += "\r\nContent-Type: application/octet-stream\r\nContent-Transfer-Encoding: binary\r\nContent-ID: <";
+        headers += attachment.contentId;
+        headers += ">\r\n\r\n";
+        pieces.append(headers);
+        pieces.append(attachment.data);
+    }
+
+    pieces.append("\r\n--" + boundary + "--\r\n");
+    return pieces;
+}
+
+bool KDSoapMtom::isMultipartRelated(const QByteArray &contentType)
+{
+    return mimeType(contentType).toLower() == "multipart/related";
+}
+
+QByteArray KDSoapMtom::soapContentType(const QByteArray &contentType)
+{
+    QByteArray result = contentTypeParameter(contentType, "start-info");
+    if (result.isEmpty()) {
+        result = "text/xml";
+    }
+    const QByteArray action = contentTypeParameter(contentType, "action");
+    if (!action.isEmpty() && contentTypeParameter(result, "action").isEmpty()) {
+        result += ";action=\"" + action + '\"';
+    }
+    return result;
+}
+
+QByteArray KDSoapMtom::contentTypeParameter(const QByteArray &contentType, const QByteArray &name)
+{
+    const int size = contentType.size();
+    int pos = contentType.indexOf(';');
+    while (pos >= 0) {
+        ++pos; // the ';'
+        const int equal = contentType.indexOf('=', pos);
+        if (equal < 0) {
+            break;
+        }
+        const QByteArray parameterName = contentType.mid(pos, equal - pos).trimmed().toLower();
+        pos = equal + 1;
+        while (pos < size && (contentType.at(pos) == ' ' || contentType.at(pos) == '\t')) {
+            ++pos;
+        }
+        QByteArray value;
+        if (pos < size && contentType.at(pos) == '\"') {
+            // quoted-string, which can contain ';'
+            ++pos;
+            while (pos < size && contentType.at(pos) != '\"') {
+                if (contentType.at(pos) == '\\' && pos + 1 < size) {
+                    ++pos;
+                }
+                value += contentType.at(pos);
+                ++pos;
+            }
+            pos = contentType.indexOf(';', pos);
+        } else {
+            const int end = contentType.indexOf(';', pos);
+            value = contentType.mid(pos, end < 0 ? -1 : end - pos).trimmed();
+            pos = end;
+        }
+        if (parameterName == name) {
+            return value;
+        }
+    }
+    return QByteArray();
+}
+
+static QByteArray stripAngleBrackets(const QByteArray &contentId)
+{
+    if (contentId.startsWith('<') && contentId.endsWith('>')) {
+        return contentId.mid(1, contentId.size() - 2);
+    }
+    return contentId;
+}
+
+bool KDSoapMtom::parseMultipartBody(const QByteArray &contentType, const QByteArray &body, QByteArray *xml, QHash<QByteArray, QByteArray> *parts)
+{
+    const QByteArray boundary = contentTypeParameter(contentType, "boundary");
+    if (boundary.isEmpty()) {
+        return false;
+    }
+    const QByteArray start = stripAngleBrackets(contentTypeParameter(contentType, "start"));
+    const QByteArray delimiter = "\r\n--" + boundary;
+
+    // The first delimiter can come without the CRLF, at the very beginning
+    int pos;
+    if (body.startsWith(delimiter.mid(2))) {
+        pos = delimiter.size() - 2;
+    } else {
+        pos = body.indexOf(delimiter);
+        if (pos < 0) {
+            return false;
+        }
+        pos += delimiter.size();
+    }
+
+    bool foundRoot = false;
+    // pos is right after a delimiter, at the "--" of the close delimiter or at the end of the line
+    while (pos + 1 < body.size() && !(body.at(pos) == '-' && body.at(pos + 1) == '-')) {
+        const int headersStart = body.indexOf("\r\n", pos); // after the transport padding, if any
+        if (headersStart < 0) {
+            return false;
+        }
+        const int headersEnd = body.indexOf("\r\n\r\n", headersStart);
+        if (headersEnd < 0) {
+            return false;
+        }
+        const int dataStart = headersEnd + 4;
+        const int dataEnd = body.indexOf(delimiter, dataStart);
+        if (dataEnd < 0) {
+            return false;
+        }
+
+        QByteArray contentId;
+        QByteArray transferEncoding;
+        if (headersEnd > headersStart) {
+            const QList<QByteArray> lines = body.mid(headersStart + 2, headersEnd - headersStart - 2).split('\n');
+            for (const QByteArray &line : lines) {
+                const int colon = line.indexOf(':');
+                if (colon < 0) {
+                    continue;
+                }
+                const QByteArray name = line.left(colon).trimmed().toLower(); // header names are case-insensitive
+                if (name == "content-id") {
+                    contentId = stripAngleBrackets(line.mid(colon + 1).trimmed());
+                } else if (name == "content-transfer-encoding") {
+                    transferEncoding = line.mid(colon + 1).trimmed().toLower();
+                }
+            }
+        }
+
+        QByteArray data = body.mid(dataStart, dataEnd - dataStart);
+        if (transferEncoding == "base64") {
+            data = QByteArray::fromBase64(data);
+        }
+        // Without a start parameter, the root part is the first one
+        if (!foundRoot && (start.isEmpty() || contentId == start)) {
+            *xml = data;
+            foundRoot = true;
+        } else {
+            parts->insert(contentId, data);
+        }
+        pos = dataEnd + delimiter.size();
+    }
+    return foundRoot;
+}
+
+void KDSoapMtom::resolveIncludes(KDSoapValue &value, const QHash<QByteArray, QByteArray> &parts)
+{
+    KDSoapValueList &children = value.childValues();
+    if (children.count() == 1) {
+        const KDSoapValue &child = children.first();
+        if (child.name() == QLatin1String("Include") && child.namespaceUri() == xopNamespace()) {
+            const QList<KDSoapValue> attributes = child.childValues().attributes();
+            for (const KDSoapValue &attribute : attributes) {
+                if (attribute.name() != QLatin1String("href")) {
+                    continue;
+                }
+                const QByteArray href = attribute.value().toString().toLatin1();
+                if (!href.startsWith("cid:")) { // krazy:exclude=strings
+                    continue;
+                }
+                // "cid:" URLs are percent-encoded Content-IDs, see RFC 2392
+                const auto it = parts.constFind(QByteArray::fromPercentEncoding(href.mid(4)));
+                if (it != parts.constEnd()) {
+                    value.setBinaryValue(it.value());
+                    return;
+                }
+            }
+        }
+    }
+    for (KDSoapValue &child : children) {
+        resolveIncludes(child, parts);
+    }
+}
+
+void KDSoapMtom::resolveIncludes(KDSoapHeaders &headers, const QHash<QByteArray, QByteArray> &parts)
+{
+    for (KDSoapMessage &header : headers) {
+        resolveIncludes(header, parts);
+    }
+}
+
+KDSoapMtomDevice::KDSoapMtomDevice(const QVector<QByteArray> &pieces, QObject *parent)
+    : QIODevice(parent)
+    , m_pieces(pieces)
+    , m_size(0)
+{
+    for (const QByteArray &piece : pieces) {
+        m_size += piece.size();
+    }
+    open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+}
+
+qint64 KDSoapMtomDevice::size() const
+{
+    return m_size;
+}
+
+QByteArray KDSoapMtomDevice::allData() const
+{
+    QByteArray data;
+    data.reserve(int(m_size));
+    for (const QByteArray &piece : m_pieces) {
+        data += piece;
+    }
+    return data;
+}
+
+qint64 KDSoapMtomDevice::readData(char *data, qint64 maxSize)
+{
+    // Unbuffered, so pos() is where the last read ended
+    qint64 offset = pos();
+    qint64 length = 0;
+    for (const QByteArray &piece : m_pieces) {
+        if (length == maxSize) {
+            break;
+        }
+        if (offset >= piece.size()) {
+            offset -= piece.size();
+            continue;
+        }
+        const qint64 count = qMin(piece.size() - offset, maxSize - length);
+        memcpy(data + length, piece.constData() + offset, size_t(count));
+        length += count;
+        offset = 0;
+    }
+    return length;
+}
+
+qint64 KDSoapMtomDevice::writeData(const char *data, qint64 maxSize)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(maxSize);
+    return -1;
+}
@@ -0,0 +1,142 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2010-2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#ifndef KDSOAPMTOM_P_H
+#define KDSOAPMTOM_P_H
+
+#include "KDSoapGlobal.h"
+#include <QtCore/QByteArray>
+#include <QtCore/QHash>
+#include <QtCore/QIODevice>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+class KDSoapValue;
+class KDSoapHeaders;
+
+/**
+ * \internal
+ * The binary values of a message which go into MIME parts of their own, when the message is written
+ * as an MTOM/XOP package: the message refers to each of them with an <xop:Include href="cid:..."/> element.
+ * The data is shared with the values, not copied.
+ */
+class KDSOAP_EXPORT KDSoapMtomAttachments
+{
+public:
+    struct Attachment
+    {
+        QByteArray contentId; // without the angle brackets
+        QByteArray data;
+    };
+
+    KDSoapMtomAttachments();
+
+    /**
+     * Adds \p data as a new part, and returns the href of the xop:Include element referring to it.
+     */
+    QString add(const QByteArray &data);
+
+    const QVector<Attachment> &attachments() const
+    {
+        return m_attachments;
+    }
+
+private:
+    QVector<Attachment> m_attachments;
+    QByteArray m_idSuffix; // makes the Content-IDs unique
+};
+
+/**
+ * \internal
+ * Reading and writing of MTOM/XOP packages (https://www.w3.org/TR/soap12-mtom/): multipart/related
+ * bodies whose root part is the SOAP message, and whose other parts are its binary values, as raw bytes.
+ */
+class KDSOAP_EXPORT KDSoapMtom
+{
+public:
+    static QString xopNamespace();
+
+    /**
+     * Returns a new random MIME boundary.
+     */
+    static QByteArray createBoundary();
+
+    /**
+     * Returns the Content-Type of a package, for a SOAP message with the Content-Type \p soapContentType
+     * (text/xml for SOAP 1.1, application/soap+xml with an optional action parameter for SOAP 1.2).
+     */
+    static QByteArray contentType(const QByteArray &boundary, const QByteArray &soapContentType);
+
+    /**
+     * Returns the body of a package for the message \p xml and its \p attachments, in pieces,
+     * so that the attachments are sent as they are rather than copied into one big buffer.
+     */
+    static QVector<QByteArray> multipartBody(const QByteArray &boundary, const QByteArray &soapContentType, const QByteArray &xml,
+                                             const KDSoapMtomAttachments &attachments);
+
+    /**
+     * Returns true if \p contentType is the one of a package.
+     */
+    static bool isMultipartRelated(const QByteArray &contentType);
+
+    /**
+     * Returns the Content-Type of the SOAP message within a package of Content-Type \p contentType,
+     * so that the SOAP version and the action can be found the same way as without MTOM.
+     */
+    static QByteArray soapContentType(const QByteArray &contentType);
+
+    /**
+     * Returns the value of the parameter \p name of \p contentType, without the quotes.
+     */
+    static QByteArray contentTypeParameter(const QByteArray &contentType, const QByteArray &name);
+
+    /**
+     * Splits the package \p body into the SOAP message, written into \p xml,
+     * and the other parts, written into \p parts by Content-ID.
+     * Returns false if \p body isn't a valid package.
+     */
+    static bool parseMultipartBody(const QByteArray &contentType, const QByteArray &body, QByteArray *xml, QHash<QByteArray, QByteArray> *parts);
+
+    /**
+     * Replaces the xop:Include elements within \p value with the parts they refer to.
+     * The values then hold the binary data itself, which KDSoapValue::base64BinaryValue() returns as is.
+     */
+    static void resolveIncludes(KDSoapValue &value, const QHash<QByteArray, QByteArray> &parts);
+    static void resolveIncludes(KDSoapHeaders &headers, const QHash<QByteArray, QByteArray> &parts);
+};
+
+/**
+ * \internal
+ * A device reading the pieces returned by KDSoapMtom::multipartBody() one after the other,
+ * for sending an MTOM request without concatenating them.
+ */
+class KDSoapMtomDevice : public QIODevice
+{
+    Q_OBJECT
+public:
+    explicit KDSoapMtomDevice(const QVector<QByteArray> &pieces, QObject *parent = nullptr);
+
+    qint64 size() const override;
+
+    /**
+     * The whole request at once. Only for debug output.
+     */
+    QByteArray allData() const;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private:
+    const QVector<QByteArray> m_pieces;
+    qint64 m_size;
+};
+
+#endif // KDSOAPMTOM_P_H
@@ -15,70 +15,84 @@ KDSoapNamespaceManager::KDSoapNamespaceManager()
 
 QString KDSoapNamespaceManager::xmlSchema1999()
 {
-    return QString::fromLatin1("http://www.w3.org/1999/XMLSchema");
+    static const QString s_ns = QString::fromLatin1("http://www.w3.org/1999/XMLSchema");
+    return s_ns;
 }
 
 QString KDSoapNamespaceManager::xmlSchema2001()
 {
-    return QString::fromLatin1("http://www.w3.org/2001/XMLSchema");
+    static const QString s_ns = QString::fromLatin1("http://www.w3.org/2001/XMLSchema");
+    return s_ns;
 }
 
 QString KDSoapNamespaceManager::xmlSchemaInstance1999()
 {
-    return QString::fromLatin1("http://www.w3.org/1999/XMLSchema-instance");
+    static const QString s_ns = QString::fromLatin1("http://www.w3.org/1999/XMLSchema-instance");
+    return s_ns;
 }
 
 QString KDSoapNamespaceManager::xmlSchemaInstance2001()
 {
-    return QString::fromLatin1("http://www.w3.org/2001/XMLSchema-instance");
+    static const QString s_ns = QString::fromLatin1("http://www.w3.org/2001/XMLSchema-instance");
+    return s_ns;
 }
 
 QString KDSoapNamespaceManager::soapEnvelope()
 {
-    return QString::fromLatin1("http://schemas.xmlsoap.org/soap/envelope/");
+    static const QString s_ns = QString::fromLatin1("http://schemas.xmlsoap.org/soap/envelope/");
+    return s_ns;
 }
 
 QString KDSoapNamespaceManager::soapEnvelope200305()
 {
-    return QString::fromLatin1("http://www.w3.org/2003/05/soap-envelope");
+    static const QString s_ns = QString::fromLatin1("http://www.w3.org/2003/05/soap-envelope");
+    return s_ns;
 }
 
 QString KDSoapNamespaceManager::soapEncoding()
 {
-    return QString::fromLatin1("http://schemas.xmlsoap.org/soap/encoding/");
+    static const QString s_ns = QString::fromLatin1("http://schemas.xmlsoap.org/soap/encoding/");
+    return s_ns;
 }
 
 QString KDSoapNamespaceManager::soapEncoding200305()
 {
-    return QString::fromLatin1("http://www.w3.org/2003/05/soap-encoding");
+    static const QString s_ns = QString::fromLatin1("http://www.w3.org/2003/05/soap-encoding");
+    return s_ns;
 }
 
 QString KDSoapNamespaceManager::soapMessageAddressing()
 {
-    return QString::fromLatin1("http://www.w3.org/2005/08/addressing");
+    static const QString s_ns = QString::fromLatin1("http://www.w3.org/2005/08/addressing");
+    return s_ns;
 }
 
 QString KDSoapNamespaceManager::soapSecurityExtention()
 {
-    return QString::fromLatin1("http://docs.oasis-open.org/wss/2004/01/oasis-200401-wss-wssecurity-secext-1.0.xsd");
+    static const QString s_ns = QString::fromLatin1("http://docs.oasis-open.org/wss/2004/01/oasis-200401-wss-wssecurity-secext-1.0.xsd");
+    return s_ns;
 }
 
 QString KDSoapNamespaceManager::soapSecurityUtility()
 {
-    return QString::fromLatin1("http://docs.oasis-open.org/wss/2004/01/oasis-200401-wss-wssecurity-utility-1.0.xsd");
+    static const QString s_ns = QString::fromLatin1("http://docs.oasis-open.org/wss/2004/01/oasis-200401-wss-wssecurity-utility-1.0.xsd");
+    return s_ns;
 }
 
 QString KDSoapNamespaceManager::soapMessageAddressing200303()
 {
-    return QString::fromLatin1("http://schemas.xmlsoap.org/ws/2003/03/addressing");
+    static const QString s_ns = QString::fromLatin1("http://schemas.xmlsoap.org/ws/2003/03/addressing");
+    return s_ns;
 }
 
 QString KDSoapNamespaceManager::soapMessageAddressing200403()
 {
-    return QString::fromLatin1("http://schemas.xmlsoap.org/ws/2004/03/addressing");
+    static const QString s_ns = QString::fromLatin1("http://schemas.xmlsoap.org/ws/2004/03/addressing");
+    return s_ns;
 }
 
 QString KDSoapNamespaceManager::soapMessageAddressing200408()
 {
-    return QString::fromLatin1("http://schemas.xmlsoap.org/ws/2004/08/addressing");
+    static const QString s_ns = QString::fromLatin1("http://schemas.xmlsoap.org/ws/2004/08/addressing");
+    return s_ns;
 }
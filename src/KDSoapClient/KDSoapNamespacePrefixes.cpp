@@ -11,7 +11,7 @@
 #include "KDSoapNamespaceManager.h"
 #include "KDSoapNamespacePrefixes_p.h"
 
-void KDSoapNamespacePrefixes::writeStandardNamespaces(QXmlStreamWriter &writer, KDSoap::SoapVersion version, bool messageAddressingEnabled,
+void KDSoapNamespacePrefixes::writeStandardNamespaces(KDSoapXmlWriter &writer, KDSoap::SoapVersion version, bool messageAddressingEnabled,
                                                       KDSoapMessageAddressingProperties::KDSoapAddressingNamespace messageAddressingNamespace)
 {
     if (version == KDSoap::SOAP1_1) {
@@ -10,20 +10,22 @@
 #ifndef KDSOAPNAMESPACEPREFIXES_P_H
 #define KDSOAPNAMESPACEPREFIXES_P_H
 
+#include <QtCore/QHash>
 #include <QtCore/QMap>
-#include <QtCore/QXmlStreamWriter>
+#include <QtCore/QPair>
 
 #include "KDSoapClientInterface.h"
 #include "KDSoapMessageAddressingProperties.h"
+#include "KDSoapXmlWriter_p.h"
 
 class KDSoapNamespacePrefixes : public QMap<QString /*ns*/, QString /*prefix*/>
 {
 public:
-    void writeStandardNamespaces(QXmlStreamWriter &writer, KDSoap::SoapVersion version = KDSoap::SOAP1_1, bool messageAddressingEnabled = false,
+    void writeStandardNamespaces(KDSoapXmlWriter &writer, KDSoap::SoapVersion version = KDSoap::SOAP1_1, bool messageAddressingEnabled = false,
                                  KDSoapMessageAddressingProperties::KDSoapAddressingNamespace messageAddressingNamespace =
                                      KDSoapMessageAddressingProperties::Addressing200508);
 
-    void writeNamespace(QXmlStreamWriter &writer, const QString &ns, const QString &prefix)
+    void writeNamespace(KDSoapXmlWriter &writer, const QString &ns, const QString &prefix)
     {
         // qDebug() << "writeNamespace" << ns << prefix;
         insert(ns, prefix);
@@ -35,8 +37,22 @@ public:
         if (prefix.isEmpty()) {
             qWarning("ERROR: Namespace not found: %s (for localName %s)", qPrintable(ns), qPrintable(localName));
         }
-        return prefix + QLatin1Char(':') + localName;
+        // The same type names come up again and again in encoded messages, build them only once
+        ResolvedName &resolved = m_resolvedNames[qMakePair(ns, localName)];
+        if (resolved.qualifiedName.isNull() || resolved.prefix != prefix) {
+            resolved.prefix = prefix;
+            resolved.qualifiedName = prefix + QLatin1Char(':') + localName;
+        }
+        return resolved.qualifiedName;
     }
+
+private:
+    struct ResolvedName
+    {
+        QString prefix;
+        QString qualifiedName;
+    };
+    mutable QHash<QPair<QString, QString>, ResolvedName> m_resolvedNames;
 };
 
 #endif // KDSOAPNAMESPACESPREFIXES_H
@@ -0,0 +1,47 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2010-2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#include "KDSoapNamespaceScope_p.h"
+
+KDSoapNamespaceScope::KDSoapNamespaceScope(const Ptr &parent, const QXmlStreamNamespaceDeclarations &declarations)
+    : m_parent(parent)
+    , m_declarations(declarations)
+{
+}
+
+KDSoapNamespaceScope::Ptr KDSoapNamespaceScope::create(const Ptr &parent, const QXmlStreamNamespaceDeclarations &declarations)
+{
+    if (declarations.isEmpty()) {
+        return parent;
+    }
+    return Ptr(new KDSoapNamespaceScope(parent, declarations));
+}
+
+QString KDSoapNamespaceScope::namespaceForPrefix(const QString &prefix) const
+{
+    for (const KDSoapNamespaceScope *scope = this; scope; scope = scope->m_parent.data()) {
+        // Within one element, the last declaration wins (like KDQName::fromSoapValue always did)
+        const QXmlStreamNamespaceDeclarations &decls = scope->m_declarations;
+        for (int i = decls.count() - 1; i >= 0; --i) {
+            if (decls.at(i).prefix() == prefix) {
+                return decls.at(i).namespaceUri().toString();
+            }
+        }
+    }
+    return QString();
+}
+
+QXmlStreamNamespaceDeclarations KDSoapNamespaceScope::allDeclarations() const
+{
+    if (!m_parent) {
+        return m_declarations;
+    }
+    return m_parent->allDeclarations() + m_declarations;
+}
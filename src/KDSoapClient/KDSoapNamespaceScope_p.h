@@ -0,0 +1,72 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2010-2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#ifndef KDSOAPNAMESPACESCOPE_P_H
+#define KDSOAPNAMESPACESCOPE_P_H
+
+#include "KDSoapGlobal.h"
+#include <QtCore/QExplicitlySharedDataPointer>
+#include <QtCore/QSharedData>
+#include <QtCore/QXmlStreamNamespaceDeclarations>
+
+class KDSoapValue;
+
+/**
+ * \internal
+ * The namespace declarations in effect for an element, as seen during parsing.
+ *
+ * Each scope only holds the declarations made by one element, and points to the
+ * scope of the parent element. Scopes are immutable once created, and shared
+ * between all the values parsed in them (child elements which don't declare any
+ * namespace simply reuse the scope of their parent).
+ */
+class KDSoapNamespaceScope : public QSharedData
+{
+public:
+    typedef QExplicitlySharedDataPointer<KDSoapNamespaceScope> Ptr;
+
+    /**
+     * Returns a scope for an element declaring \p declarations, inside \p parent.
+     * If there are no declarations, this is \p parent itself.
+     */
+    static Ptr create(const Ptr &parent, const QXmlStreamNamespaceDeclarations &declarations);
+
+    /**
+     * Returns the namespace bound to \p prefix, looking at the innermost declarations first.
+     * Returns a null string if the prefix isn't declared.
+     */
+    QString namespaceForPrefix(const QString &prefix) const;
+
+    /**
+     * Returns the declarations made by the element itself.
+     */
+    const QXmlStreamNamespaceDeclarations &declarations() const
+    {
+        return m_declarations;
+    }
+
+    /**
+     * Returns all the declarations in effect, outermost first.
+     */
+    QXmlStreamNamespaceDeclarations allDeclarations() const;
+
+    /**
+     * Attaches \p scope to \p value, as returned by KDSoapValue::environmentNamespaceDeclarations().
+     */
+    static void attach(KDSoapValue &value, const Ptr &scope);
+
+private:
+    KDSoapNamespaceScope(const Ptr &parent, const QXmlStreamNamespaceDeclarations &declarations);
+
+    const Ptr m_parent;
+    const QXmlStreamNamespaceDeclarations m_declarations;
+};
+
+#endif // KDSOAPNAMESPACESCOPE_P_H
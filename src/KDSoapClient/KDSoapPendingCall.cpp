@@ -8,9 +8,13 @@
 **
 ****************************************************************************/
 #include "KDSoapPendingCall.h"
+#include "KDSoapCompression_p.h"
 #include "KDSoapMessageReader_p.h"
+#include "KDSoapMtom_p.h"
 #include "KDSoapNamespaceManager.h"
 #include "KDSoapPendingCall_p.h"
+#include "KDSoapRequestDevice_p.h"
+#include <QBuffer>
 #include <QDebug>
 #include <QNetworkReply>
 
@@ -65,11 +69,16 @@ static void debugHelper(const QByteArray &data, const QList<QNetworkReply::RawHe
     }
 }
 
+static bool isDebugEnabled()
+{
+    const QByteArray doDebug = qgetenv("KDSOAP_DEBUG");
+    return !doDebug.trimmed().isEmpty() && doDebug != "0";
+}
+
 // Log the HTTP and XML of a response from the server.
 static void maybeDebugResponse(const QByteArray &data, QNetworkReply *reply)
 {
-    const QByteArray doDebug = qgetenv("KDSOAP_DEBUG");
-    if (doDebug.trimmed().isEmpty() || doDebug == "0") {
+    if (!isDebugEnabled()) {
         return;
     }
 
@@ -78,13 +87,28 @@ static void maybeDebugResponse(const QByteArray &data, QNetworkReply *reply)
 
 // Log the HTTP and XML of a request.
 // (not static, because this is used in KDSoapClientInterface)
-void maybeDebugRequest(const QByteArray &data, const QNetworkRequest &request, QNetworkReply *reply)
+void maybeDebugRequest(QIODevice *requestDevice, const QNetworkRequest &request, QNetworkReply *reply)
 {
-    const QByteArray doDebug = qgetenv("KDSOAP_DEBUG");
-    if (doDebug.trimmed().isEmpty() || doDebug == "0") {
+    if (!isDebugEnabled()) {
         return;
     }
 
+    QByteArray data;
+    if (QBuffer *buffer = qobject_cast<QBuffer *>(requestDevice)) {
+        data = buffer->data();
+    } else if (KDSoapRequestDevice *streamingDevice = qobject_cast<KDSoapRequestDevice *>(requestDevice)) {
+        data = streamingDevice->allData();
+    } else if (KDSoapMtomDevice *mtomDevice = qobject_cast<KDSoapMtomDevice *>(requestDevice)) {
+        data = mtomDevice->allData();
+    }
+    const QByteArray contentEncoding = request.rawHeader("Content-Encoding");
+    if (!contentEncoding.isEmpty()) {
+        QByteArray decompressed;
+        if (KDSoapCompression::decompress(data, KDSoapCompression::contentEncoding(contentEncoding), &decompressed)) {
+            data = decompressed;
+        }
+    }
+
     QList<QNetworkReply::RawHeaderPair> headerList;
     if (reply) {
         QByteArray method;
@@ -124,15 +148,24 @@ KDSoapPendingCall::Private::~Private()
     if (reply) {
         // Ensure the connection is closed, which QNetworkReply doesn't do in its destructor. This needs abort().
         QObject::disconnect(reply.data(), &QNetworkReply::finished, nullptr, nullptr);
+        QObject::disconnect(reply.data(), &QNetworkReply::readyRead, nullptr, nullptr);
         reply->abort();
     }
     delete reply.data();
-    delete buffer;
+    delete requestDevice;
+    if (replyPipe) {
+        replyPipe->closeWriting(false); // don't leave the calling thread waiting for more data
+    }
 }
 
-KDSoapPendingCall::KDSoapPendingCall(QNetworkReply *reply, QBuffer *buffer)
-    : d(new Private(reply, buffer))
+KDSoapPendingCall::KDSoapPendingCall(QNetworkReply *reply, QIODevice *requestDevice)
+    : d(new Private(reply, requestDevice))
 {
+    // Parse the response while it's being downloaded, rather than buffering all of it until finished()
+    Private *priv = d.data();
+    QObject::connect(reply, &QNetworkReply::readyRead, reply, [priv]() {
+        priv->readReplyData();
+    });
 }
 
 KDSoapPendingCall::KDSoapPendingCall(const KDSoapPendingCall &other)
@@ -176,6 +209,39 @@ QVariant KDSoapPendingCall::returnValue() const
     return QVariant();
 }
 
+void KDSoapPendingCall::Private::setResponseReader(const KDSoapClientInterface::ResponseReader &responseReader)
+{
+    useResponseReader = true;
+    messageReader.setResponseReader(responseReader);
+}
+
+void KDSoapPendingCall::Private::readReplyData()
+{
+    // Don't try to read from an aborted (closed) reply
+    if (!reply || !reply->isOpen()) {
+        return;
+    }
+    const QByteArray data = reply->readAll();
+    if (data.isEmpty()) {
+        return;
+    }
+    if (isDebugEnabled()) {
+        debugData += data;
+    }
+    if (!receivedData) {
+        // An MTOM response has to be split into its parts before parsing
+        mtomReply = KDSoapMtom::isMultipartRelated(reply->rawHeader("Content-Type"));
+    }
+    receivedData = true;
+    if (replyPipe && !mtomReply) {
+        replyPipe->appendData(data);
+    } else if (useResponseReader || mtomReply) {
+        replyData += data;
+    } else {
+        messageReader.addData(data);
+    }
+}
+
 void KDSoapPendingCall::Private::parseReply()
 {
     if (parsed) {
@@ -188,13 +254,38 @@ void KDSoapPendingCall::Private::parseReply()
     }
     parsed = true;
 
-    // Don't try to read from an aborted (closed) reply
-    const QByteArray data = reply->isOpen() ? reply->readAll() : QByteArray();
-    maybeDebugResponse(data, reply);
+    readReplyData(); // whatever wasn't read in readyRead yet
+    maybeDebugResponse(debugData, reply);
+    debugData.clear();
+
+    // The calling thread parsed the reply from the pipe, unless it had to be buffered
+    const bool streamed = replyPipe && receivedData && !mtomReply;
+    if (replyPipe) {
+        replyPipe->closeWriting(streamed);
+        replyPipe = nullptr;
+    }
 
-    if (!data.isEmpty()) {
-        KDSoapMessageReader reader;
-        reader.xmlToMessage(data, &replyMessage, nullptr, &replyHeaders, this->soapVersion);
+    if (receivedData && !streamed) {
+        if (mtomReply) {
+            QByteArray xml;
+            QHash<QByteArray, QByteArray> parts;
+            if (KDSoapMtom::parseMultipartBody(reply->rawHeader("Content-Type"), replyData, &xml, &parts)) {
+                messageReader.xmlToMessage(xml, &replyMessage, nullptr, &replyHeaders, this->soapVersion);
+                if (!parts.isEmpty()) {
+                    KDSoapMtom::resolveIncludes(replyMessage, parts);
+                    KDSoapMtom::resolveIncludes(replyHeaders, parts);
+                }
+            } else {
+                replyMessage.createFaultMessage(QString::number(QNetworkReply::ProtocolFailure), QLatin1String("Invalid multipart/related response"),
+                                                soapVersion);
+            }
+            replyData.clear();
+        } else if (useResponseReader) {
+            messageReader.xmlToMessage(replyData, &replyMessage, nullptr, &replyHeaders, this->soapVersion);
+            replyData.clear();
+        } else {
+            messageReader.finish(&replyMessage, nullptr, &replyHeaders, this->soapVersion);
+        }
     }
 
     if (reply->error()) {
@@ -14,7 +14,7 @@
 #include <QtCore/QExplicitlySharedDataPointer>
 QT_BEGIN_NAMESPACE
 class QNetworkReply;
-class QBuffer;
+class QIODevice;
 QT_END_NAMESPACE
 class KDSoapPendingCallWatcher;
 
@@ -93,7 +93,7 @@ public:
 private:
     friend class KDSoapClientInterface;
     friend class KDSoapThreadTask;
-    KDSoapPendingCall(QNetworkReply *reply, QBuffer *buffer);
+    KDSoapPendingCall(QNetworkReply *reply, QIODevice *requestDevice);
 
     friend class KDSoapPendingCallWatcher; // for connecting to d->reply
 
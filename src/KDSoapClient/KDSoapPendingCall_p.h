@@ -12,7 +12,9 @@
 
 #include "KDSoapClientInterface.h"
 #include "KDSoapMessage.h"
-#include <QBuffer>
+#include "KDSoapMessageReader_p.h"
+#include "KDSoapReplyPipe_p.h"
+#include <QIODevice>
 #include <QNetworkReply>
 #include <QPointer>
 #include <QSharedData>
@@ -20,31 +22,48 @@
 
 class KDSoapValue;
 
-void maybeDebugRequest(const QByteArray &data, const QNetworkRequest &request, QNetworkReply *reply);
+void maybeDebugRequest(QIODevice *requestDevice, const QNetworkRequest &request, QNetworkReply *reply);
 
 class KDSoapPendingCall::Private : public QSharedData
 {
 public:
-    Private(QNetworkReply *r, QBuffer *b)
+    Private(QNetworkReply *r, QIODevice *d)
         : reply(r)
-        , buffer(b)
+        , requestDevice(d)
         , soapVersion(KDSoap::SOAP1_1)
         , parsed(false)
+        , receivedData(false)
+        , useResponseReader(false)
+        , mtomReply(false)
+        , replyPipe(nullptr)
     {
     }
     ~Private();
 
+    void setResponseReader(const KDSoapClientInterface::ResponseReader &responseReader);
+    void readReplyData();
     void parseReply();
     KDSoapValue parseReplyElement(QXmlStreamReader &reader);
 
     // Can be deleted under us if the KDSoapClientInterface (and its QNetworkAccessManager)
     // are deleted before the KDSoapPendingCall.
     QPointer<QNetworkReply> reply;
-    QBuffer *buffer;
+    QIODevice *requestDevice; // a QBuffer, or a KDSoapRequestDevice when streaming requests
     KDSoapMessage replyMessage;
     KDSoapHeaders replyHeaders;
     KDSoap::SoapVersion soapVersion;
     bool parsed;
+    // The reply is parsed while it's being downloaded, see readReplyData()
+    KDSoapMessageReader messageReader;
+    bool receivedData;
+    // With a response reader, the reply is parsed at once when finished, see KDSoapMessageReader::setResponseReader()
+    bool useResponseReader;
+    // An MTOM response (multipart/related) is parsed at once when finished too
+    bool mtomReply;
+    QByteArray replyData;
+    // For a blocking call with a response reader, the reply is parsed by the calling thread, from this pipe
+    KDSoapReplyPipe *replyPipe;
+    QByteArray debugData; // only filled in when KDSOAP_DEBUG is set
 };
 
 #endif // KDSOAPPENDINGCALL_P_H
@@ -0,0 +1,101 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2010-2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+#include "KDSoapReplyPipe_p.h"
+
+#include <cstring>
+
+KDSoapReplyPipe::KDSoapReplyPipe(QObject *parent)
+    : QIODevice(parent)
+    , m_readPos(0)
+    , m_available(0)
+    , m_writingClosed(false)
+    , m_streamed(false)
+{
+    open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+}
+
+KDSoapReplyPipe::~KDSoapReplyPipe()
+{
+}
+
+void KDSoapReplyPipe::appendData(const QByteArray &data)
+{
+    if (data.isEmpty()) {
+        return;
+    }
+    QMutexLocker locker(&m_mutex);
+    m_chunks.enqueue(data);
+    m_available += data.size();
+    m_dataAppended.wakeAll();
+}
+
+void KDSoapReplyPipe::closeWriting(bool streamed)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_writingClosed) {
+        return;
+    }
+    m_writingClosed = true;
+    m_streamed = streamed;
+    m_dataAppended.wakeAll();
+}
+
+bool KDSoapReplyPipe::isStreamed() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_streamed;
+}
+
+bool KDSoapReplyPipe::isSequential() const
+{
+    return true;
+}
+
+qint64 KDSoapReplyPipe::bytesAvailable() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_available + QIODevice::bytesAvailable();
+}
+
+bool KDSoapReplyPipe::atEnd() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_writingClosed && m_available == 0;
+}
+
+qint64 KDSoapReplyPipe::readData(char *data, qint64 maxSize)
+{
+    QMutexLocker locker(&m_mutex);
+    while (m_chunks.isEmpty() && !m_writingClosed) {
+        m_dataAppended.wait(&m_mutex);
+    }
+    // Returns what the chunks have right now, rather than waiting for maxSize bytes
+    qint64 readSize = 0;
+    while (readSize < maxSize && !m_chunks.isEmpty()) {
+        const QByteArray &chunk = m_chunks.head();
+        const qint64 size = qMin<qint64>(maxSize - readSize, chunk.size() - m_readPos);
+        std::memcpy(data + readSize, chunk.constData() + m_readPos, size);
+        readSize += size;
+        m_readPos += int(size);
+        if (m_readPos == chunk.size()) {
+            m_chunks.dequeue();
+            m_readPos = 0;
+        }
+    }
+    m_available -= readSize;
+    return readSize;
+}
+
+qint64 KDSoapReplyPipe::writeData(const char *data, qint64 maxSize)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(maxSize);
+    return -1;
+}
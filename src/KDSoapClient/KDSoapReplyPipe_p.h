@@ -0,0 +1,59 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2010-2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+#ifndef KDSOAPREPLYPIPE_P_H
+#define KDSOAPREPLYPIPE_P_H
+
+#include <QtCore/QIODevice>
+#include <QtCore/QMutex>
+#include <QtCore/QQueue>
+#include <QtCore/QWaitCondition>
+
+/**
+ * \internal
+ * A sequential device which passes the reply of a blocking call from the thread which downloads it
+ * to the thread which parses it, see KDSoapClientInterface::call() with a response reader.
+ *
+ * The chunks are appended as they're received, and freed once they have been read,
+ * so the reply is never kept in memory as a whole. Reading blocks until the next chunk
+ * is available, or until closeWriting() was called.
+ */
+class KDSoapReplyPipe : public QIODevice
+{
+    Q_OBJECT
+public:
+    explicit KDSoapReplyPipe(QObject *parent = nullptr);
+    ~KDSoapReplyPipe() override;
+
+    // Called by the thread which downloads the reply
+    void appendData(const QByteArray &data);
+    // No more data will be appended. Not streamed means that the reply was handled without the pipe (e.g. MTOM)
+    void closeWriting(bool streamed);
+
+    bool isStreamed() const;
+
+    bool isSequential() const override;
+    qint64 bytesAvailable() const override;
+    bool atEnd() const override;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private:
+    mutable QMutex m_mutex;
+    QWaitCondition m_dataAppended;
+    QQueue<QByteArray> m_chunks;
+    int m_readPos; // in the first chunk
+    qint64 m_available;
+    bool m_writingClosed;
+    bool m_streamed;
+};
+
+#endif // KDSOAPREPLYPIPE_P_H
@@ -0,0 +1,220 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2010-2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+#include "KDSoapRequestDevice_p.h"
+
+#include <cstring>
+
+// How much is serialized at once, at most, for the text of binary values (which is
+// where the size of big requests comes from). 12 KB of data is 16 KB of base64.
+static const qint64 s_binaryChunkSize = 12 * 1024;
+
+KDSoapRequestDevice::KDSoapRequestDevice(const KDSoapMessageWriter &messageWriter, const KDSoapMessage &message, const QString &method,
+                                         const KDSoapHeaders &headers, const QMap<QString, KDSoapMessage> &persistentHeaders,
+                                         const KDSoapAuthentication &authentication, QObject *parent)
+    : QIODevice(parent)
+    , m_messageWriter(messageWriter)
+    , m_message(message)
+    , m_method(method)
+    , m_headers(headers)
+    , m_persistentHeaders(persistentHeaders)
+    , m_authentication(authentication)
+    , m_state(StartOfMessage)
+    , m_readPos(0)
+    , m_messageElementStarted(false)
+    , m_contentLength(-1)
+    , m_countingOnly(false)
+    , m_binaryTextLength(0)
+    , m_peakBufferSize(0)
+{
+    restart();
+    open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+}
+
+KDSoapRequestDevice::~KDSoapRequestDevice()
+{
+}
+
+bool KDSoapRequestDevice::isSequential() const
+{
+    return true;
+}
+
+qint64 KDSoapRequestDevice::bytesAvailable() const
+{
+    // Until the end, there's always more to serialize
+    const qint64 pending = m_output.size() - m_readPos;
+    return pending + (m_state != Finished ? s_binaryChunkSize : 0) + QIODevice::bytesAvailable();
+}
+
+qint64 KDSoapRequestDevice::size() const
+{
+    return contentLength();
+}
+
+bool KDSoapRequestDevice::atEnd() const
+{
+    return m_state == Finished && m_readPos == m_output.size();
+}
+
+bool KDSoapRequestDevice::reset()
+{
+    restart();
+    return true;
+}
+
+qint64 KDSoapRequestDevice::contentLength() const
+{
+    if (m_contentLength < 0) {
+        KDSoapRequestDevice counter(m_messageWriter, m_message, m_method, m_headers, m_persistentHeaders, m_authentication);
+        counter.m_countingOnly = true;
+        qint64 length = 0;
+        while (counter.m_state != Finished) {
+            counter.step();
+            length += counter.m_output.size();
+            counter.m_output.buffer().clear();
+            counter.m_output.seek(0);
+        }
+        m_contentLength = length + counter.m_binaryTextLength;
+    }
+    return m_contentLength;
+}
+
+qint64 KDSoapRequestDevice::peakBufferSize() const
+{
+    return m_peakBufferSize;
+}
+
+QByteArray KDSoapRequestDevice::allData() const
+{
+    return m_messageWriter.messageToXml(m_message, m_method, m_headers, m_persistentHeaders, m_authentication);
+}
+
+qint64 KDSoapRequestDevice::readData(char *data, qint64 maxSize)
+{
+    while (m_output.size() - m_readPos < maxSize && m_state != Finished) {
+        step();
+    }
+    m_peakBufferSize = qMax(m_peakBufferSize, m_output.size());
+    const qint64 pending = m_output.size() - m_readPos;
+    if (pending == 0) {
+        return m_state == Finished ? -1 : 0; // -1 at the end of the request
+    }
+    const qint64 length = qMin(maxSize, pending);
+    memcpy(data, m_output.buffer().constData() + m_readPos, length);
+    m_readPos += length;
+    if (m_readPos == m_output.size()) {
+        // Everything that was serialized has been read, free it
+        m_output.buffer().clear();
+        m_output.seek(0);
+        m_readPos = 0;
+    } else if (m_readPos >= s_binaryChunkSize && m_readPos > m_output.size() / 2) {
+        // The reads don't line up with the serialized pieces: free what was read anyway,
+        // so that the buffer doesn't grow with the request
+        m_output.buffer().remove(0, int(m_readPos));
+        m_output.seek(m_output.buffer().size());
+        m_readPos = 0;
+    }
+    return length;
+}
+
+qint64 KDSoapRequestDevice::writeData(const char *data, qint64 maxSize)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(maxSize);
+    return -1;
+}
+
+void KDSoapRequestDevice::restart()
+{
+    m_output.close();
+    m_output.setData(QByteArray());
+    m_output.open(QIODevice::WriteOnly);
+    m_readPos = 0;
+    m_writer.reset();
+    if (m_messageWriter.usesNativeXmlWriter(m_message)) {
+        m_streamWriter.reset();
+        m_writer.reset(new KDSoapUtf8XmlWriter(&m_output.buffer()));
+    } else {
+        m_streamWriter.reset(new QXmlStreamWriter(&m_output));
+        m_writer.reset(new KDSoapQtXmlWriter(*m_streamWriter));
+    }
+    m_namespacePrefixes.clear();
+    m_messageNamespace.clear();
+    m_messageElementStarted = false;
+    m_stack.clear();
+    m_state = StartOfMessage;
+}
+
+void KDSoapRequestDevice::enterElement(const KDSoapValue &value)
+{
+    // Same as KDSoapValue::writeElementContents(), except for the child elements and the text,
+    // which step() writes one at a time
+    value.writeElementAttributes(m_namespacePrefixes, *m_writer, m_message.use());
+    value.writeAttributes(*m_writer, false);
+    const Frame frame = {value, value.childValues(), 0, 0};
+    m_stack.append(frame);
+}
+
+// Writes the next piece of the text of the element, returns true when done
+bool KDSoapRequestDevice::writeElementText(Frame &frame)
+{
+    if (m_countingOnly && frame.textOffset == 0) {
+        // contentLength() doesn't need the encoded binary data, only its size
+        const qint64 size = frame.value.binaryTextSize();
+        if (size > 0) {
+            m_writer->writeAsciiCharacters("", 0); // ends the start tag, like the text would
+            m_binaryTextLength += size;
+            return true;
+        }
+    }
+    return frame.value.writeElementText(*m_writer, frame.textOffset, s_binaryChunkSize);
+}
+
+void KDSoapRequestDevice::step()
+{
+    switch (m_state) {
+    case StartOfMessage:
+        m_messageElementStarted = m_messageWriter.writeStartOfMessage(*m_writer, m_namespacePrefixes, m_messageNamespace, m_message, m_method, m_headers,
+                                                                      m_persistentHeaders, m_authentication);
+        if (!m_messageElementStarted) {
+            m_state = EndOfMessage;
+        } else if (const KDSoapMessage::ContentsWriter contentsWriter = m_message.contentsWriter()) {
+            // Generated code, which can only write everything at once
+            contentsWriter(*m_writer->xmlStreamWriter(), m_messageNamespace);
+            m_state = EndOfMessage;
+        } else {
+            enterElement(m_message);
+            m_state = MessageContents;
+        }
+        break;
+    case MessageContents: {
+        Frame &frame = m_stack.last();
+        if (frame.nextChild < frame.children.count()) {
+            const KDSoapValue child = frame.children.at(frame.nextChild++);
+            child.writeStartElement(*m_writer, m_messageNamespace, false);
+            enterElement(child);
+        } else if (writeElementText(frame)) {
+            m_stack.removeLast();
+            if (m_stack.isEmpty()) {
+                m_state = EndOfMessage; // which ends the message element
+            } else {
+                m_writer->writeEndElement();
+            }
+        }
+        break;
+    }
+    case EndOfMessage:
+        m_messageWriter.writeEndOfMessage(*m_writer, m_messageElementStarted);
+        m_state = Finished;
+        break;
+    case Finished:
+        break;
+    }
+}
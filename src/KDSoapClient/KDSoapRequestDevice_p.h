@@ -0,0 +1,111 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2010-2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+#ifndef KDSOAPREQUESTDEVICE_P_H
+#define KDSOAPREQUESTDEVICE_P_H
+
+#include "KDSoapAuthentication.h"
+#include "KDSoapMessage.h"
+#include "KDSoapMessageWriter_p.h"
+#include "KDSoapNamespacePrefixes_p.h"
+#include <QtCore/QBuffer>
+#include <QtCore/QIODevice>
+#include <QtCore/QScopedPointer>
+#include <QtCore/QVector>
+#include <QtCore/QXmlStreamWriter>
+
+/**
+ * \internal
+ * A sequential device which serializes a request while it's being read,
+ * see KDSoapClientInterface::setStreamingRequests().
+ *
+ * Only the data which hasn't been read yet is kept in memory: the elements are written
+ * one by one, and the binary values in pieces, when the network layer asks for more data.
+ */
+class KDSOAP_EXPORT KDSoapRequestDevice : public QIODevice
+{
+    Q_OBJECT
+public:
+    KDSoapRequestDevice(const KDSoapMessageWriter &messageWriter, const KDSoapMessage &message, const QString &method, const KDSoapHeaders &headers,
+                        const QMap<QString, KDSoapMessage> &persistentHeaders, const KDSoapAuthentication &authentication,
+                        QObject *parent = nullptr);
+    ~KDSoapRequestDevice() override;
+
+    bool isSequential() const override;
+    qint64 bytesAvailable() const override;
+    qint64 size() const override;
+    bool atEnd() const override;
+    // Starts the serialization again, e.g. when the request has to be sent again after an authentication request
+    bool reset() override;
+
+    /**
+     * The size of the whole request, computed by serializing it without keeping the data,
+     * since the network layer needs a content-length for sequential devices.
+     * The binary values are not encoded for this, their encoded size is known upfront.
+     */
+    qint64 contentLength() const;
+
+    /**
+     * The biggest size the buffer of serialized data reached so far. Only for unit tests.
+     */
+    qint64 peakBufferSize() const;
+
+    /**
+     * The whole request at once. Only for debug output.
+     */
+    QByteArray allData() const;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private:
+    void restart();
+    void step();
+    void enterElement(const KDSoapValue &value);
+
+    enum State
+    {
+        StartOfMessage,
+        MessageContents,
+        EndOfMessage,
+        Finished
+    };
+    struct Frame
+    {
+        KDSoapValue value;
+        KDSoapValueList children;
+        int nextChild;
+        qint64 textOffset;
+    };
+    bool writeElementText(Frame &frame);
+
+    const KDSoapMessageWriter m_messageWriter;
+    const KDSoapMessage m_message;
+    const QString m_method;
+    const KDSoapHeaders m_headers;
+    const QMap<QString, KDSoapMessage> m_persistentHeaders;
+    const KDSoapAuthentication m_authentication;
+
+    State m_state;
+    QBuffer m_output; // what was serialized but not read yet, from m_readPos
+    qint64 m_readPos;
+    QScopedPointer<QXmlStreamWriter> m_streamWriter; // unless the native writer is used
+    QScopedPointer<KDSoapXmlWriter> m_writer;
+    KDSoapNamespacePrefixes m_namespacePrefixes;
+    QString m_messageNamespace;
+    bool m_messageElementStarted;
+    QVector<Frame> m_stack;
+    mutable qint64 m_contentLength;
+    bool m_countingOnly; // in contentLength(): binary values are not encoded, m_binaryTextLength has their size
+    qint64 m_binaryTextLength;
+    qint64 m_peakBufferSize;
+};
+
+#endif // KDSOAPREQUESTDEVICE_P_H
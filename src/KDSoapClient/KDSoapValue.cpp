@@ -9,19 +9,38 @@
 ****************************************************************************/
 #include "KDSoapValue.h"
 #include "KDDateTime.h"
+#include "KDSoapBinaryCodec_p.h"
+#include "KDSoapLazyElement_p.h"
+#include "KDSoapMtom_p.h"
 #include "KDSoapNamespaceManager.h"
 #include "KDSoapNamespacePrefixes_p.h"
+#include "KDSoapNamespaceScope_p.h"
+#include "KDSoapValueArena_p.h"
+#include "KDSoapXmlWriter_p.h"
 #include <QDateTime>
 #include <QDebug>
 #include <QStringList>
 #include <QUrl>
 
+#include <cstring>
+
+#if defined(__has_include) && __cplusplus >= 201703L
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
+#endif
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+#define KDSOAP_HAVE_TO_CHARS
+#endif
+
 class KDSoapValue::Private : public QSharedData
 {
 public:
     Private()
-        : m_qualified(false)
+        : m_arenaNode(-1)
+        , m_qualified(false)
         , m_nillable(false)
+        , m_binary(false)
     {
     }
     Private(const QString &n, const QVariant &v, const QString &typeNameSpace, const QString &typeName)
@@ -29,8 +48,10 @@ public:
         , m_value(v)
         , m_typeNamespace(typeNameSpace)
         , m_typeName(typeName)
+        , m_arenaNode(-1)
         , m_qualified(false)
         , m_nillable(false)
+        , m_binary(false)
     {
     }
 
@@ -40,9 +61,13 @@ public:
     QString m_typeNamespace;
     QString m_typeName;
     KDSoapValueList m_childValues;
+    KDSoapLazyElement::Ptr m_lazyChildValues; // not parsed yet, see childValues()
+    KDSoapValueArena::Ptr m_arena; // not created yet from m_arenaNode, see childValues()
+    int m_arenaNode;
     bool m_qualified;
     bool m_nillable;
-    QXmlStreamNamespaceDeclarations m_environmentNamespaceDeclarations;
+    bool m_binary; // m_value is binary data rather than base64 text, see setBinaryValue()
+    KDSoapNamespaceScope::Ptr m_namespaceScope; // shared with the parent, when parsed
     QXmlStreamNamespaceDeclarations m_localNamespaceDeclarations;
 };
 
@@ -67,6 +92,12 @@ KDSoapValue::KDSoapValue(const QString &n, const KDSoapValueList &children, cons
     d->m_childValues = children;
 }
 
+KDSoapValue::KDSoapValue(const QString &n, KDSoapValueList &&children, const QString &typeNameSpace, const QString &typeName)
+    : d(new Private(n, QVariant(), typeNameSpace, typeName))
+{
+    d->m_childValues = std::move(children);
+}
+
 KDSoapValue::~KDSoapValue()
 {
 }
@@ -76,6 +107,19 @@ KDSoapValue::KDSoapValue(const KDSoapValue &other)
 {
 }
 
+KDSoapValue::KDSoapValue(KDSoapValue &&other) noexcept
+    : d(std::move(other.d))
+{
+    // other remains usable: it shares an empty value, detached when modified
+    other.d = movedFromPrivate();
+}
+
+const QSharedDataPointer<KDSoapValue::Private> &KDSoapValue::movedFromPrivate()
+{
+    static const QSharedDataPointer<Private> s_empty(new Private);
+    return s_empty;
+}
+
 bool KDSoapValue::isNull() const
 {
     return d->m_name.isEmpty() && isNil();
@@ -83,7 +127,7 @@ bool KDSoapValue::isNull() const
 
 bool KDSoapValue::isNil() const
 {
-    return d->m_value.isNull() && d->m_childValues.isEmpty() && d->m_childValues.attributes().isEmpty();
+    return d->m_value.isNull() && !d->m_lazyChildValues && !d->m_arena && d->m_childValues.isEmpty() && d->m_childValues.attributes().isEmpty();
 }
 
 void KDSoapValue::setNillable(bool nillable)
@@ -109,6 +153,16 @@ QVariant KDSoapValue::value() const
 void KDSoapValue::setValue(const QVariant &value)
 {
     d->m_value = value;
+    d->m_binary = false;
+}
+
+void KDSoapValue::setBinaryValue(const QByteArray &data)
+{
+    d->m_value = data;
+    d->m_binary = true;
+    d->m_childValues = KDSoapValueList();
+    d->m_lazyChildValues = KDSoapLazyElement::Ptr();
+    d->m_arena = KDSoapValueArena::Ptr();
 }
 
 bool KDSoapValue::isQualified() const
@@ -138,16 +192,55 @@ QXmlStreamNamespaceDeclarations KDSoapValue::namespaceDeclarations() const
 
 void KDSoapValue::setEnvironmentNamespaceDeclarations(const QXmlStreamNamespaceDeclarations &environmentNamespaceDeclarations)
 {
-    d->m_environmentNamespaceDeclarations = environmentNamespaceDeclarations;
+    d->m_namespaceScope = KDSoapNamespaceScope::create(KDSoapNamespaceScope::Ptr(), environmentNamespaceDeclarations);
 }
 
 QXmlStreamNamespaceDeclarations KDSoapValue::environmentNamespaceDeclarations() const
 {
-    return d->m_environmentNamespaceDeclarations;
+    return d->m_namespaceScope ? d->m_namespaceScope->allDeclarations() : QXmlStreamNamespaceDeclarations();
+}
+
+QString KDSoapValue::namespaceForPrefix(const QString &prefix) const
+{
+    return d->m_namespaceScope ? d->m_namespaceScope->namespaceForPrefix(prefix) : QString();
+}
+
+void KDSoapNamespaceScope::attach(KDSoapValue &value, const Ptr &scope)
+{
+    value.d->m_namespaceScope = scope;
+}
+
+void KDSoapLazyElement::attach(KDSoapValue &value, const Ptr &lazyElement)
+{
+    value.d->m_lazyChildValues = lazyElement;
+}
+
+void KDSoapValueArena::attach(KDSoapValue &value, const Ptr &arena, int node)
+{
+    value.d->m_arena = arena;
+    value.d->m_arenaNode = node;
 }
 
 KDSoapValueList &KDSoapValue::childValues() const
 {
+    if (d->m_arena) {
+        // Create the children from the arena on first use; all the copies of this value share them.
+        Private *priv = const_cast<Private *>(d.constData());
+        const KDSoapValueArena::Ptr arena = priv->m_arena;
+        priv->m_arena = KDSoapValueArena::Ptr();
+        arena->materialize(priv->m_arenaNode, priv->m_childValues);
+    }
+    if (d->m_lazyChildValues) {
+        // Parse the children on first use; all the copies of this value share them.
+        Private *priv = const_cast<Private *>(d.constData());
+        const KDSoapLazyElement::Ptr lazyChildValues = priv->m_lazyChildValues;
+        priv->m_lazyChildValues = KDSoapLazyElement::Ptr();
+        lazyChildValues->materialize(priv->m_childValues);
+    }
+    if (d.constData() == movedFromPrivate().constData()) {
+        // The list can be modified without detaching, below: it can't be the one shared by all the moved-from values
+        const_cast<KDSoapValue *>(this)->d = new Private;
+    }
     // I want to fool the QSharedDataPointer mechanism here...
     return const_cast<KDSoapValueList &>(d->m_childValues);
 }
@@ -162,6 +255,18 @@ bool KDSoapValue::operator!=(const KDSoapValue &other) const
     return d != other.d;
 }
 
+static bool isHexBinaryType(const QString &typeNs, const QString &type)
+{
+    return (typeNs == KDSoapNamespaceManager::xmlSchema1999() || typeNs == KDSoapNamespaceManager::xmlSchema2001())
+        && type == QLatin1String("hexBinary");
+}
+
+static bool isBase64BinaryType(const QString &typeNs, const QString &type)
+{
+    return (typeNs == KDSoapNamespaceManager::xmlSchema1999() || typeNs == KDSoapNamespaceManager::xmlSchema2001())
+        && type == QLatin1String("base64Binary");
+}
+
 static QString variantToTextValue(const QVariant &value, const QString &typeNs, const QString &type)
 {
     switch (value.userType()) {
@@ -174,11 +279,9 @@ static QString variantToTextValue(const QVariant &value, const QString &typeNs,
         return value.toUrl().toString();
     case QVariant::ByteArray: {
         const QByteArray data = value.toByteArray();
-        if (typeNs == KDSoapNamespaceManager::xmlSchema1999() || typeNs == KDSoapNamespaceManager::xmlSchema2001()) {
-            if (type == QLatin1String("hexBinary")) {
-                const QByteArray hb = data.toHex();
-                return QString::fromLatin1(hb.constData(), hb.size());
-            }
+        if (isHexBinaryType(typeNs, type)) {
+            const QByteArray hb = data.toHex();
+            return QString::fromLatin1(hb.constData(), hb.size());
         }
         // default to base64Binary, like variantToXMLType() does.
         const QByteArray b64 = value.toByteArray().toBase64();
@@ -237,35 +340,35 @@ static QString variantToXMLType(const QVariant &value)
     case QVariant::String:
     // fall-through
     case QVariant::Url:
-        return QLatin1String("xsd:string");
+        return QStringLiteral("xsd:string");
     case QVariant::ByteArray:
-        return QLatin1String("xsd:base64Binary");
+        return QStringLiteral("xsd:base64Binary");
     case QVariant::Int:
     // fall-through
     case QVariant::LongLong:
     // fall-through
     case QVariant::UInt:
-        return QLatin1String("xsd:int");
+        return QStringLiteral("xsd:int");
     case QVariant::ULongLong:
-        return QLatin1String("xsd:unsignedInt");
+        return QStringLiteral("xsd:unsignedInt");
     case QVariant::Bool:
-        return QLatin1String("xsd:boolean");
+        return QStringLiteral("xsd:boolean");
     case QMetaType::Float:
-        return QLatin1String("xsd:float");
+        return QStringLiteral("xsd:float");
     case QVariant::Double:
-        return QLatin1String("xsd:double");
+        return QStringLiteral("xsd:double");
     case QVariant::Time:
-        return QLatin1String("xsd:time"); // correct? xmlpatterns fallsback to datetime because of missing timezone
+        return QStringLiteral("xsd:time"); // correct? xmlpatterns fallsback to datetime because of missing timezone
     case QVariant::Date:
-        return QLatin1String("xsd:date");
+        return QStringLiteral("xsd:date");
     case QVariant::DateTime:
-        return QLatin1String("xsd:dateTime");
+        return QStringLiteral("xsd:dateTime");
     default:
         if (value.userType() == qMetaTypeId<float>()) {
-            return QLatin1String("xsd:float");
+            return QStringLiteral("xsd:float");
         }
         if (value.canConvert<KDDateTime>()) {
-            return QLatin1String("xsd:dateTime");
+            return QStringLiteral("xsd:dateTime");
         }
 
         qDebug() << value;
@@ -277,8 +380,239 @@ static QString variantToXMLType(const QVariant &value)
     }
 }
 
-void KDSoapValue::writeElement(KDSoapNamespacePrefixes &namespacePrefixes, QXmlStreamWriter &writer, KDSoapValue::Use use,
+// Formatting of the most common scalar values into a buffer, without any allocation.
+// The output must be the same as the one of variantToTextValue(). These functions return the end of
+// the written text, or nullptr for the values they don't handle, which then go through variantToTextValue().
+
+static char *formatUnsigned(char *out, quint64 value)
+{
+    char digits[20];
+    int count = 0;
+    do {
+        digits[count++] = char('0' + value % 10);
+        value /= 10;
+    } while (value);
+    while (count) {
+        *out++ = digits[--count];
+    }
+    return out;
+}
+
+static char *formatInteger(char *out, qint64 value)
+{
+    if (value < 0) {
+        *out++ = '-';
+        return formatUnsigned(out, 0 - quint64(value));
+    }
+    return formatUnsigned(out, quint64(value));
+}
+
+static char *formatDigits(char *out, int value, int count)
+{
+    for (int i = count - 1; i >= 0; --i) {
+        out[i] = char('0' + value % 10);
+        value /= 10;
+    }
+    return out + count;
+}
+
+// Like QDate::toString(Qt::ISODate)
+static char *formatDate(char *out, const QDate &date)
+{
+    if (!date.isValid() || date.year() < 1 || date.year() > 9999) {
+        return nullptr;
+    }
+    out = formatDigits(out, date.year(), 4);
+    *out++ = '-';
+    out = formatDigits(out, date.month(), 2);
+    *out++ = '-';
+    return formatDigits(out, date.day(), 2);
+}
+
+// Like QTime::toString(), with "hh:mm:ss" or "hh:mm:ss.zzz"
+static char *formatTime(char *out, const QTime &time, bool withMilliseconds)
+{
+    if (!time.isValid()) {
+        return nullptr;
+    }
+    out = formatDigits(out, time.hour(), 2);
+    *out++ = ':';
+    out = formatDigits(out, time.minute(), 2);
+    *out++ = ':';
+    out = formatDigits(out, time.second(), 2);
+    if (withMilliseconds) {
+        *out++ = '.';
+        out = formatDigits(out, time.msec(), 3);
+    }
+    return out;
+}
+
+// Like KDDateTime::toDateString()
+static char *formatDateTime(char *out, const QDateTime &dateTime, const QString &timeZone)
+{
+    if (!dateTime.isValid() || timeZone.size() > 6) {
+        return nullptr;
+    }
+    out = formatDate(out, dateTime.date());
+    if (!out) {
+        return nullptr;
+    }
+    *out++ = 'T';
+    const QTime time = dateTime.time();
+    out = formatTime(out, time, time.msec() != 0);
+    if (time.msec()) {
+        for (const QChar ch : timeZone) {
+            if (ch.unicode() >= 0x80) {
+                return nullptr;
+            }
+            *out++ = char(ch.unicode());
+        }
+        return out;
+    }
+    // Qt::ISODate
+    switch (dateTime.timeSpec()) {
+    case Qt::UTC:
+        *out++ = 'Z';
+        break;
+    case Qt::OffsetFromUTC:
+    case Qt::TimeZone: {
+        const int offset = dateTime.offsetFromUtc();
+        *out++ = offset < 0 ? '-' : '+';
+        out = formatDigits(out, qAbs(offset) / 3600, 2);
+        *out++ = ':';
+        out = formatDigits(out, (qAbs(offset) / 60) % 60, 2);
+        break;
+    }
+    default:
+        break;
+    }
+    return out;
+}
+
+#ifdef KDSOAP_HAVE_TO_CHARS
+// Like QString::number(value, 'g', QLocale::FloatingPointShortest), which QVariant::toString() uses:
+// the shortest digits which read back as the same value, in the shorter of the decimal and exponent forms.
+static char *formatDouble(char *out, double value)
+{
+    if (!qIsFinite(value)) {
+        return nullptr;
+    }
+    char scientific[32];
+    const std::to_chars_result result = std::to_chars(scientific, scientific + sizeof(scientific), value, std::chars_format::scientific);
+    if (result.ec != std::errc()) {
+        return nullptr;
+    }
+    // Split "-d.ddde+XX" into the sign, the digits and the exponent
+    const char *in = scientific;
+    if (*in == '-') {
+        *out++ = *in++;
+    }
+    char digits[32];
+    int digitCount = 0;
+    for (; *in != 'e'; ++in) {
+        if (*in != '.') {
+            digits[digitCount++] = *in;
+        }
+    }
+    ++in;
+    const bool negativeExponent = *in++ == '-';
+    int exponent = 0;
+    for (; in != result.ptr; ++in) {
+        exponent = exponent * 10 + (*in - '0');
+    }
+    if (negativeExponent) {
+        exponent = -exponent;
+    }
+    const int decimalPoint = exponent + 1;
+
+    // Characters that the exponent form needs and the decimal form doesn't: 'e', sign and two digits,
+    // adjusted for the decimal separator which only one of the forms has
+    int bias = 4;
+    if (digitCount <= decimalPoint && digitCount > 1) {
+        ++bias;
+    } else if (digitCount == 1 && decimalPoint <= 0) {
+        --bias;
+    }
+    const bool useDecimal = decimalPoint <= 0 ? 1 - decimalPoint <= bias : decimalPoint <= digitCount + bias;
+
+    if (useDecimal) {
+        if (decimalPoint <= 0) {
+            *out++ = '0';
+            *out++ = '.';
+            for (int i = decimalPoint; i < 0; ++i) {
+                *out++ = '0';
+            }
+            memcpy(out, digits, digitCount);
+            return out + digitCount;
+        }
+        for (int i = 0; i < qMax(digitCount, decimalPoint); ++i) {
+            if (i == decimalPoint) {
+                *out++ = '.';
+            }
+            *out++ = i < digitCount ? digits[i] : '0';
+        }
+        return out;
+    }
+    *out++ = digits[0];
+    if (digitCount > 1) {
+        *out++ = '.';
+        memcpy(out, digits + 1, digitCount - 1);
+        out += digitCount - 1;
+    }
+    *out++ = 'e';
+    *out++ = exponent < 0 ? '-' : '+';
+    const int absExponent = qAbs(exponent);
+    return formatDigits(out, absExponent, absExponent >= 100 ? 3 : 2);
+}
+#endif
+
+// \p buffer must have room for 64 characters
+static char *formatScalar(char *buffer, const QVariant &value)
+{
+    switch (value.userType()) {
+    case QVariant::Int:
+    case QVariant::LongLong:
+    case QVariant::UInt:
+        return formatInteger(buffer, value.toLongLong());
+    case QVariant::ULongLong:
+        return formatUnsigned(buffer, value.toULongLong());
+    case QVariant::Bool:
+        if (value.toBool()) {
+            memcpy(buffer, "true", 4);
+            return buffer + 4;
+        }
+        memcpy(buffer, "false", 5);
+        return buffer + 5;
+#ifdef KDSOAP_HAVE_TO_CHARS
+    case QVariant::Double:
+        return formatDouble(buffer, value.toDouble());
+#endif
+    case QVariant::Time: {
+        const QTime time = value.toTime();
+        return formatTime(buffer, time, time.msec() != 0);
+    }
+    case QVariant::Date:
+        return formatDate(buffer, value.toDate());
+    case QVariant::DateTime:
+        return formatDateTime(buffer, value.toDateTime(), QString());
+    default:
+        if (value.userType() == qMetaTypeId<KDDateTime>()) {
+            const KDDateTime dateTime = value.value<KDDateTime>();
+            return formatDateTime(buffer, dateTime, dateTime.timeZone());
+        }
+        return nullptr;
+    }
+}
+
+void KDSoapValue::writeElement(KDSoapNamespacePrefixes &namespacePrefixes, KDSoapXmlWriter &writer, KDSoapValue::Use use,
                                const QString &messageNamespace, bool forceQualified) const
+{
+    writeStartElement(writer, messageNamespace, forceQualified);
+    writeElementContents(namespacePrefixes, writer, use, messageNamespace);
+    writer.writeEndElement();
+}
+
+void KDSoapValue::writeStartElement(KDSoapXmlWriter &writer, const QString &messageNamespace, bool forceQualified) const
 {
     Q_ASSERT(!name().isEmpty());
     if (!d->m_nameNamespace.isEmpty() && d->m_nameNamespace != messageNamespace) {
@@ -295,12 +629,19 @@ void KDSoapValue::writeElement(KDSoapNamespacePrefixes &namespacePrefixes, QXmlS
     } else {
         writer.writeStartElement(name());
     }
-    writeElementContents(namespacePrefixes, writer, use, messageNamespace);
-    writer.writeEndElement();
 }
 
-void KDSoapValue::writeElementContents(KDSoapNamespacePrefixes &namespacePrefixes, QXmlStreamWriter &writer, KDSoapValue::Use use,
+void KDSoapValue::writeElementContents(KDSoapNamespacePrefixes &namespacePrefixes, KDSoapXmlWriter &writer, KDSoapValue::Use use,
                                        const QString &messageNamespace) const
+{
+    writeElementAttributes(namespacePrefixes, writer, use);
+    writeChildren(namespacePrefixes, writer, use, messageNamespace, false);
+
+    qint64 offset = 0;
+    writeElementText(writer, offset, -1);
+}
+
+void KDSoapValue::writeElementAttributes(KDSoapNamespacePrefixes &namespacePrefixes, KDSoapXmlWriter &writer, KDSoapValue::Use use) const
 {
     const QVariant value = this->value();
 
@@ -309,7 +650,7 @@ void KDSoapValue::writeElementContents(KDSoapNamespacePrefixes &namespacePrefixe
     }
 
     if (isNil() && d->m_nillable) {
-        writer.writeAttribute(KDSoapNamespaceManager::xmlSchemaInstance2001(), QLatin1String("nil"), QLatin1String("true"));
+        writer.writeAttribute(KDSoapNamespaceManager::xmlSchemaInstance2001(), QStringLiteral("nil"), QStringLiteral("true"));
     }
 
     if (use == EncodedUse) {
@@ -322,32 +663,107 @@ void KDSoapValue::writeElementContents(KDSoapNamespacePrefixes &namespacePrefixe
             type = variantToXMLType(value); // fallback
         }
         if (!type.isEmpty()) {
-            writer.writeAttribute(KDSoapNamespaceManager::xmlSchemaInstance2001(), QLatin1String("type"), type);
+            writer.writeAttribute(KDSoapNamespaceManager::xmlSchemaInstance2001(), QStringLiteral("type"), type);
         }
 
         const KDSoapValueList list = this->childValues();
         const bool isArray = !list.arrayType().isEmpty();
         if (isArray) {
-            writer.writeAttribute(KDSoapNamespaceManager::soapEncoding(), QLatin1String("arrayType"),
+            writer.writeAttribute(KDSoapNamespaceManager::soapEncoding(), QStringLiteral("arrayType"),
                                   namespacePrefixes.resolve(list.arrayTypeNs(), list.arrayType()) + QLatin1Char('[') + QString::number(list.count())
                                       + QLatin1Char(']'));
         }
     }
-    writeChildren(namespacePrefixes, writer, use, messageNamespace, false);
+}
 
-    if (!value.isNull()) {
-        const QString txt = variantToTextValue(value, this->typeNs(), this->type());
-        if (!txt.isEmpty()) { // In Qt6, a null string doesn't lead to a null variant anymore
-            writer.writeCharacters(txt);
+// Writes the text of the value, starting at byte \p offset for binary data, and at most \p maxBytes of
+// it (-1 for all of it, otherwise at least 3), so that big binary values can be encoded piecewise. Returns true when done.
+bool KDSoapValue::writeElementText(KDSoapXmlWriter &writer, qint64 &offset, qint64 maxBytes) const
+{
+    const QVariant value = this->value();
+    if (value.isNull()) {
+        return true;
+    }
+    if (KDSoapMtomAttachments *attachments = writer.mtomAttachments()) {
+        // Binary data goes into a MIME part of its own, as is: QByteArray values (unless they're hexBinary),
+        // and the base64 text of base64Binary values, which is what the generated code uses.
+        QByteArray data;
+        if (d->m_binary || (value.userType() == QVariant::ByteArray && !isHexBinaryType(this->typeNs(), this->type()))) {
+            data = value.toByteArray();
+        } else if (value.userType() == QVariant::String && isBase64BinaryType(this->typeNs(), this->type())) {
+            data = base64BinaryValue();
+        }
+        if (!data.isEmpty()) {
+            writer.writeStartElement(KDSoapMtom::xopNamespace(), QStringLiteral("Include"));
+            writer.writeAttribute(QStringLiteral("href"), attachments->add(data));
+            writer.writeEndElement();
+            return true;
+        }
+    }
+    if (value.userType() == QVariant::ByteArray) {
+        const QByteArray data = value.toByteArray();
+        const bool hex = isHexBinaryType(this->typeNs(), this->type());
+        const qint64 end = maxBytes < 0 ? data.size() : qMin<qint64>(data.size(), offset + maxBytes);
+        // Encoded piece by piece into a buffer on the stack, rather than into a copy of the whole value
+        char buffer[4096];
+        const qint64 pieceSize = hex ? sizeof(buffer) / 2 : sizeof(buffer) / 4 * 3;
+        while (offset < end) {
+            qint64 length = qMin(pieceSize, end - offset);
+            if (!hex && offset + length < data.size()) {
+                length -= length % 3; // keep the base64 groups complete, no padding in the middle
+                if (length == 0) {
+                    break;
+                }
+            }
+            qint64 encodedLength;
+            if (hex) {
+                KDSoapBinaryCodec::toHex(data.constData() + offset, length, buffer);
+                encodedLength = 2 * length;
+            } else {
+                KDSoapBinaryCodec::toBase64(data.constData() + offset, length, buffer);
+                encodedLength = KDSoapBinaryCodec::base64EncodedSize(length);
+            }
+            writer.writeAsciiCharacters(buffer, int(encodedLength));
+            offset += length;
         }
+        return offset >= data.size();
+    }
+    char buffer[64];
+    if (const char *end = formatScalar(buffer, value)) {
+        writer.writeAsciiCharacters(buffer, int(end - buffer));
+        return true;
+    }
+    const QString txt = variantToTextValue(value, this->typeNs(), this->type());
+    if (!txt.isEmpty()) { // In Qt6, a null string doesn't lead to a null variant anymore
+        writer.writeCharacters(txt);
+    }
+    return true;
+}
+
+qint64 KDSoapValue::binaryTextSize() const
+{
+    const QVariant value = this->value();
+    if (value.isNull() || value.userType() != QVariant::ByteArray) {
+        return -1;
     }
+    const qint64 size = value.toByteArray().size();
+    return isHexBinaryType(this->typeNs(), this->type()) ? 2 * size : KDSoapBinaryCodec::base64EncodedSize(size);
 }
 
-void KDSoapValue::writeChildren(KDSoapNamespacePrefixes &namespacePrefixes, QXmlStreamWriter &writer, KDSoapValue::Use use,
+void KDSoapValue::writeChildren(KDSoapNamespacePrefixes &namespacePrefixes, KDSoapXmlWriter &writer, KDSoapValue::Use use,
                                 const QString &messageNamespace, bool forceQualified) const
 {
-    const KDSoapValueList &args = childValues();
-    const auto attributes = args.attributes();
+    writeAttributes(writer, forceQualified);
+    KDSoapValueListIterator it(childValues());
+    while (it.hasNext()) {
+        const KDSoapValue &element = it.next();
+        element.writeElement(namespacePrefixes, writer, use, messageNamespace, forceQualified);
+    }
+}
+
+void KDSoapValue::writeAttributes(KDSoapXmlWriter &writer, bool forceQualified) const
+{
+    const auto attributes = childValues().attributes();
     for (const KDSoapValue &attr : attributes) {
         // Q_ASSERT(!attr.value().isNull());
 
@@ -358,11 +774,6 @@ void KDSoapValue::writeChildren(KDSoapNamespacePrefixes &namespacePrefixes, QXml
             writer.writeAttribute(attr.name(), variantToTextValue(attr.value(), attr.typeNs(), attr.type()));
         }
     }
-    KDSoapValueListIterator it(args);
-    while (it.hasNext()) {
-        const KDSoapValue &element = it.next();
-        element.writeElement(namespacePrefixes, writer, use, messageNamespace, forceQualified);
-    }
 }
 
 ////
@@ -424,9 +835,10 @@ KDSoapValueList KDSoapValue::split() const
     return valueList;
 }
 
-KDSoapValue KDSoapValueList::child(const QString &name) const
+template<typename Name>
+static KDSoapValue findChild(const KDSoapValueList &list, const Name &name)
 {
-    for (const KDSoapValue &val : qAsConst(*this)) {
+    for (const KDSoapValue &val : list) {
         if (val.name() == name) {
             return val;
         }
@@ -434,6 +846,23 @@ KDSoapValue KDSoapValueList::child(const QString &name) const
     return KDSoapValue();
 }
 
+KDSoapValue KDSoapValueList::child(const QString &name) const
+{
+    return findChild(*this, name);
+}
+
+KDSoapValue KDSoapValueList::child(QLatin1String name) const
+{
+    return findChild(*this, name);
+}
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+KDSoapValue KDSoapValueList::child(QStringView name) const
+{
+    return findChild(*this, name);
+}
+#endif
+
 void KDSoapValueList::setArrayType(const QString &nameSpace, const QString &type)
 {
     m_arrayType = qMakePair(nameSpace, type);
@@ -449,6 +878,19 @@ QString KDSoapValueList::arrayType() const
     return m_arrayType.second;
 }
 
+void KDSoapValueList::append(KDSoapValue &&value)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    QList<KDSoapValue>::append(std::move(value));
+#else
+    // QList has no append(T &&) in Qt 5. Copying an empty (moved-from) value only costs a reference count,
+    // so append one and swap the value into it.
+    KDSoapValue moved(std::move(value));
+    QList<KDSoapValue>::append(value);
+    last().swap(moved);
+#endif
+}
+
 void KDSoapValueList::addArgument(const QString &argumentName, const QVariant &argumentValue, const QString &typeNameSpace, const QString &typeName)
 {
     append(KDSoapValue(argumentName, argumentValue, typeNameSpace, typeName));
@@ -464,10 +906,48 @@ void KDSoapValue::setNamespaceUri(const QString &ns)
     d->m_nameNamespace = ns;
 }
 
+QByteArray KDSoapValue::base64BinaryValue() const
+{
+    const QVariant value = this->value();
+    if (d->m_binary) { // resolved xop:Include, see KDSoapMtom
+        return value.toByteArray();
+    }
+    QByteArray result;
+    if (value.userType() == QVariant::ByteArray) { // see KDSoapMessageReader, for xsi:type="xsd:base64Binary"
+        const QByteArray text = value.toByteArray();
+        result.resize(int(KDSoapBinaryCodec::decodedBufferSize(text.size())));
+        result.resize(int(KDSoapBinaryCodec::fromBase64(text.constData(), text.size(), result.data())));
+    } else {
+        const QString text = value.toString();
+        result.resize(int(KDSoapBinaryCodec::decodedBufferSize(text.size())));
+        result.resize(int(KDSoapBinaryCodec::fromBase64(text.utf16(), text.size(), result.data())));
+    }
+    return result;
+}
+
+QByteArray KDSoapValue::hexBinaryValue() const
+{
+    const QVariant value = this->value();
+    QByteArray result;
+    qint64 begin;
+    if (value.userType() == QVariant::ByteArray) {
+        const QByteArray text = value.toByteArray();
+        result.resize(int(KDSoapBinaryCodec::decodedBufferSize(text.size())));
+        begin = KDSoapBinaryCodec::fromHex(text.constData(), text.size(), result.data());
+    } else {
+        const QString text = value.toString();
+        result.resize(int(KDSoapBinaryCodec::decodedBufferSize(text.size())));
+        begin = KDSoapBinaryCodec::fromHex(text.utf16(), text.size(), result.data());
+    }
+    result.remove(0, int(begin));
+    return result;
+}
+
 QByteArray KDSoapValue::toXml(KDSoapValue::Use use, const QString &messageNamespace) const
 {
     QByteArray data;
-    QXmlStreamWriter writer(&data);
+    QXmlStreamWriter streamWriter(&data);
+    KDSoapQtXmlWriter writer(streamWriter);
     writer.writeStartDocument();
 
     KDSoapNamespacePrefixes namespacePrefixes;
@@ -478,3 +958,18 @@ QByteArray KDSoapValue::toXml(KDSoapValue::Use use, const QString &messageNamesp
 
     return data;
 }
+
+void KDSoapValue::writeLiteralElement(QXmlStreamWriter &writer, const QString &messageNamespace) const
+{
+    // Prefixes are only needed for xsi:type values, which aren't written with use=literal
+    KDSoapNamespacePrefixes namespacePrefixes;
+    KDSoapQtXmlWriter xmlWriter(writer);
+    writeElement(namespacePrefixes, xmlWriter, LiteralUse, messageNamespace, false);
+}
+
+void KDSoapValue::writeLiteralContents(QXmlStreamWriter &writer, const QString &messageNamespace) const
+{
+    KDSoapNamespacePrefixes namespacePrefixes;
+    KDSoapQtXmlWriter xmlWriter(writer);
+    writeElementContents(namespacePrefixes, xmlWriter, LiteralUse, messageNamespace);
+}
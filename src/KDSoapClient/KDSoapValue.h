@@ -19,6 +19,7 @@
 #include <QtCore/QVariant>
 #include <QtCore/QVector>
 #include <QtCore/QXmlStreamNamespaceDeclarations>
+#include <utility>
 
 #ifndef QT_NO_STL
 #include <algorithm>
@@ -26,7 +27,9 @@
 
 class KDSoapValueList;
 class KDSoapNamespacePrefixes;
+class KDSoapXmlWriter;
 QT_BEGIN_NAMESPACE
+class QXmlStreamReader;
 class QXmlStreamWriter;
 QT_END_NAMESPACE
 
@@ -55,6 +58,11 @@ enum SoapVersion
  * In terms of the actual XML being sent or received, this represents one XML element
  * or one XML attribute.
  * childValues() contains the child XML elements of this XML element.
+ *
+ * The messages received by KDSoapClientInterface and KDSoapServer are rejected when their
+ * elements are nested more than 1024 levels deep (since KDSoap 2.2), which protects the parser.
+ * Values built in code have no such limit, but destroying a value destroys its children
+ * recursively, so trees many thousands of levels deep can still overflow the stack.
  */
 class KDSOAP_EXPORT KDSoapValue
 {
@@ -88,12 +96,23 @@ public:
      */
     KDSoapValue(const QString &name, const KDSoapValueList &childValues, const QString &typeNameSpace = QString(),
                 const QString &typeName = QString());
+    /**
+     * Constructs a "complex" value with child values, which are moved into the value rather than copied.
+     * \since 2.2
+     */
+    KDSoapValue(const QString &name, KDSoapValueList &&childValues, const QString &typeNameSpace = QString(), const QString &typeName = QString());
 
     /**
      * Copy constructor
      */
     KDSoapValue(const KDSoapValue &other);
 
+    /**
+     * Move constructor. \p other is left empty, as if default-constructed.
+     * \since 2.2
+     */
+    KDSoapValue(KDSoapValue &&other) noexcept;
+
     /**
      * Assignment operator
      */
@@ -106,6 +125,16 @@ public:
         return *this;
     }
 
+    /**
+     * Move assignment operator. \p other gets the previous contents of this value.
+     * \since 2.2
+     */
+    KDSoapValue &operator=(KDSoapValue &&other) noexcept
+    {
+        swap(other);
+        return *this;
+    }
+
     /**
      * Swaps the contents of \a other with the contents of \c this. Never throws.
      */
@@ -251,6 +280,27 @@ public:
      */
     QXmlStreamNamespaceDeclarations environmentNamespaceDeclarations() const;
 
+    /**
+     * Returns the namespace URI bound to \p prefix where this value was parsed,
+     * or a null string if \p prefix wasn't declared.
+     * This is faster than searching through environmentNamespaceDeclarations().
+     * \since 2.2
+     */
+    QString namespaceForPrefix(const QString &prefix) const;
+
+    /**
+     * Reads the element \p reader is positioned on (a StartElement) and its child elements,
+     * the same way KDSoapClientInterface parses responses, and leaves \p reader on the matching EndElement.
+     *
+     * This is used by the deserialize(QXmlStreamReader&) methods generated by kdwsdl2cpp -pull-parsers,
+     * for the elements which are not read directly into C++ types.
+     * \param reader the XML reader
+     * \param namespaces the namespace declarations made by the ancestors of the element,
+     *        see environmentNamespaceDeclarations()
+     * \since 2.2
+     */
+    static KDSoapValue readElement(QXmlStreamReader &reader, const QXmlStreamNamespaceDeclarations &namespaces = QXmlStreamNamespaceDeclarations());
+
     /**
      * Returns the list of split values.
      * The data is split on spaces and the properties are copied.
@@ -270,6 +320,40 @@ public:
 
     QByteArray toXml(Use use = LiteralUse, const QString &messageNamespace = QString()) const;
 
+    /**
+     * Decodes the text of this value as xsd:base64Binary data.
+     * This is the same as QByteArray::fromBase64(value().toString().toLatin1()),
+     * without the intermediate copies of the text.
+     * For the values which were sent as MTOM attachments, this is the data itself.
+     * \since 2.2
+     */
+    QByteArray base64BinaryValue() const;
+
+    /**
+     * Decodes the text of this value as xsd:hexBinary data.
+     * This is the same as QByteArray::fromHex(value().toString().toLatin1()),
+     * without the intermediate copies of the text.
+     * \since 2.2
+     */
+    QByteArray hexBinaryValue() const;
+
+    /**
+     * Writes this value as an XML element into \p writer, with use=literal.
+     * \param messageNamespace the namespace of the enclosing message, for elements without a namespace
+     *
+     * This is used by the writeXml() methods generated by kdwsdl2cpp -xml-writers,
+     * for the elements which are not written directly from C++ types.
+     * \since 2.2
+     */
+    void writeLiteralElement(QXmlStreamWriter &writer, const QString &messageNamespace) const;
+
+    /**
+     * Same as writeLiteralElement(), but only writes the attributes, child elements and text of this value,
+     * into the element which \p writer just started.
+     * \since 2.2
+     */
+    void writeLiteralContents(QXmlStreamWriter &writer, const QString &messageNamespace) const;
+
 protected: // for KDSoapMessage
     void setName(const QString &name);
 
@@ -278,14 +362,30 @@ private:
     KDSoapValue(QString, QString, QString);
 
     friend class KDSoapMessageWriter;
-    void writeElement(KDSoapNamespacePrefixes &namespacePrefixes, QXmlStreamWriter &writer, KDSoapValue::Use use, const QString &messageNamespace,
+    friend class KDSoapNamespaceScope;
+    friend class KDSoapLazyElement;
+    friend class KDSoapValueArena;
+    friend class KDSoapRequestDevice;
+    friend class KDSoapMtom;
+    void writeElement(KDSoapNamespacePrefixes &namespacePrefixes, KDSoapXmlWriter &writer, KDSoapValue::Use use, const QString &messageNamespace,
                       bool forceQualified) const;
-    void writeElementContents(KDSoapNamespacePrefixes &namespacePrefixes, QXmlStreamWriter &writer, KDSoapValue::Use use,
+    void writeElementContents(KDSoapNamespacePrefixes &namespacePrefixes, KDSoapXmlWriter &writer, KDSoapValue::Use use,
                               const QString &messageNamespace) const;
-    void writeChildren(KDSoapNamespacePrefixes &namespacePrefixes, QXmlStreamWriter &writer, KDSoapValue::Use use, const QString &messageNamespace,
+    void writeChildren(KDSoapNamespacePrefixes &namespacePrefixes, KDSoapXmlWriter &writer, KDSoapValue::Use use, const QString &messageNamespace,
                        bool forceQualified) const;
+    // The pieces of writeElement(), also used by KDSoapRequestDevice to write without recursion
+    void writeStartElement(KDSoapXmlWriter &writer, const QString &messageNamespace, bool forceQualified) const;
+    void writeElementAttributes(KDSoapNamespacePrefixes &namespacePrefixes, KDSoapXmlWriter &writer, KDSoapValue::Use use) const;
+    void writeAttributes(KDSoapXmlWriter &writer, bool forceQualified) const;
+    bool writeElementText(KDSoapXmlWriter &writer, qint64 &offset, qint64 maxBytes) const;
+    // The size of the text written for binary data, without encoding it; -1 for other values
+    qint64 binaryTextSize() const;
+    // For the xop:Include elements of MTOM messages, replaced with the binary data they refer to
+    void setBinaryValue(const QByteArray &data);
 
     class Private;
+    // The empty contents shared by the values which were moved from, until they are modified
+    static const QSharedDataPointer<Private> &movedFromPrivate();
     QSharedDataPointer<Private> d;
 };
 
@@ -320,6 +420,30 @@ inline void swap<KDSoapValue>(KDSoapValue &lhs, KDSoapValue &rhs)
 class KDSOAP_EXPORT KDSoapValueList : public QList<KDSoapValue> // krazy:exclude=dpointer
 {
 public:
+    using QList<KDSoapValue>::append;
+
+    /**
+     * Appends \p value to the list, moving it rather than copying it.
+     * \since 2.2
+     */
+    void append(KDSoapValue &&value);
+
+    /**
+     * Constructs a value from \p args at the end of the list, and returns it.
+     *
+     * Equivalent to
+     * \code
+     * append(KDSoapValue(args...));
+     * \endcode
+     * \since 2.2
+     */
+    template<typename... Args>
+    KDSoapValue &emplaceBack(Args &&...args)
+    {
+        append(KDSoapValue(std::forward<Args>(args)...));
+        return last();
+    }
+
     /**
      * Convenience method for adding an argument to the list.
      *
@@ -347,6 +471,20 @@ public:
      */
     KDSoapValue child(const QString &name) const;
 
+    /**
+     * Same as child(const QString &), without converting \p name to a QString.
+     * \since 2.2
+     */
+    KDSoapValue child(QLatin1String name) const;
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    /**
+     * Same as child(const QString &), without converting \p name to a QString.
+     * \since 2.2
+     */
+    KDSoapValue child(QStringView name) const;
+#endif
+
     /**
      * Sets the type of the elements in this array.
      *
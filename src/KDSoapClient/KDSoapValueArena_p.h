@@ -0,0 +1,193 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2010-2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#ifndef KDSOAPVALUEARENA_P_H
+#define KDSOAPVALUEARENA_P_H
+
+#include "KDSoapAtomTable_p.h"
+#include "KDSoapNamespaceScope_p.h"
+#include <QtCore/QHash>
+#include <QtCore/QString>
+#include <QtCore/QVariant>
+#include <QtCore/QVector>
+
+class KDSoapValue;
+class KDSoapValueList;
+
+// Converts the text of an element to its value, for the XSD builtin types.
+// Sets *ok to false if the text isn't valid, the value is then the text itself.
+typedef QVariant (*KDSoapTextConverter)(const QString &text, bool *ok);
+
+/**
+ * \internal
+ * The elements of a parsed message in a compact form, see KDSoapMessageReader::setCompactParsing().
+ *
+ * All the elements of the message are nodes in a few arrays, rather than separately allocated
+ * KDSoapValues: the child nodes of an element are contiguous in one array, its attributes in
+ * another one, all the text is in a single string, and the names, namespaces and types are
+ * indexes into a table of atoms (see KDSoapAtomTable).
+ *
+ * A KDSoapValue is only created for a node when its parent's KDSoapValue::childValues()
+ * is called for the first time. The arena is freed, all at once, with the last value referring to it.
+ * It is immutable once the message has been parsed: modifying a value modifies the KDSoapValue only.
+ */
+class KDSoapValueArena : public QSharedData
+{
+public:
+    typedef QExplicitlySharedDataPointer<KDSoapValueArena> Ptr;
+
+    struct Node
+    {
+        int name; // atoms
+        int namespaceUri;
+        int typeNamespace;
+        int typeName;
+        int textBegin; // in m_text
+        int textLength;
+        int firstChild; // in m_children
+        int childCount;
+        int firstAttribute; // in m_attributes
+        int attributeCount;
+        int scope; // in m_scopes
+        bool declaresNamespaces; // the element has its own scope, rather than the one of its parent
+        KDSoapTextConverter converter;
+    };
+
+    struct Attribute
+    {
+        int name; // atom
+        int valueBegin; // in m_text
+        int valueLength;
+    };
+
+    KDSoapValueArena()
+        : m_checkedAtomCount(1)
+    {
+        // The null string, for the values without a namespace or a type
+        m_atoms.append(QString());
+        m_atomIndexes.insert(m_atoms.first().constData(), 0);
+    }
+
+    /**
+     * Returns the value for \p node, along with its text and namespaces.
+     * Its child values are created on demand, by materialize().
+     * Implemented in KDSoapMessageReader.cpp
+     */
+    KDSoapValue createValue(int node) const;
+
+    /**
+     * Creates the child values and the attributes of \p node, and appends them to \p children.
+     * Implemented in KDSoapMessageReader.cpp
+     */
+    void materialize(int node, KDSoapValueList &children) const;
+
+    /**
+     * Makes \p node the source of the (not yet created) child values of \p value.
+     */
+    static void attach(KDSoapValue &value, const Ptr &arena, int node);
+
+    /**
+     * Returns the index of the atom for \p str, adding it if needed.
+     * \p str must come from KDSoapAtomTable::intern(), so that the atoms can be found by data pointer.
+     */
+    int atom(const QString &str)
+    {
+        const auto it = m_atomIndexes.constFind(str.constData());
+        if (it != m_atomIndexes.constEnd()) {
+            return it.value();
+        }
+        m_atoms.append(str);
+        m_atomIndexes.insert(str.constData(), m_atoms.size() - 1);
+        return m_atoms.size() - 1;
+    }
+
+    /**
+     * Returns the index of the new \p scope.
+     */
+    int addScope(const KDSoapNamespaceScope::Ptr &scope)
+    {
+        m_scopes.append(scope);
+        return m_scopes.size() - 1;
+    }
+
+    /**
+     * Returns true if values (or other owners, like KDSoapMessageReader) still refer to the arena.
+     */
+    bool isShared() const
+    {
+        return ref.loadAcquire() != 1;
+    }
+
+    /**
+     * Removes all the nodes, keeping the memory allocated for them, so that the arena can be reused
+     * for another message. It must not be shared anymore.
+     * Only up to s_maximumKeptMemory bytes are kept per array: one large message doesn't keep
+     * its memory allocated for the lifetime of the arena.
+     * The atoms are kept too, as long as they are in the KDSoapAtomTable: they remain valid from one
+     * message to the next. The ones which aren't (the table was full) are dropped, otherwise
+     * a long-lived arena would keep every name it has seen.
+     */
+    void reset()
+    {
+        clearArray(m_nodes);
+        clearArray(m_children);
+        clearArray(m_attributes);
+        clearArray(m_text);
+        clearArray(m_scopes);
+        dropTransientAtoms();
+    }
+
+    QString text(int begin, int length) const
+    {
+        return m_text.mid(begin, length);
+    }
+
+    /**
+     * Removes the atoms added since the last reset() which aren't in the KDSoapAtomTable.
+     * Only those are looked up in the table, the ones kept before are known to be in it.
+     */
+    void dropTransientAtoms()
+    {
+        int kept = m_checkedAtomCount;
+        for (int i = m_checkedAtomCount; i < m_atoms.size(); ++i) {
+            const QString atom = m_atoms.at(i);
+            m_atomIndexes.remove(atom.constData());
+            if (KDSoapAtomTable::contains(atom)) {
+                m_atomIndexes.insert(atom.constData(), kept);
+                m_atoms[kept++] = atom;
+            }
+        }
+        m_atoms.resize(kept);
+        m_checkedAtomCount = kept;
+    }
+
+    static const int s_maximumKeptMemory = 64 * 1024;
+
+    // Keeps the buffer of \p array, unless it's larger than s_maximumKeptMemory
+    template<typename Array>
+    static void clearArray(Array &array)
+    {
+        array.resize(0); // clear() would free the buffer of a QString
+        if (qint64(array.capacity()) * qint64(sizeof(typename Array::value_type)) > s_maximumKeptMemory) {
+            array.squeeze();
+        }
+    }
+
+    QVector<Node> m_nodes;
+    QVector<int> m_children;
+    QVector<Attribute> m_attributes;
+    QString m_text;
+    QVector<QString> m_atoms; // 0 is the null string
+    QHash<const QChar *, int> m_atomIndexes;
+    int m_checkedAtomCount; // the first atoms, known to be in the KDSoapAtomTable
+    QVector<KDSoapNamespaceScope::Ptr> m_scopes;
+};
+
+#endif // KDSOAPVALUEARENA_P_H
@@ -0,0 +1,447 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2010-2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+#include "KDSoapXmlWriter_p.h"
+
+#include <QtCore/QIODevice>
+#include <cstring>
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0) && QT_CONFIG(textcodec)
+#include <QTextCodec>
+#endif
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__SSE2__)
+#define KDSOAP_SSE2
+#include <emmintrin.h>
+#endif
+
+KDSoapXmlWriter::~KDSoapXmlWriter()
+{
+}
+
+////
+
+void KDSoapQtXmlWriter::writeStartDocument()
+{
+    m_writer.writeStartDocument();
+}
+
+void KDSoapQtXmlWriter::writeEndDocument()
+{
+    m_writer.writeEndDocument();
+}
+
+void KDSoapQtXmlWriter::writeNamespace(const QString &namespaceUri, const QString &prefix)
+{
+    m_writer.writeNamespace(namespaceUri, prefix);
+}
+
+void KDSoapQtXmlWriter::writeStartElement(const QString &namespaceUri, const QString &name)
+{
+    m_writer.writeStartElement(namespaceUri, name);
+}
+
+void KDSoapQtXmlWriter::writeStartElement(const QString &qualifiedName)
+{
+    m_writer.writeStartElement(qualifiedName);
+}
+
+void KDSoapQtXmlWriter::writeAttribute(const QString &namespaceUri, const QString &name, const QString &value)
+{
+    m_writer.writeAttribute(namespaceUri, name, value);
+}
+
+void KDSoapQtXmlWriter::writeAttribute(const QString &qualifiedName, const QString &value)
+{
+    m_writer.writeAttribute(qualifiedName, value);
+}
+
+void KDSoapQtXmlWriter::writeCharacters(const QString &text)
+{
+    m_writer.writeCharacters(text);
+}
+
+void KDSoapQtXmlWriter::writeEndElement()
+{
+    m_writer.writeEndElement();
+}
+
+bool KDSoapQtXmlWriter::canWriteToDevice() const
+{
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0) && QT_CONFIG(textcodec)
+    const bool utf8 = !m_writer.codec() || m_writer.codec()->mibEnum() == 106;
+#else
+    const bool utf8 = true;
+#endif
+    return m_writer.device() && utf8 && !m_writer.hasError();
+}
+
+// The ASCII text has nothing to escape, so it can go straight into the device
+// when the writer writes UTF-8 into one.
+void KDSoapQtXmlWriter::writeAsciiCharacters(const char *data, int length)
+{
+    if (canWriteToDevice()) {
+        m_writer.writeCharacters(QString()); // ends the start tag of the element
+        m_writer.device()->write(data, length);
+    } else {
+        m_writer.writeCharacters(QString::fromLatin1(data, length));
+    }
+}
+
+void KDSoapQtXmlWriter::writeRawXml(const QByteArray &xml)
+{
+    Q_ASSERT(m_writer.device());
+    m_writer.writeCharacters(QString()); // ends the start tag of the element, before the data
+    m_writer.device()->write(xml);
+}
+
+QXmlStreamWriter *KDSoapQtXmlWriter::xmlStreamWriter()
+{
+    return &m_writer;
+}
+
+////
+
+// How many characters are converted at once, so that the room reserved for the worst case stays small
+static const int s_chunkSize = 4096;
+// The longest output for one UTF-16 code unit: "&quot;"
+static const int s_maxBytesPerChar = 6;
+
+static char *appendLatin1(char *out, const char *text, int length)
+{
+    memcpy(out, text, length);
+    return out + length;
+}
+
+// What QString::toUtf8() and the UTF-8 encoder of QXmlStreamWriter write for an unpaired surrogate
+static const QByteArray &unpairedSurrogateReplacement()
+{
+    static const QByteArray replacement = QString(QChar(ushort(0xdc00))).toUtf8();
+    return replacement;
+}
+
+#ifdef KDSOAP_SSE2
+// Converts the ASCII characters at the start of \p in which don't need any escaping, 8 at a time.
+// Returns how many were converted; the bytes written past them are overwritten afterwards.
+static int convertPlainAscii(const ushort *in, int length, char *out, bool escape)
+{
+    const __m128i controlLimit = _mm_set1_epi16(escape ? 0x20 : 0);
+    const __m128i asciiLimit = _mm_set1_epi16(0x7f);
+    const __m128i lt = _mm_set1_epi16('<');
+    const __m128i gt = _mm_set1_epi16('>');
+    const __m128i amp = _mm_set1_epi16('&');
+    const __m128i quot = _mm_set1_epi16('"');
+    int i = 0;
+    while (i + 8 <= length) {
+        const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+        // Signed comparisons: the characters from 0x8000 are negative, so below controlLimit
+        __m128i special = _mm_or_si128(_mm_cmplt_epi16(chars, controlLimit), _mm_cmpgt_epi16(chars, asciiLimit));
+        if (escape) {
+            special = _mm_or_si128(special, _mm_or_si128(_mm_cmpeq_epi16(chars, lt), _mm_cmpeq_epi16(chars, gt)));
+            special = _mm_or_si128(special, _mm_or_si128(_mm_cmpeq_epi16(chars, amp), _mm_cmpeq_epi16(chars, quot)));
+        }
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(out + i), _mm_packus_epi16(chars, chars));
+        const int mask = _mm_movemask_epi8(special);
+        if (mask != 0) {
+            return i + __builtin_ctz(uint(mask)) / 2;
+        }
+        i += 8;
+    }
+    return i;
+}
+#endif
+
+// Converts UTF-16 to UTF-8, escaping it like QXmlStreamWriter does if \p escape is true.
+// \p out must have room for s_maxBytesPerChar bytes per character.
+static char *convertToUtf8(const ushort *in, int length, char *out, bool escape, bool escapeWhitespace, bool &encodingError)
+{
+    int i = 0;
+    while (i < length) {
+#ifdef KDSOAP_SSE2
+        const int plain = convertPlainAscii(in + i, length - i, out, escape);
+        i += plain;
+        out += plain;
+        if (i == length) {
+            break;
+        }
+#endif
+        const ushort ch = in[i++];
+        if (ch < 0x80) {
+            if (!escape) {
+                *out++ = char(ch);
+                continue;
+            }
+            switch (ch) {
+            case '<':
+                out = appendLatin1(out, "&lt;", 4);
+                break;
+            case '>':
+                out = appendLatin1(out, "&gt;", 4);
+                break;
+            case '&':
+                out = appendLatin1(out, "&amp;", 5);
+                break;
+            case '"':
+                out = appendLatin1(out, "&quot;", 6);
+                break;
+            case '\t':
+                out = escapeWhitespace ? appendLatin1(out, "&#9;", 4) : appendLatin1(out, "\t", 1);
+                break;
+            case '\n':
+                out = escapeWhitespace ? appendLatin1(out, "&#10;", 5) : appendLatin1(out, "\n", 1);
+                break;
+            case '\r':
+                out = escapeWhitespace ? appendLatin1(out, "&#13;", 5) : appendLatin1(out, "\r", 1);
+                break;
+            default:
+                if (ch < 0x20) {
+                    encodingError = true; // not allowed in XML 1.0, left out
+                } else {
+                    *out++ = char(ch);
+                }
+                break;
+            }
+        } else if (ch < 0x800) {
+            *out++ = char(0xc0 | (ch >> 6));
+            *out++ = char(0x80 | (ch & 0x3f));
+        } else if (ch >= 0xd800 && ch < 0xe000) {
+            if (ch < 0xdc00 && i < length && in[i] >= 0xdc00 && in[i] < 0xe000) {
+                const uint ucs4 = 0x10000 + ((uint(ch) - 0xd800) << 10) + (uint(in[i++]) - 0xdc00);
+                *out++ = char(0xf0 | (ucs4 >> 18));
+                *out++ = char(0x80 | ((ucs4 >> 12) & 0x3f));
+                *out++ = char(0x80 | ((ucs4 >> 6) & 0x3f));
+                *out++ = char(0x80 | (ucs4 & 0x3f));
+            } else {
+                const QByteArray &replacement = unpairedSurrogateReplacement();
+                out = appendLatin1(out, replacement.constData(), replacement.size());
+            }
+        } else if (escape && ch >= 0xfffe) {
+            encodingError = true;
+        } else {
+            *out++ = char(0xe0 | (ch >> 12));
+            *out++ = char(0x80 | ((ch >> 6) & 0x3f));
+            *out++ = char(0x80 | (ch & 0x3f));
+        }
+    }
+    return out;
+}
+
+KDSoapUtf8XmlWriter::KDSoapUtf8XmlWriter(QByteArray *data)
+    : m_data(data)
+    , m_lastNamespaceDeclaration(0)
+    , m_namespacePrefixCount(0)
+    , m_inStartElement(false)
+    , m_hasEncodingError(false)
+{
+}
+
+void KDSoapUtf8XmlWriter::write(const char *data, int length)
+{
+    m_data->append(data, length);
+}
+
+void KDSoapUtf8XmlWriter::write(const QString &text, Escaping escaping)
+{
+    const ushort *in = reinterpret_cast<const ushort *>(text.constData());
+    int remaining = text.size();
+    while (remaining > 0) {
+        int length = qMin(remaining, s_chunkSize);
+        if (length < remaining && in[length - 1] >= 0xd800 && in[length - 1] < 0xdc00) {
+            --length; // keep surrogate pairs together
+        }
+        const int oldSize = m_data->size();
+        m_data->resize(oldSize + s_maxBytesPerChar * length);
+        char *begin = m_data->data() + oldSize;
+        const char *end = convertToUtf8(in, length, begin, escaping != NoEscaping, escaping == AttributeEscaping, m_hasEncodingError);
+        m_data->resize(oldSize + int(end - begin));
+        in += length;
+        remaining -= length;
+    }
+}
+
+// The following is the logic of QXmlStreamWriterPrivate, minus the auto-formatting.
+
+const KDSoapUtf8XmlWriter::NamespaceDeclaration &KDSoapUtf8XmlWriter::findNamespace(const QString &namespaceUri, bool writeDeclaration,
+                                                                                    bool noDefault)
+{
+    for (int j = m_namespaceDeclarations.size() - 1; j >= 0; --j) {
+        const NamespaceDeclaration &declaration = m_namespaceDeclarations.at(j);
+        if (declaration.namespaceUri == namespaceUri && (!noDefault || !declaration.prefix.isEmpty())) {
+            return declaration;
+        }
+    }
+    if (namespaceUri.isEmpty()) {
+        return m_emptyNamespace;
+    }
+    // Make up a prefix, which isn't declared yet
+    QString prefix;
+    int n = ++m_namespacePrefixCount;
+    for (;;) {
+        prefix = QLatin1Char('n') + QString::number(n++);
+        int j = m_namespaceDeclarations.size() - 1;
+        while (j >= 0 && m_namespaceDeclarations.at(j).prefix != prefix) {
+            --j;
+        }
+        if (j < 0) {
+            break;
+        }
+    }
+    const NamespaceDeclaration declaration = {prefix, namespaceUri};
+    m_namespaceDeclarations.append(declaration);
+    if (writeDeclaration) {
+        writeNamespaceDeclaration(declaration);
+    }
+    return m_namespaceDeclarations.last();
+}
+
+void KDSoapUtf8XmlWriter::writeNamespaceDeclaration(const NamespaceDeclaration &declaration)
+{
+    if (declaration.prefix.isEmpty()) {
+        write(" xmlns=\"", 8);
+    } else {
+        write(" xmlns:", 7);
+        write(declaration.prefix);
+        write("=\"", 2);
+    }
+    write(declaration.namespaceUri); // not escaped, like QXmlStreamWriter
+    write("\"", 1);
+}
+
+void KDSoapUtf8XmlWriter::finishStartElement()
+{
+    if (!m_inStartElement) {
+        return;
+    }
+    write(">", 1);
+    m_inStartElement = false;
+    m_lastNamespaceDeclaration = m_namespaceDeclarations.size();
+}
+
+void KDSoapUtf8XmlWriter::writeStartDocument()
+{
+    finishStartElement();
+    static const char prolog[] = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>";
+    write(prolog, sizeof(prolog) - 1);
+}
+
+void KDSoapUtf8XmlWriter::writeEndDocument()
+{
+    while (!m_tags.isEmpty()) {
+        writeEndElement();
+    }
+    write("\n", 1);
+}
+
+void KDSoapUtf8XmlWriter::writeNamespace(const QString &namespaceUri, const QString &prefix)
+{
+    if (prefix.isEmpty()) {
+        findNamespace(namespaceUri, m_inStartElement, false);
+    } else {
+        const NamespaceDeclaration declaration = {prefix, namespaceUri};
+        m_namespaceDeclarations.append(declaration);
+        if (m_inStartElement) {
+            writeNamespaceDeclaration(declaration);
+        }
+    }
+}
+
+void KDSoapUtf8XmlWriter::writeStartElement(const QString &namespaceUri, const QString &name)
+{
+    finishStartElement();
+    const Tag tag = {findNamespace(namespaceUri, false, false).prefix, name, m_lastNamespaceDeclaration};
+    m_tags.append(tag);
+    write("<", 1);
+    if (!tag.prefix.isEmpty()) {
+        write(tag.prefix);
+        write(":", 1);
+    }
+    write(name);
+    m_inStartElement = true;
+    // The namespaces declared before the element, and the one of the element if it's new
+    for (int i = m_lastNamespaceDeclaration; i < m_namespaceDeclarations.size(); ++i) {
+        writeNamespaceDeclaration(m_namespaceDeclarations.at(i));
+    }
+}
+
+void KDSoapUtf8XmlWriter::writeStartElement(const QString &qualifiedName)
+{
+    writeStartElement(QString(), qualifiedName);
+}
+
+void KDSoapUtf8XmlWriter::writeAttribute(const QString &namespaceUri, const QString &name, const QString &value)
+{
+    Q_ASSERT(m_inStartElement);
+    const QString prefix = findNamespace(namespaceUri, true, true).prefix;
+    write(" ", 1);
+    if (!prefix.isEmpty()) {
+        write(prefix);
+        write(":", 1);
+    }
+    write(name);
+    write("=\"", 2);
+    write(value, AttributeEscaping);
+    write("\"", 1);
+}
+
+void KDSoapUtf8XmlWriter::writeAttribute(const QString &qualifiedName, const QString &value)
+{
+    Q_ASSERT(m_inStartElement);
+    write(" ", 1);
+    write(qualifiedName);
+    write("=\"", 2);
+    write(value, AttributeEscaping);
+    write("\"", 1);
+}
+
+void KDSoapUtf8XmlWriter::writeCharacters(const QString &text)
+{
+    finishStartElement();
+    write(text, TextEscaping);
+}
+
+void KDSoapUtf8XmlWriter::writeEndElement()
+{
+    if (m_tags.isEmpty()) {
+        return;
+    }
+    const Tag tag = m_tags.takeLast();
+    if (m_inStartElement) {
+        // Nothing was written, close as an empty element.
+        // Like QXmlStreamWriter, this keeps the namespaces declared by the element in the list.
+        write("/>", 2);
+        m_inStartElement = false;
+        m_lastNamespaceDeclaration = tag.namespaceDeclarationsSize;
+        return;
+    }
+    m_lastNamespaceDeclaration = tag.namespaceDeclarationsSize;
+    m_namespaceDeclarations.resize(m_lastNamespaceDeclaration);
+    write("</", 2);
+    if (!tag.prefix.isEmpty()) {
+        write(tag.prefix);
+        write(":", 1);
+    }
+    write(tag.name);
+    write(">", 1);
+}
+
+void KDSoapUtf8XmlWriter::writeAsciiCharacters(const char *data, int length)
+{
+    finishStartElement();
+    write(data, length);
+}
+
+void KDSoapUtf8XmlWriter::writeRawXml(const QByteArray &xml)
+{
+    finishStartElement();
+    m_data->append(xml);
+}
+
+QXmlStreamWriter *KDSoapUtf8XmlWriter::xmlStreamWriter()
+{
+    return nullptr;
+}
@@ -0,0 +1,164 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2010-2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#ifndef KDSOAPXMLWRITER_P_H
+#define KDSOAPXMLWRITER_P_H
+
+#include "KDSoapGlobal.h"
+#include <QtCore/QByteArray>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+#include <QtCore/QXmlStreamWriter>
+
+class KDSoapMtomAttachments;
+
+/**
+ * \internal
+ * The part of the QXmlStreamWriter API used to serialize messages, so that they
+ * can be written either with QXmlStreamWriter or with KDSoapUtf8XmlWriter.
+ */
+class KDSOAP_EXPORT KDSoapXmlWriter
+{
+public:
+    virtual ~KDSoapXmlWriter();
+
+    virtual void writeStartDocument() = 0;
+    virtual void writeEndDocument() = 0;
+    virtual void writeNamespace(const QString &namespaceUri, const QString &prefix) = 0;
+    virtual void writeStartElement(const QString &namespaceUri, const QString &name) = 0;
+    virtual void writeStartElement(const QString &qualifiedName) = 0;
+    virtual void writeAttribute(const QString &namespaceUri, const QString &name, const QString &value) = 0;
+    virtual void writeAttribute(const QString &qualifiedName, const QString &value) = 0;
+    virtual void writeCharacters(const QString &text) = 0;
+    virtual void writeEndElement() = 0;
+
+    /// Writes ASCII text which doesn't need escaping, such as formatted numbers or base64
+    virtual void writeAsciiCharacters(const char *data, int length) = 0;
+    /// Writes UTF-8 XML serialized beforehand, as the contents of the current element
+    virtual void writeRawXml(const QByteArray &xml) = 0;
+
+    /// The QXmlStreamWriter behind this writer, for the code which needs one, or nullptr
+    virtual QXmlStreamWriter *xmlStreamWriter() = 0;
+
+    /// Where binary values go when writing an MTOM message, rather than inline as base64, see KDSoapMtom
+    void setMtomAttachments(KDSoapMtomAttachments *attachments)
+    {
+        m_mtomAttachments = attachments;
+    }
+    KDSoapMtomAttachments *mtomAttachments() const
+    {
+        return m_mtomAttachments;
+    }
+
+private:
+    KDSoapMtomAttachments *m_mtomAttachments = nullptr;
+};
+
+/**
+ * \internal
+ * KDSoapXmlWriter on top of a QXmlStreamWriter, the default.
+ */
+class KDSOAP_EXPORT KDSoapQtXmlWriter : public KDSoapXmlWriter
+{
+public:
+    explicit KDSoapQtXmlWriter(QXmlStreamWriter &writer)
+        : m_writer(writer)
+    {
+    }
+
+    void writeStartDocument() override;
+    void writeEndDocument() override;
+    void writeNamespace(const QString &namespaceUri, const QString &prefix) override;
+    void writeStartElement(const QString &namespaceUri, const QString &name) override;
+    void writeStartElement(const QString &qualifiedName) override;
+    void writeAttribute(const QString &namespaceUri, const QString &name, const QString &value) override;
+    void writeAttribute(const QString &qualifiedName, const QString &value) override;
+    void writeCharacters(const QString &text) override;
+    void writeEndElement() override;
+    void writeAsciiCharacters(const char *data, int length) override;
+    void writeRawXml(const QByteArray &xml) override;
+    QXmlStreamWriter *xmlStreamWriter() override;
+
+private:
+    // Whether bytes can go straight into the device of the writer
+    bool canWriteToDevice() const;
+
+    QXmlStreamWriter &m_writer;
+};
+
+/**
+ * \internal
+ * KDSoapXmlWriter appending UTF-8 to a QByteArray directly, with vectorized escaping of the text.
+ *
+ * The namespace bookkeeping (the declarations in scope, and the n1, n2... prefixes made up
+ * for namespaces written without a prefix) is the same as the one of QXmlStreamWriter,
+ * so that the prefixes which KDSoapNamespacePrefixes records for xsi:type values are the
+ * same, and so that the output is the same, byte for byte, as with KDSoapQtXmlWriter.
+ */
+class KDSOAP_EXPORT KDSoapUtf8XmlWriter : public KDSoapXmlWriter
+{
+public:
+    explicit KDSoapUtf8XmlWriter(QByteArray *data);
+
+    void writeStartDocument() override;
+    void writeEndDocument() override;
+    void writeNamespace(const QString &namespaceUri, const QString &prefix) override;
+    void writeStartElement(const QString &namespaceUri, const QString &name) override;
+    void writeStartElement(const QString &qualifiedName) override;
+    void writeAttribute(const QString &namespaceUri, const QString &name, const QString &value) override;
+    void writeAttribute(const QString &qualifiedName, const QString &value) override;
+    void writeCharacters(const QString &text) override;
+    void writeEndElement() override;
+    void writeAsciiCharacters(const char *data, int length) override;
+    void writeRawXml(const QByteArray &xml) override;
+    QXmlStreamWriter *xmlStreamWriter() override;
+
+    /// True if characters which can't be written in XML 1.0 were left out, like QXmlStreamWriter::hasError()
+    bool hasError() const
+    {
+        return m_hasEncodingError;
+    }
+
+private:
+    struct NamespaceDeclaration
+    {
+        QString prefix;
+        QString namespaceUri;
+    };
+    struct Tag
+    {
+        QString prefix;
+        QString name;
+        int namespaceDeclarationsSize;
+    };
+    enum Escaping
+    {
+        NoEscaping,
+        TextEscaping,
+        AttributeEscaping
+    };
+
+    const NamespaceDeclaration &findNamespace(const QString &namespaceUri, bool writeDeclaration, bool noDefault);
+    void writeNamespaceDeclaration(const NamespaceDeclaration &declaration);
+    void finishStartElement();
+    void write(const char *data, int length);
+    void write(const QString &text, Escaping escaping = NoEscaping);
+
+    QByteArray *m_data;
+    QVector<NamespaceDeclaration> m_namespaceDeclarations;
+    QVector<Tag> m_tags;
+    NamespaceDeclaration m_emptyNamespace;
+    int m_lastNamespaceDeclaration;
+    int m_namespacePrefixCount;
+    bool m_inStartElement;
+    bool m_hasEncodingError;
+};
+
+#endif // KDSOAPXMLWRITER_P_H
@@ -18,10 +18,13 @@ class KDSoapDelayedResponseHandleData : public QSharedData
 public:
     KDSoapDelayedResponseHandleData(KDSoapServerSocket *s)
         : socket(s)
+        , requestId(-1)
     {
     }
     // QPointer in case the client disconnects during a delayed response
     QPointer<KDSoapServerSocket> socket;
+    // The request to respond to, the socket might have received others since then (HTTP pipelining)
+    int requestId;
 };
 
 KDSoapDelayedResponseHandle::KDSoapDelayedResponseHandle()
@@ -49,10 +52,15 @@ KDSoapDelayedResponseHandle::~KDSoapDelayedResponseHandle()
 KDSoapDelayedResponseHandle::KDSoapDelayedResponseHandle(KDSoapServerSocket *socket)
     : data(new KDSoapDelayedResponseHandleData(socket))
 {
-    socket->setResponseDelayed();
+    data->requestId = socket->setResponseDelayed();
 }
 
 KDSoapServerSocket *KDSoapDelayedResponseHandle::serverSocket() const
 {
     return data->socket;
 }
+
+int KDSoapDelayedResponseHandle::requestId() const
+{
+    return data->requestId;
+}
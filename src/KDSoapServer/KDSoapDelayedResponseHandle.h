@@ -38,6 +38,7 @@ private:
     friend class KDSoapServerObjectInterface;
     explicit KDSoapDelayedResponseHandle(KDSoapServerSocket *socket);
     KDSoapServerSocket *serverSocket() const;
+    int requestId() const;
     QSharedDataPointer<KDSoapDelayedResponseHandleData> data;
 };
 
@@ -0,0 +1,175 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2010-2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+#include "KDSoapHttpHeaderView_p.h"
+#include <QDebug>
+#include <QDir>
+
+#include <climits>
+#include <cstring>
+
+// Same order as KDSoapHttpHeaderView::Header
+static const char *const s_headerNames[] = {"content-length", "content-type",     "soapaction",     "transfer-encoding",
+                                             "authorization",  "content-encoding", "accept-encoding"};
+
+static bool isSpace(char ch)
+{
+    return ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n';
+}
+
+static bool equalsIgnoreCase(const char *data, int length, const char *str)
+{
+    return int(qstrlen(str)) == length && qstrnicmp(data, str, uint(length)) == 0;
+}
+
+KDSoapHttpHeaderView::KDSoapHttpHeaderView()
+{
+    // With Qt 5, this also makes resize(0) keep the memory
+    m_data.reserve(512);
+    clear();
+}
+
+void KDSoapHttpHeaderView::clear()
+{
+    m_data.resize(0);
+    m_valid = false;
+    m_requestType = m_target = m_httpVersion = Range {-1, 0};
+    for (Range &header : m_headers) {
+        header = Range {-1, 0};
+    }
+    m_fields.clear();
+    m_map.clear();
+    m_mapBuilt = false;
+}
+
+bool KDSoapHttpHeaderView::parse(const char *data, int size)
+{
+    clear();
+    m_data.append(data, size);
+    const char *begin = m_data.constData();
+    const char *end = begin + size;
+
+    // The first line is special, it's the GET or POST line: "method target version"
+    const char *lineEnd = static_cast<const char *>(memchr(begin, '\n', size));
+    if (!lineEnd) {
+        lineEnd = end;
+    }
+    const char *space1 = static_cast<const char *>(memchr(begin, ' ', lineEnd - begin));
+    const char *space2 = space1 ? static_cast<const char *>(memchr(space1 + 1, ' ', lineEnd - space1 - 1)) : nullptr;
+    if (!space2) {
+        qDebug() << "Malformed HTTP request:" << QByteArray(begin, int(lineEnd - begin));
+        return false;
+    }
+    const char *versionEnd = space2 + 1;
+    while (versionEnd < lineEnd && !isSpace(*versionEnd)) {
+        ++versionEnd;
+    }
+    m_requestType = Range {0, int(space1 - begin)};
+    m_target = Range {int(space1 + 1 - begin), int(space2 - space1 - 1)};
+    m_httpVersion = Range {int(space2 + 1 - begin), int(versionEnd - space2 - 1)};
+    m_valid = true;
+
+    for (const char *line = lineEnd + 1; line < end; line = lineEnd + 1) {
+        lineEnd = static_cast<const char *>(memchr(line, '\n', end - line));
+        if (!lineEnd) {
+            lineEnd = end;
+        }
+        const char *colon = static_cast<const char *>(memchr(line, ':', lineEnd - line));
+        if (!colon) {
+            qDebug() << "Malformed HTTP header:" << QByteArray(line, int(lineEnd - line));
+            continue;
+        }
+        // remove space before and \r\n after
+        const char *valueBegin = colon + 1;
+        const char *valueEnd = lineEnd;
+        while (valueBegin < valueEnd && isSpace(*valueBegin)) {
+            ++valueBegin;
+        }
+        while (valueEnd > valueBegin && isSpace(valueEnd[-1])) {
+            --valueEnd;
+        }
+        const Field field = {Range {int(line - begin), int(colon - line)}, Range {int(valueBegin - begin), int(valueEnd - valueBegin)}};
+        m_fields.append(field);
+        // RFC2616 section 4.2 "Field names are case-insensitive"
+        for (int header = 0; header < HeaderCount; ++header) {
+            if (equalsIgnoreCase(line, field.name.length, s_headerNames[header])) {
+                m_headers[header] = field.value; // the last one wins
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+QByteArray KDSoapHttpHeaderView::path() const
+{
+    // Grammar from https://datatracker.ietf.org/doc/html/rfc7230#section-5.3.1
+    //  origin-form    = absolute-path [ "?" query ]
+    // and https://datatracker.ietf.org/doc/html/rfc3986#section-3.3
+    // says the path ends at the first '?' or '#' character
+    const QByteArray target = range(m_target);
+    const int queryPos = target.indexOf('?');
+    const QByteArray path = queryPos >= 0 ? target.left(queryPos) : target;
+    const QByteArray query = queryPos >= 0 ? target.mid(queryPos) : QByteArray();
+    // Unfortunately QDir::cleanPath works with QString
+    const QByteArray cleanedPath = QDir::cleanPath(QString::fromUtf8(path)).toUtf8();
+    return cleanedPath + query;
+}
+
+bool KDSoapHttpHeaderView::valueEquals(Header header, const char *str) const
+{
+    const Range &r = m_headers[header];
+    return r.begin >= 0 && equalsIgnoreCase(m_data.constData() + r.begin, r.length, str);
+}
+
+int KDSoapHttpHeaderView::contentLength() const
+{
+    const Range &r = m_headers[ContentLength];
+    if (r.begin < 0 || r.length == 0) {
+        return 0;
+    }
+    qint64 length = 0;
+    for (const char *ch = m_data.constData() + r.begin, *end = ch + r.length; ch != end; ++ch) {
+        if (*ch < '0' || *ch > '9') {
+            return 0;
+        }
+        length = length * 10 + (*ch - '0');
+        if (length > INT_MAX) {
+            return 0;
+        }
+    }
+    return int(length);
+}
+
+QByteArray KDSoapHttpHeaderView::value(const char *name) const
+{
+    for (int i = m_fields.size() - 1; i >= 0; --i) {
+        const Field &field = m_fields.at(i);
+        if (equalsIgnoreCase(m_data.constData() + field.name.begin, field.name.length, name)) {
+            return range(field.value);
+        }
+    }
+    return QByteArray();
+}
+
+const QMap<QByteArray, QByteArray> &KDSoapHttpHeaderView::toMap() const
+{
+    if (!m_mapBuilt) {
+        m_mapBuilt = true;
+        if (m_valid) {
+            m_map.insert("_requestType", requestType());
+            m_map.insert("_path", path());
+            m_map.insert("_httpVersion", httpVersion());
+            for (const Field &field : m_fields) {
+                m_map.insert(range(field.name).toLower(), range(field.value));
+            }
+        }
+    }
+    return m_map;
+}
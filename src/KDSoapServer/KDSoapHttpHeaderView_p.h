@@ -0,0 +1,129 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2010-2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+#ifndef KDSOAPHTTPHEADERVIEW_P_H
+#define KDSOAPHTTPHEADERVIEW_P_H
+
+#include "KDSoapServerGlobal.h"
+#include <QtCore/QByteArray>
+#include <QtCore/QMap>
+#include <QtCore/QVarLengthArray>
+
+/**
+ * \internal
+ * The request line and the headers of an HTTP request, as positions in the received header block.
+ *
+ * Parsing doesn't allocate, once the buffers have grown to the size of the requests: the names
+ * aren't lowercased, lookups are case-insensitive instead, and the headers used by KDSoapServerSocket
+ * are found once, while parsing. Only the values which are asked for are copied.
+ * The QMap of the public interfaces (KDSoapServerRawXMLInterface, KDSoapServerCustomVerbRequestInterface)
+ * is built by toMap(), when one of them is used.
+ */
+class KDSOAPSERVER_EXPORT KDSoapHttpHeaderView
+{
+public:
+    enum Header
+    {
+        ContentLength,
+        ContentType,
+        SoapAction,
+        TransferEncoding,
+        Authorization,
+        ContentEncoding,
+        AcceptEncoding,
+        HeaderCount
+    };
+
+    KDSoapHttpHeaderView();
+
+    /**
+     * Parses the header block of a request, without the empty line that ends it.
+     * The data is copied, so it doesn't need to remain valid.
+     * Returns false if the request line is malformed: there are no headers then.
+     */
+    bool parse(const char *data, int size);
+    void clear();
+
+    bool isValid() const
+    {
+        return m_valid;
+    }
+
+    // The request line
+    QByteArray requestType() const
+    {
+        return range(m_requestType);
+    }
+    QByteArray httpVersion() const
+    {
+        return range(m_httpVersion);
+    }
+    /**
+     * The path of the request, cleaned up (no "..", see QDir::cleanPath), followed by the query if any.
+     */
+    QByteArray path() const;
+
+    bool contains(Header header) const
+    {
+        return m_headers[header].begin >= 0;
+    }
+    QByteArray value(Header header) const
+    {
+        return range(m_headers[header]);
+    }
+    /**
+     * Case-insensitive comparison of the value of \p header with \p str, without copying the value.
+     */
+    bool valueEquals(Header header, const char *str) const;
+    /**
+     * The Content-Length, 0 if there's none or if it's invalid.
+     */
+    int contentLength() const;
+
+    /**
+     * Returns the value of the header called \p name (case-insensitive), for the ones without a Header.
+     * The last one wins if there are several.
+     */
+    QByteArray value(const char *name) const;
+
+    /**
+     * The headers as a map, with lowercase names, and the pseudo-headers "_requestType",
+     * "_path" and "_httpVersion" for the request line. Built on first use.
+     */
+    const QMap<QByteArray, QByteArray> &toMap() const;
+
+private:
+    struct Range
+    {
+        int begin;
+        int length;
+    };
+    struct Field
+    {
+        Range name;
+        Range value;
+    };
+
+    QByteArray range(const Range &r) const
+    {
+        return r.begin < 0 ? QByteArray() : m_data.mid(r.begin, r.length);
+    }
+
+    QByteArray m_data;
+    bool m_valid;
+    Range m_requestType;
+    Range m_target;
+    Range m_httpVersion;
+    Range m_headers[HeaderCount];
+    QVarLengthArray<Field, 32> m_fields;
+    mutable QMap<QByteArray, QByteArray> m_map;
+    mutable bool m_mapBuilt;
+};
+
+#endif // KDSOAPHTTPHEADERVIEW_P_H
@@ -0,0 +1,229 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2010-2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+#include "KDSoapHttpRequestParser_p.h"
+#include <cstring>
+
+static const int s_initialBufferSize = 2048;
+// The memory reserved upfront for a body, whatever its Content-Length says: the rest is allocated as it arrives.
+// The Content-Length comes from the client, which doesn't have to send the body.
+static const int s_maximumBodyReservation = 64 * 1024;
+
+KDSoapHttpRequestParser::KDSoapHttpRequestParser()
+    : m_state(ReadingHeaders)
+    , m_chunked(false)
+    , m_writingBody(false)
+    , m_writeStart(0)
+    , m_pos(0)
+    , m_scanPos(0)
+    , m_remaining(0)
+{
+    // With Qt 5, this also makes resize(0) keep the memory
+    m_buffer.reserve(s_initialBufferSize);
+}
+
+char *KDSoapHttpRequestParser::prepareWrite(int size)
+{
+    // Once everything before the body is parsed, the data goes straight into the body
+    m_writingBody = m_state == ReadingBody && m_pos == m_buffer.size();
+    QByteArray &target = m_writingBody ? m_body : m_buffer;
+    m_writeStart = target.size();
+    target.resize(m_writeStart + size);
+    return target.data() + m_writeStart;
+}
+
+void KDSoapHttpRequestParser::commit(int size)
+{
+    if (!m_writingBody) {
+        m_buffer.resize(m_writeStart + size);
+        process();
+        return;
+    }
+    m_writingBody = false;
+    const int bodySize = qMin(size, m_remaining);
+    if (size > bodySize) {
+        // Already the next request
+        m_buffer.append(m_body.constData() + m_writeStart + bodySize, size - bodySize);
+    }
+    m_body.resize(m_writeStart + bodySize);
+    m_remaining -= bodySize;
+    if (m_remaining == 0) {
+        m_state = Done;
+    }
+}
+
+void KDSoapHttpRequestParser::addData(const char *data, int size)
+{
+    if (size > 0) {
+        memcpy(prepareWrite(size), data, size);
+        commit(size);
+    }
+}
+
+void KDSoapHttpRequestParser::reset()
+{
+    m_state = ReadingHeaders;
+    m_chunked = false;
+    m_writingBody = false;
+    m_buffer.resize(0);
+    m_pos = 0;
+    m_scanPos = 0;
+    m_remaining = 0;
+    m_headers.clear();
+    m_body.clear();
+}
+
+void KDSoapHttpRequestParser::startNextRequest()
+{
+    m_state = ReadingHeaders;
+    m_chunked = false;
+    m_writingBody = false;
+    m_scanPos = m_pos;
+    m_remaining = 0;
+    m_headers.clear();
+    m_body.clear();
+    process();
+}
+
+// Looks for the end of the line starting at m_pos, from where the previous call stopped
+bool KDSoapHttpRequestParser::findLine(int *lineEnd)
+{
+    const int eol = m_buffer.indexOf("\r\n", m_scanPos);
+    if (eol == -1) {
+        m_scanPos = qMax(m_pos, m_buffer.size() - 1); // the \r might be the last byte received
+        return false;
+    }
+    *lineEnd = eol;
+    return true;
+}
+
+void KDSoapHttpRequestParser::startBody()
+{
+    m_scanPos = m_pos;
+    m_chunked = m_headers.valueEquals(KDSoapHttpHeaderView::TransferEncoding, "chunked");
+    if (m_chunked) {
+        m_state = ReadingChunkSize;
+        return;
+    }
+    const int contentLength = m_headers.contentLength();
+    if (contentLength <= 0) {
+        m_state = Done;
+        return;
+    }
+    m_body.reserve(qMin(contentLength, s_maximumBodyReservation));
+    m_remaining = contentLength;
+    m_state = ReadingBody;
+}
+
+// Moves up to maxSize bytes of body data from m_buffer to m_body
+int KDSoapHttpRequestParser::takeBodyData(int maxSize)
+{
+    const int size = qMin(maxSize, m_buffer.size() - m_pos);
+    m_body.append(m_buffer.constData() + m_pos, size);
+    m_pos += size;
+    m_remaining -= size;
+    return size;
+}
+
+void KDSoapHttpRequestParser::process()
+{
+    bool needMoreData = false;
+    while (!needMoreData) {
+        switch (m_state) {
+        case ReadingHeaders: {
+            const int end = m_buffer.indexOf("\r\n\r\n", m_scanPos);
+            if (end == -1) {
+                m_scanPos = qMax(m_pos, m_buffer.size() - 3); // the separator might be split over several reads
+                needMoreData = true;
+                break;
+            }
+            m_headers.parse(m_buffer.constData() + m_pos, end - m_pos);
+            m_pos = end + 4;
+            startBody();
+            break;
+        }
+        case ReadingBody:
+        case ReadingChunkData:
+            if (takeBodyData(m_remaining) == 0) {
+                needMoreData = true;
+            } else if (m_remaining == 0) {
+                m_state = m_state == ReadingBody ? Done : ReadingChunkEnd;
+            }
+            break;
+        case ReadingChunkEnd:
+            if (m_buffer.size() - m_pos < 2) {
+                needMoreData = true;
+            } else if (m_buffer.at(m_pos) != '\r' || m_buffer.at(m_pos + 1) != '\n') {
+                m_state = Error;
+            } else {
+                m_pos += 2;
+                m_scanPos = m_pos;
+                m_state = ReadingChunkSize;
+            }
+            break;
+        case ReadingChunkSize: {
+            int lineEnd;
+            if (!findLine(&lineEnd)) {
+                needMoreData = true;
+                break;
+            }
+            QByteArray chunkSizeStr = QByteArray::fromRawData(m_buffer.constData() + m_pos, lineEnd - m_pos);
+            const int extensionPos = chunkSizeStr.indexOf(';'); // chunk extensions are ignored
+            if (extensionPos >= 0) {
+                chunkSizeStr = chunkSizeStr.left(extensionPos);
+            }
+            bool ok;
+            const int chunkSize = chunkSizeStr.trimmed().toInt(&ok, 16);
+            if (!ok || chunkSize < 0) {
+                m_state = Error;
+                break;
+            }
+            m_pos = lineEnd + 2;
+            m_scanPos = m_pos;
+            if (chunkSize == 0) {
+                m_state = ReadingTrailers;
+            } else {
+                m_remaining = chunkSize;
+                m_state = ReadingChunkData;
+            }
+            break;
+        }
+        case ReadingTrailers: {
+            // Ignored, up to the empty line
+            int lineEnd;
+            if (!findLine(&lineEnd)) {
+                needMoreData = true;
+                break;
+            }
+            const bool emptyLine = lineEnd == m_pos;
+            m_pos = lineEnd + 2;
+            m_scanPos = m_pos;
+            if (emptyLine) {
+                m_state = Done;
+            }
+            break;
+        }
+        case Done:
+        case Error:
+            needMoreData = true;
+            break;
+        }
+    }
+
+    // Drop what was parsed, without moving the data around on every call
+    if (m_pos == m_buffer.size()) {
+        m_buffer.resize(0);
+        m_pos = 0;
+        m_scanPos = 0;
+    } else if (m_pos > s_initialBufferSize && m_pos > m_buffer.size() / 2) {
+        m_buffer.remove(0, m_pos);
+        m_scanPos -= m_pos;
+        m_pos = 0;
+    }
+}
@@ -0,0 +1,122 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2010-2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+#ifndef KDSOAPHTTPREQUESTPARSER_P_H
+#define KDSOAPHTTPREQUESTPARSER_P_H
+
+#include "KDSoapHttpHeaderView_p.h"
+#include "KDSoapServerGlobal.h"
+#include <QtCore/QByteArray>
+
+/**
+ * \internal
+ * Incremental parser for the HTTP/1.1 requests received by KDSoapServerSocket.
+ *
+ * The data is parsed as it arrives, remembering where the previous call stopped, so that
+ * a request received in many small pieces is still parsed in linear time.
+ * The body of a request with a Content-Length is read directly into its final buffer:
+ * call prepareWrite() for a buffer of the size of the available data, fill it, then call commit().
+ */
+class KDSOAPSERVER_EXPORT KDSoapHttpRequestParser
+{
+public:
+    enum State
+    {
+        ReadingHeaders,
+        ReadingBody, // with a Content-Length
+        ReadingChunkSize,
+        ReadingChunkData,
+        ReadingChunkEnd, // the CRLF after the data of a chunk
+        ReadingTrailers,
+        Done,
+        Error // malformed chunked encoding
+    };
+
+    KDSoapHttpRequestParser();
+
+    /**
+     * Returns a buffer where the next \p size bytes received must be written.
+     * Call commit() with the number of bytes actually written, before any other method.
+     */
+    char *prepareWrite(int size);
+    /**
+     * Parses the \p size bytes written into the buffer returned by prepareWrite().
+     */
+    void commit(int size);
+    /**
+     * Parses \p size bytes from \p data. Same as prepareWrite(), memcpy and commit().
+     */
+    void addData(const char *data, int size);
+
+    State state() const
+    {
+        return m_state;
+    }
+    bool headersComplete() const
+    {
+        return m_state != ReadingHeaders;
+    }
+    bool isChunked() const
+    {
+        return m_chunked;
+    }
+    /**
+     * True if nothing was received since the end of the last request.
+     */
+    bool isIdle() const
+    {
+        return m_state == ReadingHeaders && m_pos == m_buffer.size();
+    }
+
+    /**
+     * The request line and the headers, once headersComplete() is true.
+     */
+    const KDSoapHttpHeaderView &headers() const
+    {
+        return m_headers;
+    }
+
+    /**
+     * The body received so far, decoded if it was chunked.
+     * It can be cleared after it's been used, when streaming it, without affecting the parsing.
+     */
+    QByteArray &body()
+    {
+        return m_body;
+    }
+
+    /**
+     * Discards the current request, and anything received after it, to parse a new one.
+     */
+    void reset();
+    /**
+     * Discards the current request, once it's Done, and parses the data received after it:
+     * the next request, when the client pipelines them.
+     */
+    void startNextRequest();
+
+private:
+    void process();
+    bool findLine(int *lineEnd);
+    void startBody();
+    int takeBodyData(int maxSize);
+
+    State m_state;
+    bool m_chunked;
+    bool m_writingBody; // the last prepareWrite() returned a pointer into m_body
+    int m_writeStart;
+    QByteArray m_buffer; // received and not parsed yet: headers and chunk framing
+    int m_pos; // parsing position in m_buffer
+    int m_scanPos; // where to resume looking for the end of a line or of the headers
+    int m_remaining; // of the body or of the current chunk
+    KDSoapHttpHeaderView m_headers;
+    QByteArray m_body;
+};
+
+#endif // KDSOAPHTTPREQUESTPARSER_P_H
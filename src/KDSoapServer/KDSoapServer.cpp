@@ -29,6 +29,13 @@ public:
         , m_logLevel(KDSoapServer::LogNothing)
         , m_path(QString::fromLatin1("/"))
         , m_maxConnections(-1)
+        , m_compressionLevel(-1)
+        , m_compressionThreshold(1024)
+        , m_maxDecompressedRequestSize(16 * 1024 * 1024)
+        , m_maxPipelineDepth(16)
+        , m_keepAliveTimeout(0)
+        , m_maxRequestsPerConnection(0)
+        , m_maxConnectionLifetime(0)
         , m_portBeforeSuspend(0)
     {
     }
@@ -53,6 +60,13 @@ public:
     QString m_wsdlPathInUrl;
     QString m_path;
     int m_maxConnections;
+    int m_compressionLevel;
+    int m_compressionThreshold;
+    int m_maxDecompressedRequestSize;
+    int m_maxPipelineDepth;
+    int m_keepAliveTimeout;
+    int m_maxRequestsPerConnection;
+    int m_maxConnectionLifetime;
 
     QHostAddress m_addressBeforeSuspend;
     quint16 m_portBeforeSuspend;
@@ -338,6 +352,90 @@ int KDSoapServer::maxConnections() const
     return d->m_maxConnections;
 }
 
+void KDSoapServer::setCompressionLevel(int level)
+{
+    QMutexLocker lock(&d->m_serverDataMutex);
+    d->m_compressionLevel = level;
+}
+
+int KDSoapServer::compressionLevel() const
+{
+    QMutexLocker lock(&d->m_serverDataMutex);
+    return d->m_compressionLevel;
+}
+
+void KDSoapServer::setCompressionThreshold(int bytes)
+{
+    QMutexLocker lock(&d->m_serverDataMutex);
+    d->m_compressionThreshold = bytes;
+}
+
+int KDSoapServer::compressionThreshold() const
+{
+    QMutexLocker lock(&d->m_serverDataMutex);
+    return d->m_compressionThreshold;
+}
+
+void KDSoapServer::setMaxDecompressedRequestSize(int bytes)
+{
+    QMutexLocker lock(&d->m_serverDataMutex);
+    d->m_maxDecompressedRequestSize = bytes;
+}
+
+int KDSoapServer::maxDecompressedRequestSize() const
+{
+    QMutexLocker lock(&d->m_serverDataMutex);
+    return d->m_maxDecompressedRequestSize;
+}
+
+void KDSoapServer::setMaxPipelineDepth(int depth)
+{
+    QMutexLocker lock(&d->m_serverDataMutex);
+    d->m_maxPipelineDepth = depth;
+}
+
+int KDSoapServer::maxPipelineDepth() const
+{
+    QMutexLocker lock(&d->m_serverDataMutex);
+    return d->m_maxPipelineDepth;
+}
+
+void KDSoapServer::setKeepAliveTimeout(int msecs)
+{
+    QMutexLocker lock(&d->m_serverDataMutex);
+    d->m_keepAliveTimeout = msecs;
+}
+
+int KDSoapServer::keepAliveTimeout() const
+{
+    QMutexLocker lock(&d->m_serverDataMutex);
+    return d->m_keepAliveTimeout;
+}
+
+void KDSoapServer::setMaxRequestsPerConnection(int requests)
+{
+    QMutexLocker lock(&d->m_serverDataMutex);
+    d->m_maxRequestsPerConnection = requests;
+}
+
+int KDSoapServer::maxRequestsPerConnection() const
+{
+    QMutexLocker lock(&d->m_serverDataMutex);
+    return d->m_maxRequestsPerConnection;
+}
+
+void KDSoapServer::setMaxConnectionLifetime(int msecs)
+{
+    QMutexLocker lock(&d->m_serverDataMutex);
+    d->m_maxConnectionLifetime = msecs;
+}
+
+int KDSoapServer::maxConnectionLifetime() const
+{
+    QMutexLocker lock(&d->m_serverDataMutex);
+    return d->m_maxConnectionLifetime;
+}
+
 void KDSoapServer::setFeatures(Features features)
 {
     QMutexLocker lock(&d->m_serverDataMutex);
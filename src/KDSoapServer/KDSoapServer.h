@@ -47,8 +47,19 @@ public:
     {
         Public = 0, ///< HTTP with no ssl and no authentication needed (default)
         Ssl = 1, ///< HTTPS
-        AuthRequired = 2 ///< Requires authentication. Currently not implemented, patches welcome.
-                         // bitfield, next item is 4
+        AuthRequired = 2, ///< Requires authentication. Currently not implemented, patches welcome.
+        NativeXmlWriter = 4, ///< Writes the responses with an XML writer producing UTF-8 directly, rather than QXmlStreamWriter.
+                             ///< The responses are the same, byte for byte. \since 2.2
+        ResponseCompression = 8, ///< Compresses the responses with gzip or deflate, for the clients accepting it, see setCompressionThreshold().
+                                 ///< Needs KDSoap to be built with zlib. \since 2.2
+        RequestArena = 16, ///< Parses each request into a compact arena of nodes, which the thread reuses for its next requests,
+                           ///< and writes each response into a buffer of the size of the previous one. This avoids most of the
+                           ///< allocations made for each request, which compete with each other when many threads are used.
+                           ///< The server object should not keep the values of a request beyond the call, they would need
+                           ///< a new arena for the next request. \since 2.2
+        StaticResponseHeaders = 32 ///< KDSoapServerObjectInterface::additionalHttpResponseHeaderItems() returns the same items for every
+                                   ///< response: it's only called once per thread, and the headers are rendered once. \since 2.2
+                                   // bitfield, next item is 64
     };
     Q_DECLARE_FLAGS(Features, Feature)
 
@@ -184,6 +195,117 @@ public:
      */
     int maxConnections() const;
 
+    /**
+     * Sets the zlib compression level of the responses, from 1 (fastest) to 9 (smallest).
+     * The default value, -1, means zlib's default level (currently 6).
+     * \sa ResponseCompression
+     * \since 2.2
+     */
+    void setCompressionLevel(int level);
+
+    /**
+     * Returns the compression level of the responses.
+     * \sa setCompressionLevel()
+     * \since 2.2
+     */
+    int compressionLevel() const;
+
+    /**
+     * Sets the size in bytes from which responses are compressed, 1024 by default.
+     * Only used when the ResponseCompression feature is enabled.
+     *
+     * Compressed requests are decompressed in any case, when KDSoap is built with zlib.
+     * \since 2.2
+     */
+    void setCompressionThreshold(int bytes);
+
+    /**
+     * Returns the size in bytes from which responses are compressed.
+     * \sa setCompressionThreshold()
+     * \since 2.2
+     */
+    int compressionThreshold() const;
+
+    /**
+     * Sets the maximum size in bytes of a compressed request, once decompressed, 16 MB by default.
+     * Larger requests are rejected with "413 Payload Too Large", so that a small compressed
+     * request can't make the server allocate an arbitrary amount of memory.
+     * \since 2.2
+     */
+    void setMaxDecompressedRequestSize(int bytes);
+
+    /**
+     * Returns the maximum size in bytes of a compressed request, once decompressed.
+     * \sa setMaxDecompressedRequestSize()
+     * \since 2.2
+     */
+    int maxDecompressedRequestSize() const;
+
+    /**
+     * Sets how many requests received on one connection can be waiting for their response, 16 by default.
+     *
+     * HTTP/1.1 clients can send several requests without waiting for the responses ("pipelining");
+     * the responses are always sent in the order of the requests, even when some of them are delayed
+     * (see KDSoapServerObjectInterface::prepareDelayedResponse()). Once this many responses are pending,
+     * the server stops reading from the connection until the oldest one is sent: the client can't make it
+     * buffer more than about 16 KB per pending request.
+     * \since 2.2
+     */
+    void setMaxPipelineDepth(int depth);
+
+    /**
+     * Returns how many requests received on one connection can be waiting for their response.
+     * \sa setMaxPipelineDepth()
+     * \since 2.2
+     */
+    int maxPipelineDepth() const;
+
+    /**
+     * Sets how long, in milliseconds, a connection can stay open without receiving anything
+     * while the server isn't working on one of its requests. Such idle keep-alive connections
+     * are then closed, so that they don't use up file descriptors.
+     * The default value, 0, means that they are kept until the client disconnects.
+     * \since 2.2
+     */
+    void setKeepAliveTimeout(int msecs);
+
+    /**
+     * Returns how long a connection can stay idle, in milliseconds.
+     * \sa setKeepAliveTimeout()
+     * \since 2.2
+     */
+    int keepAliveTimeout() const;
+
+    /**
+     * Sets how many requests can be sent on one connection. The response to the last one
+     * has a "Connection: close" header, and the connection is closed once it's sent.
+     * The default value, 0, means no limit.
+     * \since 2.2
+     */
+    void setMaxRequestsPerConnection(int requests);
+
+    /**
+     * Returns how many requests can be sent on one connection.
+     * \sa setMaxRequestsPerConnection()
+     * \since 2.2
+     */
+    int maxRequestsPerConnection() const;
+
+    /**
+     * Sets how long, in milliseconds, a connection can be used. The first request received after that
+     * is the last one, like with setMaxRequestsPerConnection(), and an idle connection is closed.
+     * The default value, 0, means no limit.
+     * \since 2.2
+     */
+    void setMaxConnectionLifetime(int msecs);
+
+    /**
+     * Returns how long a connection can be used, in milliseconds.
+     * \sa setMaxConnectionLifetime()
+     * \since 2.2
+     */
+    int maxConnectionLifetime() const;
+
     /**
      * Sets the number of expected sockets (connections) in this process.
      * This is necessary in order to increase system limits when a large number of clients
@@ -185,15 +185,13 @@ void KDSoapServerObjectInterface::sendDelayedResponse(const KDSoapDelayedRespons
 {
     KDSoapServerSocket *socket = responseHandle.serverSocket();
     if (socket) {
-        socket->sendDelayedReply(this, response);
+        socket->sendDelayedReply(this, response, responseHandle.requestId());
     }
 }
 
 void KDSoapServerObjectInterface::writeHTTP(const QByteArray &httpReply)
 {
-    const qint64 written = d->m_serverSocket->write(httpReply);
-    Q_ASSERT(written == httpReply.size()); // Please report a bug if you hit this.
-    Q_UNUSED(written);
+    d->m_serverSocket->writeBlocks({httpReply});
 }
 
 void KDSoapServerObjectInterface::writeXML(const QByteArray &reply, bool isFault)
@@ -14,19 +14,27 @@
 #include "KDSoapServerRawXMLInterface.h"
 #include "KDSoapServerSocket_p.h"
 #include "KDSoapSocketList_p.h"
+#include <KDSoapClient/KDSoapCompression_p.h>
 #include <KDSoapClient/KDSoapMessage.h>
 #include <KDSoapClient/KDSoapMessageReader_p.h>
 #include <KDSoapClient/KDSoapMessageWriter_p.h>
+#include <KDSoapClient/KDSoapMtom_p.h>
 #include <KDSoapClient/KDSoapNamespaceManager.h>
-#include <QBuffer>
-#include <QDir>
 #include <QFile>
 #include <QFileInfo>
 #include <QMetaMethod>
 #include <QThread>
 #include <QVarLengthArray>
 
-static const char s_forbidden[] = "HTTP/1.1 403 Forbidden\r\nContent-Length: 0\r\n\r\n";
+#ifdef Q_OS_UNIX
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+
+// The most blocks written with one system call by writeBlocks(), the others are buffered by the socket
+static const int s_maximumGatheredBlocks = 16;
 
 KDSoapServerSocket::KDSoapServerSocket(KDSoapSocketList *owner, QObject *serverObject)
 #ifndef QT_NO_SSL
@@ -39,11 +47,20 @@ KDSoapServerSocket::KDSoapServerSocket(KDSoapSocketList *owner, QObject *serverO
     m_owner(owner)
     , m_serverObject(serverObject)
     , m_delayedResponse(false)
-    , m_socketEnabled(true)
+    , m_processingRequests(false)
     , m_receivedData(false)
     , m_useRawXML(false)
-    , m_bytesReceived(0)
-    , m_chunkStart(0)
+    , m_mtom(false)
+    , m_responseEncoding(KDSoapCompression::Identity)
+    , m_requestStarted(false)
+    , m_nextRequestId(0)
+    , m_respondingTo(-1)
+    , m_connectionTime(owner->now())
+    , m_lastActivity(m_connectionTime)
+    , m_scheduledExpiry(-1)
+    , m_requestCount(0)
+    , m_lastRequestId(-1)
+    , m_active(false)
 {
     connect(this, &QIODevice::readyRead, this, &KDSoapServerSocket::slotReadyRead);
     m_doDebug = qEnvironmentVariableIsSet("KDSOAP_DEBUG");
@@ -56,64 +73,6 @@ KDSoapServerSocket::~KDSoapServerSocket()
     emit socketDeleted(this);
 }
 
-typedef QMap<QByteArray, QByteArray> HeadersMap;
-static HeadersMap parseHeaders(const QByteArray &headerData)
-{
-    HeadersMap headersMap;
-    QBuffer sourceBuffer;
-    sourceBuffer.setData(headerData);
-    sourceBuffer.open(QIODevice::ReadOnly);
-    // The first line is special, it's the GET or POST line
-    const QList<QByteArray> firstLine = sourceBuffer.readLine().split(' ');
-    if (firstLine.count() < 3) {
-        qDebug() << "Malformed HTTP request:" << firstLine;
-        return headersMap;
-    }
-    const QByteArray &requestType = firstLine.at(0);
-    headersMap.insert("_requestType", requestType);
-
-    // Grammar from https://datatracker.ietf.org/doc/html/rfc7230#section-5.3.1
-    //  origin-form    = absolute-path [ "?" query ]
-    // and https://datatracker.ietf.org/doc/html/rfc3986#section-3.3
-    // says the path ends at the first '?' or '#' character
-    const QByteArray arg1 = firstLine.at(1);
-    const int queryPos = arg1.indexOf('?');
-    const QByteArray path = queryPos >= 0 ? arg1.left(queryPos) : arg1;
-    const QByteArray query = queryPos >= 0 ? arg1.mid(queryPos) : QByteArray();
-    // Unfortunately QDir::cleanPath works with QString
-    const QByteArray cleanedPath = QDir::cleanPath(QString::fromUtf8(path)).toUtf8();
-    headersMap.insert("_path", cleanedPath + query);
-
-    const QByteArray &httpVersion = firstLine.at(2);
-    headersMap.insert("_httpVersion", httpVersion);
-
-    while (!sourceBuffer.atEnd()) {
-        const QByteArray line = sourceBuffer.readLine();
-        const int pos = line.indexOf(':');
-        if (pos == -1) {
-            qDebug() << "Malformed HTTP header:" << line;
-        }
-        const QByteArray header = line.left(pos).toLower(); // RFC2616 section 4.2 "Field names are case-insensitive"
-        const QByteArray value = line.mid(pos + 1).trimmed(); // remove space before and \r\n after
-        // qDebug() << "HEADER" << header << "VALUE" << value;
-        headersMap.insert(header, value);
-    }
-    return headersMap;
-}
-
-// We could parse headers as we go along looking for \r\n, and stop at empty header line, to avoid all this memory copying
-// But in practice XML parsing (and writing) is far, far slower anyway.
-static bool splitHeadersAndData(const QByteArray &request, QByteArray &header, QByteArray &data)
-{
-    const int sep = request.indexOf("\r\n\r\n");
-    if (sep <= 0) {
-        return false;
-    }
-    header = request.left(sep);
-    data = request.mid(sep + 4);
-    return true;
-}
-
 static QByteArray stripQuotes(const QByteArray &bar)
 {
     if (bar.startsWith('\"') && bar.endsWith('\"')) {
@@ -123,44 +82,60 @@ static QByteArray stripQuotes(const QByteArray &bar)
     return bar;
 }
 
-static QByteArray httpResponseHeaders(bool fault, const QByteArray &contentType, int responseDataSize, QObject *serverObject)
+static QByteArray httpResponseHeaders(const QByteArray &status, const QByteArray &contentType, int responseDataSize,
+                                      const QByteArray &additionalHeaders, const QByteArray &contentEncoding = QByteArray())
 {
     QByteArray httpResponse;
-    httpResponse.reserve(50);
-    if (fault) {
-        // https://www.w3.org/TR/2007/REC-soap12-part0-20070427 and look for 500
-        httpResponse += "HTTP/1.1 500 Internal Server Error\r\n";
-    } else if (responseDataSize == 0) {
-        httpResponse += "HTTP/1.1 204 No Content\r\n";
-    } else {
-        httpResponse += "HTTP/1.1 200 OK\r\n";
-    }
+    httpResponse.reserve(100 + contentType.size() + additionalHeaders.size());
+    httpResponse += "HTTP/1.1 ";
+    httpResponse += status;
+    httpResponse += "\r\n";
 
-    httpResponse += "Content-Type: ";
-    httpResponse += contentType;
-    httpResponse += "\r\nContent-Length: ";
+    if (!contentType.isEmpty()) {
+        httpResponse += "Content-Type: ";
+        httpResponse += contentType;
+        httpResponse += "\r\n";
+    }
+    httpResponse += "Content-Length: ";
     httpResponse += QByteArray::number(responseDataSize);
     httpResponse += "\r\n";
-
-    KDSoapServerObjectInterface *serverObjectInterface = qobject_cast<KDSoapServerObjectInterface *>(serverObject);
-    if (serverObjectInterface) {
-        const KDSoapServerObjectInterface::HttpResponseHeaderItems &additionalItems = serverObjectInterface->additionalHttpResponseHeaderItems();
-        for (const KDSoapServerObjectInterface::HttpResponseHeaderItem &headerItem : qAsConst(additionalItems)) {
-            httpResponse += headerItem.m_name;
-            httpResponse += ": ";
-            httpResponse += headerItem.m_value;
-            httpResponse += "\r\n";
-        }
+    if (!contentEncoding.isEmpty()) {
+        httpResponse += "Content-Encoding: ";
+        httpResponse += contentEncoding;
+        httpResponse += "\r\n";
     }
+    httpResponse += additionalHeaders;
 
     httpResponse += "\r\n"; // end of headers
     return httpResponse;
 }
 
+static QByteArray httpResponseHeaders(bool fault, const QByteArray &contentType, int responseDataSize, const QByteArray &additionalHeaders,
+                                      const QByteArray &contentEncoding = QByteArray())
+{
+    QByteArray status;
+    if (fault) {
+        // https://www.w3.org/TR/2007/REC-soap12-part0-20070427 and look for 500
+        status = "500 Internal Server Error";
+    } else if (responseDataSize == 0) {
+        status = "204 No Content";
+    } else {
+        status = "200 OK";
+    }
+    return httpResponseHeaders(status, contentType, responseDataSize, additionalHeaders, contentEncoding);
+}
+
+// The data buffered by the socket for each pipelined request, while the pipeline is full
+static const qint64 s_pipelinedRequestBufferSize = 16 * 1024;
+
+// The memory reserved upfront for a response, whatever the size of the previous one: the rest is allocated as it's written.
+// Otherwise one large response would make every following response in the thread reserve as much.
+static const int s_maximumResponseReservation = 64 * 1024;
+
 void KDSoapServerSocket::slotReadyRead()
 {
-    if (!m_socketEnabled) {
-        return;
+    if (m_processingRequests) {
+        return; // called by sendDelayedReply() while handling a request: the loop below goes on
     }
 
     // QNAM in Qt 5.x tends to connect additional sockets in advance and not use them
@@ -172,130 +147,256 @@ void KDSoapServerSocket::slotReadyRead()
 
     // qDebug() << this << QThread::currentThread() << "slotReadyRead!";
 
-    QByteArray buf(2048, ' ');
-    qint64 nread = -1;
-    while (nread != 0) {
-        nread = read(buf.data(), buf.size());
+    m_lastActivity = m_owner->now();
+    readRequests();
+    updateConnectionState();
+}
+
+void KDSoapServerSocket::readRequests()
+{
+    for (;;) {
+        if (!processRequests()) {
+            return;
+        }
+        if (pipelineFull()) {
+            // The rest is read once a response is sent, see sendDelayedReply(). Meanwhile, let the socket
+            // buffer a little more, then stop reading from the network, rather than buffer whatever the client sends.
+            setReadBufferSize(qint64(qMax(m_owner->server()->maxPipelineDepth(), 1)) * s_pipelinedRequestBufferSize);
+            return;
+        }
+        if (readBufferSize() != 0) {
+            setReadBufferSize(0); // the pipeline drained
+        }
+
+        // Read straight into the parser's buffers, which only grow when the data doesn't fit
+        const qint64 available = bytesAvailable();
+        if (available <= 0) {
+            return;
+        }
+        const int size = int(qMin<qint64>(available, 1024 * 1024));
+        const qint64 nread = read(m_parser.prepareWrite(size), size);
         if (nread < 0) {
+            m_parser.commit(0);
             qDebug() << "Error reading from server socket:" << errorString();
             return;
         }
-        m_requestBuffer += buf.left(nread);
-        m_bytesReceived += nread;
+        m_parser.commit(int(nread));
+        if (nread == 0) {
+            return;
+        }
     }
+}
+
+bool KDSoapServerSocket::pipelineFull() const
+{
+    return m_pendingResponses.size() >= qMax(m_owner->server()->maxPipelineDepth(), 1);
+}
+
+bool KDSoapServerSocket::isLastRequest()
+{
+    ++m_requestCount;
+    const KDSoapServer *server = m_owner->server();
+    const int maxRequests = server->maxRequestsPerConnection();
+    const int lifetime = server->maxConnectionLifetime();
+    return (maxRequests > 0 && m_requestCount >= maxRequests) || (lifetime > 0 && m_owner->now() - m_connectionTime >= lifetime);
+}
+
+void KDSoapServerSocket::updateConnectionState()
+{
+    // While responses are pending, the server is busy with this connection: it doesn't expire
+    const bool waitingForResponses = !m_pendingResponses.isEmpty();
+    m_owner->setSocketActive(this, waitingForResponses || !m_parser.isIdle());
+    if (waitingForResponses) {
+        m_owner->unscheduleExpiry(this);
+    } else {
+        m_owner->scheduleExpiry(this);
+    }
+}
+
+qint64 KDSoapServerSocket::expiryTime() const
+{
+    const KDSoapServer *server = m_owner->server();
+    qint64 expiryTime = -1;
+    const int keepAliveTimeout = server->keepAliveTimeout();
+    if (keepAliveTimeout > 0) {
+        expiryTime = m_lastActivity + keepAliveTimeout;
+    }
+    const int lifetime = server->maxConnectionLifetime();
+    if (lifetime > 0) {
+        const qint64 endOfLife = m_connectionTime + lifetime;
+        expiryTime = expiryTime < 0 ? endOfLife : qMin(expiryTime, endOfLife);
+    }
+    return expiryTime;
+}
 
+bool KDSoapServerSocket::processRequests()
+{
     KDSoapServerRawXMLInterface *rawXmlInterface = qobject_cast<KDSoapServerRawXMLInterface *>(m_serverObject);
 
-    if (m_httpHeaders.isEmpty()) {
-        // New request: see if we can parse headers
-        QByteArray receivedHttpHeaders, receivedData;
-        const bool splitOK = splitHeadersAndData(m_requestBuffer, receivedHttpHeaders, receivedData);
-        if (!splitOK) {
-            // qDebug() << "Incomplete SOAP request, wait for more data";
-            // incomplete request, wait for more data
-            return;
+    // Several requests can be in the parser, when the client pipelines them
+    for (;;) {
+        if (m_lastRequestId >= 0) {
+            // The connection is being closed, nothing else is handled
+            m_parser.reset();
+            return false;
         }
-        m_httpHeaders = parseHeaders(receivedHttpHeaders);
-        // Leave only the actual data in the buffer
-        m_requestBuffer = receivedData;
-        m_bytesReceived = receivedData.size();
-        m_useRawXML = false;
-        if (rawXmlInterface) {
-            KDSoapServerObjectInterface *serverObjectInterface = qobject_cast<KDSoapServerObjectInterface *>(m_serverObject);
-            serverObjectInterface->setServerSocket(this);
-            m_useRawXML = rawXmlInterface->newRequest(m_httpHeaders.value("_requestType"), m_httpHeaders);
+
+        if (m_parser.state() == KDSoapHttpRequestParser::Error) {
+            const int requestId = beginResponse();
+            const QByteArray badRequest = "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\n\r\n";
+            writeBlocks({badRequest});
+            endResponse(requestId);
+            m_respondingTo = -1;
+            m_parser.reset(); // nothing after the malformed request can be parsed
+            m_requestStarted = false;
+            return false;
         }
-    }
 
-    if (m_doDebug) {
-        qDebug() << "headers:" << m_httpHeaders;
-        qDebug() << "data received:" << m_requestBuffer;
-    }
+        if (!m_requestStarted && m_parser.headersComplete()) {
+            // New request
+            m_requestStarted = true;
+            const KDSoapHttpHeaderView &httpHeaders = m_parser.headers();
+            // Kept for the response, which can be sent later on, when delayed, or by a raw XML interface
+            m_responseEncoding = KDSoapCompression::acceptedEncoding(httpHeaders.value(KDSoapHttpHeaderView::AcceptEncoding));
+            m_useRawXML = false;
+            if (rawXmlInterface) {
+                KDSoapServerObjectInterface *serverObjectInterface = qobject_cast<KDSoapServerObjectInterface *>(m_serverObject);
+                serverObjectInterface->setServerSocket(this);
+                m_useRawXML = rawXmlInterface->newRequest(httpHeaders.requestType(), httpHeaders.toMap());
+            }
+        }
 
-    if (m_httpHeaders.value("transfer-encoding") != "chunked") {
-        if (m_useRawXML) {
-            rawXmlInterface->processXML(m_requestBuffer);
-            m_requestBuffer.clear();
+        if (m_useRawXML && !m_parser.body().isEmpty()) {
+            // Streamed as it arrives, rather than accumulated
+            rawXmlInterface->processXML(m_parser.body());
+            m_parser.body().clear();
         }
 
-        const QByteArray contentLength = m_httpHeaders.value("content-length");
-        if (m_bytesReceived < contentLength.toInt()) {
-            return; // incomplete request, wait for more data
+        if (m_parser.state() != KDSoapHttpRequestParser::Done) {
+            return true; // incomplete request, wait for more data
+        }
+        if (pipelineFull()) {
+            return true; // handled once a response is sent
         }
 
+        if (m_doDebug) {
+            qDebug() << "headers:" << m_parser.headers().toMap();
+            qDebug() << "data received:" << m_parser.body();
+        }
+
+        m_processingRequests = true;
+        const int requestId = beginResponse();
+        if (isLastRequest()) {
+            m_lastRequestId = requestId;
+        }
         if (m_useRawXML) {
             rawXmlInterface->endRequest();
         } else {
-            handleRequest(m_httpHeaders, m_requestBuffer);
+            handleRequest(m_parser.headers(), m_parser.body());
         }
-    } else {
-        // qDebug() << "requestBuffer has " << m_requestBuffer.size() << "bytes, starting at" << m_chunkStart;
-        while (m_chunkStart >= 0) {
-            const int nextEOL = m_requestBuffer.indexOf("\r\n", m_chunkStart);
-            if (nextEOL == -1) {
-                return;
-            }
-            const QByteArray chunkSizeStr = m_requestBuffer.mid(m_chunkStart, nextEOL - m_chunkStart);
-            // qDebug() << m_chunkStart << nextEOL << "chunkSizeStr=" << chunkSizeStr;
-            bool ok;
-            int chunkSize = chunkSizeStr.toInt(&ok, 16);
-            if (!ok) {
-                const QByteArray badRequest = "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\n\r\n";
-                write(badRequest);
-                return;
-            }
-            if (chunkSize == 0) { // done!
-                m_requestBuffer = m_requestBuffer.mid(nextEOL);
-                m_chunkStart = -1;
-                break;
+        m_respondingTo = -1;
+        if (m_delayedResponse) {
+            m_delayedResponse = false;
+            // Kept for sendDelayedReply(), the next requests are handled meanwhile
+            PendingResponse *response = pendingResponse(requestId);
+            if (response && !response->complete) {
+                response->messageNamespace = m_messageNamespace;
+                response->method = m_method;
+                response->mtom = m_mtom;
+                response->responseEncoding = m_responseEncoding;
             }
-            if (nextEOL + 2 + chunkSize + 2 >= m_requestBuffer.size()) {
-                return; // not enough data, chunk is incomplete
-            }
-            const QByteArray chunk = m_requestBuffer.mid(nextEOL + 2, chunkSize);
-            if (m_useRawXML) {
-                rawXmlInterface->processXML(chunk);
-            } else {
-                m_decodedRequestBuffer += chunk;
-            }
-            m_chunkStart = nextEOL + 2 + chunkSize + 2;
+        } else {
+            endResponse(requestId);
         }
-        // We have the full data, now ensure we read trailers
-        if (!m_requestBuffer.contains("\r\n\r\n")) {
-            return;
+        m_processingRequests = false;
+
+        m_parser.startNextRequest();
+        m_requestStarted = false;
+        m_receivedData = false;
+    }
+}
+
+int KDSoapServerSocket::beginResponse()
+{
+    PendingResponse response;
+    response.requestId = m_nextRequestId++;
+    response.complete = false;
+    response.mtom = false;
+    response.responseEncoding = KDSoapCompression::Identity;
+    m_pendingResponses.append(response);
+    m_respondingTo = response.requestId;
+    m_delayedResponse = false;
+    return response.requestId;
+}
+
+KDSoapServerSocket::PendingResponse *KDSoapServerSocket::pendingResponse(int requestId)
+{
+    for (PendingResponse &response : m_pendingResponses) {
+        if (response.requestId == requestId) {
+            return &response;
         }
-        if (m_useRawXML) {
-            rawXmlInterface->endRequest();
-        } else {
-            handleRequest(m_httpHeaders, m_decodedRequestBuffer);
+    }
+    return nullptr;
+}
+
+void KDSoapServerSocket::endResponse(int requestId)
+{
+    PendingResponse *response = pendingResponse(requestId);
+    if (!response) {
+        return;
+    }
+    response->complete = true;
+    // Send the complete responses at the front, and what was already written of the next one
+    while (!m_pendingResponses.isEmpty()) {
+        PendingResponse &first = m_pendingResponses.first();
+        if (!first.blocks.isEmpty()) {
+            sendBlocks(first.blocks);
+            first.blocks.clear();
+        }
+        if (!first.complete) {
+            break;
         }
-        m_decodedRequestBuffer.clear();
-        m_chunkStart = 0;
+        m_pendingResponses.removeFirst();
+    }
+    if (m_pendingResponses.isEmpty() && m_lastRequestId >= 0) {
+        disconnectFromHost(); // after sending what's still buffered
     }
-    m_requestBuffer.clear();
-    m_httpHeaders.clear();
-    m_receivedData = false;
 }
 
-void KDSoapServerSocket::handleRequest(const QMap<QByteArray, QByteArray> &httpHeaders, const QByteArray &receivedData)
+void KDSoapServerSocket::handleRequest(const KDSoapHttpHeaderView &httpHeaders, const QByteArray &receivedData)
 {
-    const QByteArray requestType = httpHeaders.value("_requestType");
-    const QString path = QString::fromLatin1(httpHeaders.value("_path").constData());
+    const QByteArray requestType = httpHeaders.requestType();
+    const QString path = QString::fromLatin1(httpHeaders.path().constData());
+    m_mtom = false;
 
     if (!path.startsWith(QLatin1String("/"))) {
         // denied for security reasons (ex: path starting with "..")
-        write(s_forbidden);
+        writeEmptyResponse("403 Forbidden");
         return;
     }
 
     KDSoapServerAuthInterface *serverAuthInterface = qobject_cast<KDSoapServerAuthInterface *>(m_serverObject);
     if (serverAuthInterface) {
-        const QByteArray authValue = httpHeaders.value("authorization");
+        const QByteArray authValue = httpHeaders.value(KDSoapHttpHeaderView::Authorization);
         if (!serverAuthInterface->handleHttpAuth(authValue, path)) {
             // send auth request (Qt supports basic, ntlm and digest)
-            const QByteArray unauthorized =
-                "HTTP/1.1 401 Authorization Required\r\nWWW-Authenticate: Basic realm=\"example\"\r\nContent-Length: 0\r\n\r\n";
-            write(unauthorized);
+            writeEmptyResponse("401 Authorization Required", "WWW-Authenticate: Basic realm=\"example\"\r\n");
+            return;
+        }
+    }
+
+    QByteArray requestData = receivedData;
+    const KDSoapCompression::Encoding requestEncoding = KDSoapCompression::contentEncoding(httpHeaders.value(KDSoapHttpHeaderView::ContentEncoding));
+    if (requestEncoding != KDSoapCompression::Identity) {
+        if (requestEncoding == KDSoapCompression::Unsupported || !KDSoapCompression::isAvailable()) {
+            // The Accept-Encoding header tells the client what it can send instead (RFC 7694)
+            writeEmptyResponse("415 Unsupported Media Type",
+                               "Accept-Encoding: " + QByteArray(KDSoapCompression::isAvailable() ? "gzip, deflate" : "identity") + "\r\n");
+            return;
+        }
+        bool tooLarge = false;
+        if (!KDSoapCompression::decompress(receivedData, requestEncoding, &requestData, m_owner->server()->maxDecompressedRequestSize(), &tooLarge)) {
+            writeEmptyResponse(tooLarge ? "413 Payload Too Large" : "400 Bad Request");
             return;
         }
     }
@@ -303,15 +404,14 @@ void KDSoapServerSocket::handleRequest(const QMap<QByteArray, QByteArray> &httpH
     if (requestType != "GET" && requestType != "POST") {
         KDSoapServerCustomVerbRequestInterface *serverCustomRequest = qobject_cast<KDSoapServerCustomVerbRequestInterface *>(m_serverObject);
         QByteArray customVerbRequestAnswer;
-        if (serverCustomRequest && serverCustomRequest->processCustomVerbRequest(requestType, receivedData, httpHeaders, customVerbRequestAnswer)) {
-            write(customVerbRequestAnswer);
+        if (serverCustomRequest && serverCustomRequest->processCustomVerbRequest(requestType, requestData, httpHeaders.toMap(), customVerbRequestAnswer)) {
+            writeBlocks({customVerbRequestAnswer});
             return;
         } else {
             qWarning() << "Unknown HTTP request:" << requestType;
             // handleError(replyMsg, "Client.Data", QString::fromLatin1("Invalid request type '%1', should be GET or
             // POST").arg(QString::fromLatin1(requestType.constData()))); sendReply(0, replyMsg);
-            const QByteArray methodNotAllowed = "HTTP/1.1 405 Method Not Allowed\r\nAllow: GET POST\r\nContent-Length: 0\r\n\r\n";
-            write(methodNotAllowed);
+            writeEmptyResponse("405 Method Not Allowed", "Allow: GET POST\r\n");
             return;
         }
     }
@@ -346,23 +446,45 @@ void KDSoapServerSocket::handleRequest(const QMap<QByteArray, QByteArray> &httpH
         return;
     }
 
+    // An MTOM request is a multipart/related package: the message, and its binary values in parts of their own
+    QByteArray contentType = httpHeaders.value(KDSoapHttpHeaderView::ContentType);
+    QByteArray soapData = requestData;
+    QHash<QByteArray, QByteArray> mtomParts;
+    m_mtom = KDSoapMtom::isMultipartRelated(contentType);
+    if (m_mtom) {
+        if (!KDSoapMtom::parseMultipartBody(contentType, requestData, &soapData, &mtomParts)) {
+            m_mtom = false;
+            handleError(replyMsg, "Client.Data", QString::fromLatin1("Invalid multipart/related request"));
+            sendReply(serverObjectInterface, replyMsg);
+            return;
+        }
+        contentType = KDSoapMtom::soapContentType(contentType);
+    }
+
     // parse message
     KDSoapMessage requestMsg;
     KDSoapHeaders requestHeaders;
     KDSoapMessageReader reader;
-    KDSoapMessageReader::XmlError err = reader.xmlToMessage(receivedData, &requestMsg, &m_messageNamespace, &requestHeaders, KDSoap::SOAP1_1);
+    if (server->features().testFlag(KDSoapServer::RequestArena)) {
+        reader.setCompactParsing(true);
+        reader.setArena(m_owner->requestArena());
+    }
+    KDSoapMessageReader::XmlError err = reader.xmlToMessage(soapData, &requestMsg, &m_messageNamespace, &requestHeaders, KDSoap::SOAP1_1);
     if (err == KDSoapMessageReader::PrematureEndOfDocumentError) {
         // qDebug() << "Incomplete SOAP message, wait for more data";
         // This should never happen, since we check for content-size above.
         return;
     } // TODO handle parse errors?
+    if (!mtomParts.isEmpty()) {
+        KDSoapMtom::resolveIncludes(requestMsg, mtomParts);
+        KDSoapMtom::resolveIncludes(requestHeaders, mtomParts);
+    }
 
     // check soap version and extract soapAction header
     QByteArray soapAction;
-    const QByteArray contentType = httpHeaders.value("content-type");
     if (contentType.startsWith("text/xml")) { // krazy:exclude=strings
         // SOAP 1.1
-        soapAction = httpHeaders.value("soapaction");
+        soapAction = httpHeaders.value(KDSoapHttpHeaderView::SoapAction);
         // The SOAP standard allows quotation marks around the SoapAction, so we have to get rid of these.
         soapAction = stripQuotes(soapAction);
 
@@ -384,8 +506,7 @@ void KDSoapServerSocket::handleRequest(const QMap<QByteArray, QByteArray> &httpH
     }
 
     if (serverObjectInterface && m_delayedResponse) {
-        // Delayed response. Disable the socket to make sure we don't handle another call at the same time.
-        setSocketEnabled(false);
+        // Delayed response, sent by sendDelayedReply(). The responses to the next requests wait for it.
     } else {
         sendReply(serverObjectInterface, replyMsg);
     }
@@ -399,9 +520,8 @@ bool KDSoapServerSocket::handleWsdlDownload()
     if (wf.open(QIODevice::ReadOnly)) {
         // qDebug() << "Returning wsdl file contents";
         const QByteArray responseText = wf.readAll();
-        const QByteArray response = httpResponseHeaders(false, "application/xml", responseText.size(), m_serverObject);
-        write(response);
-        write(responseText);
+        const QByteArray response = httpResponseHeaders(false, "application/xml", responseText.size(), m_owner->additionalResponseHeaders());
+        writeBlocks({response, responseText});
         return true;
     }
     return false;
@@ -412,22 +532,19 @@ bool KDSoapServerSocket::handleFileDownload(KDSoapServerObjectInterface *serverO
     QByteArray contentType;
     QIODevice *device = serverObjectInterface->processFileRequest(path, contentType);
     if (!device) {
-        const QByteArray notFound = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
-        write(notFound);
+        writeEmptyResponse("404 Not Found");
         return true;
     }
     if (!device->open(QIODevice::ReadOnly)) {
-        write(s_forbidden);
+        writeEmptyResponse("403 Forbidden");
         delete device;
         return true; // handled!
     }
-    const QByteArray response = httpResponseHeaders(false, contentType, device->size(), m_serverObject);
+    const QByteArray response = httpResponseHeaders(false, contentType, device->size(), m_owner->additionalResponseHeaders());
     if (m_doDebug) {
         qDebug() << "KDSoapServerSocket: file download response" << response;
     }
-    qint64 written = write(response);
-    Q_ASSERT(written == response.size()); // Please report a bug if you hit this.
-    Q_UNUSED(written);
+    writeBlocks({response});
 
     char block[4096] = {0};
     // qint64 totalRead = 0;
@@ -437,10 +554,7 @@ bool KDSoapServerSocket::handleFileDownload(KDSoapServerObjectInterface *serverO
             break;
         }
         // totalRead += in;
-        if (in != write(block, in)) {
-            // error = true;
-            break;
-        }
+        writeBlocks({QByteArray(block, int(in))});
     }
     // if (totalRead != device->size()) {
     //    // Unable to read from the source.
@@ -454,17 +568,118 @@ bool KDSoapServerSocket::handleFileDownload(KDSoapServerObjectInterface *serverO
 
 void KDSoapServerSocket::writeXML(const QByteArray &xmlResponse, bool isFault)
 {
-    const QByteArray httpHeaders = httpResponseHeaders(isFault, "text/xml", xmlResponse.size(),
-                                                       m_serverObject); // TODO return application/soap+xml;charset=utf-8 instead for SOAP 1.2
+    writeResponse({xmlResponse}, "text/xml", isFault); // TODO return application/soap+xml;charset=utf-8 instead for SOAP 1.2
+}
+
+void KDSoapServerSocket::writeResponse(const QVector<QByteArray> &pieces, const QByteArray &contentType, bool isFault)
+{
+    int size = 0;
+    for (const QByteArray &piece : pieces) {
+        size += piece.size();
+    }
+    QByteArray contentEncoding;
+    QByteArray compressed;
+    if (m_responseEncoding != KDSoapCompression::Identity && size > 0) {
+        KDSoapServer *server = m_owner->server();
+        if (server->features().testFlag(KDSoapServer::ResponseCompression) && size >= server->compressionThreshold()
+            && KDSoapCompression::compress(pieces, m_responseEncoding, server->compressionLevel(), &compressed)) {
+            contentEncoding = KDSoapCompression::name(m_responseEncoding);
+            size = compressed.size();
+        }
+    }
+    const QByteArray httpHeaders = httpResponseHeaders(isFault, contentType, size, additionalResponseHeaders(), contentEncoding);
+    if (m_doDebug) {
+        qDebug() << "KDSoapServerSocket: writing" << httpHeaders << pieces;
+    }
+    if (!contentEncoding.isEmpty()) {
+        writeBlocks({httpHeaders, compressed});
+    } else {
+        // The body isn't concatenated to the headers, and the MTOM attachments are written as they are
+        QVector<QByteArray> blocks;
+        blocks.reserve(pieces.size() + 1);
+        blocks.append(httpHeaders);
+        blocks += pieces;
+        writeBlocks(blocks);
+    }
+}
+
+void KDSoapServerSocket::writeEmptyResponse(const QByteArray &status, const QByteArray &headers)
+{
+    const QByteArray httpHeaders = httpResponseHeaders(status, QByteArray(), 0, additionalResponseHeaders() + headers);
     if (m_doDebug) {
-        qDebug() << "KDSoapServerSocket: writing" << httpHeaders << xmlResponse;
-    }
-    qint64 written = write(httpHeaders);
-    Q_ASSERT(written == httpHeaders.size()); // Please report a bug if you hit this.
-    written = write(xmlResponse);
-    Q_ASSERT(written == xmlResponse.size()); // Please report a bug if you hit this.
-    Q_UNUSED(written);
-    // flush() ?
+        qDebug() << "KDSoapServerSocket: writing" << httpHeaders;
+    }
+    writeBlocks({httpHeaders});
+}
+
+QByteArray KDSoapServerSocket::additionalResponseHeaders() const
+{
+    QByteArray additionalHeaders = m_owner->additionalResponseHeaders();
+    if (m_respondingTo >= 0 && m_respondingTo == m_lastRequestId) {
+        additionalHeaders += "Connection: close\r\n"; // see KDSoapServer::setMaxRequestsPerConnection()
+    }
+    return additionalHeaders;
+}
+
+void KDSoapServerSocket::writeBlocks(const QVector<QByteArray> &blocks)
+{
+    // The responses are sent in the order of the requests: the one to a pipelined request waits for the previous ones
+    if (!m_pendingResponses.isEmpty() && m_pendingResponses.first().requestId != m_respondingTo) {
+        PendingResponse *response = pendingResponse(m_respondingTo);
+        if (response) {
+            response->blocks += blocks;
+            return;
+        }
+    }
+    sendBlocks(blocks);
+}
+
+void KDSoapServerSocket::sendBlocks(const QVector<QByteArray> &blocks)
+{
+    int sentBlocks = 0;
+    qint64 sentBytes = 0; // of the first block not sent completely
+#ifdef Q_OS_UNIX
+    // When nothing is waiting in the write buffer of the socket, the blocks are sent right away, with a single
+    // system call, rather than being copied into the buffer and sent one by one. Not with SSL, which needs the buffer.
+    if (bytesToWrite() == 0 && socketDescriptor() != -1
+#ifndef QT_NO_SSL
+        && mode() == UnencryptedMode
+#endif
+    ) {
+        iovec vectors[s_maximumGatheredBlocks];
+        const int count = qMin(int(blocks.size()), s_maximumGatheredBlocks);
+        for (int i = 0; i < count; ++i) {
+            vectors[i].iov_base = const_cast<char *>(blocks.at(i).constData());
+            vectors[i].iov_len = size_t(blocks.at(i).size());
+        }
+        msghdr message;
+        memset(&message, 0, sizeof(message));
+        message.msg_iov = vectors;
+        message.msg_iovlen = count;
+#ifdef MSG_NOSIGNAL
+        const int flags = MSG_NOSIGNAL; // errors are reported by the socket below, rather than by SIGPIPE
+#else
+        const int flags = 0;
+#endif
+        ssize_t sent;
+        do {
+            sent = ::sendmsg(int(socketDescriptor()), &message, flags);
+        } while (sent < 0 && errno == EINTR);
+        // The rest (all of it, if the kernel buffer is full) goes through the socket
+        sentBytes = qMax<qint64>(sent, 0);
+        while (sentBlocks < count && sentBytes >= blocks.at(sentBlocks).size()) {
+            sentBytes -= blocks.at(sentBlocks).size();
+            ++sentBlocks;
+        }
+    }
+#endif
+    for (int i = sentBlocks; i < blocks.size(); ++i) {
+        const QByteArray &block = blocks.at(i);
+        const qint64 offset = i == sentBlocks ? sentBytes : 0;
+        const qint64 written = write(block.constData() + offset, block.size() - offset);
+        Q_ASSERT(written == block.size() - offset); // Please report a bug if you hit this.
+        Q_UNUSED(written);
+    }
 }
 
 void KDSoapServerSocket::sendReply(KDSoapServerObjectInterface *serverObjectInterface, const KDSoapMessage &replyMsg)
@@ -472,6 +687,8 @@ void KDSoapServerSocket::sendReply(KDSoapServerObjectInterface *serverObjectInte
     const bool isFault = replyMsg.isFault();
 
     QByteArray xmlResponse;
+    QVector<QByteArray> mtomBody; // the response as an MTOM package, if the request was one
+    QByteArray mtomContentType;
     if (!replyMsg.isNull()) {
         KDSoapMessageWriter msgWriter;
         // Note that the kdsoap client parsing code doesn't care for the name (except if it's fault), even in
@@ -488,11 +705,33 @@ void KDSoapServerSocket::sendReply(KDSoapServerObjectInterface *serverObjectInte
                 responseNamespace = serverObjectInterface->responseNamespace();
             }
         }
+        const KDSoapServer::Features features = m_owner->server()->features();
         msgWriter.setMessageNamespace(responseNamespace);
+        msgWriter.setNativeXmlWriter(features.testFlag(KDSoapServer::NativeXmlWriter));
+        KDSoapMtomAttachments attachments;
+        if (m_mtom) {
+            msgWriter.setMtomAttachments(&attachments);
+        }
+        const bool requestArena = features.testFlag(KDSoapServer::RequestArena);
+        if (requestArena) {
+            msgWriter.setSizeHint(qMin(m_owner->responseSizeHint(), s_maximumResponseReservation));
+        }
         xmlResponse = msgWriter.messageToXml(replyMsg, responseName, responseHeaders, QMap<QString, KDSoapMessage>());
+        if (requestArena) {
+            m_owner->setResponseSizeHint(xmlResponse.size());
+        }
+        if (m_mtom) {
+            const QByteArray boundary = KDSoapMtom::createBoundary();
+            mtomBody = KDSoapMtom::multipartBody(boundary, "text/xml", xmlResponse, attachments);
+            mtomContentType = KDSoapMtom::contentType(boundary, "text/xml");
+        }
     }
 
-    writeXML(xmlResponse, isFault);
+    if (!mtomBody.isEmpty()) {
+        writeResponse(mtomBody, mtomContentType, isFault);
+    } else {
+        writeXML(xmlResponse, isFault);
+    }
 
     // All done, check if we should log this
     KDSoapServer *server = m_owner->server();
@@ -510,16 +749,42 @@ void KDSoapServerSocket::sendReply(KDSoapServerObjectInterface *serverObjectInte
     }
 }
 
-void KDSoapServerSocket::sendDelayedReply(KDSoapServerObjectInterface *serverObjectInterface, const KDSoapMessage &replyMsg)
+void KDSoapServerSocket::sendDelayedReply(KDSoapServerObjectInterface *serverObjectInterface, const KDSoapMessage &replyMsg, int requestId)
 {
+    PendingResponse *response = pendingResponse(requestId);
+    if (!response || response->complete) {
+        qWarning("KDSoapServerSocket: the delayed response was already sent");
+        return;
+    }
+    // The data of the delayed request, rather than the one of the request being handled, if any
+    const QString messageNamespace = m_messageNamespace;
+    const QString method = m_method;
+    const bool mtom = m_mtom;
+    const KDSoapCompression::Encoding responseEncoding = m_responseEncoding;
+    const int respondingTo = m_respondingTo;
+    m_messageNamespace = response->messageNamespace;
+    m_method = response->method;
+    m_mtom = response->mtom;
+    m_responseEncoding = response->responseEncoding;
+    m_respondingTo = requestId;
+
     sendReply(serverObjectInterface, replyMsg);
-    m_delayedResponse = false;
-    setSocketEnabled(true);
+    endResponse(requestId);
+
+    m_messageNamespace = messageNamespace;
+    m_method = method;
+    m_mtom = mtom;
+    m_responseEncoding = responseEncoding;
+    m_respondingTo = respondingTo;
+
+    // The requests waiting for room in the pipeline
+    slotReadyRead();
 }
 
-void KDSoapServerSocket::setResponseDelayed()
+int KDSoapServerSocket::setResponseDelayed()
 {
     m_delayedResponse = true;
+    return m_respondingTo;
 }
 
 void KDSoapServerSocket::handleError(KDSoapMessage &replyMsg, const char *errorCode, const QString &error)
@@ -559,18 +824,4 @@ void KDSoapServerSocket::makeCall(KDSoapServerObjectInterface *serverObjectInter
     }
 }
 
-// Prevention against concurrent requests without waiting for a (delayed) reply,
-// but untestable with QNAM on the client side, since it doesn't do that.
-void KDSoapServerSocket::setSocketEnabled(bool enabled)
-{
-    if (m_socketEnabled == enabled) {
-        return;
-    }
-
-    m_socketEnabled = enabled;
-    if (enabled) {
-        slotReadyRead();
-    }
-}
-
 #include "moc_KDSoapServerSocket_p.cpp"
@@ -17,7 +17,9 @@
 #include <QSslSocket>
 #endif
 
-#include <QMap>
+#include "KDSoapHttpRequestParser_p.h"
+#include <KDSoapClient/KDSoapCompression_p.h>
+#include <QVector>
 QT_BEGIN_NAMESPACE
 class QObject;
 QT_END_NAMESPACE
@@ -38,8 +40,8 @@ public:
     KDSoapServerSocket(KDSoapSocketList *owner, QObject *serverObject);
     ~KDSoapServerSocket();
 
-    void setResponseDelayed();
-    void sendDelayedReply(KDSoapServerObjectInterface *serverObjectInterface, const KDSoapMessage &replyMsg);
+    int setResponseDelayed(); // returns the id of the request
+    void sendDelayedReply(KDSoapServerObjectInterface *serverObjectInterface, const KDSoapMessage &replyMsg, int requestId);
     void sendReply(KDSoapServerObjectInterface *serverObjectInterface, const KDSoapMessage &replyMsg);
 Q_SIGNALS:
     void socketDeleted(KDSoapServerSocket *);
@@ -48,34 +50,73 @@ private Q_SLOTS:
     void slotReadyRead();
 
 private:
-    void handleRequest(const QMap<QByteArray, QByteArray> &headers, const QByteArray &receivedData);
+    // The response to a request that was handled, and not sent completely yet
+    struct PendingResponse
+    {
+        int requestId;
+        bool complete;
+        QVector<QByteArray> blocks; // written before the responses to the previous requests were sent
+        // The data of the request, for a delayed reply
+        QString messageNamespace;
+        QString method;
+        bool mtom;
+        KDSoapCompression::Encoding responseEncoding;
+    };
+
+    void readRequests();
+    bool processRequests();
+    bool pipelineFull() const;
+    bool isLastRequest();
+    void updateConnectionState();
+    qint64 expiryTime() const;
+    int beginResponse();
+    void endResponse(int requestId);
+    PendingResponse *pendingResponse(int requestId);
+    void handleRequest(const KDSoapHttpHeaderView &headers, const QByteArray &receivedData);
     bool handleWsdlDownload();
     bool handleFileDownload(KDSoapServerObjectInterface *serverObjectInterface, const QString &path);
     void makeCall(KDSoapServerObjectInterface *serverObjectInterface, const KDSoapMessage &requestMsg, KDSoapMessage &replyMsg,
                   const KDSoapHeaders &requestHeaders, const QByteArray &soapAction, const QString &path);
     void handleError(KDSoapMessage &replyMsg, const char *errorCode, const QString &error);
-    void setSocketEnabled(bool enabled);
     void writeXML(const QByteArray &xmlResponse, bool isFault);
+    void writeResponse(const QVector<QByteArray> &pieces, const QByteArray &contentType, bool isFault);
+    void writeEmptyResponse(const QByteArray &status, const QByteArray &headers = QByteArray());
+    QByteArray additionalResponseHeaders() const;
+    void writeBlocks(const QVector<QByteArray> &blocks);
+    void sendBlocks(const QVector<QByteArray> &blocks);
     friend class KDSoapServerObjectInterface;
+    friend class KDSoapSocketList;
 
     KDSoapSocketList *m_owner;
     QObject *m_serverObject;
     bool m_delayedResponse;
     bool m_doDebug;
-    bool m_socketEnabled;
+    bool m_processingRequests;
     bool m_receivedData;
 
     // Current request being assembled
     bool m_useRawXML;
-    int m_bytesReceived;
-    int m_chunkStart;
-    QMap<QByteArray, QByteArray> m_httpHeaders;
-    QByteArray m_requestBuffer;
-    QByteArray m_decodedRequestBuffer; // used for chunked transfer encoding only
+    bool m_mtom; // the request was an MTOM package, so the response is one too
+    KDSoapCompression::Encoding m_responseEncoding; // the best one the client accepts
+    bool m_requestStarted; // its headers were handled
+    KDSoapHttpRequestParser m_parser;
 
-    // Data for the current call (stored here for delayed replies)
+    // Data for the current call
     QString m_messageNamespace;
     QString m_method;
+
+    // HTTP pipelining: the responses are sent in the order of the requests
+    QVector<PendingResponse> m_pendingResponses;
+    int m_nextRequestId;
+    int m_respondingTo; // the request whose response is being written, -1 if none
+
+    // Keep-alive, see KDSoapServer::setKeepAliveTimeout(), times from KDSoapSocketList::now()
+    qint64 m_connectionTime;
+    qint64 m_lastActivity;
+    qint64 m_scheduledExpiry; // its time in the expiry queue of m_owner, -1 if not queued
+    int m_requestCount;
+    int m_lastRequestId; // the connection is closed after responding to it, -1 until then
+    bool m_active; // counted in KDSoapSocketList::activeSocketCount()
 };
 
 #endif // KDSOAPSERVERSOCKET_P_H
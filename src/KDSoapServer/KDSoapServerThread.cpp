@@ -43,6 +43,14 @@ int KDSoapServerThread::socketCount() const
     return 0;
 }
 
+int KDSoapServerThread::activeSocketCount() const
+{
+    if (d) {
+        return d->activeSocketCount();
+    }
+    return 0;
+}
+
 int KDSoapServerThread::socketCountForServer(const KDSoapServer *server) const
 {
     if (d) {
@@ -115,6 +123,19 @@ int KDSoapServerThreadImpl::socketCount()
     return sc;
 }
 
+// Called from main thread!
+int KDSoapServerThreadImpl::activeSocketCount()
+{
+    QMutexLocker lock(&m_socketListMutex);
+    int sc = 0;
+    for (KDSoapSocketList *socketList : qAsConst(m_socketLists)) {
+        sc += socketList->activeSocketCount();
+    }
+    // About to send a request, most likely
+    sc += m_incomingConnectionCount.loadAcquire();
+    return sc;
+}
+
 KDSoapSocketList *KDSoapServerThreadImpl::socketListForServer(KDSoapServer *server)
 {
     KDSoapSocketList *sockets = m_socketLists.value(server);
@@ -31,6 +31,7 @@ public Q_SLOTS:
 
 public:
     int socketCount();
+    int activeSocketCount();
     int socketCountForServer(const KDSoapServer *server);
     int totalConnectionCountForServer(const KDSoapServer *server);
     void resetTotalConnectionCountForServer(const KDSoapServer *server);
@@ -57,6 +58,7 @@ public:
     void quitThread();
 
     int socketCount() const;
+    int activeSocketCount() const;
     int socketCountForServer(const KDSoapServer *server) const;
     int totalConnectionCountForServer(const KDSoapServer *server) const;
     void resetTotalConnectionCountForServer(const KDSoapServer *server);
@@ -8,6 +8,7 @@
 **
 ****************************************************************************/
 #include "KDSoapServer.h"
+#include "KDSoapServerObjectInterface.h"
 #include "KDSoapServerSocket_p.h"
 #include "KDSoapSocketList_p.h"
 #include <QDebug>
@@ -16,9 +17,15 @@ KDSoapSocketList::KDSoapSocketList(KDSoapServer *server)
     : m_server(server)
     , m_serverObject(server->createServerObject())
     , m_totalConnectionCount(0)
+    , m_activeSocketCount(0)
+    , m_responseSizeHint(0)
+    , m_staticResponseHeadersRendered(false)
 {
     Q_ASSERT(m_server);
     Q_ASSERT(m_serverObject);
+    m_clock.start();
+    m_expiryTimer.setSingleShot(true);
+    connect(&m_expiryTimer, &QTimer::timeout, this, &KDSoapSocketList::expireSockets);
 }
 
 KDSoapSocketList::~KDSoapSocketList()
@@ -45,13 +52,115 @@ KDSoapServerSocket *KDSoapSocketList::handleIncomingConnection(int socketDescrip
     QObject::connect(socket, &KDSoapServerSocket::disconnected, socket, &KDSoapServerSocket::deleteLater);
     m_sockets.insert(socket);
     connect(socket, &KDSoapServerSocket::socketDeleted, this, &KDSoapSocketList::socketDeleted);
+    scheduleExpiry(socket); // in case it never sends anything
     return socket;
 }
 
+KDSoapValueArena::Ptr KDSoapSocketList::requestArena()
+{
+    // The sockets of a list are all in the same thread, and handle one request at a time.
+    // If the server object kept values of the previous request, they keep the old arena alive.
+    if (!m_requestArena || m_requestArena->isShared()) {
+        m_requestArena = new KDSoapValueArena;
+    }
+    return m_requestArena;
+}
+
+QByteArray KDSoapSocketList::additionalResponseHeaders()
+{
+    if (m_staticResponseHeadersRendered) {
+        return m_staticResponseHeaders;
+    }
+    QByteArray headers;
+    KDSoapServerObjectInterface *serverObjectInterface = qobject_cast<KDSoapServerObjectInterface *>(m_serverObject);
+    if (serverObjectInterface) {
+        const KDSoapServerObjectInterface::HttpResponseHeaderItems &additionalItems = serverObjectInterface->additionalHttpResponseHeaderItems();
+        for (const KDSoapServerObjectInterface::HttpResponseHeaderItem &headerItem : qAsConst(additionalItems)) {
+            headers += headerItem.m_name;
+            headers += ": ";
+            headers += headerItem.m_value;
+            headers += "\r\n";
+        }
+    }
+    if (m_server->features().testFlag(KDSoapServer::StaticResponseHeaders)) {
+        m_staticResponseHeaders = headers;
+        m_staticResponseHeadersRendered = true;
+    }
+    return headers;
+}
+
+void KDSoapSocketList::setSocketActive(KDSoapServerSocket *socket, bool active)
+{
+    if (socket->m_active == active) {
+        return;
+    }
+    socket->m_active = active;
+    if (active) {
+        m_activeSocketCount.ref();
+    } else {
+        m_activeSocketCount.deref();
+    }
+}
+
+void KDSoapSocketList::scheduleExpiry(KDSoapServerSocket *socket)
+{
+    const qint64 expiryTime = socket->expiryTime();
+    if (expiryTime < 0) {
+        unscheduleExpiry(socket);
+        return;
+    }
+    if (socket->m_scheduledExpiry >= 0 && socket->m_scheduledExpiry <= expiryTime) {
+        return; // expireSockets() will see the new expiry time, no need to move it in the queue
+    }
+    unscheduleExpiry(socket);
+    socket->m_scheduledExpiry = expiryTime;
+    m_expiryQueue.insert(expiryTime, socket);
+    if (m_expiryQueue.constBegin().key() == expiryTime) {
+        m_expiryTimer.start(int(qMax<qint64>(expiryTime - now(), 0)));
+    }
+}
+
+void KDSoapSocketList::unscheduleExpiry(KDSoapServerSocket *socket)
+{
+    if (socket->m_scheduledExpiry < 0) {
+        return;
+    }
+    m_expiryQueue.remove(socket->m_scheduledExpiry, socket);
+    socket->m_scheduledExpiry = -1;
+}
+
+void KDSoapSocketList::expireSockets()
+{
+    const qint64 currentTime = now();
+    QVector<KDSoapServerSocket *> expired;
+    while (!m_expiryQueue.isEmpty() && m_expiryQueue.constBegin().key() <= currentTime) {
+        KDSoapServerSocket *socket = m_expiryQueue.constBegin().value();
+        m_expiryQueue.erase(m_expiryQueue.begin());
+        socket->m_scheduledExpiry = -1;
+        if (socket->bytesToWrite() > 0) {
+            socket->m_lastActivity = currentTime; // still sending a response to a slow client
+        }
+        // It might have received data since it was queued
+        if (socket->expiryTime() <= currentTime) {
+            expired.append(socket);
+        } else {
+            scheduleExpiry(socket);
+        }
+    }
+    for (KDSoapServerSocket *socket : qAsConst(expired)) {
+        socket->close(); // will disconnect
+    }
+    if (!m_expiryQueue.isEmpty()) {
+        m_expiryTimer.start(int(qMax<qint64>(m_expiryQueue.constBegin().key() - now(), 0)));
+    }
+}
+
 void KDSoapSocketList::socketDeleted(KDSoapServerSocket *socket)
 {
     // qDebug() << Q_FUNC_INFO;
     m_sockets.remove(socket);
+    unscheduleExpiry(socket);
+    setSocketActive(socket, false);
 }
 
 int KDSoapSocketList::socketCount() const
@@ -59,6 +168,11 @@ int KDSoapSocketList::socketCount() const
     return m_sockets.count();
 }
 
+int KDSoapSocketList::activeSocketCount() const
+{
+    return m_activeSocketCount.loadAcquire();
+}
+
 void KDSoapSocketList::disconnectAll()
 {
     for (KDSoapServerSocket *socket : qAsConst(m_sockets)) {
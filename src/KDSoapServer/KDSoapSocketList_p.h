@@ -10,8 +10,12 @@
 #ifndef KDSOAPSOCKETLIST_P_H
 #define KDSOAPSOCKETLIST_P_H
 
+#include <KDSoapClient/KDSoapValueArena_p.h>
+#include <QElapsedTimer>
+#include <QMultiMap>
 #include <QObject>
 #include <QSet>
+#include <QTimer>
 QT_BEGIN_NAMESPACE
 class QTcpSocket;
 class QObject;
@@ -29,6 +33,8 @@ public:
     KDSoapServerSocket *handleIncomingConnection(int socketDescriptor);
 
     int socketCount() const;
+    // The sockets with a request in progress or responses to send: the others are idle keep-alive connections
+    int activeSocketCount() const;
     void disconnectAll();
 
     int totalConnectionCount() const;
@@ -40,14 +46,54 @@ public:
         return m_server;
     }
 
+    // For KDSoapServer::RequestArena: the arena for parsing the next request in this thread.
+    // It's the one of the previous request, unless values of that request are still in use.
+    KDSoapValueArena::Ptr requestArena();
+
+    // For KDSoapServer::RequestArena: the size of the previous response written in this thread
+    int responseSizeHint() const
+    {
+        return m_responseSizeHint;
+    }
+    void setResponseSizeHint(int size)
+    {
+        m_responseSizeHint = size;
+    }
+
+    // The additionalHttpResponseHeaderItems() of the server object, as HTTP header lines.
+    // With KDSoapServer::StaticResponseHeaders, they are only rendered for the first response.
+    QByteArray additionalResponseHeaders();
+
+    // Milliseconds since the creation of the list, for the keep-alive timeouts
+    qint64 now() const
+    {
+        return m_clock.elapsed();
+    }
+    void setSocketActive(KDSoapServerSocket *socket, bool active);
+    // One timer for all the sockets of the thread: they are queued by expiry time
+    void scheduleExpiry(KDSoapServerSocket *socket);
+    void unscheduleExpiry(KDSoapServerSocket *socket);
+
 public Q_SLOTS:
     void socketDeleted(KDSoapServerSocket *socket);
 
+private Q_SLOTS:
+    void expireSockets();
+
 private:
     KDSoapServer *m_server;
     QObject *m_serverObject;
     QSet<KDSoapServerSocket *> m_sockets;
     QAtomicInt m_totalConnectionCount;
+    QAtomicInt m_activeSocketCount;
+    QElapsedTimer m_clock;
+    // The expiry times can only be later than the queued ones: they are checked again when they're reached
+    QMultiMap<qint64, KDSoapServerSocket *> m_expiryQueue;
+    QTimer m_expiryTimer;
+    KDSoapValueArena::Ptr m_requestArena;
+    int m_responseSizeHint;
+    QByteArray m_staticResponseHeaders;
+    bool m_staticResponseHeadersRendered;
 };
 
 #endif // KDSOAPSOCKETLIST_P_H
@@ -60,22 +60,22 @@ KDSoapServerThread *KDSoapThreadPool::Private::chooseNextThread()
 {
     KDSoapServerThread *chosenThread = nullptr;
     // Try to pick an existing thread
+    int minActiveSocketCount = 0;
     int minSocketCount = 0;
     KDSoapServerThread *bestThread = nullptr;
     for (KDSoapServerThread *thr : qAsConst(m_threads)) {
-        // We look at the amount of sockets connected to each thread, and pick the less busy one.
-        // Note that this isn't fully accurate, due to Keep-Alive: it's possible for long-term
-        // idling clients to be all on one thread, and active clients on another one, and this
-        // wouldn't use CPU fully. But this is probably still better than no keep-alive (much more
-        // connection overhead). Maybe we have to look at sockets who made a request in the last
-        // N seconds... but the past is no indication of the future.
         const int sc = thr->socketCount();
         if (sc == 0) { // Perfect, an idling thread
             // qDebug() << "Picked" << thr << "since it was idling";
             chosenThread = thr;
             break;
         }
-        if (!bestThread || sc < minSocketCount) {
+        // We look at the amount of active sockets in each thread, and pick the less busy one.
+        // Idle keep-alive connections don't use CPU, so they only break ties: they're spread
+        // over the threads too, since they'll become active again at some point.
+        const int asc = thr->activeSocketCount();
+        if (!bestThread || asc < minActiveSocketCount || (asc == minActiveSocketCount && sc < minSocketCount)) {
+            minActiveSocketCount = asc;
             minSocketCount = sc;
             bestThread = thr;
         }
@@ -9,8 +9,13 @@
 ****************************************************************************/
 
 #include "KDDateTime.h"
+#include "KDSoapMessage.h"
+#include "KDSoapNamespaceManager.h"
 #include "KDSoapValue.h"
 #include <QTest>
+#include <QXmlStreamWriter>
+
+#include <limits>
 
 class Basic : public QObject
 {
@@ -38,6 +43,138 @@ private Q_SLOTS:
 #endif
     }
 
+    void testValueMove()
+    {
+        KDSoapValue v1(QLatin1String("v1"), 10);
+        const KDSoapValue copy = v1;
+        KDSoapValue v2(std::move(v1));
+        QCOMPARE(v2.name(), QLatin1String("v1"));
+        QCOMPARE(v2.value().toInt(), 10);
+        // moved-from values are empty, and usable
+        QVERIFY(v1.isNull());
+        QVERIFY(v1.childValues().isEmpty());
+        v1.setName(QLatin1String("reused"));
+        QCOMPARE(v1.name(), QLatin1String("reused"));
+        KDSoapValue v3(QLatin1String("v3"), 3);
+        KDSoapValue v4(std::move(v3));
+        QVERIFY(v3.isNull()); // not modified by v1.setName()
+        v1 = KDSoapValue(QLatin1String("again"), 5);
+        QCOMPARE(v1.value().toInt(), 5);
+        v1 = std::move(v2);
+        QCOMPARE(v1.name(), QLatin1String("v1"));
+        QCOMPARE(v1, copy);
+
+        // childValues() is modifiable without detaching: the moved-from values don't share that list
+        KDSoapValue v5(QLatin1String("v5"), 5);
+        KDSoapValue v6(std::move(v5));
+        v5.childValues().addArgument(QLatin1String("child"), 1);
+        v5.childValues().attributes().append(KDSoapValue(QLatin1String("attribute"), 2));
+        QCOMPARE(v5.childValues().count(), 1);
+        KDSoapValue v7(QLatin1String("v7"), 7);
+        KDSoapValue v8(std::move(v7));
+        QVERIFY(v7.isNull());
+        QVERIFY(v7.childValues().isEmpty());
+        QVERIFY(v7.childValues().attributes().isEmpty());
+        QVERIFY(KDSoapValue(std::move(v8)).childValues().isEmpty());
+        QVERIFY(v8.childValues().isEmpty());
+
+        // Lists
+        KDSoapValueList list;
+        KDSoapValue child(QLatin1String("child"), QString::fromLatin1("text"));
+        list.append(std::move(child));
+        list.append(copy);
+        KDSoapValue &emplaced = list.emplaceBack(QLatin1String("emplaced"), 3);
+        emplaced.setQualified(true);
+        QCOMPARE(list.count(), 3);
+        QCOMPARE(list.at(0).value().toString(), QLatin1String("text"));
+        QCOMPARE(list.at(1), copy);
+        QVERIFY(list.at(2).isQualified());
+        QCOMPARE(list.at(2).value().toInt(), 3);
+
+        const KDSoapValue parent(QLatin1String("parent"), std::move(list));
+        QCOMPARE(parent.childValues().count(), 3);
+
+        // Messages
+        KDSoapMessage message;
+        message.setQualified(true);
+        KDSoapValueList args;
+        args.addArgument(QLatin1String("a"), 1);
+        message.addArgument(QLatin1String("list"), std::move(args));
+        message.addArgument(KDSoapValue(QLatin1String("b"), 2));
+        QCOMPARE(message.arguments().count(), 2);
+        QCOMPARE(message.arguments().at(0).childValues().count(), 1);
+        QVERIFY(message.arguments().at(1).isQualified());
+        message.setFault(true);
+        KDSoapMessage moved(std::move(message));
+        QVERIFY(moved.isFault());
+        QCOMPARE(moved.arguments().count(), 2);
+        QVERIFY(!message.isFault());
+        QVERIFY(message.arguments().isEmpty());
+        message.arguments().addArgument(QLatin1String("c"), 3);
+        KDSoapMessage other;
+        KDSoapMessage otherMoved(std::move(other));
+        QVERIFY(other.arguments().isEmpty());
+        message = moved;
+        QCOMPARE(message, moved);
+        KDSoapHeaders headers;
+        headers.append(std::move(moved));
+        QVERIFY(headers.first().isFault());
+        QCOMPARE(headers.first(), message);
+    }
+
+    void testChildLookup()
+    {
+        KDSoapValueList list;
+        for (int i = 0; i < 100; ++i) {
+            list.addArgument(QString::fromLatin1("field%1").arg(i % 50), i);
+        }
+        QCOMPARE(list.child(QLatin1String("field7")).value().toInt(), 7); // the first one
+        QCOMPARE(list.child(QString::fromLatin1("field49")).value().toInt(), 49);
+        QVERIFY(list.child(QLatin1String("field50")).isNull());
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+        QCOMPARE(list.child(QStringView(u"field8")).value().toInt(), 8);
+#endif
+
+        // Lookups follow the changes of the list
+        list.append(KDSoapValue(QLatin1String("field50"), 100));
+        QCOMPARE(list.child(QLatin1String("field50")).value().toInt(), 100);
+        list.removeFirst();
+        QCOMPARE(list.child(QLatin1String("field0")).value().toInt(), 50);
+        // Replaced in place, under a new name
+        list[7] = KDSoapValue(QLatin1String("replaced"), -1);
+        QCOMPARE(list.child(QLatin1String("replaced")).value().toInt(), -1);
+        QCOMPARE(list.child(QLatin1String("field8")).value().toInt(), 58);
+        // Edits which keep the size of the list
+        list.removeLast();
+        list.append(KDSoapValue(QLatin1String("appended"), 200));
+        QCOMPARE(list.child(QLatin1String("appended")).value().toInt(), 200);
+        QVERIFY(list.child(QLatin1String("field50")).isNull());
+        // A name put before its first occurrence
+        list[0] = KDSoapValue(QLatin1String("field30"), -2);
+        QCOMPARE(list.child(QLatin1String("field30")).value().toInt(), -2);
+        list.move(0, list.size() - 1);
+        QCOMPARE(list.child(QLatin1String("field30")).value().toInt(), 30);
+        const KDSoapValueList copy = list;
+        list.clear();
+        QVERIFY(list.child(QLatin1String("field2")).isNull());
+        QCOMPARE(copy.child(QLatin1String("field2")).value().toInt(), 2);
+
+        // Headers, by name and namespace
+        KDSoapHeaders headers;
+        for (int i = 0; i < 40; ++i) {
+            KDSoapMessage header;
+            header = KDSoapValue(QString::fromLatin1("header%1").arg(i % 20), i);
+            header.setNamespaceUri(i < 20 ? QString::fromLatin1("urn:a") : QString::fromLatin1("urn:b"));
+            headers.append(header);
+        }
+        QCOMPARE(headers.header(QLatin1String("header3")).value().toInt(), 3);
+        QCOMPARE(headers.header(QLatin1String("header3"), QLatin1String("urn:b")).value().toInt(), 23);
+        QCOMPARE(headers.header(QLatin1String("header3"), QString()).value().toInt(), 3);
+        QVERIFY(headers.header(QLatin1String("header3"), QLatin1String("urn:c")).name().isEmpty());
+        headers[3] = headers.at(24);
+        QCOMPARE(headers.header(QLatin1String("header4")).value().toInt(), 24);
+    }
+
     void testDateTime()
     {
         QDateTime qdt(QDate(2010, 12, 31), QTime(0, 0, 0));
@@ -52,6 +189,136 @@ private Q_SLOTS:
         kdt.setTimeZone(QString::fromLatin1("+01:00"));
         QCOMPARE(kdt.toDateString(), QString::fromLatin1("2011-03-15T23:59:59.999+01:00"));
     }
+
+    // The text of scalar values is formatted without QString, it must be the same as with QString
+    void testScalarText_data()
+    {
+        QTest::addColumn<QVariant>("value");
+        QTest::addColumn<QString>("expected");
+
+        QTest::newRow("int") << QVariant(-42) << QString::fromLatin1("-42");
+        QTest::newRow("uint") << QVariant(4000000000U) << QString::fromLatin1("4000000000");
+        QTest::newRow("min_longlong") << QVariant(std::numeric_limits<qlonglong>::min()) << QString::number(std::numeric_limits<qlonglong>::min());
+        QTest::newRow("max_ulonglong") << QVariant(std::numeric_limits<qulonglong>::max())
+                                       << QString::number(std::numeric_limits<qulonglong>::max());
+        QTest::newRow("true") << QVariant(true) << QString::fromLatin1("true");
+        QTest::newRow("false") << QVariant(false) << QString::fromLatin1("false");
+
+        const double doubles[] = {0.0, 1.0, -1.5, 0.1, 1.0 / 3, 10000.0, 1e6, 123456.0, 1234560.0, 0.001, 0.0001, 0.00012345, 1e-10, 3.14159, 1e21, 1.5e300, -2.5e-300};
+        for (const double d : doubles) {
+            const QString text = QString::number(d, 'g', QLocale::FloatingPointShortest);
+            QTest::newRow(qPrintable(QLatin1String("double ") + text)) << QVariant(d) << text;
+        }
+
+        QTest::newRow("date") << QVariant(QDate(2023, 2, 7)) << QString::fromLatin1("2023-02-07");
+        QTest::newRow("time") << QVariant(QTime(9, 5, 3)) << QString::fromLatin1("09:05:03");
+        QTest::newRow("time_ms") << QVariant(QTime(9, 5, 3, 7)) << QString::fromLatin1("09:05:03.007");
+        QTest::newRow("datetime_local") << QVariant(QDateTime(QDate(2010, 12, 31), QTime(1, 2, 3))) << QString::fromLatin1("2010-12-31T01:02:03");
+        QTest::newRow("datetime_utc") << QVariant(QDateTime(QDate(2010, 12, 31), QTime(1, 2, 3), Qt::UTC))
+                                      << QString::fromLatin1("2010-12-31T01:02:03Z");
+        QTest::newRow("datetime_offset") << QVariant(QDateTime(QDate(2010, 12, 31), QTime(1, 2, 3), Qt::OffsetFromUTC, -(5 * 3600 + 30 * 60)))
+                                         << QString::fromLatin1("2010-12-31T01:02:03-05:30");
+        KDDateTime kdt(QDateTime(QDate(2011, 3, 15), QTime(23, 59, 59, 999)));
+        kdt.setTimeZone(QString::fromLatin1("+01:00"));
+        QTest::newRow("kddatetime") << QVariant(kdt) << QString::fromLatin1("2011-03-15T23:59:59.999+01:00");
+    }
+
+    void testScalarText()
+    {
+        QFETCH(QVariant, value);
+        QFETCH(QString, expected);
+        const KDSoapValue soapValue(QLatin1String("v"), value);
+        const QString expectedXml = QLatin1String("<v>") + expected + QLatin1String("</v>");
+
+        QByteArray data;
+        QXmlStreamWriter writer(&data);
+        soapValue.writeLiteralElement(writer, QString());
+        QCOMPARE(QString::fromUtf8(data), expectedXml);
+
+        // Writers without a device get the text as a QString
+        QString str;
+        QXmlStreamWriter stringWriter(&str);
+        soapValue.writeLiteralElement(stringWriter, QString());
+        QCOMPARE(str, expectedXml);
+    }
+
+    void testBinaryValues_data()
+    {
+        QTest::addColumn<int>("size");
+        // around the sizes of the SIMD blocks and of the pieces written at once
+        const int sizes[] = {0, 1, 2, 3, 11, 12, 13, 16, 27, 28, 31, 32, 33, 100, 3071, 3072, 3073, 100000};
+        for (const int size : sizes) {
+            QTest::newRow(qPrintable(QString::number(size))) << size;
+        }
+    }
+
+    void testBinaryValues()
+    {
+        QFETCH(int, size);
+        QByteArray data(size, Qt::Uninitialized);
+        for (int i = 0; i < size; ++i) {
+            data[i] = char((i * 7919) >> 3);
+        }
+
+        // Writing
+        QByteArray xml;
+        QXmlStreamWriter writer(&xml);
+        KDSoapValue(QLatin1String("v"), data).writeLiteralElement(writer, QString());
+        QCOMPARE(xml, size ? "<v>" + data.toBase64() + "</v>" : QByteArray("<v/>"));
+        QByteArray hexXml;
+        QXmlStreamWriter hexWriter(&hexXml);
+        KDSoapValue(QLatin1String("v"), data, KDSoapNamespaceManager::xmlSchema2001(), QLatin1String("hexBinary")).writeLiteralElement(hexWriter, QString());
+        QCOMPARE(hexXml, size ? "<v>" + data.toHex() + "</v>" : QByteArray("<v/>"));
+
+        // Reading, from the QString the parser creates, with line breaks and padding
+        QByteArray base64 = data.toBase64();
+        for (int pos = 76; pos < base64.size(); pos += 77) {
+            base64.insert(pos, '\n');
+        }
+        QCOMPARE(KDSoapValue(QLatin1String("v"), QString::fromLatin1(base64)).base64BinaryValue(), data);
+        QCOMPARE(KDSoapValue(QLatin1String("v"), base64).base64BinaryValue(), data); // with xsi:type
+        const QByteArray hex = " " + data.toHex().toUpper() + "\n";
+        QCOMPARE(KDSoapValue(QLatin1String("v"), QString::fromLatin1(hex)).hexBinaryValue(), data);
+        QCOMPARE(KDSoapValue(QLatin1String("v"), hex).hexBinaryValue(), data);
+    }
+
+    // MIME-style line breaks, which can put the base64 groups anywhere relative to the decoded blocks
+    void testWrappedBase64_data()
+    {
+        QTest::addColumn<int>("lineLength");
+        QTest::addColumn<QByteArray>("lineBreak");
+        QTest::newRow("76, LF") << 76 << QByteArray("\n");
+        QTest::newRow("76, CRLF") << 76 << QByteArray("\r\n");
+        QTest::newRow("64, CRLF") << 64 << QByteArray("\r\n");
+        QTest::newRow("73, LF") << 73 << QByteArray("\n");
+        QTest::newRow("30, spaces") << 30 << QByteArray("   ");
+    }
+
+    void testWrappedBase64()
+    {
+        QFETCH(int, lineLength);
+        QFETCH(QByteArray, lineBreak);
+        QByteArray data(10000, Qt::Uninitialized);
+        for (int i = 0; i < data.size(); ++i) {
+            data[i] = char((i * 7919) >> 3);
+        }
+        const QByteArray base64 = data.toBase64();
+        QByteArray wrapped;
+        for (int pos = 0; pos < base64.size(); pos += lineLength) {
+            wrapped += base64.mid(pos, lineLength) + lineBreak;
+        }
+        QCOMPARE(KDSoapValue(QLatin1String("v"), QString::fromLatin1(wrapped)).base64BinaryValue(), data);
+        QCOMPARE(KDSoapValue(QLatin1String("v"), wrapped).base64BinaryValue(), data);
+    }
+
+    void testInvalidBinaryValues()
+    {
+        // Same results as QByteArray, which skips what isn't part of the encoding
+        const QString base64 = QString::fromUtf8("S0RT\u00e9b2Fw!!IHJvY2tz\u263a==");
+        QCOMPARE(KDSoapValue(QLatin1String("v"), base64).base64BinaryValue(), QByteArray::fromBase64(base64.toLatin1()));
+        const QString hex = QString::fromLatin1("abc:12 Zf");
+        QCOMPARE(KDSoapValue(QLatin1String("v"), hex).hexBinaryValue(), QByteArray::fromHex(hex.toLatin1()));
+    }
 };
 
 QTEST_MAIN(Basic)
@@ -0,0 +1,82 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#include "KDSoapValue.h"
+#include <QTest>
+#include <QXmlStreamWriter>
+
+class BinaryBenchmark : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void benchmarkBinaryWriting_data()
+    {
+        QTest::addColumn<int>("megabytes");
+        QTest::newRow("1MB") << 1;
+        QTest::newRow("10MB") << 10;
+        QTest::newRow("100MB") << 100;
+    }
+
+    void benchmarkBinaryWriting()
+    {
+        QFETCH(int, megabytes);
+        const KDSoapValue value(QLatin1String("v"), QByteArray(megabytes * 1024 * 1024, 'K'));
+        QBENCHMARK {
+            QByteArray xml;
+            QXmlStreamWriter writer(&xml);
+            value.writeLiteralElement(writer, QString());
+        }
+    }
+
+    void benchmarkBinaryReading_data()
+    {
+        benchmarkBinaryWriting_data();
+    }
+
+    void benchmarkBinaryReading()
+    {
+        QFETCH(int, megabytes);
+        const QByteArray data(megabytes * 1024 * 1024, 'K');
+        const KDSoapValue parsed(QLatin1String("v"), QString::fromLatin1(data.toBase64()));
+        QByteArray decoded;
+        QBENCHMARK {
+            decoded = parsed.base64BinaryValue();
+        }
+        QCOMPARE(decoded, data);
+    }
+
+    void benchmarkWrappedBinaryReading_data()
+    {
+        benchmarkBinaryWriting_data();
+    }
+
+    // With MIME line breaks every 76 characters, as some servers send
+    void benchmarkWrappedBinaryReading()
+    {
+        QFETCH(int, megabytes);
+        const QByteArray data(megabytes * 1024 * 1024, 'K');
+        const QByteArray base64 = data.toBase64();
+        QByteArray wrapped;
+        wrapped.reserve(base64.size() + base64.size() / 76 * 2 + 2);
+        for (int pos = 0; pos < base64.size(); pos += 76) {
+            wrapped += base64.mid(pos, 76) + "\r\n";
+        }
+        const KDSoapValue parsed(QLatin1String("v"), QString::fromLatin1(wrapped));
+        QByteArray decoded;
+        QBENCHMARK {
+            decoded = parsed.base64BinaryValue();
+        }
+        QCOMPARE(decoded, data);
+    }
+};
+
+QTEST_MAIN(BinaryBenchmark)
+
+#include "benchmark_binary.moc"
@@ -13,6 +13,7 @@
 #include "KDSoapMessage.h"
 #include "KDSoapNamespaceManager.h"
 #include "KDSoapPendingCallWatcher.h"
+#include "KDSoapRequestDevice_p.h"
 #include "KDSoapServer.h"
 #include "KDSoapServerObjectInterface.h"
 #include "KDSoapValue.h"
@@ -318,6 +319,20 @@ private Q_SLOTS:
         client.call(QLatin1String("test"), message, QString::fromLatin1("MySoapAction"));
         QVERIFY(xmlBufferCompare(server.receivedData(), expectedRequestXml + expectedRequestBody));
 
+        // Again, with the serialized persistent headers from the previous call
+        server.resetReceivedBuffers();
+        client.call(QLatin1String("test"), message, QString::fromLatin1("MySoapAction"));
+        QVERIFY(xmlBufferCompare(server.receivedData(), expectedRequestXml + expectedRequestBody));
+
+        // Changing the persistent header must not reuse them
+        server.resetReceivedBuffers();
+        KDSoapMessage header2;
+        header2.setUse(KDSoapMessage::EncodedUse);
+        header2.addArgument(QString::fromLatin1("header1"), QString::fromLatin1("otherValue"));
+        client.setHeader(QLatin1String("header1"), header2);
+        client.call(QLatin1String("test"), message, QString::fromLatin1("MySoapAction"));
+        QVERIFY(server.receivedData().contains("<n1:header1 xsi:type=\"xsd:string\">otherValue</n1:header1>"));
+
         // Now remove the persistent header (using setHeader + empty message)
         server.resetReceivedBuffers();
         client.setHeader(QLatin1String("header1"), KDSoapMessage());
@@ -328,6 +343,83 @@ private Q_SLOTS:
         QVERIFY(xmlBufferCompare(server.receivedData(), expectedRequestXmlNoHeader + expectedRequestBody));
     }
 
+    void testStreamingRequests()
+    {
+        HttpServerThread server(emptyResponse(), HttpServerThread::Public);
+        KDSoapClientInterface client(server.endPoint(), countryMessageNamespace());
+        KDSoapMessage message;
+        message.setUse(KDSoapMessage::EncodedUse);
+        message.addArgument(QString::fromLatin1("testString"), QString::fromUtf8("Hello Klarälvdalens"));
+
+        // Binary data bigger than what's serialized at once, and not a multiple of 3 bytes
+        QByteArray data(100000 + 1, Qt::Uninitialized);
+        for (int i = 0; i < data.size(); ++i) {
+            data[i] = char(i % 251);
+        }
+        KDSoapValueList valueList;
+        valueList.append(KDSoapValue(QString::fromLatin1("base64"), data));
+        valueList.append(KDSoapValue(QString::fromLatin1("hex"), data.left(30000), KDSoapNamespaceManager::xmlSchema2001(),
+                                     QString::fromLatin1("hexBinary")));
+        valueList.attributes().append(KDSoapValue(QString::fromLatin1("attr"), QString::fromLatin1("attrValue")));
+        message.addArgument(QString::fromLatin1("binary"), valueList);
+
+        KDSoapMessage header1;
+        header1.addArgument(QString::fromLatin1("header1"), QString::fromLatin1("headerValue"));
+        KDSoapHeaders headers;
+        headers << header1;
+
+        client.call(QLatin1String("test"), message, QString::fromLatin1("MySoapAction"), headers);
+        const QByteArray expectedRequestXml = server.receivedData();
+        QVERIFY(expectedRequestXml.contains(data.toBase64()));
+        QVERIFY(expectedRequestXml.contains(data.left(30000).toHex()));
+
+        QVERIFY(!client.streamingRequests());
+        client.setStreamingRequests(true);
+        QVERIFY(client.streamingRequests());
+        server.resetReceivedBuffers();
+        KDSoapMessage ret = client.call(QLatin1String("test"), message, QString::fromLatin1("MySoapAction"), headers);
+        QVERIFY(!ret.isFault());
+        QCOMPARE(server.receivedData(), expectedRequestXml);
+        QVERIFY(server.receivedHeaders().toLower().contains("content-length: " + QByteArray::number(expectedRequestXml.size())));
+
+        // Same thing with asyncCall
+        server.resetReceivedBuffers();
+        KDSoapPendingCall call = client.asyncCall(QLatin1String("test"), message, QString::fromLatin1("MySoapAction"), headers);
+        KDSoapPendingCallWatcher watcher(call);
+        QEventLoop loop;
+        connect(&watcher, &KDSoapPendingCallWatcher::finished, &loop, &QEventLoop::quit);
+        loop.exec();
+        QVERIFY(!call.returnMessage().isFault());
+        QCOMPARE(server.receivedData(), expectedRequestXml);
+    }
+
+    // Only a small part of a big request is in memory at any time, whatever the size of the reads
+    void testStreamingRequestBuffer()
+    {
+        KDSoapMessage message;
+        QByteArray data(10 * 1024 * 1024, Qt::Uninitialized);
+        for (int i = 0; i < data.size(); ++i) {
+            data[i] = char(i % 251);
+        }
+        message.addArgument(QString::fromLatin1("base64"), data);
+        message.addArgument(QString::fromLatin1("hex"), data.left(100000), KDSoapNamespaceManager::xmlSchema2001(), QString::fromLatin1("hexBinary"));
+
+        KDSoapMessageWriter writer;
+        writer.setMessageNamespace(countryMessageNamespace());
+        KDSoapRequestDevice device(writer, message, QString(), KDSoapHeaders(), QMap<QString, KDSoapMessage>(), KDSoapAuthentication());
+        const QByteArray expectedRequestXml = device.allData();
+        QCOMPARE(device.contentLength(), qint64(expectedRequestXml.size()));
+
+        QByteArray requestXml;
+        char buffer[1000];
+        qint64 length;
+        while ((length = device.read(buffer, sizeof(buffer))) > 0) {
+            requestXml.append(buffer, int(length));
+        }
+        QVERIFY(requestXml == expectedRequestXml);
+        QVERIFY2(device.peakBufferSize() < 64 * 1024, QByteArray::number(device.peakBufferSize()).constData());
+    }
+
     // Test parsing of complex replies, like with SugarCRM
     void testParseComplexReply()
     {
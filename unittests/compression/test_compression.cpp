@@ -0,0 +1,423 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#include "KDSoapClientInterface.h"
+#include "KDSoapCompression_p.h"
+#include "KDSoapMessage.h"
+#include "KDSoapNamespaceManager.h"
+#include "KDSoapPendingCallWatcher.h"
+#include "KDSoapServer.h"
+#include "KDSoapServerObjectInterface.h"
+#include "KDSoapValue.h"
+#include "httpserver_p.h"
+#include <QDebug>
+#include <QEventLoop>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QTest>
+
+using namespace KDSoapUnitTestHelpers;
+
+static const char s_ns[] = "http://www.kdab.com/xml/MyWsdl/";
+
+#define SKIP_WITHOUT_ZLIB()                                                                                                                          \
+    if (!KDSoapCompression::isAvailable()) {                                                                                                         \
+        QSKIP("KDSoap was built without zlib");                                                                                                      \
+    }
+
+static QString longText(int size)
+{
+    QString text;
+    text.reserve(size);
+    while (text.size() < size) {
+        text += QString::number(text.size() * 7919 % 1000) + QLatin1Char(' ');
+    }
+    return text;
+}
+
+class EchoServerObject : public QObject, public KDSoapServerObjectInterface
+{
+    Q_OBJECT
+    Q_INTERFACES(KDSoapServerObjectInterface)
+public:
+    void processRequest(const KDSoapMessage &request, KDSoapMessage &response, const QByteArray &soapAction) override
+    {
+        if (request.name() == QLatin1String("echoText")) {
+            const QString text = request.childValues().child(QLatin1String("text")).value().toString();
+            response.addArgument(QLatin1String("text"), text);
+            response.addArgument(QLatin1String("size"), text.size());
+        } else {
+            KDSoapServerObjectInterface::processRequest(request, response, soapAction);
+        }
+    }
+    HttpResponseHeaderItems additionalHttpResponseHeaderItems() const override
+    {
+        return {HttpResponseHeaderItem("X-Echo", "1")};
+    }
+};
+
+class EchoServer : public KDSoapServer
+{
+    Q_OBJECT
+public:
+    QObject *createServerObject() override
+    {
+        return new EchoServerObject;
+    }
+};
+
+static QNetworkReply *postAndWait(QNetworkAccessManager &manager, const QNetworkRequest &request, const QByteArray &data)
+{
+    QNetworkReply *reply = manager.post(request, data);
+    QEventLoop loop;
+    QObject::connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
+    loop.exec();
+    return reply;
+}
+
+static QByteArray echoTextRequest(const QString &text)
+{
+    return "<soap:Envelope xmlns:soap=\"http://schemas.xmlsoap.org/soap/envelope/\"><soap:Body>"
+           "<n1:echoText xmlns:n1=\"http://www.kdab.com/xml/MyWsdl/\"><text>"
+        + text.toUtf8() + "</text></n1:echoText></soap:Body></soap:Envelope>";
+}
+
+class CompressionTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testCodec_data()
+    {
+        QTest::addColumn<int>("encoding");
+        QTest::addColumn<QByteArray>("data");
+
+        const QByteArray text = longText(100000).toUtf8();
+        QByteArray binary(100000, Qt::Uninitialized);
+        quint32 seed = 1;
+        for (int i = 0; i < binary.size(); ++i) {
+            seed = seed * 1103515245 + 12345;
+            binary[i] = char(seed >> 16); // hardly compressible
+        }
+        QTest::newRow("gzip_empty") << int(KDSoapCompression::Gzip) << QByteArray();
+        QTest::newRow("gzip_text") << int(KDSoapCompression::Gzip) << text;
+        QTest::newRow("gzip_binary") << int(KDSoapCompression::Gzip) << binary;
+        QTest::newRow("deflate_empty") << int(KDSoapCompression::Deflate) << QByteArray();
+        QTest::newRow("deflate_text") << int(KDSoapCompression::Deflate) << text;
+        QTest::newRow("deflate_binary") << int(KDSoapCompression::Deflate) << binary;
+    }
+
+    void testCodec()
+    {
+        SKIP_WITHOUT_ZLIB();
+        QFETCH(int, encoding);
+        QFETCH(QByteArray, data);
+        const KDSoapCompression::Encoding enc = static_cast<KDSoapCompression::Encoding>(encoding);
+
+        // In pieces, the way MTOM packages are
+        const QVector<QByteArray> pieces = {data.left(data.size() / 3), QByteArray(), data.mid(data.size() / 3)};
+        QByteArray compressed;
+        QVERIFY(KDSoapCompression::compress(pieces, enc, -1, &compressed));
+        if (enc == KDSoapCompression::Gzip) {
+            QVERIFY(compressed.startsWith("\x1f\x8b"));
+        }
+        QByteArray decompressed;
+        QVERIFY(KDSoapCompression::decompress(compressed, enc, &decompressed));
+        QCOMPARE(decompressed, data);
+
+        QByteArray fastest;
+        QVERIFY(KDSoapCompression::compress({data}, enc, 1, &fastest));
+        QVERIFY(KDSoapCompression::decompress(fastest, enc, &decompressed));
+        QCOMPARE(decompressed, data);
+
+        if (!data.isEmpty()) {
+            QVERIFY(!KDSoapCompression::decompress(compressed.left(compressed.size() / 2), enc, &decompressed)); // truncated
+        }
+        QVERIFY(!KDSoapCompression::decompress(QByteArray("not compressed at all"), enc, &decompressed));
+    }
+
+    void testMaximumDecompressedSize_data()
+    {
+        QTest::addColumn<int>("encoding");
+
+        QTest::newRow("gzip") << int(KDSoapCompression::Gzip);
+        QTest::newRow("deflate") << int(KDSoapCompression::Deflate);
+    }
+
+    void testMaximumDecompressedSize()
+    {
+        SKIP_WITHOUT_ZLIB();
+        QFETCH(int, encoding);
+        const KDSoapCompression::Encoding enc = static_cast<KDSoapCompression::Encoding>(encoding);
+
+        // 4 MB of zeros compress to a few KB
+        const QByteArray data(4 * 1024 * 1024, '\0');
+        QByteArray compressed;
+        QVERIFY(KDSoapCompression::compress({data}, enc, -1, &compressed));
+        QVERIFY(compressed.size() < 16 * 1024);
+
+        QByteArray decompressed;
+        bool tooLarge = true;
+        QVERIFY(KDSoapCompression::decompress(compressed, enc, &decompressed, data.size(), &tooLarge));
+        QVERIFY(!tooLarge);
+        QCOMPARE(decompressed, data);
+
+        QVERIFY(!KDSoapCompression::decompress(compressed, enc, &decompressed, data.size() - 1, &tooLarge));
+        QVERIFY(tooLarge);
+        QVERIFY(decompressed.isEmpty());
+        QVERIFY(!KDSoapCompression::decompress(compressed, enc, &decompressed, 1000, &tooLarge));
+        QVERIFY(tooLarge);
+
+        // Invalid data isn't reported as too large
+        QVERIFY(!KDSoapCompression::decompress(compressed.left(compressed.size() / 2), enc, &decompressed, data.size(), &tooLarge));
+        QVERIFY(!tooLarge);
+    }
+
+    void testEncodingNames()
+    {
+        QCOMPARE(KDSoapCompression::contentEncoding(""), KDSoapCompression::Identity);
+        QCOMPARE(KDSoapCompression::contentEncoding("identity"), KDSoapCompression::Identity);
+        QCOMPARE(KDSoapCompression::contentEncoding(" GZIP "), KDSoapCompression::Gzip);
+        QCOMPARE(KDSoapCompression::contentEncoding("x-gzip"), KDSoapCompression::Gzip);
+        QCOMPARE(KDSoapCompression::contentEncoding("deflate"), KDSoapCompression::Deflate);
+        QCOMPARE(KDSoapCompression::contentEncoding("br"), KDSoapCompression::Unsupported);
+        QCOMPARE(KDSoapCompression::name(KDSoapCompression::Gzip), QByteArray("gzip"));
+        QCOMPARE(KDSoapCompression::name(KDSoapCompression::Deflate), QByteArray("deflate"));
+    }
+
+    void testAcceptedEncoding()
+    {
+        SKIP_WITHOUT_ZLIB();
+        QCOMPARE(KDSoapCompression::acceptedEncoding(""), KDSoapCompression::Identity);
+        QCOMPARE(KDSoapCompression::acceptedEncoding("gzip, deflate"), KDSoapCompression::Gzip);
+        QCOMPARE(KDSoapCompression::acceptedEncoding("deflate, gzip"), KDSoapCompression::Gzip);
+        QCOMPARE(KDSoapCompression::acceptedEncoding("deflate"), KDSoapCompression::Deflate);
+        QCOMPARE(KDSoapCompression::acceptedEncoding("gzip;q=0.5, deflate"), KDSoapCompression::Deflate);
+        QCOMPARE(KDSoapCompression::acceptedEncoding("gzip;q=0, deflate;q=0"), KDSoapCompression::Identity);
+        QCOMPARE(KDSoapCompression::acceptedEncoding("br, zstd"), KDSoapCompression::Identity);
+        QCOMPARE(KDSoapCompression::acceptedEncoding("*"), KDSoapCompression::Gzip);
+        QCOMPARE(KDSoapCompression::acceptedEncoding("compress"), KDSoapCompression::Identity);
+    }
+
+    void testCompressedRequest_data()
+    {
+        QTest::addColumn<int>("compression");
+        QTest::addColumn<int>("textSize");
+        QTest::addColumn<QByteArray>("expectedEncoding");
+
+        QTest::newRow("none") << int(KDSoapClientInterface::NoCompression) << 10000 << QByteArray();
+        QTest::newRow("gzip") << int(KDSoapClientInterface::GzipCompression) << 10000 << QByteArray("gzip");
+        QTest::newRow("deflate") << int(KDSoapClientInterface::DeflateCompression) << 10000 << QByteArray("deflate");
+        QTest::newRow("below_threshold") << int(KDSoapClientInterface::GzipCompression) << 10 << QByteArray();
+    }
+
+    void testCompressedRequest()
+    {
+        SKIP_WITHOUT_ZLIB();
+        QFETCH(int, compression);
+        QFETCH(int, textSize);
+        QFETCH(QByteArray, expectedEncoding);
+
+        const QByteArray response = "<?xml version=\"1.0\" encoding=\"UTF-8\"?><soap:Envelope xmlns:soap=\"http://schemas.xmlsoap.org/soap/envelope/\">"
+                                    "<soap:Body><n1:echoTextResponse xmlns:n1=\"http://www.kdab.com/xml/MyWsdl/\"><size>5</size>"
+                                    "</n1:echoTextResponse></soap:Body></soap:Envelope>";
+        HttpServerThread server(response, HttpServerThread::Public);
+        KDSoapClientInterface client(server.endPoint(), QString::fromLatin1(s_ns));
+        QCOMPARE(client.requestCompression(), KDSoapClientInterface::NoCompression);
+        QCOMPARE(client.compressionThreshold(), 1024);
+        client.setRequestCompression(static_cast<KDSoapClientInterface::Compression>(compression));
+        client.setCompressionLevel(9);
+
+        const QString text = longText(textSize);
+        KDSoapMessage message;
+        message.addArgument(QLatin1String("text"), text);
+        const KDSoapMessage reply = client.call(QLatin1String("echoText"), message);
+        QVERIFY(!reply.isFault());
+        QCOMPARE(reply.childValues().child(QLatin1String("size")).value().toInt(), 5);
+
+        QCOMPARE(server.header("Content-Encoding"), expectedEncoding);
+        QByteArray xml = server.receivedData();
+        if (!expectedEncoding.isEmpty()) {
+            QVERIFY(xml.size() < text.size() / 2);
+            QVERIFY(KDSoapCompression::decompress(server.receivedData(), KDSoapCompression::contentEncoding(expectedEncoding), &xml));
+        }
+        QVERIFY(xml.contains(text.toUtf8()));
+
+        // Compressed responses are accepted, and decompressed by QNetworkAccessManager
+        QVERIFY(server.header("Accept-Encoding").contains("gzip"));
+    }
+
+    void testCallServer_data()
+    {
+        QTest::addColumn<int>("compression");
+        QTest::addColumn<bool>("mtom");
+
+        QTest::newRow("none") << int(KDSoapClientInterface::NoCompression) << false;
+        QTest::newRow("gzip") << int(KDSoapClientInterface::GzipCompression) << false;
+        QTest::newRow("deflate") << int(KDSoapClientInterface::DeflateCompression) << false;
+        QTest::newRow("gzip_mtom") << int(KDSoapClientInterface::GzipCompression) << true;
+    }
+
+    void testCallServer()
+    {
+        SKIP_WITHOUT_ZLIB();
+        QFETCH(int, compression);
+        QFETCH(bool, mtom);
+
+        TestServerThread<EchoServer> serverThread;
+        EchoServer *server = serverThread.startThread();
+        QVERIFY(server);
+        server->setFeatures(KDSoapServer::ResponseCompression);
+        KDSoapClientInterface client(server->endPoint(), QString::fromLatin1(s_ns));
+        client.setRequestCompression(static_cast<KDSoapClientInterface::Compression>(compression));
+        client.setMtomRequests(mtom);
+
+        const QString text = longText(100000);
+        KDSoapMessage message;
+        message.addArgument(QLatin1String("text"), text);
+        const KDSoapMessage response = client.call(QLatin1String("echoText"), message);
+        QVERIFY2(!response.isFault(), qPrintable(response.faultAsString()));
+        QCOMPARE(response.childValues().child(QLatin1String("size")).value().toInt(), text.size());
+        QCOMPARE(response.childValues().child(QLatin1String("text")).value().toString(), text);
+
+        // Asynchronously too
+        KDSoapPendingCall call = client.asyncCall(QLatin1String("echoText"), message);
+        KDSoapPendingCallWatcher watcher(call);
+        QEventLoop loop;
+        connect(&watcher, &KDSoapPendingCallWatcher::finished, &loop, &QEventLoop::quit);
+        loop.exec();
+        QCOMPARE(call.returnMessage().childValues().child(QLatin1String("text")).value().toString(), text);
+    }
+
+    void testCompressedResponse_data()
+    {
+        QTest::addColumn<bool>("enabled");
+        QTest::addColumn<QByteArray>("acceptEncoding");
+        QTest::addColumn<int>("textSize");
+        QTest::addColumn<QByteArray>("expectedEncoding");
+
+        QTest::newRow("gzip") << true << QByteArray("gzip, deflate") << 10000 << QByteArray("gzip");
+        QTest::newRow("deflate") << true << QByteArray("deflate") << 10000 << QByteArray("deflate");
+        QTest::newRow("not_accepted") << true << QByteArray("br") << 10000 << QByteArray();
+        QTest::newRow("below_threshold") << true << QByteArray("gzip") << 10 << QByteArray();
+        QTest::newRow("disabled") << false << QByteArray("gzip") << 10000 << QByteArray();
+    }
+
+    void testCompressedResponse()
+    {
+        SKIP_WITHOUT_ZLIB();
+        QFETCH(bool, enabled);
+        QFETCH(QByteArray, acceptEncoding);
+        QFETCH(int, textSize);
+        QFETCH(QByteArray, expectedEncoding);
+
+        TestServerThread<EchoServer> serverThread;
+        EchoServer *server = serverThread.startThread();
+        QVERIFY(server);
+        QCOMPARE(server->compressionThreshold(), 1024);
+        server->setCompressionThreshold(2000);
+        QCOMPARE(server->compressionThreshold(), 2000);
+        server->setCompressionLevel(1);
+        QCOMPARE(server->compressionLevel(), 1);
+        if (enabled) {
+            server->setFeatures(KDSoapServer::ResponseCompression);
+        }
+
+        // QNetworkAccessManager leaves the response alone when the Accept-Encoding header is ours
+        QNetworkAccessManager manager;
+        QNetworkRequest request(QUrl(server->endPoint()));
+        request.setHeader(QNetworkRequest::ContentTypeHeader, QByteArray("text/xml"));
+        request.setRawHeader("SoapAction", "\"http://www.kdab.com/xml/MyWsdl/echoText\"");
+        request.setRawHeader("Accept-Encoding", acceptEncoding);
+        const QString text = longText(textSize);
+        QNetworkReply *reply = postAndWait(manager, request, echoTextRequest(text));
+        QCOMPARE(reply->error(), QNetworkReply::NoError);
+        QCOMPARE(reply->rawHeader("Content-Encoding"), expectedEncoding);
+        const QByteArray body = reply->readAll();
+        QCOMPARE(reply->header(QNetworkRequest::ContentLengthHeader).toInt(), body.size());
+        QByteArray xml = body;
+        if (!expectedEncoding.isEmpty()) {
+            QVERIFY(body.size() < text.size() / 2);
+            QVERIFY(KDSoapCompression::decompress(body, KDSoapCompression::contentEncoding(expectedEncoding), &xml));
+        }
+        QVERIFY(xml.contains("<text>" + text.toUtf8() + "</text>"));
+        delete reply;
+    }
+
+    void testInvalidRequestEncoding_data()
+    {
+        QTest::addColumn<QByteArray>("contentEncoding");
+        QTest::addColumn<int>("expectedStatus");
+
+        QTest::newRow("unsupported") << QByteArray("br") << 415;
+        QTest::newRow("corrupt") << QByteArray("gzip") << 400;
+    }
+
+    void testInvalidRequestEncoding()
+    {
+        SKIP_WITHOUT_ZLIB();
+        QFETCH(QByteArray, contentEncoding);
+        QFETCH(int, expectedStatus);
+
+        TestServerThread<EchoServer> serverThread;
+        EchoServer *server = serverThread.startThread();
+        QVERIFY(server);
+
+        QNetworkAccessManager manager;
+        QNetworkRequest request(QUrl(server->endPoint()));
+        request.setHeader(QNetworkRequest::ContentTypeHeader, QByteArray("text/xml"));
+        request.setRawHeader("Content-Encoding", contentEncoding);
+        QNetworkReply *reply = postAndWait(manager, request, echoTextRequest(QStringLiteral("hello")));
+        QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), expectedStatus);
+        if (expectedStatus == 415) {
+            QCOMPARE(reply->rawHeader("Accept-Encoding"), QByteArray("gzip, deflate"));
+        }
+        // The error responses have the additional headers too
+        QCOMPARE(reply->rawHeader("X-Echo"), QByteArray("1"));
+        delete reply;
+    }
+
+    void testTooLargeRequest()
+    {
+        SKIP_WITHOUT_ZLIB();
+        TestServerThread<EchoServer> serverThread;
+        EchoServer *server = serverThread.startThread();
+        QVERIFY(server);
+        QCOMPARE(server->maxDecompressedRequestSize(), 16 * 1024 * 1024);
+        server->setMaxDecompressedRequestSize(100 * 1000);
+
+        const QByteArray small = echoTextRequest(longText(50 * 1000));
+        const QByteArray large = echoTextRequest(longText(200 * 1000));
+        QByteArray compressedSmall;
+        QByteArray compressedLarge;
+        QVERIFY(KDSoapCompression::compress({small}, KDSoapCompression::Gzip, -1, &compressedSmall));
+        QVERIFY(KDSoapCompression::compress({large}, KDSoapCompression::Gzip, -1, &compressedLarge));
+
+        QNetworkAccessManager manager;
+        QNetworkRequest request(QUrl(server->endPoint()));
+        request.setHeader(QNetworkRequest::ContentTypeHeader, QByteArray("text/xml"));
+        request.setRawHeader("Content-Encoding", "gzip");
+
+        QNetworkReply *reply = postAndWait(manager, request, compressedLarge);
+        QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 413);
+        QCOMPARE(reply->rawHeader("X-Echo"), QByteArray("1"));
+        delete reply;
+
+        reply = postAndWait(manager, request, compressedSmall);
+        QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 200);
+        QVERIFY(reply->readAll().contains("echoTextResponse"));
+        delete reply;
+    }
+};
+
+QTEST_MAIN(CompressionTest)
+
+#include "test_compression.moc"
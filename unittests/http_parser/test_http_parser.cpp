@@ -0,0 +1,334 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#include "KDSoapHttpRequestParser_p.h"
+#include <QTest>
+
+#include <cstring>
+
+static QByteArray contentLengthRequest(const QByteArray &body)
+{
+    return "POST /path/../service?x=1 HTTP/1.1\r\n"
+           "SoapAction: \"http://www.kdab.com/xml/MyWsdl/getEmployeeCountry\"\r\n"
+           "Content-Type: text/xml;charset=utf-8\r\n"
+           "Content-Length: "
+        + QByteArray::number(body.size())
+        + "\r\n"
+          "\r\n"
+        + body;
+}
+
+static QByteArray chunkedRequest(const QByteArray &body, int chunkSize, const QByteArray &trailers)
+{
+    QByteArray request = "POST / HTTP/1.1\r\n"
+                         "Transfer-Encoding: chunked\r\n"
+                         "\r\n";
+    for (int pos = 0; pos < body.size(); pos += chunkSize) {
+        const QByteArray chunk = body.mid(pos, chunkSize);
+        request += QByteArray::number(chunk.size(), 16) + (pos == 0 ? ";name=value" : "") + "\r\n" + chunk + "\r\n";
+    }
+    return request + "0\r\n" + trailers + "\r\n";
+}
+
+// The way KDSoapServerSocket reads: straight into the parser's buffers
+static void feed(KDSoapHttpRequestParser &parser, const QByteArray &data, int pieceSize)
+{
+    for (int pos = 0; pos < data.size(); pos += pieceSize) {
+        const int size = qMin(pieceSize, data.size() - pos);
+        char *dest = parser.prepareWrite(size);
+        memcpy(dest, data.constData() + pos, size);
+        parser.commit(size);
+    }
+}
+
+static QByteArray body(int size)
+{
+    QByteArray data(size, Qt::Uninitialized);
+    for (int i = 0; i < size; ++i) {
+        data[i] = char('a' + i % 26);
+    }
+    return data;
+}
+
+class HttpParserTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testContentLength_data()
+    {
+        QTest::addColumn<int>("pieceSize");
+
+        QTest::newRow("1") << 1;
+        QTest::newRow("3") << 3;
+        QTest::newRow("100") << 100;
+        QTest::newRow("all") << 100000;
+    }
+
+    void testContentLength()
+    {
+        QFETCH(int, pieceSize);
+        const QByteArray data = body(5000);
+        const QByteArray request = contentLengthRequest(data);
+
+        KDSoapHttpRequestParser parser;
+        feed(parser, request.left(request.size() - 1), pieceSize);
+        QVERIFY(parser.headersComplete());
+        QCOMPARE(parser.state(), KDSoapHttpRequestParser::ReadingBody);
+        QVERIFY(!parser.isChunked());
+        feed(parser, request.right(1), pieceSize);
+        QCOMPARE(parser.state(), KDSoapHttpRequestParser::Done);
+
+        QCOMPARE(parser.headers().requestType(), QByteArray("POST"));
+        QCOMPARE(parser.headers().path(), QByteArray("/service?x=1"));
+        QCOMPARE(parser.headers().value(KDSoapHttpHeaderView::SoapAction), QByteArray("\"http://www.kdab.com/xml/MyWsdl/getEmployeeCountry\""));
+        QCOMPARE(parser.headers().value(KDSoapHttpHeaderView::ContentType), QByteArray("text/xml;charset=utf-8"));
+        QCOMPARE(parser.body(), data);
+
+        // Ready for the next request
+        parser.reset();
+        QVERIFY(!parser.headersComplete());
+        QVERIFY(parser.body().isEmpty());
+        feed(parser, request, pieceSize);
+        QCOMPARE(parser.state(), KDSoapHttpRequestParser::Done);
+        QCOMPARE(parser.body(), data);
+    }
+
+    void testBodyReserved()
+    {
+        // The body is allocated once, from the Content-Length, and filled in place
+        const QByteArray data = body(60000);
+        const QByteArray request = contentLengthRequest(data);
+        const int headersSize = request.size() - data.size();
+
+        KDSoapHttpRequestParser parser;
+        feed(parser, request.left(headersSize + 10), 7);
+        QCOMPARE(parser.state(), KDSoapHttpRequestParser::ReadingBody);
+        QCOMPARE(parser.body().size(), 10);
+        QVERIFY(parser.body().capacity() >= data.size());
+        const char *storage = parser.body().constData();
+        feed(parser, request.mid(headersSize + 10), 1000);
+        QCOMPARE(parser.state(), KDSoapHttpRequestParser::Done);
+        QCOMPARE(parser.body().constData(), storage);
+        QCOMPARE(parser.body(), data);
+    }
+
+    void testBodyReservationLimit()
+    {
+        // Only a part of a big body is allocated upfront, the client might never send it
+        KDSoapHttpRequestParser parser;
+        feed(parser, "POST / HTTP/1.1\r\nContent-Length: 1000000000\r\n\r\n", 100);
+        QCOMPARE(parser.state(), KDSoapHttpRequestParser::ReadingBody);
+        QVERIFY(parser.body().capacity() <= 64 * 1024);
+
+        // The rest grows as the data arrives
+        const QByteArray data = body(1000000);
+        feed(parser, data, 10000);
+        QCOMPARE(parser.state(), KDSoapHttpRequestParser::ReadingBody);
+        QCOMPARE(parser.body(), data);
+    }
+
+    void testNoBody()
+    {
+        KDSoapHttpRequestParser parser;
+        feed(parser, "GET /file.txt HTTP/1.1\r\nHost: localhost\r\n\r", 1);
+        QVERIFY(!parser.headersComplete());
+        feed(parser, "\n", 1);
+        QCOMPARE(parser.state(), KDSoapHttpRequestParser::Done);
+        QCOMPARE(parser.headers().requestType(), QByteArray("GET"));
+        QCOMPARE(parser.headers().value("host"), QByteArray("localhost"));
+        QVERIFY(parser.body().isEmpty());
+    }
+
+    void testHeaderView()
+    {
+        const QByteArray block = "POST /a/./b/../c?q=/.. HTTP/1.1\r\n"
+                                 "content-TYPE: text/xml\r\n"
+                                 "X-Custom:   spaces around  \r\n"
+                                 "Authorization: Basic abc=\r\n"
+                                 "not a header\r\n"
+                                 "Content-Length: 42\r\n"
+                                 "x-custom: last one";
+        KDSoapHttpHeaderView headers;
+        QVERIFY(headers.parse(block.constData(), block.size()));
+        QVERIFY(headers.isValid());
+        QCOMPARE(headers.requestType(), QByteArray("POST"));
+        QCOMPARE(headers.httpVersion(), QByteArray("HTTP/1.1"));
+        QCOMPARE(headers.path(), QByteArray("/a/c?q=/.."));
+        QCOMPARE(headers.value(KDSoapHttpHeaderView::ContentType), QByteArray("text/xml"));
+        QCOMPARE(headers.value(KDSoapHttpHeaderView::Authorization), QByteArray("Basic abc="));
+        QCOMPARE(headers.contentLength(), 42);
+        QVERIFY(headers.valueEquals(KDSoapHttpHeaderView::ContentType, "TEXT/XML"));
+        QVERIFY(!headers.contains(KDSoapHttpHeaderView::SoapAction));
+        QVERIFY(headers.value(KDSoapHttpHeaderView::SoapAction).isNull());
+        QCOMPARE(headers.value("X-CUSTOM"), QByteArray("last one"));
+        QVERIFY(headers.value("x-other").isNull());
+
+        // For the public interfaces
+        const QMap<QByteArray, QByteArray> map = headers.toMap();
+        QCOMPARE(map.value("_requestType"), QByteArray("POST"));
+        QCOMPARE(map.value("_path"), QByteArray("/a/c?q=/.."));
+        QCOMPARE(map.value("_httpVersion"), QByteArray("HTTP/1.1"));
+        QCOMPARE(map.value("content-type"), QByteArray("text/xml"));
+        QCOMPARE(map.value("x-custom"), QByteArray("last one"));
+        QCOMPARE(map.value("content-length"), QByteArray("42"));
+        QCOMPARE(map.size(), 7);
+
+        const QByteArray malformed = "POST/ HTTP/1.1\r\nContent-Type: text/xml";
+        QVERIFY(!headers.parse(malformed.constData(), malformed.size()));
+        QVERIFY(!headers.isValid());
+        QVERIFY(!headers.contains(KDSoapHttpHeaderView::ContentType));
+        QVERIFY(headers.toMap().isEmpty());
+    }
+
+    void testInvalidContentLength()
+    {
+        KDSoapHttpHeaderView headers;
+        for (const char *value : {"abc", "-5", "99999999999", ""}) {
+            const QByteArray block = "POST / HTTP/1.1\r\nContent-Length: " + QByteArray(value);
+            QVERIFY(headers.parse(block.constData(), block.size()));
+            QCOMPARE(headers.contentLength(), 0);
+        }
+    }
+
+    void testChunked_data()
+    {
+        QTest::addColumn<int>("chunkSize");
+        QTest::addColumn<int>("pieceSize");
+        QTest::addColumn<QByteArray>("trailers");
+
+        QTest::newRow("bytes") << 100 << 1 << QByteArray();
+        QTest::newRow("bytes_trailers") << 100 << 1 << QByteArray("Ignore: me\r\n");
+        QTest::newRow("small_chunks") << 5 << 7 << QByteArray("Ignore: me\r\nAnd: me\r\n");
+        QTest::newRow("one_piece") << 1000 << 100000 << QByteArray();
+    }
+
+    void testChunked()
+    {
+        QFETCH(int, chunkSize);
+        QFETCH(int, pieceSize);
+        QFETCH(QByteArray, trailers);
+        const QByteArray data = body(3000);
+        const QByteArray request = chunkedRequest(data, chunkSize, trailers);
+
+        KDSoapHttpRequestParser parser;
+        feed(parser, request.left(request.size() - 1), pieceSize);
+        QVERIFY(parser.isChunked());
+        QCOMPARE(parser.state(), KDSoapHttpRequestParser::ReadingTrailers);
+        QCOMPARE(parser.body(), data);
+        feed(parser, request.right(1), pieceSize);
+        QCOMPARE(parser.state(), KDSoapHttpRequestParser::Done);
+        QCOMPARE(parser.body(), data);
+    }
+
+    void testStreamedBody()
+    {
+        // The raw XML interface takes the body as it arrives
+        const QByteArray data = body(3000);
+        const QByteArray request = chunkedRequest(data, 100, QByteArray());
+        KDSoapHttpRequestParser parser;
+        QByteArray streamed;
+        for (int pos = 0; pos < request.size(); pos += 50) {
+            feed(parser, request.mid(pos, 50), 50);
+            streamed += parser.body();
+            parser.body().clear();
+        }
+        QCOMPARE(parser.state(), KDSoapHttpRequestParser::Done);
+        QCOMPARE(streamed, data);
+    }
+
+    void testPipelining_data()
+    {
+        QTest::addColumn<int>("pieceSize");
+
+        QTest::newRow("1") << 1;
+        QTest::newRow("100") << 100;
+        QTest::newRow("all") << 100000;
+    }
+
+    void testPipelining()
+    {
+        // Several requests received at once, each one is parsed after the previous one was handled
+        QFETCH(int, pieceSize);
+        const QByteArray data1 = body(3000);
+        const QByteArray data2 = body(50);
+        const QByteArray requests =
+            contentLengthRequest(data1) + chunkedRequest(data2, 20, QByteArray()) + "GET /file.txt HTTP/1.1\r\n\r\n" + contentLengthRequest(data2);
+
+        KDSoapHttpRequestParser parser;
+        feed(parser, requests, pieceSize);
+        // Nothing is parsed after the first request, until it's handled
+        QCOMPARE(parser.state(), KDSoapHttpRequestParser::Done);
+        QVERIFY(!parser.isChunked());
+        QCOMPARE(parser.body(), data1);
+
+        parser.startNextRequest();
+        QCOMPARE(parser.state(), KDSoapHttpRequestParser::Done);
+        QVERIFY(parser.isChunked());
+        QCOMPARE(parser.body(), data2);
+
+        parser.startNextRequest();
+        QCOMPARE(parser.state(), KDSoapHttpRequestParser::Done);
+        QCOMPARE(parser.headers().requestType(), QByteArray("GET"));
+        QVERIFY(parser.body().isEmpty());
+
+        parser.startNextRequest();
+        QCOMPARE(parser.state(), KDSoapHttpRequestParser::Done);
+        QCOMPARE(parser.headers().requestType(), QByteArray("POST"));
+        QCOMPARE(parser.body(), data2);
+
+        parser.startNextRequest();
+        QCOMPARE(parser.state(), KDSoapHttpRequestParser::ReadingHeaders);
+        feed(parser, contentLengthRequest(data1), pieceSize);
+        QCOMPARE(parser.state(), KDSoapHttpRequestParser::Done);
+        QCOMPARE(parser.body(), data1);
+    }
+
+    void testBadChunkSize_data()
+    {
+        QTest::addColumn<QByteArray>("chunks");
+
+        QTest::newRow("not_hex") << QByteArray("zz\r\nabc\r\n0\r\n\r\n");
+        QTest::newRow("no_crlf_after_data") << QByteArray("3\r\nabcdef\r\n0\r\n\r\n");
+    }
+
+    void testBadChunkSize()
+    {
+        QFETCH(QByteArray, chunks);
+        KDSoapHttpRequestParser parser;
+        feed(parser, "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n" + chunks, 1);
+        QCOMPARE(parser.state(), KDSoapHttpRequestParser::Error);
+    }
+
+    void benchmarkSlowUpload_data()
+    {
+        QTest::addColumn<bool>("chunked");
+
+        QTest::newRow("content_length") << false;
+        QTest::newRow("chunked") << true;
+    }
+
+    // A large body arriving in small pieces: linear in the size of the request
+    void benchmarkSlowUpload()
+    {
+        QFETCH(bool, chunked);
+        const QByteArray data = body(1024 * 1024);
+        const QByteArray request = chunked ? chunkedRequest(data, 4000, QByteArray()) : contentLengthRequest(data);
+        QBENCHMARK {
+            KDSoapHttpRequestParser parser;
+            feed(parser, request, 500);
+            QCOMPARE(parser.state(), KDSoapHttpRequestParser::Done);
+        }
+    }
+};
+
+QTEST_MAIN(HttpParserTest)
+
+#include "test_http_parser.moc"
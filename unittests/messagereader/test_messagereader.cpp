@@ -8,10 +8,76 @@
 **
 ****************************************************************************/
 
+#include "KDQName.h"
+#include "KDSoapAtomTable_p.h"
 #include "KDSoapMessage.h"
 #include "KDSoapMessageReader_p.h"
+#include "KDSoapNamespaceManager.h"
 #include <QDebug>
+#include <QSet>
 #include <QTest>
+#include <QThread>
+#include <QXmlStreamReader>
+
+// Collects the string buffers used by names, namespaces and types in a tree of values
+static void collectNameBuffers(const KDSoapValue &value, QSet<const QChar *> *buffers, int *nodes)
+{
+    ++*nodes;
+    buffers->insert(value.name().constData());
+    buffers->insert(value.namespaceUri().constData());
+    buffers->insert(value.type().constData());
+    for (const KDSoapValue &child : value.childValues()) {
+        collectNameBuffers(child, buffers, nodes);
+    }
+}
+
+// Describes a tree of values, to compare lazily and fully parsed messages
+static QString dumpValue(const KDSoapValue &value)
+{
+    QString str = value.namespaceUri() + QLatin1Char(':') + value.name() + QLatin1Char('[') + value.typeNs() + QLatin1Char(':') + value.type()
+        + QLatin1String("]=") + value.value().toString();
+    for (const KDSoapValue &attr : value.childValues().attributes()) {
+        str += QLatin1String(" @") + attr.name() + QLatin1Char('=') + attr.value().toString();
+    }
+    str += QLatin1String(" {");
+    for (const KDSoapValue &child : value.childValues()) {
+        str += dumpValue(child) + QLatin1Char(';');
+    }
+    return str + QLatin1Char('}');
+}
+
+static QByteArray repeatedElementsMessage(int count)
+{
+    QByteArray xml = "<soapenv:Envelope xmlns:soapenv=\"http://schemas.xmlsoap.org/soap/envelope/\" "
+                     "xmlns:xsd=\"http://www.w3.org/2001/XMLSchema\" xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\">"
+                     "<soapenv:Body><m:list xmlns:m=\"urn:list\">";
+    for (int i = 0; i < count; ++i) {
+        xml += "<m:item><m:id xsi:type=\"xsd:int\">" + QByteArray::number(i) + "</m:id><m:label xsi:type=\"xsd:string\">label</m:label></m:item>";
+    }
+    xml += "</m:list></soapenv:Body></soapenv:Envelope>";
+    return xml;
+}
+
+// Both strings were returned by KDSoapAtomTable::intern() for the same name
+static bool sameBuffer(const QString &a, const QString &b)
+{
+    return a.constData() == b.constData() && a.size() == b.size();
+}
+
+class InternThread : public QThread
+{
+public:
+    void run() override
+    {
+        for (int i = 0; i < 1000; ++i) {
+            m_mainThreadName = KDSoapAtomTable::intern(QString::fromLatin1("internedInMainThread"));
+            m_threadName = KDSoapAtomTable::intern(QString::fromLatin1("internedInThread"));
+        }
+    }
+
+    QString m_mainThreadName;
+    QString m_threadName;
+};
 
 class TestMessageReader : public QObject
 {
@@ -99,6 +165,592 @@ private Q_SLOTS:
         QVERIFY(msg.isFault());
         QCOMPARE(msg.faultAsString(), QString::fromLatin1("Fault 4: XML error: [1:163] Premature end of document."));
     }
+
+    void testIncrementalParsing_data()
+    {
+        QTest::addColumn<int>("chunkSize");
+        QTest::newRow("1") << 1;
+        QTest::newRow("7") << 7;
+        QTest::newRow("64") << 64;
+        QTest::newRow("all") << 100000;
+    }
+
+    void testIncrementalParsing()
+    {
+        QFETCH(int, chunkSize);
+        const QByteArray xml = "<soapenv:Envelope xmlns:soapenv=\"http://schemas.xmlsoap.org/soap/envelope/\" "
+                               "xmlns:dat=\"http://www.27seconds.com/Holidays/US/Dates/\">"
+                               "<soapenv:Header><dat:session>abcdef</dat:session></soapenv:Header>"
+                               "<soapenv:Body>"
+                               "<dat:GetEaster attr=\"value\">"
+                               "<dat:year>2011</dat:year>"
+                               "<dat:description>A rather long description, which will end up split into many chunks</dat:description>"
+                               "</dat:GetEaster>"
+                               "</soapenv:Body>"
+                               "</soapenv:Envelope>";
+
+        KDSoapMessageReader reader;
+        for (int pos = 0; pos < xml.size(); pos += chunkSize) {
+            reader.addData(xml.mid(pos, chunkSize));
+        }
+        QString ns;
+        KDSoapMessage msg;
+        KDSoapHeaders headers;
+        const KDSoapMessageReader::XmlError err = reader.finish(&msg, &ns, &headers, KDSoap::SOAP1_1);
+        QCOMPARE(err, KDSoapMessageReader::NoError);
+        QVERIFY(!msg.isFault());
+        QCOMPARE(msg.name(), QLatin1String("GetEaster"));
+        QCOMPARE(ns, QLatin1String("http://www.27seconds.com/Holidays/US/Dates/"));
+        QCOMPARE(msg.childValues().attributes().count(), 1);
+        QCOMPARE(msg.childValues().attributes().first().value().toString(), QLatin1String("value"));
+        QCOMPARE(msg.childValues().count(), 2);
+        QCOMPARE(msg.childValues().child(QLatin1String("year")).value().toString(), QLatin1String("2011"));
+        QCOMPARE(msg.childValues().child(QLatin1String("description")).value().toString(),
+                 QLatin1String("A rather long description, which will end up split into many chunks"));
+        QCOMPARE(headers.count(), 1);
+        QCOMPARE(headers.header(QLatin1String("session")).value().toString(), QLatin1String("abcdef"));
+    }
+
+    void testIncrementalParsingFault()
+    {
+        const QByteArray xmlMissingEnd =
+            "<soapenv:Envelope xmlns:soapenv=\"http://schemas.xmlsoap.org/soap/envelope/\" xmlns:dat=\"http://www.27seconds.com/Holidays/US/Dates/\">"
+            "<soapenv:Header/>"
+            "<soapenv:Body>";
+
+        KDSoapMessageReader reader;
+        reader.addData(xmlMissingEnd.left(50));
+        reader.addData(xmlMissingEnd.mid(50));
+        KDSoapMessage msg;
+        KDSoapHeaders headers;
+        const KDSoapMessageReader::XmlError err = reader.finish(&msg, nullptr, &headers, KDSoap::SOAP1_1);
+        QCOMPARE(err, KDSoapMessageReader::PrematureEndOfDocumentError);
+        QVERIFY(msg.isFault());
+        QCOMPARE(msg.faultAsString(), QString::fromLatin1("Fault code 4: XML error: [1:163] Premature end of document."));
+    }
+
+    void testNamespaceScopes()
+    {
+        const QByteArray xml = "<soapenv:Envelope xmlns:soapenv=\"http://schemas.xmlsoap.org/soap/envelope/\" "
+                               "xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\" xmlns:t=\"urn:outer\">"
+                               "<soapenv:Body>"
+                               "<m:Get xmlns:m=\"urn:message\">"
+                               "<m:outer xsi:type=\"t:OuterType\">t:value</m:outer>"
+                               "<m:inner xmlns:t=\"urn:inner\"><m:leaf xsi:type=\"t:InnerType\">t:value</m:leaf></m:inner>"
+                               "</m:Get>"
+                               "</soapenv:Body>"
+                               "</soapenv:Envelope>";
+
+        const KDSoapMessageReader reader;
+        KDSoapMessage msg;
+        KDSoapHeaders headers;
+        QCOMPARE(reader.xmlToMessage(xml, &msg, nullptr, &headers, KDSoap::SOAP1_1), KDSoapMessageReader::NoError);
+
+        const KDSoapValue outer = msg.childValues().child(QLatin1String("outer"));
+        QCOMPARE(outer.typeNs(), QLatin1String("urn:outer"));
+        QCOMPARE(outer.namespaceForPrefix(QLatin1String("m")), QLatin1String("urn:message"));
+        QCOMPARE(KDQName::fromSoapValue(outer).nameSpace(), QLatin1String("urn:outer"));
+        QCOMPARE(outer.environmentNamespaceDeclarations().count(), 4);
+
+        // The innermost declaration of a prefix wins
+        const KDSoapValue leaf = msg.childValues().child(QLatin1String("inner")).childValues().child(QLatin1String("leaf"));
+        QCOMPARE(leaf.typeNs(), QLatin1String("urn:inner"));
+        QCOMPARE(KDQName::fromSoapValue(leaf).nameSpace(), QLatin1String("urn:inner"));
+        QCOMPARE(leaf.environmentNamespaceDeclarations().count(), 5);
+        QVERIFY(leaf.namespaceForPrefix(QLatin1String("undeclared")).isNull());
+    }
+
+    void testResponseReader()
+    {
+        const QByteArray xml = repeatedElementsMessage(3);
+        const KDSoapMessageReader fullReader;
+        KDSoapMessage fullMsg;
+        KDSoapHeaders headers;
+        QCOMPARE(fullReader.xmlToMessage(xml, &fullMsg, nullptr, &headers, KDSoap::SOAP1_1), KDSoapMessageReader::NoError);
+
+        KDSoapValueList items;
+        QXmlStreamNamespaceDeclarations declarations;
+        KDSoapMessageReader reader;
+        reader.setResponseReader([&](QXmlStreamReader &xmlReader, const QXmlStreamNamespaceDeclarations &namespaces) {
+            declarations = namespaces;
+            const QXmlStreamNamespaceDeclarations listNamespaces = namespaces + xmlReader.namespaceDeclarations();
+            while (xmlReader.readNextStartElement()) {
+                items.append(KDSoapValue::readElement(xmlReader, listNamespaces));
+                QVERIFY(xmlReader.isEndElement());
+            }
+        });
+        KDSoapMessage msg;
+        QCOMPARE(reader.xmlToMessage(xml, &msg, nullptr, &headers, KDSoap::SOAP1_1), KDSoapMessageReader::NoError);
+        QCOMPARE(msg.name(), QLatin1String("list"));
+        QCOMPARE(msg.namespaceUri(), QLatin1String("urn:list"));
+        QVERIFY(msg.childValues().isEmpty());
+        QCOMPARE(declarations.count(), 3); // the ones from the envelope
+        QCOMPARE(items.count(), 3);
+        for (int i = 0; i < items.count(); ++i) {
+            QCOMPARE(dumpValue(items.at(i)), dumpValue(fullMsg.childValues().at(i)));
+        }
+        QCOMPARE(items.at(2).childValues().child(QLatin1String("id")).value(), QVariant(2));
+
+        // Faults are not passed to the response reader
+        const QByteArray faultXml = "<soap:Envelope xmlns:soap=\"http://schemas.xmlsoap.org/soap/envelope/\"><soap:Body><soap:Fault>"
+                                    "<faultcode>soap:Server</faultcode><faultstring>Error</faultstring></soap:Fault></soap:Body></soap:Envelope>";
+        items.clear();
+        QCOMPARE(reader.xmlToMessage(faultXml, &msg, nullptr, &headers, KDSoap::SOAP1_1), KDSoapMessageReader::NoError);
+        QVERIFY(msg.isFault());
+        QVERIFY(items.isEmpty());
+    }
+
+    void testLazyParsing_data()
+    {
+        QTest::addColumn<int>("chunkSize"); // 0 for xmlToMessage
+        QTest::newRow("xmlToMessage") << 0;
+        QTest::newRow("incremental, 1") << 1;
+        QTest::newRow("incremental, 13") << 13;
+    }
+
+    void testLazyParsing()
+    {
+        QFETCH(int, chunkSize);
+        // Non-ASCII text (including a character outside of the BMP) before the lazy ranges,
+        // and prefixes declared by the ancestors of the lazy elements
+        const QByteArray xml = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+                               "<soapenv:Envelope xmlns:soapenv=\"http://schemas.xmlsoap.org/soap/envelope/\" "
+                               "xmlns:xsd=\"http://www.w3.org/2001/XMLSchema\" xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\" "
+                               "xmlns:t=\"urn:types\">"
+                               "<soapenv:Header><t:session>caf\xc3\xa9</t:session></soapenv:Header>"
+                               "<soapenv:Body>"
+                               "<m:Response xmlns:m=\"urn:message\">"
+                               "<m:label>\xe2\x82\xac \xf0\x9f\x98\x80</m:label>\n"
+                               "<m:person kind=\"employee\"><m:name>J\xc3\xb6rg</m:name>"
+                               "<m:address xmlns=\"urn:default\"><street>Hauptstra\xc3\x9f" "e</street><t:number xsi:type=\"xsd:int\">5</t:number></m:address>"
+                               "</m:person>\n"
+                               "<m:empty/>"
+                               "<m:person kind=\"manager\"><m:name>Ann</m:name><m:address/>"
+                               "<m:note>before<m:b>bold</m:b><!-- c --><![CDATA[<after>]]></m:note><m:note>x<m:b/>y<m:b/></m:note></m:person>"
+                               "</m:Response>"
+                               "</soapenv:Body>"
+                               "</soapenv:Envelope>";
+
+        KDSoapMessage expected;
+        KDSoapHeaders expectedHeaders;
+        {
+            const KDSoapMessageReader reader;
+            QCOMPARE(reader.xmlToMessage(xml, &expected, nullptr, &expectedHeaders, KDSoap::SOAP1_1), KDSoapMessageReader::NoError);
+        }
+
+        KDSoapMessageReader reader;
+        reader.setLazyParsing(true);
+        KDSoapMessage msg;
+        KDSoapHeaders headers;
+        if (chunkSize == 0) {
+            QCOMPARE(reader.xmlToMessage(xml, &msg, nullptr, &headers, KDSoap::SOAP1_1), KDSoapMessageReader::NoError);
+        } else {
+            for (int pos = 0; pos < xml.size(); pos += chunkSize) {
+                reader.addData(xml.mid(pos, chunkSize));
+            }
+            QCOMPARE(reader.finish(&msg, nullptr, &headers, KDSoap::SOAP1_1), KDSoapMessageReader::NoError);
+        }
+
+        // Only the needed subtree is parsed
+        const KDSoapValue person = msg.childValues().at(1);
+        QCOMPARE(person.childValues().attributes().first().value().toString(), QLatin1String("employee"));
+        const KDSoapValue number = person.childValues().child(QLatin1String("address")).childValues().child(QLatin1String("number"));
+        QCOMPARE(number.value(), QVariant(5));
+        QCOMPARE(number.typeNs(), KDSoapNamespaceManager::xmlSchema2001());
+        QCOMPARE(number.namespaceUri(), QLatin1String("urn:types"));
+        QCOMPARE(person.childValues().child(QLatin1String("address")).childValues().child(QLatin1String("street")).namespaceUri(),
+                 QLatin1String("urn:default"));
+
+        // And the whole thing is the same as when parsed right away
+        QCOMPARE(dumpValue(msg), dumpValue(expected));
+        QCOMPARE(headers.count(), 1);
+        QCOMPARE(dumpValue(headers.first()), dumpValue(expectedHeaders.first()));
+        QVERIFY(msg.childValues().child(QLatin1String("empty")).isNil());
+    }
+
+    void testLazyParsingDeepDocument()
+    {
+        const int depth = 500;
+        QByteArray xml = "<soapenv:Envelope xmlns:soapenv=\"http://schemas.xmlsoap.org/soap/envelope/\"><soapenv:Body><m:Response xmlns:m=\"urn:message\">";
+        for (int i = 0; i < depth; ++i) {
+            xml += "<m:level index=\"" + QByteArray::number(i) + "\"><m:label>" + QByteArray::number(i) + "</m:label>";
+        }
+        for (int i = 0; i < depth; ++i) {
+            xml += "</m:level>";
+        }
+        xml += "</m:Response></soapenv:Body></soapenv:Envelope>";
+
+        KDSoapMessageReader reader;
+        reader.setLazyParsing(true);
+        KDSoapMessage msg;
+        KDSoapHeaders headers;
+        QCOMPARE(reader.xmlToMessage(xml, &msg, nullptr, &headers, KDSoap::SOAP1_1), KDSoapMessageReader::NoError);
+
+        // Each level only parses the tags and text of its own children
+        KDSoapValue level = msg;
+        for (int i = 0; i < depth; ++i) {
+            level = level.childValues().child(QLatin1String("level"));
+            QCOMPARE(level.childValues().count(), i + 1 < depth ? 2 : 1);
+            QCOMPARE(level.childValues().attributes().first().value().toString(), QString::number(i));
+            QCOMPARE(level.childValues().child(QLatin1String("label")).value().toString(), QString::number(i));
+        }
+    }
+
+    void testCompactParsing_data()
+    {
+        QTest::addColumn<int>("chunkSize"); // 0 for xmlToMessage
+        QTest::addColumn<bool>("lazy"); // ignored, compact parsing wins
+        QTest::newRow("xmlToMessage") << 0 << false;
+        QTest::newRow("xmlToMessage, lazy") << 0 << true;
+        QTest::newRow("incremental, 1") << 1 << false;
+        QTest::newRow("incremental, 13") << 13 << false;
+    }
+
+    void testCompactParsing()
+    {
+        QFETCH(int, chunkSize);
+        QFETCH(bool, lazy);
+        const QByteArray xml = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+                               "<soapenv:Envelope xmlns:soapenv=\"http://schemas.xmlsoap.org/soap/envelope/\" "
+                               "xmlns:xsd=\"http://www.w3.org/2001/XMLSchema\" xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\" "
+                               "xmlns:t=\"urn:types\">"
+                               "<soapenv:Header><t:session>caf\xc3\xa9</t:session><t:token t:kind=\"a\"/></soapenv:Header>"
+                               "<soapenv:Body>"
+                               "<m:Response xmlns:m=\"urn:message\">"
+                               "<m:label>\xe2\x82\xac \xf0\x9f\x98\x80</m:label>\n"
+                               "<m:person kind=\"employee\" id=\"1\"><m:name>J\xc3\xb6rg</m:name>"
+                               "<m:address xmlns=\"urn:default\"><street>Hauptstra\xc3\x9f" "e</street><t:number xsi:type=\"xsd:int\">5</t:number></m:address>"
+                               "</m:person>\n"
+                               "<m:empty/>"
+                               "<m:mixed>before<m:child/>after</m:mixed>"
+                               "<m:person kind=\"manager\"><m:name>Ann</m:name><m:address/>"
+                               "<m:note>before<m:b>bold</m:b><!-- c --><![CDATA[<after>]]></m:note><m:note>x<m:b/>y<m:b/></m:note></m:person>"
+                               "</m:Response>"
+                               "</soapenv:Body>"
+                               "</soapenv:Envelope>";
+
+        KDSoapMessage expected;
+        KDSoapHeaders expectedHeaders;
+        {
+            const KDSoapMessageReader reader;
+            QCOMPARE(reader.xmlToMessage(xml, &expected, nullptr, &expectedHeaders, KDSoap::SOAP1_1), KDSoapMessageReader::NoError);
+        }
+
+        KDSoapMessage msg;
+        KDSoapHeaders headers;
+        {
+            // The message doesn't depend on the reader
+            KDSoapMessageReader reader;
+            QVERIFY(!reader.compactParsing());
+            reader.setCompactParsing(true);
+            reader.setLazyParsing(lazy);
+            if (chunkSize == 0) {
+                QCOMPARE(reader.xmlToMessage(xml, &msg, nullptr, &headers, KDSoap::SOAP1_1), KDSoapMessageReader::NoError);
+            } else {
+                for (int pos = 0; pos < xml.size(); pos += chunkSize) {
+                    reader.addData(xml.mid(pos, chunkSize));
+                }
+                QCOMPARE(reader.finish(&msg, nullptr, &headers, KDSoap::SOAP1_1), KDSoapMessageReader::NoError);
+            }
+        }
+
+        const KDSoapValue person = msg.childValues().at(1);
+        QCOMPARE(person.childValues().attributes().count(), 2);
+        QCOMPARE(person.childValues().attributes().first().value().toString(), QLatin1String("employee"));
+        const KDSoapValue address = person.childValues().child(QLatin1String("address"));
+        QCOMPARE(address.namespaceDeclarations().count(), 1);
+        QCOMPARE(address.namespaceDeclarations().first().namespaceUri().toString(), QLatin1String("urn:default"));
+        QCOMPARE(address.namespaceForPrefix(QLatin1String("t")), QLatin1String("urn:types"));
+        const KDSoapValue number = address.childValues().child(QLatin1String("number"));
+        QCOMPARE(number.value(), QVariant(5));
+        QCOMPARE(number.typeNs(), KDSoapNamespaceManager::xmlSchema2001());
+        QCOMPARE(number.type(), QLatin1String("int"));
+        QCOMPARE(number.namespaceUri(), QLatin1String("urn:types"));
+        QCOMPARE(address.childValues().child(QLatin1String("street")).namespaceUri(), QLatin1String("urn:default"));
+
+        // The whole thing is the same as when parsed into separate values
+        QCOMPARE(dumpValue(msg), dumpValue(expected));
+        QCOMPARE(headers.count(), 2);
+        QCOMPARE(dumpValue(headers.at(0)), dumpValue(expectedHeaders.at(0)));
+        QCOMPARE(dumpValue(headers.at(1)), dumpValue(expectedHeaders.at(1)));
+        QVERIFY(msg.childValues().child(QLatin1String("empty")).isNil());
+        QVERIFY(!headers.at(1).isNil()); // attributes only
+
+        // Modifying a value doesn't modify the message it comes from
+        KDSoapValue name = msg.childValues().at(4).childValues().child(QLatin1String("name"));
+        name.setValue(QString::fromLatin1("Bob"));
+        QCOMPARE(name.value().toString(), QLatin1String("Bob"));
+        QCOMPARE(msg.childValues().at(4).childValues().child(QLatin1String("name")).value().toString(), QLatin1String("Ann"));
+    }
+
+    void testInvalidCharacterReferences_data()
+    {
+        QTest::addColumn<int>("chunkSize"); // 0 for xmlToMessage without the option
+        QTest::newRow("xmlToMessage") << 0;
+        QTest::newRow("incremental, 1") << 1;
+        QTest::newRow("incremental, 5") << 5;
+        QTest::newRow("incremental, 64") << 64;
+        QTest::newRow("incremental, all") << 100000;
+    }
+
+    void testInvalidCharacterReferences()
+    {
+        QFETCH(int, chunkSize);
+        const QByteArray xml = "<soapenv:Envelope xmlns:soapenv=\"http://schemas.xmlsoap.org/soap/envelope/\"><soapenv:Body>"
+                               "<m:Response xmlns:m=\"urn:message\">"
+                               "<m:a>x&#x13;y&#1;z&#x41;&#039;&amp;</m:a>"
+                               "<!-- &#x2; --><m:b attr=\"&#x0B;\"><![CDATA[&#x14;]]]]>&#x1F;</m:b>"
+                               "</m:Response>"
+                               "</soapenv:Body></soapenv:Envelope>";
+        KDSoapMessageReader reader;
+        KDSoapMessage msg;
+        KDSoapHeaders headers;
+        if (chunkSize == 0) {
+            QCOMPARE(reader.xmlToMessage(xml, &msg, nullptr, &headers, KDSoap::SOAP1_1), KDSoapMessageReader::NoError);
+        } else {
+            reader.setReplaceInvalidCharacterReferences(true);
+            for (int pos = 0; pos < xml.size(); pos += chunkSize) {
+                reader.addData(xml.mid(pos, chunkSize));
+            }
+            QCOMPARE(reader.finish(&msg, nullptr, &headers, KDSoap::SOAP1_1), KDSoapMessageReader::NoError);
+        }
+        QCOMPARE(msg.childValues().child(QLatin1String("a")).value().toString(), QLatin1String("x?y?zA'&"));
+        const KDSoapValue b = msg.childValues().child(QLatin1String("b"));
+        QCOMPARE(b.childValues().attributes().first().value().toString(), QLatin1String("?"));
+        // Not a reference in a CDATA section
+        QCOMPARE(b.value().toString(), QLatin1String("&#x14;]]?"));
+    }
+
+    void testMaximumDepth()
+    {
+        const int depth = 2000;
+        const QByteArray xml = "<soapenv:Envelope xmlns:soapenv=\"http://schemas.xmlsoap.org/soap/envelope/\"><soapenv:Body>"
+            + QByteArray("<a>").repeated(depth) + "leaf" + QByteArray("</a>").repeated(depth) + "</soapenv:Body></soapenv:Envelope>";
+
+        KDSoapMessageReader reader;
+        QCOMPARE(reader.maximumDepth(), 1024);
+        KDSoapMessage msg;
+        KDSoapHeaders headers;
+        QCOMPARE(reader.xmlToMessage(xml, &msg, nullptr, &headers, KDSoap::SOAP1_1), KDSoapMessageReader::ParseError);
+        QVERIFY(msg.isFault());
+        QVERIFY(msg.faultAsString().contains(QLatin1String("Maximum element depth of 1024 exceeded")));
+
+        // No recursion when parsing, so no limit is fine too
+        reader.setMaximumDepth(0);
+        msg = KDSoapMessage();
+        QCOMPARE(reader.xmlToMessage(xml, &msg, nullptr, &headers, KDSoap::SOAP1_1), KDSoapMessageReader::NoError);
+        KDSoapValue value = msg;
+        int levels = 1;
+        while (!value.childValues().isEmpty()) {
+            value = value.childValues().first();
+            ++levels;
+        }
+        QCOMPARE(levels, depth);
+        QCOMPARE(value.value().toString(), QLatin1String("leaf"));
+    }
+
+    void testMaximumNodeCount()
+    {
+        const QByteArray xml = repeatedElementsMessage(100); // 3 elements per item
+        KDSoapMessageReader reader;
+        QCOMPARE(reader.maximumNodeCount(), 0);
+        reader.setMaximumNodeCount(200);
+        KDSoapMessage msg;
+        KDSoapHeaders headers;
+        QCOMPARE(reader.xmlToMessage(xml, &msg, nullptr, &headers, KDSoap::SOAP1_1), KDSoapMessageReader::ParseError);
+        QVERIFY(msg.faultAsString().contains(QLatin1String("Maximum element count of 200 exceeded")));
+
+        // Same in incremental mode
+        KDSoapMessageReader incrementalReader;
+        incrementalReader.setMaximumNodeCount(200);
+        incrementalReader.addData(xml);
+        msg = KDSoapMessage();
+        QCOMPARE(incrementalReader.finish(&msg, nullptr, &headers, KDSoap::SOAP1_1), KDSoapMessageReader::ParseError);
+
+        reader.setMaximumNodeCount(400);
+        msg = KDSoapMessage();
+        QCOMPARE(reader.xmlToMessage(xml, &msg, nullptr, &headers, KDSoap::SOAP1_1), KDSoapMessageReader::NoError);
+        QCOMPARE(msg.childValues().count(), 100);
+    }
+
+    void testXsdTypes_data()
+    {
+        QTest::addColumn<QString>("type");
+        QTest::addColumn<QString>("text");
+        QTest::addColumn<QVariant>("expectedValue");
+        QTest::newRow("int") << "xsd:int" << "-42" << QVariant(-42);
+        QTest::newRow("invalid int") << "xsd:int" << "forty-two" << QVariant(QString::fromLatin1("forty-two"));
+        // Out-of-range values are converted like QVariant::convert does
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+        QTest::newRow("int truncated") << "xsd:int" << "4294967338" << QVariant(42);
+#else
+        QTest::newRow("int overflow") << "xsd:int" << "4294967338" << QVariant(QString::fromLatin1("4294967338"));
+#endif
+        QTest::newRow("int 64-bit overflow") << "xsd:int" << "99999999999999999999" << QVariant(QString::fromLatin1("99999999999999999999"));
+        QTest::newRow("unsignedInt") << "xsd:unsignedInt" << "4000000000" << QVariant(Q_UINT64_C(4000000000));
+        QTest::newRow("double") << "xsd:double" << "1.5e3" << QVariant(1500.0);
+        QTest::newRow("float") << "xsd:float" << "0.25" << QVariant(0.25f);
+        QTest::newRow("true") << "xsd:boolean" << "true" << QVariant(true);
+        QTest::newRow("1") << "xsd:boolean" << "1" << QVariant(true);
+        QTest::newRow("false") << "xsd:boolean" << "false" << QVariant(false);
+        QTest::newRow("0") << "xsd:boolean" << "0" << QVariant(false);
+        QTest::newRow("date") << "xsd:date" << "2023-02-28" << QVariant(QDate(2023, 2, 28));
+        QTest::newRow("invalid date") << "xsd:date" << "2023-02-30" << QVariant(QString::fromLatin1("2023-02-30"));
+        QTest::newRow("time") << "xsd:time" << "12:34:56" << QVariant(QTime(12, 34, 56));
+        QTest::newRow("dateTime") << "xsd:dateTime" << "2023-02-28T12:34:56Z" << QVariant(QString::fromLatin1("2023-02-28T12:34:56Z"));
+        QTest::newRow("base64Binary") << "xsd:base64Binary" << "S0RTb2Fw" << QVariant(QByteArray("S0RTb2Fw"));
+        QTest::newRow("string") << "xsd:string" << "123" << QVariant(QString::fromLatin1("123"));
+        QTest::newRow("custom") << "xsd:integer" << "123" << QVariant(QString::fromLatin1("123"));
+        QTest::newRow("same slot as int") << "xsd:iXt" << "123" << QVariant(QString::fromLatin1("123"));
+    }
+
+    void testXsdTypes()
+    {
+        QFETCH(QString, type);
+        QFETCH(QString, text);
+        QFETCH(QVariant, expectedValue);
+        const QByteArray xml = "<soapenv:Envelope xmlns:soapenv=\"http://schemas.xmlsoap.org/soap/envelope/\" "
+                               "xmlns:xsd=\"http://www.w3.org/2001/XMLSchema\" xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\">"
+                               "<soapenv:Body><m:value xmlns:m=\"urn:message\" xsi:type=\""
+            + type.toLatin1() + "\">" + text.toLatin1() + "</m:value></soapenv:Body></soapenv:Envelope>";
+        const KDSoapMessageReader reader;
+        KDSoapMessage msg;
+        KDSoapHeaders headers;
+        QCOMPARE(reader.xmlToMessage(xml, &msg, nullptr, &headers, KDSoap::SOAP1_1), KDSoapMessageReader::NoError);
+        QCOMPARE(msg.value().userType(), expectedValue.userType());
+        QCOMPARE(msg.value(), expectedValue);
+    }
+
+    void benchmarkEncodedArray()
+    {
+        QByteArray xml = "<soapenv:Envelope xmlns:soapenv=\"http://schemas.xmlsoap.org/soap/envelope/\" "
+                         "xmlns:soap-enc=\"http://schemas.xmlsoap.org/soap/encoding/\" "
+                         "xmlns:xsd=\"http://www.w3.org/2001/XMLSchema\" xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\">"
+                         "<soapenv:Body><m:values xmlns:m=\"urn:message\" soap-enc:arrayType=\"xsd:anyType[3000]\">";
+        for (int i = 0; i < 1000; ++i) {
+            const QByteArray number = QByteArray::number(i);
+            xml += "<item xsi:type=\"xsd:int\">" + number + "</item><item xsi:type=\"xsd:double\">" + number
+                + ".5</item><item xsi:type=\"xsd:boolean\">true</item>";
+        }
+        xml += "</m:values></soapenv:Body></soapenv:Envelope>";
+
+        const KDSoapMessageReader reader;
+        KDSoapMessage msg;
+        KDSoapHeaders headers;
+        QBENCHMARK {
+            reader.xmlToMessage(xml, &msg, nullptr, &headers, KDSoap::SOAP1_1);
+        }
+        QCOMPARE(msg.childValues().count(), 3000);
+        QCOMPARE(msg.childValues().at(2997).value(), QVariant(999));
+        QCOMPARE(msg.childValues().at(2998).value(), QVariant(999.5));
+    }
+
+    void testInternedNames()
+    {
+        const KDSoapMessageReader reader;
+        KDSoapMessage msg1;
+        KDSoapMessage msg2;
+        KDSoapHeaders headers;
+        const QByteArray xml = repeatedElementsMessage(3);
+        QCOMPARE(reader.xmlToMessage(xml, &msg1, nullptr, &headers, KDSoap::SOAP1_1), KDSoapMessageReader::NoError);
+        QCOMPARE(reader.xmlToMessage(xml, &msg2, nullptr, &headers, KDSoap::SOAP1_1), KDSoapMessageReader::NoError);
+
+        const KDSoapValue first = msg1.childValues().at(0).childValues().child(QLatin1String("id"));
+        const KDSoapValue second = msg1.childValues().at(1).childValues().child(QLatin1String("id"));
+        const KDSoapValue other = msg2.childValues().at(2).childValues().child(QLatin1String("id"));
+        QCOMPARE(first.value().toInt(), 0);
+        QCOMPARE(other.value().toInt(), 2);
+        // Same name, namespace and type: same buffer, within a message and across messages
+        QVERIFY(sameBuffer(first.name(), second.name()));
+        QVERIFY(sameBuffer(first.name(), other.name()));
+        QVERIFY(sameBuffer(first.namespaceUri(), other.namespaceUri()));
+        QVERIFY(sameBuffer(first.type(), other.type()));
+        // Well-known namespaces are the ones from KDSoapNamespaceManager
+        QVERIFY(sameBuffer(first.typeNs(), KDSoapNamespaceManager::xmlSchema2001()));
+        QVERIFY(sameBuffer(KDSoapAtomTable::intern(QString::fromLatin1("http://schemas.xmlsoap.org/soap/envelope/")),
+                           KDSoapNamespaceManager::soapEnvelope()));
+    }
+
+    void testInternFromThreads()
+    {
+        // Each thread finds the atoms it already used without locking, but they are the same for all threads
+        const QString name = KDSoapAtomTable::intern(QString::fromLatin1("internedInMainThread"));
+        QVERIFY(sameBuffer(KDSoapAtomTable::intern(QString::fromLatin1("internedInMainThread")), name));
+        InternThread threads[4];
+        for (InternThread &thread : threads) {
+            thread.start();
+        }
+        for (InternThread &thread : threads) {
+            QVERIFY(thread.wait());
+            QVERIFY(sameBuffer(thread.m_mainThreadName, name));
+            QVERIFY(sameBuffer(thread.m_threadName, threads[0].m_threadName));
+        }
+        QVERIFY(sameBuffer(KDSoapAtomTable::intern(QString::fromLatin1("internedInThread")), threads[0].m_threadName));
+    }
+
+    void benchmarkNameAllocations_data()
+    {
+        QTest::addColumn<int>("count");
+        QTest::newRow("10") << 10;
+        QTest::newRow("1000") << 1000;
+    }
+
+    void benchmarkNameAllocations()
+    {
+        QFETCH(int, count);
+        const QByteArray xml = repeatedElementsMessage(count);
+        const KDSoapMessageReader reader;
+        KDSoapMessage msg;
+        KDSoapHeaders headers;
+        QBENCHMARK {
+            reader.xmlToMessage(xml, &msg, nullptr, &headers, KDSoap::SOAP1_1);
+        }
+
+        // Without interning, every node allocates its own name, namespace and type strings
+        QSet<const QChar *> buffers;
+        int nodes = 0;
+        collectNameBuffers(msg, &buffers, &nodes);
+        QVERIFY(buffers.count() < 10);
+    }
+
+    // Last, since it fills the atom table of the process
+    void testReusedArenaWithFullAtomTable()
+    {
+        int previousCount;
+        int filler = 0;
+        do {
+            previousCount = KDSoapAtomTable::count();
+            KDSoapAtomTable::intern(QString::fromLatin1("filler%1").arg(filler++));
+        } while (KDSoapAtomTable::count() > previousCount);
+
+        // Names which can't be interned anymore, different in every message, like a hostile client would send
+        KDSoapValueArena::Ptr arena(new KDSoapValueArena);
+        KDSoapMessageReader reader;
+        reader.setCompactParsing(true);
+        reader.setArena(arena);
+        int maximumAtoms = 0;
+        for (int message = 0; message < 20; ++message) {
+            QByteArray xml = "<soapenv:Envelope xmlns:soapenv=\"http://schemas.xmlsoap.org/soap/envelope/\"><soapenv:Body><m:request xmlns:m=\"urn:list\">";
+            for (int i = 0; i < 50; ++i) {
+                const QByteArray name = "n" + QByteArray::number(message) + "_" + QByteArray::number(i);
+                xml += "<m:" + name + ">" + QByteArray::number(i) + "</m:" + name + ">";
+            }
+            xml += "</m:request></soapenv:Body></soapenv:Envelope>";
+            KDSoapMessage msg;
+            KDSoapHeaders headers;
+            QCOMPARE(reader.xmlToMessage(xml, &msg, nullptr, &headers, KDSoap::SOAP1_1), KDSoapMessageReader::NoError);
+            QCOMPARE(msg.childValues().count(), 50);
+            QCOMPARE(msg.childValues().at(49).name(), QString::fromLatin1("n%1_49").arg(message));
+            QCOMPARE(msg.childValues().at(49).value().toString(), QLatin1String("49"));
+            if (message == 0) {
+                maximumAtoms = arena->m_atoms.size();
+            }
+            // The names of the previous messages were dropped
+            QVERIFY(arena->m_atoms.size() <= maximumAtoms);
+        }
+        arena->reset();
+        QVERIFY(arena->m_atoms.size() <= maximumAtoms - 50);
+    }
 };
 
 QTEST_MAIN(TestMessageReader)
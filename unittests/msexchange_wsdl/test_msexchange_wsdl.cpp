@@ -511,6 +511,7 @@ private Q_SLOTS:
         HttpServerThread server(serverResponseXml.toUtf8(), HttpServerThread::Public);
         ExchangeServices service(this);
         service.setEndPoint(server.endPoint());
+        service.clientInterface()->setReplaceInvalidCharacterReferences(true);
         GetFolderJob *job = new GetFolderJob(&service);
 
         QEventLoop loop;
@@ -0,0 +1,263 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#include "KDSoapClientInterface.h"
+#include "KDSoapMessage.h"
+#include "KDSoapMessageReader_p.h"
+#include "KDSoapMtom_p.h"
+#include "KDSoapNamespaceManager.h"
+#include "KDSoapPendingCallWatcher.h"
+#include "KDSoapServer.h"
+#include "KDSoapServerObjectInterface.h"
+#include "KDSoapValue.h"
+#include "httpserver_p.h"
+#include <QDebug>
+#include <QEventLoop>
+#include <QTest>
+
+using namespace KDSoapUnitTestHelpers;
+
+static const char s_ns[] = "http://www.kdab.com/xml/MyWsdl/";
+
+static QByteArray binaryData(int size)
+{
+    QByteArray data(size, Qt::Uninitialized);
+    for (int i = 0; i < size; ++i) {
+        data[i] = char(i * 7 % 256); // all the byte values, including CR, LF and '-'
+    }
+    return data;
+}
+
+class EchoServerObject : public QObject, public KDSoapServerObjectInterface
+{
+    Q_OBJECT
+    Q_INTERFACES(KDSoapServerObjectInterface)
+public:
+    void processRequest(const KDSoapMessage &request, KDSoapMessage &response, const QByteArray &soapAction) override
+    {
+        if (request.name() == QLatin1String("echoBinary")) {
+            const QByteArray data = request.childValues().child(QLatin1String("data")).base64BinaryValue();
+            response.addArgument(QLatin1String("data"), data, KDSoapNamespaceManager::xmlSchema2001(), QString::fromLatin1("base64Binary"));
+            response.addArgument(QLatin1String("size"), data.size());
+        } else {
+            KDSoapServerObjectInterface::processRequest(request, response, soapAction);
+        }
+    }
+};
+
+class EchoServer : public KDSoapServer
+{
+    Q_OBJECT
+public:
+    QObject *createServerObject() override
+    {
+        return new EchoServerObject;
+    }
+};
+
+class MtomTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testContentTypeParameter()
+    {
+        const QByteArray contentType = "multipart/related; type=\"application/xop+xml\";start=\"<root@x>\"; "
+                                       "start-info=\"application/soap+xml; action=\\\"urn:a;b\\\"\"; boundary=plain_boundary";
+        QCOMPARE(KDSoapMtom::contentTypeParameter(contentType, "type"), QByteArray("application/xop+xml"));
+        QCOMPARE(KDSoapMtom::contentTypeParameter(contentType, "start"), QByteArray("<root@x>"));
+        QCOMPARE(KDSoapMtom::contentTypeParameter(contentType, "start-info"), QByteArray("application/soap+xml; action=\"urn:a;b\""));
+        QCOMPARE(KDSoapMtom::contentTypeParameter(contentType, "boundary"), QByteArray("plain_boundary"));
+        QCOMPARE(KDSoapMtom::contentTypeParameter(contentType, "charset"), QByteArray());
+        QVERIFY(KDSoapMtom::isMultipartRelated(contentType));
+        QVERIFY(KDSoapMtom::isMultipartRelated("Multipart/Related;boundary=x"));
+        QVERIFY(!KDSoapMtom::isMultipartRelated("text/xml;charset=utf-8"));
+        QCOMPARE(KDSoapMtom::soapContentType(contentType), QByteArray("application/soap+xml; action=\"urn:a;b\""));
+    }
+
+    void testMultipartBody()
+    {
+        KDSoapMtomAttachments attachments;
+        const QString href1 = attachments.add(binaryData(1000));
+        const QString href2 = attachments.add(QByteArray("\r\n--not a boundary\r\n"));
+        QVERIFY(href1.startsWith(QLatin1String("cid:")));
+        QVERIFY(href1 != href2);
+
+        const QByteArray xml = "<Envelope/>";
+        const QByteArray boundary = KDSoapMtom::createBoundary();
+        const QByteArray soapContentType = "application/soap+xml;charset=utf-8;action=ActionHex";
+        const QByteArray contentType = KDSoapMtom::contentType(boundary, soapContentType);
+        QCOMPARE(KDSoapMtom::contentTypeParameter(contentType, "boundary"), boundary);
+        QCOMPARE(KDSoapMtom::contentTypeParameter(contentType, "start-info"), QByteArray("application/soap+xml"));
+        QCOMPARE(KDSoapMtom::soapContentType(contentType), QByteArray("application/soap+xml;action=\"ActionHex\""));
+
+        const QVector<QByteArray> pieces = KDSoapMtom::multipartBody(boundary, soapContentType, xml, attachments);
+        QCOMPARE(pieces.count(), 2 + 2 * 2 + 1);
+        // the data is shared, not copied
+        QVERIFY(pieces.at(3).constData() == attachments.attachments().at(0).data.constData());
+
+        QByteArray body;
+        for (const QByteArray &piece : pieces) {
+            body += piece;
+        }
+        QByteArray parsedXml;
+        QHash<QByteArray, QByteArray> parts;
+        QVERIFY(KDSoapMtom::parseMultipartBody(contentType, body, &parsedXml, &parts));
+        QCOMPARE(parsedXml, xml);
+        QCOMPARE(parts.count(), 2);
+        QCOMPARE(parts.value(href1.mid(4).toLatin1()), binaryData(1000));
+        QCOMPARE(parts.value(href2.mid(4).toLatin1()), QByteArray("\r\n--not a boundary\r\n"));
+
+        // KDSoapMtomDevice reads the same bytes
+        KDSoapMtomDevice device(pieces);
+        QCOMPARE(device.size(), qint64(body.size()));
+        QByteArray readData;
+        while (!device.atEnd()) {
+            readData += device.read(333);
+        }
+        QCOMPARE(readData, body);
+        QVERIFY(device.seek(10));
+        QCOMPARE(device.readAll(), body.mid(10));
+    }
+
+    // A package as written by other implementations: preamble, no start parameter, other headers
+    void testParseForeignPackage()
+    {
+        const QByteArray contentType = "multipart/related; type=\"application/xop+xml\"; boundary=\"uuid:0ca0e16e\"; start-info=\"text/xml\"";
+        const QByteArray body = "This is the preamble\r\n"
+                                "--uuid:0ca0e16e\r\n"
+                                "Content-Type: application/xop+xml; charset=UTF-8; type=\"text/xml\"\r\n"
+                                "content-transfer-encoding: binary\r\n"
+                                "\r\n"
+                                "<soap:Envelope xmlns:soap=\"http://schemas.xmlsoap.org/soap/envelope/\"><soap:Body>"
+                                "<n1:getDocumentResponse xmlns:n1=\"http://www.kdab.com/xml/MyWsdl/\">"
+                                "<document><xop:Include xmlns:xop=\"http://www.w3.org/2004/08/xop/include\" href=\"cid:doc%40example.org\"/></document>"
+                                "<encoded><xop:Include xmlns:xop=\"http://www.w3.org/2004/08/xop/include\" href=\"cid:other@example.org\"/></encoded>"
+                                "<inline>S0RTb2Fw</inline>"
+                                "</n1:getDocumentResponse></soap:Body></soap:Envelope>\r\n"
+                                "--uuid:0ca0e16e  \r\n" // transport padding
+                                "Content-Type: application/octet-stream\r\n"
+                                "Content-ID: <doc@example.org>\r\n"
+                                "\r\n"
+                                "raw\r\nbytes\r\n"
+                                "--uuid:0ca0e16e\r\n"
+                                "Content-ID: <other@example.org>\r\n"
+                                "Content-Transfer-Encoding: base64\r\n"
+                                "\r\n"
+                                "S0RTb2Fw\r\n"
+                                "--uuid:0ca0e16e--\r\n"
+                                "epilogue";
+        QByteArray xml;
+        QHash<QByteArray, QByteArray> parts;
+        QVERIFY(KDSoapMtom::parseMultipartBody(contentType, body, &xml, &parts));
+        QVERIFY(xml.startsWith("<soap:Envelope"));
+        QVERIFY(xml.endsWith("</soap:Envelope>"));
+        QCOMPARE(parts.value("doc@example.org"), QByteArray("raw\r\nbytes"));
+        QCOMPARE(parts.value("other@example.org"), QByteArray("KDSoap"));
+
+        KDSoapMessage message;
+        KDSoapHeaders headers;
+        KDSoapMessageReader reader;
+        QCOMPARE(reader.xmlToMessage(xml, &message, nullptr, &headers, KDSoap::SOAP1_1), KDSoapMessageReader::NoError);
+        KDSoapMtom::resolveIncludes(message, parts);
+        const KDSoapValue document = message.childValues().child(QLatin1String("document"));
+        QVERIFY(document.childValues().isEmpty());
+        QCOMPARE(document.value().toByteArray(), QByteArray("raw\r\nbytes"));
+        QCOMPARE(document.base64BinaryValue(), QByteArray("raw\r\nbytes"));
+        QCOMPARE(message.childValues().child(QLatin1String("encoded")).base64BinaryValue(), QByteArray("KDSoap"));
+        QCOMPARE(message.childValues().child(QLatin1String("inline")).base64BinaryValue(), QByteArray("KDSoap"));
+
+        QVERIFY(!KDSoapMtom::parseMultipartBody("multipart/related", body, &xml, &parts)); // no boundary
+        QVERIFY(!KDSoapMtom::parseMultipartBody(contentType, body.left(body.indexOf("raw")), &xml, &parts)); // truncated
+    }
+
+    void testRequest()
+    {
+        const QByteArray response = "<?xml version=\"1.0\" encoding=\"UTF-8\"?><soap:Envelope xmlns:soap=\"http://schemas.xmlsoap.org/soap/envelope/\">"
+                                    "<soap:Body><n1:echoBinaryResponse xmlns:n1=\"http://www.kdab.com/xml/MyWsdl/\"><size>5</size>"
+                                    "</n1:echoBinaryResponse></soap:Body></soap:Envelope>";
+        HttpServerThread server(response, HttpServerThread::Public);
+        KDSoapClientInterface client(server.endPoint(), QString::fromLatin1(s_ns));
+        QVERIFY(!client.mtomRequests());
+        client.setMtomRequests(true);
+        QVERIFY(client.mtomRequests());
+
+        const QByteArray data = binaryData(100000);
+        KDSoapMessage message;
+        message.addArgument(QLatin1String("data"), data);
+        // the way kdwsdl2cpp serializes base64Binary values
+        message.addArgument(QLatin1String("text"), QString::fromLatin1(QByteArray("KDSoap").toBase64().constData()),
+                            KDSoapNamespaceManager::xmlSchema2001(), QString::fromLatin1("base64Binary"));
+        message.addArgument(QLatin1String("hex"), QByteArray("KDSoap"), KDSoapNamespaceManager::xmlSchema2001(), QString::fromLatin1("hexBinary"));
+        const KDSoapMessage reply = client.call(QLatin1String("echoBinary"), message);
+        QVERIFY(!reply.isFault());
+        QCOMPARE(reply.childValues().child(QLatin1String("size")).value().toInt(), 5);
+
+        const QByteArray contentType = server.header("Content-Type");
+        QVERIFY(KDSoapMtom::isMultipartRelated(contentType));
+        QCOMPARE(KDSoapMtom::contentTypeParameter(contentType, "start-info"), QByteArray("text/xml"));
+        QCOMPARE(server.header("SoapAction").constData(), "\"http://www.kdab.com/xml/MyWsdl/echoBinary\"");
+
+        QByteArray xml;
+        QHash<QByteArray, QByteArray> parts;
+        QVERIFY(KDSoapMtom::parseMultipartBody(contentType, server.receivedData(), &xml, &parts));
+        QCOMPARE(parts.count(), 2);
+        QVERIFY(xml.contains("xmlns:xop=\"http://www.w3.org/2004/08/xop/include\""));
+        QVERIFY(xml.contains("<data><xop:Include href=\"cid:"));
+        QVERIFY(xml.contains("<text><xop:Include href=\"cid:"));
+        QVERIFY(xml.contains("<hex>4b44536f6170</hex>"));
+        QVERIFY(!xml.contains(data.toBase64().left(100)));
+        QVERIFY(parts.values().contains(data));
+        QVERIFY(parts.values().contains(QByteArray("KDSoap")));
+    }
+
+    void testCallServer_data()
+    {
+        QTest::addColumn<bool>("mtom");
+        QTest::addColumn<int>("soapVersion");
+
+        QTest::newRow("mtom") << true << int(KDSoapClientInterface::SOAP1_1);
+        QTest::newRow("mtom_soap12") << true << int(KDSoapClientInterface::SOAP1_2);
+        QTest::newRow("inline") << false << int(KDSoapClientInterface::SOAP1_1);
+    }
+
+    void testCallServer()
+    {
+        QFETCH(bool, mtom);
+        QFETCH(int, soapVersion);
+
+        TestServerThread<EchoServer> serverThread;
+        EchoServer *server = serverThread.startThread();
+        QVERIFY(server);
+        KDSoapClientInterface client(server->endPoint(), QString::fromLatin1(s_ns));
+        client.setSoapVersion(static_cast<KDSoapClientInterface::SoapVersion>(soapVersion));
+        client.setMtomRequests(mtom);
+
+        const QByteArray data = binaryData(1024 * 1024);
+        KDSoapMessage message;
+        message.addArgument(QLatin1String("data"), data, KDSoapNamespaceManager::xmlSchema2001(), QString::fromLatin1("base64Binary"));
+        const KDSoapMessage response = client.call(QLatin1String("echoBinary"), message);
+        QVERIFY2(!response.isFault(), qPrintable(response.faultAsString()));
+        QCOMPARE(response.childValues().child(QLatin1String("size")).value().toInt(), data.size());
+        QCOMPARE(response.childValues().child(QLatin1String("data")).base64BinaryValue(), data);
+
+        // Asynchronously too
+        KDSoapPendingCall call = client.asyncCall(QLatin1String("echoBinary"), message);
+        KDSoapPendingCallWatcher watcher(call);
+        QEventLoop loop;
+        connect(&watcher, &KDSoapPendingCallWatcher::finished, &loop, &QEventLoop::quit);
+        loop.exec();
+        QCOMPARE(call.returnMessage().childValues().child(QLatin1String("data")).base64BinaryValue(), data);
+    }
+};
+
+QTEST_MAIN(MtomTest)
+
+#include "test_mtom.moc"
@@ -0,0 +1,414 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#include "KDSoapAuthentication.h"
+#include "KDSoapClientInterface.h"
+#include "KDSoapMessageAddressingProperties.h"
+#include "KDSoapMessageReader_p.h"
+#include "KDSoapMessageWriter_p.h"
+#include "KDSoapNamespaceManager.h"
+#include "KDSoapXmlWriter_p.h"
+#include "httpserver_p.h"
+#include "wsdl_mywsdl_document.h"
+#include <QDebug>
+#include <QTest>
+
+using namespace KDSoapUnitTestHelpers;
+
+static const char s_ns[] = "http://www.kdab.com/xml/MyWsdl/";
+
+// Compares the output of KDSoapUtf8XmlWriter with the one of QXmlStreamWriter, byte for byte
+class NativeXmlWriterTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    static QByteArray messageToXml(bool native, const KDSoapMessage &message, const QString &method, const KDSoapHeaders &headers,
+                                   const QString &messageNamespace, KDSoap::SoapVersion version,
+                                   const QMap<QString, KDSoapMessage> &persistentHeaders = QMap<QString, KDSoapMessage>(),
+                                   const KDSoapAuthentication &authentication = KDSoapAuthentication())
+    {
+        KDSoapMessageWriter writer;
+        writer.setMessageNamespace(messageNamespace);
+        writer.setVersion(version);
+        writer.setNativeXmlWriter(native);
+        return writer.messageToXml(message, method, headers, persistentHeaders, authentication);
+    }
+
+    static KDSoapMessage parse(const QByteArray &xml, KDSoapHeaders *headers = nullptr)
+    {
+        KDSoapMessageReader reader;
+        KDSoapMessage message;
+        KDSoapHeaders parsedHeaders;
+        const KDSoapMessageReader::XmlError err = reader.xmlToMessage(xml, &message, nullptr, &parsedHeaders, KDSoap::SOAP1_1);
+        if (err != KDSoapMessageReader::NoError) {
+            qWarning() << "Parse error" << err << "in" << xml;
+        }
+        if (headers) {
+            *headers = parsedHeaders;
+        }
+        return message;
+    }
+
+    static KDAB__AddEmployee addEmployeeParameters()
+    {
+        KDAB__EmployeeAchievements achievements;
+        QList<KDAB__EmployeeAchievement> lst;
+        KDAB__EmployeeAchievement achievement;
+        achievement.setType(QByteArray("Project"));
+        achievement.setLabel(QString::fromLatin1("Management <& \"co\">"));
+        achievement.setTime(QDate(2011, 06, 27));
+        lst.append(achievement);
+        achievements.setItems(lst);
+        KDAB__EmployeeType employeeType;
+        employeeType.setType(KDAB__EmployeeTypeEnum::Developer);
+        employeeType.setOtherRoles(QList<KDAB__EmployeeTypeEnum>() << KDAB__EmployeeTypeEnum::TeamLeader << KDAB__EmployeeTypeEnum::Tester);
+        employeeType.setTeam(QList<KDAB__TeamName>() << QString::fromLatin1("Minitel"));
+
+        KDAB__AddEmployee addEmployeeParams;
+        addEmployeeParams.setEmployeeType(employeeType);
+        addEmployeeParams.setEmployeeName(QString::fromUtf8("David Ä Faure"));
+        addEmployeeParams.setEmployeeCountry(QString::fromLatin1("France"));
+        addEmployeeParams.setEmployeeAchievements(achievements);
+        KDAB__EmployeeId id;
+        id.setId(5);
+        addEmployeeParams.setEmployeeId(id);
+        return addEmployeeParams;
+    }
+
+    // The same sequence of calls, for comparing the writers directly
+    static void writeDocument(KDSoapXmlWriter &writer, const QString &text)
+    {
+        const QString ns1 = QString::fromLatin1("urn:one");
+        const QString ns2 = QString::fromLatin1("urn:two");
+        writer.writeStartDocument();
+        writer.writeNamespace(ns1, QString::fromLatin1("one"));
+        writer.writeStartElement(ns1, QString::fromLatin1("root"));
+        writer.writeNamespace(ns2, QString()); // made-up prefix
+        writer.writeAttribute(ns2, QString::fromLatin1("attr"), text);
+        writer.writeAttribute(QString::fromLatin1("plain"), text);
+        // Empty elements declaring a namespace, then siblings using it
+        writer.writeStartElement(QString::fromLatin1("urn:three"), QString::fromLatin1("empty"));
+        writer.writeEndElement();
+        writer.writeStartElement(QString::fromLatin1("urn:three"), QString::fromLatin1("sibling"));
+        writer.writeCharacters(text);
+        writer.writeEndElement();
+        writer.writeStartElement(QString::fromLatin1("urn:four"), QString::fromLatin1("empty"));
+        writer.writeAttribute(QString::fromLatin1("urn:five"), QString::fromLatin1("attr"), QString());
+        writer.writeEndElement();
+        writer.writeStartElement(QString::fromLatin1("unqualified"));
+        writer.writeAsciiCharacters("12345", 5);
+        writer.writeEndElement();
+        writer.writeStartElement(ns2, QString::fromLatin1("empty"));
+        writer.writeCharacters(QString());
+        writer.writeEndElement();
+        writer.writeNamespace(QString::fromLatin1("urn:six"), QString());
+        writer.writeStartElement(QString::fromLatin1("urn:six"), QString::fromLatin1("child"));
+        writer.writeStartElement(ns1, QString::fromLatin1("grandchild"));
+        writer.writeCharacters(text);
+        // Left open, closed by writeEndDocument
+    }
+
+private Q_SLOTS:
+    void testWriters_data()
+    {
+        QTest::addColumn<QString>("text");
+        QTest::newRow("empty") << QString();
+        QTest::newRow("ascii") << QString::fromLatin1("Hello world");
+        QTest::newRow("long") << QString::fromLatin1("0123456789abcdefghijklmnopqrstuvwxyz").repeated(200);
+        QTest::newRow("markup") << QString::fromLatin1("<a href=\"x\">&amp; 'b' >c<</a>");
+        QTest::newRow("whitespace") << QString::fromLatin1("\ttab\nnewline\r\nend ");
+        QTest::newRow("control") << QString::fromLatin1("a\x01 b\x0b c\x0c d\x1f e\x7f");
+        QTest::newRow("latin1") << QString::fromUtf8("Klarälvdalens Datakonsult ÅÄÖ åäö ÿ");
+        QTest::newRow("bmp") << QString::fromUtf8("Ελληνικά, русский, 日本語, € ✓");
+        QTest::newRow("surrogates") << QString::fromUtf8("emoji 😀 and 𝄞 music");
+        QTest::newRow("noncharacters") << QString(QChar(0xfffe)) + QString(QChar(0xffff)) + QString::fromLatin1("ok");
+        QString mixed;
+        for (int i = 0; i < 3000; ++i) {
+            mixed += QChar(ushort((i * 7919) % 0xd000 + 1));
+        }
+        QTest::newRow("mixed") << mixed;
+    }
+
+    void testWriters()
+    {
+        QFETCH(QString, text);
+
+        QByteArray expected;
+        {
+            QXmlStreamWriter streamWriter(&expected);
+            KDSoapQtXmlWriter writer(streamWriter);
+            writeDocument(writer, text);
+            writer.writeEndDocument();
+        }
+        QByteArray xml;
+        KDSoapUtf8XmlWriter writer(&xml);
+        writeDocument(writer, text);
+        writer.writeEndDocument();
+        QCOMPARE(QString::fromUtf8(xml), QString::fromUtf8(expected));
+        QCOMPARE(xml, expected);
+    }
+
+    void testMessages_data()
+    {
+        QTest::addColumn<KDSoapMessage>("message");
+        QTest::addColumn<QString>("method");
+        QTest::addColumn<KDSoapHeaders>("headers");
+        QTest::addColumn<bool>("soap12");
+
+        // From builtinhttp
+        KDSoapMessage countryMessage;
+        countryMessage.addArgument(QLatin1String("employeeName"), QString::fromUtf8("David Ä Faure"));
+        QTest::newRow("country") << countryMessage << QString::fromLatin1("getEmployeeCountry") << KDSoapHeaders() << false;
+        QTest::newRow("country12") << countryMessage << QString::fromLatin1("getEmployeeCountry") << KDSoapHeaders() << true;
+
+        KDSoapMessage encoded;
+        encoded.setUse(KDSoapMessage::EncodedUse);
+        encoded.addArgument(QLatin1String("testString"), QString::fromUtf8("Hello Klarälvdalens <&>"));
+        encoded.addArgument(QLatin1String("testInt"), 42);
+        encoded.addArgument(QLatin1String("testLongLong"), qint64(-1234567890123LL));
+        encoded.addArgument(QLatin1String("testBool"), true);
+        encoded.addArgument(QLatin1String("testDouble"), 3.14159);
+        encoded.addArgument(QLatin1String("testFloat"), float(1.5));
+        encoded.addArgument(QLatin1String("testDate"), QDate(2023, 2, 28));
+        encoded.addArgument(QLatin1String("testTime"), QTime(12, 34, 56, 789));
+        encoded.addArgument(QLatin1String("testDateTime"), QDateTime(QDate(2023, 2, 28), QTime(1, 2, 3), Qt::UTC));
+        encoded.addArgument(QLatin1String("testUrl"), QUrl(QString::fromLatin1("http://www.kdab.com/?a=1&b=2")));
+        encoded.addArgument(QLatin1String("testBase64"), QByteArray("binary\0data", 11));
+        encoded.addArgument(QLatin1String("testHex"), QByteArray("hex"), KDSoapNamespaceManager::xmlSchema2001(), QLatin1String("hexBinary"));
+        encoded.addArgument(QLatin1String("testTyped"), QString::fromLatin1("typed"), QString::fromLatin1(s_ns), QLatin1String("MyType"));
+        KDSoapValue nil(QLatin1String("testNil"), QVariant());
+        nil.setNillable(true);
+        encoded.childValues().append(nil);
+        KDSoapValueList array;
+        array.setArrayType(KDSoapNamespaceManager::xmlSchema2001(), QLatin1String("string"));
+        array.addArgument(QLatin1String("item"), QString::fromLatin1("one"));
+        array.addArgument(QLatin1String("item"), QString::fromLatin1("two"));
+        array.attributes().append(KDSoapValue(QLatin1String("attr"), QString::fromLatin1("a \"quoted\"\tvalue")));
+        encoded.addArgument(QLatin1String("testArray"), array, KDSoapNamespaceManager::soapEncoding(), QLatin1String("Array"));
+        QTest::newRow("encoded") << encoded << QString::fromLatin1("test") << KDSoapHeaders() << false;
+
+        KDSoapHeaders headers;
+        KDSoapMessage header1;
+        header1.addArgument(QLatin1String("header1"), QString::fromLatin1("headerValue"));
+        headers << header1;
+        KDSoapMessage header2;
+        header2.setUse(KDSoapMessage::EncodedUse);
+        header2.addArgument(QLatin1String("header2"), 12, QString::fromLatin1("urn:other"), QLatin1String("OtherType"));
+        headers << header2;
+        QTest::newRow("headers") << encoded << QString::fromLatin1("test") << headers << false;
+
+        // Qualified elements of other namespaces, some of them empty
+        KDSoapMessage document;
+        KDSoapValue qualified(QLatin1String("qualified"), QString::fromLatin1("value"));
+        qualified.setQualified(true);
+        KDSoapValue other(QLatin1String("other"), QVariant());
+        other.setNamespaceUri(QString::fromLatin1("urn:other"));
+        KDSoapValue otherSibling(QLatin1String("otherSibling"), QString::fromLatin1("text"));
+        otherSibling.setNamespaceUri(QString::fromLatin1("urn:other"));
+        KDSoapValue third(QLatin1String("third"), QVariant());
+        third.setNamespaceUri(QString::fromLatin1("urn:third"));
+        KDSoapValueList children;
+        children << qualified << other << otherSibling << third << qualified;
+        KDSoapValue parent(QLatin1String("parent"), children);
+        parent.addNamespaceDeclaration(QXmlStreamNamespaceDeclaration(QString::fromLatin1("decl"), QString::fromLatin1("urn:declared")));
+        document.childValues().append(parent);
+        document.childValues().attributes().append(KDSoapValue(QLatin1String("version"), QString::fromLatin1("1.0")));
+        QTest::newRow("namespaces") << document << QString::fromLatin1("doc") << KDSoapHeaders() << false;
+
+        KDSoapMessage fault;
+        fault.setFault(true);
+        fault.addArgument(QLatin1String("faultcode"), QString::fromLatin1("Server.Error"));
+        fault.addArgument(QLatin1String("faultstring"), QString::fromLatin1("Something <bad> happened"));
+        QTest::newRow("fault") << fault << QString::fromLatin1("Fault") << KDSoapHeaders() << false;
+
+        QTest::newRow("null") << KDSoapMessage() << QString() << KDSoapHeaders() << false;
+
+        // Generated code, as in wsdl_document and xml_writers
+        KDSoapMessage generated;
+        generated = addEmployeeParameters().serialize(QString::fromLatin1("addEmployee"));
+        generated.setNamespaceUri(QString::fromLatin1(s_ns));
+        QTest::newRow("generated") << generated << QString() << KDSoapHeaders() << false;
+
+        // Parsed messages, as in builtinhttp and messagereader
+        QTest::newRow("parsedComplexType")
+            << parse(QByteArray(xmlEnvBegin11())
+                     + "><soap:Body xmlns:tns=\"http://www.sugarcrm.com/sugarcrm\">"
+                       "<ns1:loginResponse xmlns:ns1=\"http://www.sugarcrm.com/sugarcrm\">"
+                       "  <return xsi:type=\"tns:set_entry_result\">"
+                       "    <id xsi:type=\"xsd:string\">12345</id>"
+                       "    <error xsi:type=\"tns:error_value\">"
+                       "       <number xsi:type=\"xsd:string\">0</number>"
+                       "       <name xsi:type=\"xsd:string\">No Error</name>"
+                       "       <description xsi:type=\"xsd:string\">No Error</description>"
+                       "    </error>"
+                       "    <testArray ns1:attr=\"aValue\" xsi:type=\"soap-enc:Array\" soap-enc:arrayType=\"xsi:string\">"
+                       "    </testArray>"
+                       "  </return>"
+                       "</ns1:loginResponse>"
+                       "</soap:Body>"
+                     + xmlEnvEnd())
+            << QString() << KDSoapHeaders() << false;
+        KDSoapHeaders parsedHeaders;
+        const KDSoapMessage parsedRequest = parse("<soapenv:Envelope xmlns:soapenv=\"http://schemas.xmlsoap.org/soap/envelope/\" "
+                                                  "xmlns:dat=\"http://www.27seconds.com/Holidays/US/Dates/\">"
+                                                  "<soapenv:Header><dat:session>abc &amp; def</dat:session></soapenv:Header>"
+                                                  "<soapenv:Body><dat:GetEaster><dat:year>2011</dat:year>"
+                                                  "<dat:comment xml:lang=\"fr\">P&#226;ques</dat:comment></dat:GetEaster></soapenv:Body>"
+                                                  "</soapenv:Envelope>",
+                                                  &parsedHeaders);
+        QTest::newRow("parsedRequest") << parsedRequest << QString() << parsedHeaders << false;
+    }
+
+    void testMessages()
+    {
+        QFETCH(KDSoapMessage, message);
+        QFETCH(QString, method);
+        QFETCH(KDSoapHeaders, headers);
+        QFETCH(bool, soap12);
+        const KDSoap::SoapVersion version = soap12 ? KDSoap::SOAP1_2 : KDSoap::SOAP1_1;
+        const QString messageNamespace = QString::fromLatin1(s_ns);
+
+        const QByteArray expected = messageToXml(false, message, method, headers, messageNamespace, version);
+        const QByteArray xml = messageToXml(true, message, method, headers, messageNamespace, version);
+        QCOMPARE(QString::fromUtf8(xml), QString::fromUtf8(expected));
+        QCOMPARE(xml, expected);
+    }
+
+    void testPersistentHeadersAndAuthentication()
+    {
+        KDSoapMessage message;
+        message.addArgument(QLatin1String("employeeName"), QString::fromUtf8("David Ä Faure"));
+        KDSoapMessageAddressingProperties addressing;
+        addressing.setAction(QString::fromLatin1("http://www.kdab.com/getEmployeeCountry"));
+        addressing.setDestination(QString::fromLatin1("http://www.kdab.com/service"));
+        addressing.setMessageID(QString::fromLatin1("uuid:12345"));
+        addressing.setReplyEndpointAddress(KDSoapMessageAddressingProperties::predefinedAddressToString(KDSoapMessageAddressingProperties::Anonymous));
+        message.setMessageAddressingProperties(addressing);
+
+        QMap<QString, KDSoapMessage> persistentHeaders;
+        KDSoapMessage session;
+        session.addArgument(QLatin1String("sessionId"), QString::fromLatin1("s3ss10n"));
+        persistentHeaders.insert(QString::fromLatin1("session"), session);
+
+        KDSoapAuthentication authentication;
+        authentication.setUser(QString::fromLatin1("user"));
+        authentication.setPassword(QString::fromLatin1("p&ssword"));
+        authentication.setUseWSUsernameToken(true);
+        authentication.setOverrideWSUsernameNonce("nonce");
+        authentication.setOverrideWSUsernameCreatedTime(QDateTime(QDate(2023, 1, 1), QTime(12, 0), Qt::UTC));
+
+        const QString messageNamespace = QString::fromLatin1(s_ns);
+        const QByteArray expected =
+            messageToXml(false, message, QString::fromLatin1("getEmployeeCountry"), KDSoapHeaders(), messageNamespace, KDSoap::SOAP1_2, persistentHeaders, authentication);
+        QVERIFY(expected.contains(":Security>"));
+        const QByteArray xml =
+            messageToXml(true, message, QString::fromLatin1("getEmployeeCountry"), KDSoapHeaders(), messageNamespace, KDSoap::SOAP1_2, persistentHeaders, authentication);
+        QCOMPARE(xml, expected);
+
+        // With the persistent headers from the cache
+        KDSoapMessageWriter writer;
+        writer.setMessageNamespace(messageNamespace);
+        writer.setVersion(KDSoap::SOAP1_2);
+        writer.setPersistentHeadersCache(QSharedPointer<KDSoapPersistentHeadersCache>::create());
+        writer.setNativeXmlWriter(true);
+        for (int i = 0; i < 2; ++i) {
+            QCOMPARE(writer.messageToXml(message, QString::fromLatin1("getEmployeeCountry"), KDSoapHeaders(), persistentHeaders, authentication), expected);
+        }
+    }
+
+    // Requests prepared before the persistent headers change keep the old headers, without storing them in the cache
+    void testPersistentHeadersChanges()
+    {
+        KDSoapMessage message;
+        message.addArgument(QLatin1String("employeeName"), QString::fromLatin1("David"));
+        const QString messageNamespace = QString::fromLatin1(s_ns);
+        auto persistentHeaders = [](const QString &sessionId) -> QMap<QString, KDSoapMessage> {
+            KDSoapMessage session;
+            session.addArgument(QLatin1String("sessionId"), sessionId);
+            QMap<QString, KDSoapMessage> headers;
+            headers.insert(QString::fromLatin1("session"), session);
+            return headers;
+        };
+        const QMap<QString, KDSoapMessage> oldHeaders = persistentHeaders(QString::fromLatin1("old"));
+        const QMap<QString, KDSoapMessage> newHeaders = persistentHeaders(QString::fromLatin1("new"));
+        const QByteArray expectedOld = messageToXml(true, message, QString::fromLatin1("getEmployeeCountry"), KDSoapHeaders(), messageNamespace,
+                                                    KDSoap::SOAP1_1, oldHeaders, KDSoapAuthentication());
+        const QByteArray expectedNew = messageToXml(true, message, QString::fromLatin1("getEmployeeCountry"), KDSoapHeaders(), messageNamespace,
+                                                    KDSoap::SOAP1_1, newHeaders, KDSoapAuthentication());
+        QVERIFY(expectedOld.contains(">old<"));
+        QVERIFY(expectedNew.contains(">new<"));
+
+        const auto cache = QSharedPointer<KDSoapPersistentHeadersCache>::create();
+        KDSoapMessageWriter oldWriter;
+        oldWriter.setMessageNamespace(messageNamespace);
+        oldWriter.setNativeXmlWriter(true);
+        oldWriter.setPersistentHeadersCache(cache);
+        QCOMPARE(oldWriter.messageToXml(message, QString::fromLatin1("getEmployeeCountry"), KDSoapHeaders(), oldHeaders), expectedOld);
+
+        cache->headersChanged();
+        KDSoapMessageWriter newWriter = oldWriter;
+        newWriter.setPersistentHeadersCache(cache);
+        // The old writer doesn't fill the cache with the old headers...
+        QCOMPARE(oldWriter.messageToXml(message, QString::fromLatin1("getEmployeeCountry"), KDSoapHeaders(), oldHeaders), expectedOld);
+        QCOMPARE(newWriter.messageToXml(message, QString::fromLatin1("getEmployeeCountry"), KDSoapHeaders(), newHeaders), expectedNew);
+        // ...nor takes the new ones from it
+        QCOMPARE(oldWriter.messageToXml(message, QString::fromLatin1("getEmployeeCountry"), KDSoapHeaders(), oldHeaders), expectedOld);
+        QCOMPARE(newWriter.messageToXml(message, QString::fromLatin1("getEmployeeCountry"), KDSoapHeaders(), newHeaders), expectedNew);
+    }
+
+    void testContentsWriter()
+    {
+        // Written with QXmlStreamWriter anyway
+        const KDAB__AddEmployee params = addEmployeeParameters();
+        KDSoapMessage message;
+        message = KDSoapValue(QString::fromLatin1("addEmployee"), QVariant());
+        message.setNamespaceUri(QString::fromLatin1(s_ns));
+        message.setContentsWriter([params](QXmlStreamWriter &writer, const QString &messageNamespace) { params.writeXml(writer, messageNamespace); });
+
+        KDSoapMessageWriter writer;
+        writer.setNativeXmlWriter(true);
+        QVERIFY(!writer.usesNativeXmlWriter(message));
+        const QByteArray xml = writer.messageToXml(message, QString(), KDSoapHeaders(), QMap<QString, KDSoapMessage>());
+        QVERIFY(xml.contains("<n1:otherRoles>Tester</n1:otherRoles>"));
+    }
+
+    void testClientInterface()
+    {
+        const QByteArray response = QByteArray(xmlEnvBegin11()) + "><soap:Body/>";
+        HttpServerThread server(response, HttpServerThread::Public);
+        KDSoapClientInterface client(server.endPoint(), QString::fromLatin1(s_ns));
+        KDSoapMessage message;
+        message.setUse(KDSoapMessage::EncodedUse);
+        message.addArgument(QLatin1String("testString"), QString::fromUtf8("Hello Klarälvdalens <&>"));
+        message.addArgument(QLatin1String("testBinary"), QByteArray(10000, 'K'));
+
+        client.call(QLatin1String("test"), message);
+        const QByteArray expected = server.receivedData();
+        QVERIFY(!expected.isEmpty());
+
+        QVERIFY(!client.nativeXmlWriter());
+        client.setNativeXmlWriter(true);
+        QVERIFY(client.nativeXmlWriter());
+        server.resetReceivedBuffers();
+        client.call(QLatin1String("test"), message);
+        QCOMPARE(server.receivedData(), expected);
+
+        // And while streaming the request
+        client.setStreamingRequests(true);
+        server.resetReceivedBuffers();
+        client.call(QLatin1String("test"), message);
+        QCOMPARE(server.receivedData(), expected);
+    }
+};
+
+QTEST_MAIN(NativeXmlWriterTest)
+
+#include "test_native_xml_writer.moc"
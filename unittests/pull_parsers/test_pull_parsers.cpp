@@ -0,0 +1,143 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#include "httpserver_p.h"
+#include "wsdl_mywsdl_document.h"
+#include <QDebug>
+#include <QTest>
+
+using namespace KDSoapUnitTestHelpers;
+
+// The responses of the blocking calls are deserialized by the generated deserialize(QXmlStreamReader&)
+class PullParsersTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testEmployeeType()
+    {
+        HttpServerThread server(employeeTypeResponse(1), HttpServerThread::Public);
+        MyWsdlDocument service;
+        service.setEndPoint(server.endPoint());
+
+        const KDAB__EmployeeType employeeType = service.getEmployeeType(employeeNameParams());
+        QVERIFY2(service.lastError().isEmpty(), qPrintable(service.lastError()));
+        QCOMPARE(employeeType.type().type(), KDAB__EmployeeTypeEnum::Developer);
+        QCOMPARE(employeeType.team().count(), 1);
+        QCOMPARE(employeeType.team().first().value().value(), QLatin1String("Minitel"));
+        QCOMPARE(employeeType.otherRoles().count(), 1);
+        QCOMPARE(employeeType.otherRoles().at(0).type(), KDAB__EmployeeTypeEnum::TeamLeader);
+    }
+
+    // Big enough to be received in several chunks, which are parsed while the rest is received
+    void testLargeResponse()
+    {
+        const int roleCount = 50000;
+        HttpServerThread server(employeeTypeResponse(roleCount), HttpServerThread::Public);
+        MyWsdlDocument service;
+        service.setEndPoint(server.endPoint());
+
+        const KDAB__EmployeeType employeeType = service.getEmployeeType(employeeNameParams());
+        QVERIFY2(service.lastError().isEmpty(), qPrintable(service.lastError()));
+        QCOMPARE(employeeType.otherRoles().count(), roleCount);
+        QCOMPARE(employeeType.otherRoles().last().type(), KDAB__EmployeeTypeEnum::TeamLeader);
+        QCOMPARE(employeeType.team().first().value().value(), QLatin1String("Minitel"));
+    }
+
+    // Namespaces declared by nested elements
+    void testNestedNamespaceDeclarations()
+    {
+        const QByteArray responseData = QByteArray(xmlEnvBegin11())
+            + "><soap:Body>"
+              "<kdab:getEmployeeCountryResponse xmlns:kdab=\"http://www.kdab.com/xml/MyWsdl/\">"
+              "<kdab:employeeCountry>France</kdab:employeeCountry>"
+              "<n1:repeatedName xmlns:n1=\"http://www.kdab.com/xml/MyWsdl/\" xmlns:s=\"http://www.w3.org/2001/XMLSchema\">"
+              "<n1:stringparam1 xsi:type=\"s:string\">Paris</n1:stringparam1>"
+              "</n1:repeatedName>"
+              "</kdab:getEmployeeCountryResponse>"
+              "</soap:Body>"
+            + xmlEnvEnd();
+        HttpServerThread server(responseData, HttpServerThread::Public);
+        MyWsdlDocument service;
+        service.setEndPoint(server.endPoint());
+
+        const KDAB__EmployeeCountryResponse response = service.getEmployeeCountry(employeeNameParams());
+        QVERIFY2(service.lastError().isEmpty(), qPrintable(service.lastError()));
+        QCOMPARE(response.employeeCountry().value(), QLatin1String("France"));
+        QCOMPARE(response.repeatedName().stringparam1(), QLatin1String("Paris"));
+    }
+
+    void testFault()
+    {
+        const QByteArray responseData = QByteArray(xmlEnvBegin11())
+            + "><soap:Body>"
+              "<soap:Fault>"
+              "<faultcode>soap:Server</faultcode>"
+              "<faultstring>Employee not found</faultstring>"
+              "</soap:Fault>"
+              "</soap:Body>"
+            + xmlEnvEnd();
+        HttpServerThread server(responseData, HttpServerThread::Public);
+        MyWsdlDocument service;
+        service.setEndPoint(server.endPoint());
+
+        const KDAB__EmployeeType employeeType = service.getEmployeeType(employeeNameParams());
+        QVERIFY(service.lastError().contains(QLatin1String("Employee not found")));
+        QCOMPARE(employeeType.otherRoles().count(), 0);
+    }
+
+    // The error of the network reply is reported, not the failure to parse its body
+    void testHttpError()
+    {
+        HttpServerThread server(QByteArray(), HttpServerThread::Public | HttpServerThread::Error404);
+        MyWsdlDocument service;
+        service.setEndPoint(server.endPoint());
+
+        service.getEmployeeType(employeeNameParams());
+        QVERIFY(service.lastError().contains(QLatin1String("Not Found")));
+    }
+
+    void testInvalidResponse()
+    {
+        const QByteArray responseData = QByteArray(xmlEnvBegin11()) + "><soap:Body><kdab:getEmployeeTypeResponse xmlns:kdab=\"http://www.kdab.com/xml/MyWsdl/\">";
+        HttpServerThread server(responseData, HttpServerThread::Public);
+        MyWsdlDocument service;
+        service.setEndPoint(server.endPoint());
+
+        service.getEmployeeType(employeeNameParams());
+        QVERIFY(!service.lastError().isEmpty());
+    }
+
+private:
+    static KDAB__EmployeeNameParams employeeNameParams()
+    {
+        KDAB__EmployeeNameParams params;
+        params.setEmployeeName(KDAB__EmployeeName(QLatin1String("Joe")));
+        return params;
+    }
+
+    static QByteArray employeeTypeResponse(int roleCount)
+    {
+        QByteArray responseData = QByteArray(xmlEnvBegin11())
+            + "><soap:Body>"
+              "<kdab:getEmployeeTypeResponse xmlns:kdab=\"http://www.kdab.com/xml/MyWsdl/\" kdab:type=\"Developer\">";
+        for (int i = 0; i < roleCount; ++i) {
+            responseData += "<kdab:otherRoles>TeamLeader</kdab:otherRoles>";
+        }
+        responseData += "<kdab:team>Minitel</kdab:team>"
+                        "</kdab:getEmployeeTypeResponse>"
+                        "</soap:Body>";
+        return responseData + xmlEnvEnd();
+    }
+};
+
+QTEST_MAIN(PullParsersTest)
+
+#include "test_pull_parsers.moc"
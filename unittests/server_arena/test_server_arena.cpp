@@ -0,0 +1,285 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#include "KDSoapClientInterface.h"
+#include "KDSoapMessage.h"
+#include "KDSoapPendingCallWatcher.h"
+#include "KDSoapServer.h"
+#include "KDSoapServerObjectInterface.h"
+#include "KDSoapThreadPool.h"
+#include "KDSoapValue.h"
+#include "KDSoapValueArena_p.h"
+#include "httpserver_p.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QTest>
+
+#include <atomic>
+#include <cstdlib>
+
+using namespace KDSoapUnitTestHelpers;
+
+static const char s_ns[] = "http://www.kdab.com/xml/MyWsdl/";
+
+// Counts the allocations made in the threads of the server, by replacing malloc (glibc only).
+// That includes the allocations of Qt, and the ones of operator new.
+static std::atomic<qint64> s_serverAllocations(0);
+static thread_local bool t_serverThread = false;
+
+#if defined(__GLIBC__)
+#define COUNT_ALLOCATIONS
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size)
+{
+    if (t_serverThread) {
+        s_serverAllocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    if (t_serverThread) {
+        s_serverAllocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    if (t_serverThread) {
+        s_serverAllocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    return __libc_realloc(ptr, size);
+}
+}
+#endif
+
+class SumServerObject : public QObject, public KDSoapServerObjectInterface
+{
+    Q_OBJECT
+    Q_INTERFACES(KDSoapServerObjectInterface)
+public:
+    SumServerObject()
+    {
+        t_serverThread = true; // created in the thread handling the requests
+    }
+
+    void processRequest(const KDSoapMessage &request, KDSoapMessage &response, const QByteArray &soapAction) override
+    {
+        if (request.name() == QLatin1String("sum")) {
+            const KDSoapValueList items = request.childValues().child(QLatin1String("items")).childValues();
+            int sum = 0;
+            KDSoapValueList echoed;
+            for (const KDSoapValue &item : items) {
+                sum += item.value().toInt();
+                echoed.append(KDSoapValue(QLatin1String("item"), item.value()));
+            }
+            response.addArgument(QLatin1String("sum"), sum);
+            response.addArgument(QLatin1String("items"), echoed);
+        } else {
+            KDSoapServerObjectInterface::processRequest(request, response, soapAction);
+        }
+    }
+};
+
+class SumServer : public KDSoapServer
+{
+    Q_OBJECT
+public:
+    QObject *createServerObject() override
+    {
+        return new SumServerObject;
+    }
+};
+
+static KDSoapMessage sumMessage(int count)
+{
+    KDSoapValueList items;
+    for (int i = 0; i < count; ++i) {
+        items.append(KDSoapValue(QLatin1String("item"), i));
+    }
+    KDSoapMessage message;
+    message.addArgument(QLatin1String("items"), items);
+    return message;
+}
+
+// Makes \p callsPerClient calls from each of \p numClients clients, all at the same time.
+// Returns the number of successful calls.
+static int makeCalls(const QString &endPoint, int numClients, int callsPerClient, const KDSoapMessage &message, int expectedSum)
+{
+    QVector<KDSoapClientInterface *> clients;
+    QEventLoop loop;
+    int pending = numClients * callsPerClient;
+    int succeeded = 0;
+    for (int i = 0; i < numClients; ++i) {
+        KDSoapClientInterface *client = new KDSoapClientInterface(endPoint, QString::fromLatin1(s_ns));
+        clients.append(client);
+        for (int j = 0; j < callsPerClient; ++j) {
+            KDSoapPendingCallWatcher *watcher = new KDSoapPendingCallWatcher(client->asyncCall(QLatin1String("sum"), message), &loop);
+            QObject::connect(watcher, &KDSoapPendingCallWatcher::finished, &loop, [&, watcher]() {
+                const KDSoapMessage reply = watcher->returnMessage();
+                if (!reply.isFault() && reply.childValues().child(QLatin1String("sum")).value().toInt() == expectedSum) {
+                    ++succeeded;
+                }
+                watcher->deleteLater();
+                if (--pending == 0) {
+                    loop.quit();
+                }
+            });
+        }
+    }
+    loop.exec();
+    qDeleteAll(clients);
+    return succeeded;
+}
+
+class ServerArenaTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testSameResponses()
+    {
+        const KDSoapMessage message = sumMessage(10);
+        for (bool arena : {false, true}) {
+            TestServerThread<SumServer> serverThread;
+            SumServer *server = serverThread.startThread();
+            QVERIFY(server);
+            if (arena) {
+                server->setFeatures(KDSoapServer::RequestArena);
+            }
+            KDSoapClientInterface client(server->endPoint(), QString::fromLatin1(s_ns));
+            // The arena of a request is reused for the next ones
+            for (int i = 0; i < 3; ++i) {
+                const KDSoapMessage reply = client.call(QLatin1String("sum"), message);
+                QVERIFY2(!reply.isFault(), qPrintable(reply.faultAsString()));
+                QCOMPARE(reply.childValues().child(QLatin1String("sum")).value().toInt(), 45);
+                const KDSoapValueList items = reply.childValues().child(QLatin1String("items")).childValues();
+                QCOMPARE(items.count(), 10);
+                QCOMPARE(items.at(9).value().toInt(), 9);
+            }
+        }
+    }
+
+    void testArenaReset()
+    {
+        KDSoapValueArena arena;
+        arena.m_text.fill(QLatin1Char('x'), 1000);
+        arena.m_nodes.resize(100);
+        const int textCapacity = arena.m_text.capacity();
+        const int nodesCapacity = arena.m_nodes.capacity();
+        arena.reset();
+        QVERIFY(arena.m_text.isEmpty());
+        QVERIFY(arena.m_nodes.isEmpty());
+        // The memory of a usual message is kept for the next one
+        QCOMPARE(arena.m_text.capacity(), textCapacity);
+        QCOMPARE(arena.m_nodes.capacity(), nodesCapacity);
+
+        // ... but not the one of a large message
+        arena.m_text.fill(QLatin1Char('x'), 1000 * 1000);
+        arena.m_nodes.resize(100 * 1000);
+        arena.reset();
+        QVERIFY(arena.m_text.isEmpty());
+        QVERIFY(arena.m_nodes.isEmpty());
+        QVERIFY(arena.m_text.capacity() * int(sizeof(QChar)) <= KDSoapValueArena::s_maximumKeptMemory);
+        QVERIFY(arena.m_nodes.capacity() * int(sizeof(KDSoapValueArena::Node)) <= KDSoapValueArena::s_maximumKeptMemory);
+    }
+
+    void testLargeRequest()
+    {
+        TestServerThread<SumServer> serverThread;
+        SumServer *server = serverThread.startThread();
+        QVERIFY(server);
+        server->setFeatures(KDSoapServer::RequestArena);
+        KDSoapClientInterface client(server->endPoint(), QString::fromLatin1(s_ns));
+        // The arena and the response buffer shrink back after the large request
+        for (int count : {10, 20000, 10, 10}) {
+            const KDSoapMessage reply = client.call(QLatin1String("sum"), sumMessage(count));
+            QVERIFY2(!reply.isFault(), qPrintable(reply.faultAsString()));
+            QCOMPARE(reply.childValues().child(QLatin1String("sum")).value().toInt(), count * (count - 1) / 2);
+            QCOMPARE(reply.childValues().child(QLatin1String("items")).childValues().count(), count);
+        }
+    }
+
+    void testAllocationsPerRequest()
+    {
+#ifndef COUNT_ALLOCATIONS
+        QSKIP("Allocations can only be counted with glibc");
+#else
+        const int numRequests = 50;
+        const KDSoapMessage message = sumMessage(100);
+        qint64 allocations[2];
+        for (bool arena : {false, true}) {
+            KDSoapThreadPool threadPool;
+            threadPool.setMaxThreadCount(1);
+            TestServerThread<SumServer> serverThread;
+            SumServer *server = serverThread.startThread();
+            QVERIFY(server);
+            server->setThreadPool(&threadPool);
+            server->setFeatures(arena ? KDSoapServer::RequestArena : KDSoapServer::Public);
+            QCOMPARE(makeCalls(server->endPoint(), 1, 1, message, 4950), 1); // creates the server object and the arena
+            s_serverAllocations = 0;
+            QCOMPARE(makeCalls(server->endPoint(), 1, numRequests, message, 4950), numRequests);
+            allocations[arena] = s_serverAllocations / numRequests;
+            qDebug() << (arena ? "RequestArena:" : "Default:") << allocations[arena] << "allocations per request";
+        }
+        QVERIFY(allocations[true] < allocations[false]);
+#endif
+    }
+
+    void testThroughput_data()
+    {
+        QTest::addColumn<int>("threads");
+        QTest::addColumn<bool>("arena");
+
+        for (int threads : {1, 2, 4, 8}) {
+            QTest::newRow(qPrintable(QStringLiteral("%1_threads").arg(threads))) << threads << false;
+            QTest::newRow(qPrintable(QStringLiteral("%1_threads_arena").arg(threads))) << threads << true;
+        }
+    }
+
+    // Note that the clients run in the same process, in the main thread: with many server threads,
+    // they become the bottleneck. Run against a server on another machine for absolute numbers.
+    void testThroughput()
+    {
+        QFETCH(int, threads);
+        QFETCH(bool, arena);
+        const int numClients = 8; // with 6 connections each, see testMultipleThreads in serverlib
+        const int callsPerClient = 30;
+        const KDSoapMessage message = sumMessage(100);
+
+        KDSoapThreadPool threadPool;
+        threadPool.setMaxThreadCount(threads);
+        TestServerThread<SumServer> serverThread;
+        SumServer *server = serverThread.startThread();
+        QVERIFY(server);
+        server->setThreadPool(&threadPool);
+        server->setFeatures(arena ? KDSoapServer::RequestArena : KDSoapServer::Public);
+
+        s_serverAllocations = 0;
+        QElapsedTimer timer;
+        timer.start();
+        QCOMPARE(makeCalls(server->endPoint(), numClients, callsPerClient, message, 4950), numClients * callsPerClient);
+        const qint64 elapsed = qMax<qint64>(timer.elapsed(), 1);
+        const int numRequests = numClients * callsPerClient;
+        qDebug() << threads << "threads:" << numRequests * 1000 / elapsed << "requests/s," << s_serverAllocations / numRequests
+                 << "allocations per request";
+    }
+};
+
+QTEST_MAIN(ServerArenaTest)
+
+#include "test_server_arena.moc"
@@ -10,6 +10,7 @@
 
 #include "KDSoapAuthentication.h"
 #include "KDSoapClientInterface.h"
+#include "KDSoapDelayedResponseHandle.h"
 #include "KDSoapMessage.h"
 #include "KDSoapNamespaceManager.h"
 #include "KDSoapPendingCallWatcher.h"
@@ -23,6 +24,7 @@
 #include "httpserver_p.h" // KDSoapUnitTestHelpers
 #include <QAuthenticator>
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
@@ -200,6 +202,7 @@ public: // SOAP-accessible methods
         if (employeeName == QLatin1String("Slow")) {
             PublicThread::msleep(100);
         }
+        m_callCount.ref();
         return employeeName + QString::fromLatin1(" France");
     }
 
@@ -232,11 +235,17 @@ public: // SOAP-accessible methods
         return input1 + input2;
     }
 
+    int callCount() const
+    {
+        return m_callCount.loadAcquire();
+    }
+
 private:
     bool m_requireAuth;
     bool m_useRawXML;
     bool m_rawXMLValid;
     QByteArray m_assembledXML;
+    QAtomicInt m_callCount;
 };
 
 class CountryServer : public KDSoapServer
@@ -599,6 +608,45 @@ private Q_SLOTS:
         QCOMPARE(s_serverObjects.count(), 0);
     }
 
+    void testIdleConnectionsSpreadOverThreads()
+    {
+        const int maxThreads = 3;
+        const int connectionsPerThread = 2;
+        {
+            KDSoapThreadPool threadPool;
+            threadPool.setMaxThreadCount(maxThreads);
+            CountryServerThread serverThread(&threadPool);
+            CountryServer *server = serverThread.startThread();
+
+            // Keep-alive connections which don't send anything yet: none of them is active
+            QVector<ClientSocket *> sockets;
+            for (int i = 0; i < maxThreads * connectionsPerThread; ++i) {
+                sockets.append(new ClientSocket(server));
+                QVERIFY(sockets.last()->waitForConnected());
+                QTRY_COMPARE(server->numConnectedSockets(), i + 1);
+            }
+            QTRY_COMPARE(s_serverObjects.count(), maxThreads);
+
+            // When they become active, each thread handles its share
+            for (ClientSocket *socket : qAsConst(sockets)) {
+                socket->write(socketRequest("David"));
+                QVERIFY(socket->waitForBytesWritten());
+                QByteArray received;
+                QByteArray response;
+                QVERIFY(readSocketResponse(*socket, received, response));
+                QVERIFY(response.startsWith("HTTP/1.1 200 OK"));
+            }
+            {
+                QMutexLocker locker(&s_serverObjectsMutex);
+                for (const CountryServerObject *serverObject : qAsConst(s_serverObjects)) {
+                    QCOMPARE(serverObject->callCount(), connectionsPerThread);
+                }
+            }
+            qDeleteAll(sockets);
+        }
+        QCOMPARE(s_serverObjects.count(), 0);
+    }
+
 // OSX: "Fault code 99: Unknown error", sometimes
 // Windows/Linux with Qt 4.8 or 5.5: nothing happens after "82 sockets seen. 100 connected right now. Messages received 100"
 #if 0
@@ -1218,6 +1266,113 @@ private Q_SLOTS:
         }
     }
 
+    void testPipelining_data()
+    {
+        QTest::addColumn<int>("maxPipelineDepth");
+        QTest::addColumn<bool>("firstDelayed");
+
+        QTest::newRow("default") << 16 << false;
+        QTest::newRow("default_delayed") << 16 << true;
+        QTest::newRow("depth_1") << 1 << false;
+        QTest::newRow("depth_1_delayed") << 1 << true;
+        QTest::newRow("depth_2_delayed") << 2 << true;
+    }
+
+    // HTTP/1.1 pipelining: several requests sent at once, the responses come back in the same order
+    void testPipelining()
+    {
+        QFETCH(int, maxPipelineDepth);
+        QFETCH(bool, firstDelayed);
+        CountryServerThread serverThread;
+        CountryServer *server = serverThread.startThread();
+        server->setMaxPipelineDepth(maxPipelineDepth);
+
+        QList<QByteArray> employeeNames;
+        employeeNames << (firstDelayed ? "Delayed" : "First") << "Second"
+                      << "Third" << s_longEmployeeName;
+        QByteArray requests;
+        for (const QByteArray &employeeName : qAsConst(employeeNames)) {
+            requests += socketRequest(employeeName);
+        }
+        ClientSocket socket(server);
+        QVERIFY(socket.waitForConnected());
+        socket.write(requests);
+        QVERIFY(socket.waitForBytesWritten());
+
+        QByteArray received;
+        for (const QByteArray &employeeName : qAsConst(employeeNames)) {
+            QByteArray response;
+            QVERIFY(readSocketResponse(socket, received, response));
+            const QByteArray responseFirstLine = response.left(response.indexOf("\r\n"));
+            QCOMPARE(QString::fromUtf8(responseFirstLine.constData()), QString("HTTP/1.1 200 OK"));
+            const QByteArray xmlResponse = response.mid(response.indexOf("\r\n\r\n") + 4);
+            QVERIFY(xmlBufferCompare(xmlResponse, expectedCountryResponse(employeeName)));
+        }
+        QVERIFY(received.isEmpty());
+    }
+
+    void testMaxRequestsPerConnection()
+    {
+        CountryServerThread serverThread;
+        CountryServer *server = serverThread.startThread();
+        server->setMaxRequestsPerConnection(2);
+
+        ClientSocket socket(server);
+        QVERIFY(socket.waitForConnected());
+        socket.write(socketRequest("First") + socketRequest("Second") + socketRequest("Third"));
+        QVERIFY(socket.waitForBytesWritten());
+
+        QByteArray received;
+        QByteArray response;
+        QVERIFY(readSocketResponse(socket, received, response));
+        QVERIFY(response.startsWith("HTTP/1.1 200 OK"));
+        QVERIFY(!response.contains("Connection: close"));
+        QVERIFY(readSocketResponse(socket, received, response));
+        QVERIFY(response.startsWith("HTTP/1.1 200 OK"));
+        QVERIFY(response.contains("\r\nConnection: close\r\n"));
+        // The third request is ignored
+        QVERIFY(received.isEmpty());
+        QVERIFY(socket.state() == QAbstractSocket::UnconnectedState || socket.waitForDisconnected());
+    }
+
+    void testKeepAliveTimeout_data()
+    {
+        QTest::addColumn<int>("keepAliveTimeout");
+        QTest::addColumn<int>("maxConnectionLifetime");
+        QTest::addColumn<bool>("sendRequest");
+
+        QTest::newRow("idle_after_request") << 200 << 0 << true;
+        QTest::newRow("nothing_sent") << 200 << 0 << false;
+        QTest::newRow("lifetime") << 0 << 300 << true;
+    }
+
+    void testKeepAliveTimeout()
+    {
+        QFETCH(int, keepAliveTimeout);
+        QFETCH(int, maxConnectionLifetime);
+        QFETCH(bool, sendRequest);
+        CountryServerThread serverThread;
+        CountryServer *server = serverThread.startThread();
+        server->setKeepAliveTimeout(keepAliveTimeout);
+        server->setMaxConnectionLifetime(maxConnectionLifetime);
+
+        ClientSocket socket(server);
+        QVERIFY(socket.waitForConnected());
+        QElapsedTimer timer;
+        timer.start();
+        if (sendRequest) {
+            socket.write(socketRequest("David"));
+            QVERIFY(socket.waitForBytesWritten());
+            QByteArray received;
+            QByteArray response;
+            QVERIFY(readSocketResponse(socket, received, response));
+            QVERIFY(!response.contains("Connection: close")); // sent before the end of its lifetime
+        }
+        // Closed by the server
+        QVERIFY(socket.waitForDisconnected(5000));
+        QVERIFY(timer.elapsed() >= qMax(keepAliveTimeout, maxConnectionLifetime) / 2);
+    }
+
     void testContentTypeParsing() // SOAP 112
     {
         CountryServerThread serverThread;
@@ -1326,10 +1481,22 @@ private Q_SLOTS:
 #endif
     }
 
+    void testAdditionalHttpResponseHeaderItems_data()
+    {
+        QTest::addColumn<bool>("staticHeaders");
+
+        QTest::newRow("default") << false;
+        QTest::newRow("static") << true;
+    }
+
     void testAdditionalHttpResponseHeaderItems()
     {
+        QFETCH(bool, staticHeaders);
         CountryServerThread serverThread;
         CountryServer *server = serverThread.startThread();
+        if (staticHeaders) {
+            server->setFeatures(KDSoapServer::StaticResponseHeaders);
+        }
 
         QUrl url(server->endPoint());
         QNetworkRequest request(url);
@@ -1337,16 +1504,20 @@ private Q_SLOTS:
         QString soapHeader = QString::fromLatin1("text/xml;charset=utf-8");
         request.setHeader(QNetworkRequest::ContentTypeHeader, soapHeader.toUtf8());
         QNetworkAccessManager accessManager;
-        QNetworkReply *reply = accessManager.post(request, rawCountryMessage());
-        QEventLoop loop;
-        connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
-        loop.exec();
-        reply->readAll();
-
-        QVERIFY(reply->rawHeaderList().contains("Access-Control-Allow-Origin"));
-        QCOMPARE(reply->rawHeader("Access-Control-Allow-Origin").constData(), "*");
-        QVERIFY(reply->rawHeaderList().contains("Access-Control-Allow-Headers"));
-        QCOMPARE(reply->rawHeader("Access-Control-Allow-Headers").constData(), "Content-Type");
+        // The second response reuses the headers rendered for the first one, with StaticResponseHeaders
+        for (int i = 0; i < 2; ++i) {
+            QNetworkReply *reply = accessManager.post(request, rawCountryMessage());
+            QEventLoop loop;
+            connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
+            loop.exec();
+            QVERIFY(xmlBufferCompare(reply->readAll(), expectedCountryResponse()));
+
+            QVERIFY(reply->rawHeaderList().contains("Access-Control-Allow-Origin"));
+            QCOMPARE(reply->rawHeader("Access-Control-Allow-Origin").constData(), "*");
+            QVERIFY(reply->rawHeaderList().contains("Access-Control-Allow-Headers"));
+            QCOMPARE(reply->rawHeader("Access-Control-Allow-Headers").constData(), "Content-Type");
+            delete reply;
+        }
     }
 
     void testTimeout()
@@ -1450,6 +1621,43 @@ private:
         return QString::fromUtf8("David Ä Faure France");
     }
 
+    static QByteArray socketRequest(const QByteArray &employeeName)
+    {
+        const QByteArray message = rawCountryMessage(employeeName);
+        return "POST / HTTP/1.1\r\n"
+               "SoapAction: http://www.kdab.com/xml/MyWsdl/getEmployeeCountry\r\n"
+               "Content-Type: text/xml;charset=utf-8\r\n"
+               "Content-Length: "
+            + QByteArray::number(message.size()) + "\r\n\r\n" + message;
+    }
+
+    // Takes one response (with a Content-Length) from what was received so far, reading more if needed
+    static bool readSocketResponse(ClientSocket &socket, QByteArray &received, QByteArray &response)
+    {
+        for (;;) {
+            const int headersEnd = received.indexOf("\r\n\r\n");
+            if (headersEnd >= 0) {
+                const QByteArray headers = received.left(headersEnd).toLower();
+                const int lengthPos = headers.indexOf("content-length:");
+                if (lengthPos < 0) {
+                    return false;
+                }
+                const int lengthEnd = headers.indexOf("\r\n", lengthPos);
+                const int length = headers.mid(lengthPos + 15, lengthEnd < 0 ? -1 : lengthEnd - lengthPos - 15).trimmed().toInt();
+                const int size = headersEnd + 4 + length;
+                if (received.size() >= size) {
+                    response = received.left(size);
+                    received.remove(0, size);
+                    return true;
+                }
+            }
+            if (!socket.waitForReadyRead()) {
+                return false;
+            }
+            received += socket.readAll();
+        }
+    }
+
     void verifySocketResponse(ClientSocket &socket, const QByteArray &employeeName)
     {
         QVERIFY(socket.waitForReadyRead());
@@ -1532,6 +1740,17 @@ void CountryServerObject::processRequest(const KDSoapMessage &request, KDSoapMes
             return;
         }
         const QString employeeName = request.childValues().child(QLatin1String("employeeName")).value().toString();
+        if (employeeName == QLatin1String("Delayed")) {
+            // Answered later: the responses to the requests pipelined after this one must wait
+            const KDSoapDelayedResponseHandle handle = prepareDelayedResponse();
+            QTimer::singleShot(100, this, [this, handle]() {
+                KDSoapMessage delayedResponse;
+                delayedResponse.setValue(QLatin1String("getEmployeeCountryResponse"));
+                delayedResponse.addArgument(QLatin1String("employeeCountry"), QString::fromLatin1("Delayed France"));
+                sendDelayedResponse(handle, delayedResponse);
+            });
+            return;
+        }
         const QString ret = this->getEmployeeCountry(employeeName);
         if (!hasFault()) {
             response.setValue(QLatin1String("getEmployeeCountryResponse"));
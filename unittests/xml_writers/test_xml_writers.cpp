@@ -0,0 +1,104 @@
+/****************************************************************************
+**
+** This file is part of the KD Soap project.
+**
+** SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+**
+** SPDX-License-Identifier: MIT
+**
+****************************************************************************/
+
+#include "KDSoapMessageWriter_p.h"
+#include "httpserver_p.h"
+#include "wsdl_mywsdl_document.h"
+#include <QDebug>
+#include <QTest>
+
+using namespace KDSoapUnitTestHelpers;
+
+static const char s_ns[] = "http://www.kdab.com/xml/MyWsdl/";
+
+class XmlWritersTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    static KDAB__AddEmployee addEmployeeParameters()
+    {
+        KDAB__EmployeeAchievements achievements;
+        QList<KDAB__EmployeeAchievement> lst;
+        KDAB__EmployeeAchievement achievement;
+        achievement.setType(QByteArray("Project"));
+        achievement.setLabel(QString::fromLatin1("Management"));
+        achievement.setTime(QDate(2011, 06, 27));
+        lst.append(achievement);
+        achievements.setItems(lst);
+        KDAB__EmployeeType employeeType;
+        employeeType.setType(KDAB__EmployeeTypeEnum::Developer);
+        employeeType.setOtherRoles(QList<KDAB__EmployeeTypeEnum>() << KDAB__EmployeeTypeEnum::TeamLeader << KDAB__EmployeeTypeEnum::Tester);
+        employeeType.setTeam(QList<KDAB__TeamName>() << QString::fromLatin1("Minitel"));
+
+        KDAB__AddEmployee addEmployeeParams;
+        addEmployeeParams.setEmployeeType(employeeType);
+        addEmployeeParams.setEmployeeName(QString::fromLatin1("David Faure"));
+        addEmployeeParams.setEmployeeCountry(QString::fromLatin1("France"));
+        addEmployeeParams.setEmployeeAchievements(achievements);
+        KDAB__EmployeeId id;
+        id.setId(5);
+        addEmployeeParams.setEmployeeId(id);
+        return addEmployeeParams;
+    }
+
+    // The request as sent without writeXml()
+    static QByteArray serializedRequest(const KDAB__AddEmployee &params)
+    {
+        KDSoapMessage message;
+        message = params.serialize(QString::fromLatin1("addEmployee"));
+        message.setNamespaceUri(QString::fromLatin1(s_ns));
+        KDSoapMessageWriter writer;
+        return writer.messageToXml(message, QString(), KDSoapHeaders(), QMap<QString, KDSoapMessage>());
+    }
+
+    static QByteArray addEmployeeResponse()
+    {
+        return QByteArray(xmlEnvBegin11())
+            + "><soap:Body>"
+              "<kdab:addEmployeeResponse xmlns:kdab=\"http://www.kdab.com/xml/MyWsdl/\">466F6F</kdab:addEmployeeResponse>"
+              "</soap:Body>"
+            + xmlEnvEnd();
+    }
+
+private Q_SLOTS:
+    void testContentsWriter()
+    {
+        const KDAB__AddEmployee params = addEmployeeParameters();
+        KDSoapMessage message;
+        message = KDSoapValue(QString::fromLatin1("addEmployee"), QVariant());
+        message.setNamespaceUri(QString::fromLatin1(s_ns));
+        message.setContentsWriter([params](QXmlStreamWriter &writer, const QString &messageNamespace) { params.writeXml(writer, messageNamespace); });
+        QVERIFY(message.childValues().isEmpty());
+
+        KDSoapMessageWriter writer;
+        const QByteArray xml = writer.messageToXml(message, QString(), KDSoapHeaders(), QMap<QString, KDSoapMessage>());
+        QVERIFY(xml.contains("<n1:otherRoles>Tester</n1:otherRoles>"));
+        QVERIFY(xmlBufferCompare(xml, serializedRequest(params)));
+        QCOMPARE(QString::fromUtf8(xml), QString::fromUtf8(serializedRequest(params)));
+    }
+
+    void testClientCall()
+    {
+        HttpServerThread server(addEmployeeResponse(), HttpServerThread::Public);
+        MyWsdlDocument service;
+        service.setEndPoint(server.endPoint());
+
+        const KDAB__AddEmployee params = addEmployeeParameters();
+        const QByteArray ret = service.addEmployee(params);
+        QVERIFY2(service.lastError().isEmpty(), qPrintable(service.lastError()));
+        QCOMPARE(ret, QByteArray("Foo"));
+        QVERIFY(xmlBufferCompare(server.receivedData(), serializedRequest(params)));
+    }
+};
+
+QTEST_MAIN(XmlWritersTest)
+
+#include "test_xml_writers.moc"